@@ -0,0 +1,202 @@
+#pragma once
+#include "byte_swap.h"
+#include "platform.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BYTE_SWAP_ARRAY_SSE2
+#include <emmintrin.h>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define BYTE_SWAP_ARRAY_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif
+
+/*
+ * Bulk endian swapping copies between big endian guest memory and the host,
+ * such as guest register files and index buffers.
+ *
+ * pshufb is used when the compiler targets SSSE3, otherwise the swap is done
+ * with SSE2 shifts and shuffles which are always available on x86-64.
+ */
+
+#ifdef BYTE_SWAP_ARRAY_SSE2
+
+namespace byte_swap_array_detail
+{
+
+// Swap the bytes within each 16 bit lane
+inline __m128i
+swap16(__m128i x)
+{
+   return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+inline __m128i
+swap32(__m128i x)
+{
+#ifdef BYTE_SWAP_ARRAY_SSSE3
+   return _mm_shuffle_epi8(x, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+                                           4, 5, 6, 7, 0, 1, 2, 3));
+#else
+   x = swap16(x);
+   x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+   return _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+#endif
+}
+
+inline __m128i
+swap64(__m128i x)
+{
+#ifdef BYTE_SWAP_ARRAY_SSSE3
+   return _mm_shuffle_epi8(x, _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15,
+                                           0, 1, 2, 3, 4, 5, 6, 7));
+#else
+   x = swap16(x);
+   x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+   return _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+#endif
+}
+
+inline __m128i
+load(const void *src)
+{
+   return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+}
+
+inline void
+store(void *dst, __m128i x)
+{
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), x);
+}
+
+} // namespace byte_swap_array_detail
+
+#endif // BYTE_SWAP_ARRAY_SSE2
+
+//! Copy count 16 bit values from src to dst, swapping the endian of each.
+inline void
+byte_swap_copy(uint16_t *dst,
+               const uint16_t *src,
+               size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_SSE2
+   using namespace byte_swap_array_detail;
+
+   for (; i + 8 <= count; i += 8) {
+      store(dst + i, swap16(load(src + i)));
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+//! Copy count 32 bit values from src to dst, swapping the endian of each.
+inline void
+byte_swap_copy(uint32_t *dst,
+               const uint32_t *src,
+               size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_SSE2
+   using namespace byte_swap_array_detail;
+
+   for (; i + 4 <= count; i += 4) {
+      store(dst + i, swap32(load(src + i)));
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+//! Copy count 64 bit values from src to dst, swapping the endian of each.
+inline void
+byte_swap_copy(uint64_t *dst,
+               const uint64_t *src,
+               size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_SSE2
+   using namespace byte_swap_array_detail;
+
+   for (; i + 2 <= count; i += 2) {
+      store(dst + i, swap64(load(src + i)));
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+/**
+ * Split count pairs of 64 bit values from src into dstLo and dstHi,
+ * swapping the endian of each.
+ *
+ * src[i * 2 + 0] is copied to dstLo[i] and src[i * 2 + 1] to dstHi[i].
+ */
+inline void
+byte_swap_copy_deinterleave(uint64_t *dstLo,
+                            uint64_t *dstHi,
+                            const uint64_t *src,
+                            size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_SSE2
+   using namespace byte_swap_array_detail;
+
+   for (; i + 2 <= count; i += 2) {
+      auto a = swap64(load(src + i * 2));
+      auto b = swap64(load(src + i * 2 + 2));
+      store(dstLo + i, _mm_unpacklo_epi64(a, b));
+      store(dstHi + i, _mm_unpackhi_epi64(a, b));
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dstLo[i] = byte_swap(src[i * 2 + 0]);
+      dstHi[i] = byte_swap(src[i * 2 + 1]);
+   }
+}
+
+/**
+ * Merge count 64 bit values from srcLo and srcHi into pairs in dst,
+ * swapping the endian of each.
+ *
+ * srcLo[i] is copied to dst[i * 2 + 0] and srcHi[i] to dst[i * 2 + 1].
+ */
+inline void
+byte_swap_copy_interleave(uint64_t *dst,
+                          const uint64_t *srcLo,
+                          const uint64_t *srcHi,
+                          size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_SSE2
+   using namespace byte_swap_array_detail;
+
+   for (; i + 2 <= count; i += 2) {
+      auto lo = swap64(load(srcLo + i));
+      auto hi = swap64(load(srcHi + i));
+      store(dst + i * 2, _mm_unpacklo_epi64(lo, hi));
+      store(dst + i * 2 + 2, _mm_unpackhi_epi64(lo, hi));
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i * 2 + 0] = byte_swap(srcLo[i]);
+      dst[i * 2 + 1] = byte_swap(srcHi[i]);
+   }
+}
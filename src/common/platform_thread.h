@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <thread>
 #include <string>
 
@@ -12,4 +14,31 @@ setThreadName(std::thread *thread,
 void
 exitThread(int result);
 
+/**
+ * Block the calling thread while *address == expected.
+ *
+ * May return spuriously, callers must re-check their condition.
+ */
+void
+waitOnAddress(std::atomic<uint32_t> *address,
+              uint32_t expected);
+
+//! Wake one thread blocked in waitOnAddress on address.
+void
+wakeOnAddress(std::atomic<uint32_t> *address);
+
+using ThreadSampleHandler = void(*)(void *userData, uintptr_t instructionPointer);
+
+/**
+ * Briefly stop thread and call handler with its current instruction pointer.
+ *
+ * Returns once handler has completed. The handler may run on the target
+ * thread from a signal handler, or on the calling thread while the target is
+ * suspended, so it must not allocate or take any locks.
+ */
+bool
+sampleThread(std::thread *thread,
+             ThreadSampleHandler handler,
+             void *userData);
+
 } // namespace platform
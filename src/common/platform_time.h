@@ -1,6 +1,14 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
 #include <ctime>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 namespace platform
 {
 
@@ -10,4 +18,32 @@ localtime(const std::time_t& time);
 time_t
 make_gm_time(std::tm time);
 
+/**
+ * Read a cheap monotonic host tick counter.
+ *
+ * On x86 this is the TSC, which is invariant on every CPU we support, other
+ * architectures fall back to std::chrono::steady_clock in nanoseconds.
+ * Use hostTicksToNanoseconds to convert a difference of two reads.
+ */
+inline uint64_t
+readHostTicks()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   auto now = std::chrono::steady_clock::now().time_since_epoch();
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+/**
+ * Measure the rate of readHostTicks, this sleeps briefly so should be called
+ * once at startup before anything converts ticks while holding a lock.
+ */
+void
+calibrateHostTicks();
+
+uint64_t
+hostTicksToNanoseconds(uint64_t ticks);
+
 } // namespace platform
@@ -2,8 +2,21 @@
 #include "platform_thread.h"
 
 #ifdef PLATFORM_POSIX
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+#include <chrono>
 #include <cstdlib>
+#include <mutex>
 #include <pthread.h>
+#include <signal.h>
+#include <ucontext.h>
+
+#ifdef PLATFORM_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace platform
 {
@@ -26,6 +39,124 @@ exitThread(int result)
    pthread_exit(res);
 }
 
+void
+waitOnAddress(std::atomic<uint32_t> *address,
+              uint32_t expected)
+{
+#ifdef PLATFORM_LINUX
+   static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+   syscall(SYS_futex, reinterpret_cast<uint32_t *>(address),
+           FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+   if (address->load(std::memory_order_relaxed) == expected) {
+      std::this_thread::yield();
+   }
+#endif
+}
+
+void
+wakeOnAddress(std::atomic<uint32_t> *address)
+{
+#ifdef PLATFORM_LINUX
+   syscall(SYS_futex, reinterpret_cast<uint32_t *>(address),
+           FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+static std::mutex sSampleMutex;
+static ThreadSampleHandler sSampleHandler = nullptr;
+static void *sSampleUserData = nullptr;
+static std::atomic<pthread_t> sSampleTarget;
+
+//! Sequence number of the pending request, 0 if there is none. A signal
+//! handler claims a request by exchanging it for 0, so a signal arriving
+//! after its request timed out can never run with a later request's data.
+static std::atomic<uint32_t> sSampleRequest { 0 };
+static std::atomic<uint32_t> sSampleDone { 0 };
+static uint32_t sSampleSequence = 0;
+
+static void
+sampleSignalHandler(int, siginfo_t *, void *context)
+{
+   auto request = sSampleRequest.load(std::memory_order_acquire);
+
+   if (!request || !pthread_equal(pthread_self(), sSampleTarget.load())) {
+      return;
+   }
+
+   if (!sSampleRequest.compare_exchange_strong(request, 0, std::memory_order_acq_rel)) {
+      return;
+   }
+
+   auto ctx = reinterpret_cast<ucontext_t *>(context);
+   auto instructionPointer = uintptr_t { 0 };
+
+#if defined(PLATFORM_APPLE) && defined(__x86_64__)
+   instructionPointer = static_cast<uintptr_t>(ctx->uc_mcontext->__ss.__rip);
+#elif defined(__x86_64__)
+   instructionPointer = static_cast<uintptr_t>(ctx->uc_mcontext.gregs[REG_RIP]);
+#endif
+
+   sSampleHandler(sSampleUserData, instructionPointer);
+   sSampleDone.store(request, std::memory_order_release);
+}
+
+bool
+sampleThread(std::thread *thread,
+             ThreadSampleHandler handler,
+             void *userData)
+{
+   static std::once_flag sInstallFlag;
+   std::call_once(sInstallFlag, []() {
+      struct sigaction action = { };
+      action.sa_sigaction = sampleSignalHandler;
+      action.sa_flags = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGPROF, &action, nullptr);
+   });
+
+   std::lock_guard<std::mutex> lock { sSampleMutex };
+   auto request = ++sSampleSequence;
+
+   if (!request) {
+      request = ++sSampleSequence;
+   }
+
+   sSampleHandler = handler;
+   sSampleUserData = userData;
+   sSampleTarget.store(thread->native_handle());
+   sSampleRequest.store(request, std::memory_order_release);
+
+   if (pthread_kill(thread->native_handle(), SIGPROF) != 0) {
+      sSampleRequest.store(0, std::memory_order_release);
+      return false;
+   }
+
+   // The signal is normally handled within microseconds, only give up if
+   // the target thread has been stopped by something else entirely.
+   auto start = std::chrono::steady_clock::now();
+   while (sSampleDone.load(std::memory_order_acquire) != request) {
+      if (std::chrono::steady_clock::now() - start > std::chrono::seconds { 1 }) {
+         // Withdraw the request, unless the handler has already claimed it
+         // in which case it is about to finish.
+         auto expected = request;
+         if (sSampleRequest.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+            return false;
+         }
+
+         while (sSampleDone.load(std::memory_order_acquire) != request) {
+            std::this_thread::yield();
+         }
+
+         break;
+      }
+
+      std::this_thread::yield();
+   }
+
+   return true;
+}
+
 } // namespace platform
 
 #endif
@@ -0,0 +1,40 @@
+#include "platform_time.h"
+
+#include <mutex>
+#include <thread>
+
+namespace platform
+{
+
+static double
+sHostTicksPerNanosecond = 1.0;
+
+static std::once_flag
+sHostTicksCalibrated;
+
+void
+calibrateHostTicks()
+{
+   std::call_once(sHostTicksCalibrated, []() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+      auto startTime = std::chrono::steady_clock::now();
+      auto startTicks = readHostTicks();
+      std::this_thread::sleep_for(std::chrono::milliseconds { 10 });
+      auto endTime = std::chrono::steady_clock::now();
+      auto endTicks = readHostTicks();
+
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime);
+      sHostTicksPerNanosecond = static_cast<double>(endTicks - startTicks) / static_cast<double>(elapsed.count());
+#endif
+   });
+}
+
+uint64_t
+hostTicksToNanoseconds(uint64_t ticks)
+{
+   // Normally already done at startup, calibrating here would sleep
+   calibrateHostTicks();
+   return static_cast<uint64_t>(static_cast<double>(ticks) / sHostTicksPerNanosecond);
+}
+
+} // namespace platform
@@ -46,6 +46,41 @@ exitThread(int result)
    ExitThread(result);
 }
 
+void
+waitOnAddress(std::atomic<uint32_t> *address,
+              uint32_t expected)
+{
+   WaitOnAddress(address, &expected, sizeof(expected), INFINITE);
+}
+
+void
+wakeOnAddress(std::atomic<uint32_t> *address)
+{
+   WakeByAddressSingle(address);
+}
+
+bool
+sampleThread(std::thread *thread,
+             ThreadSampleHandler handler,
+             void *userData)
+{
+   auto handle = static_cast<HANDLE>(thread->native_handle());
+   if (SuspendThread(handle) == static_cast<DWORD>(-1)) {
+      return false;
+   }
+
+   CONTEXT context;
+   context.ContextFlags = CONTEXT_CONTROL;
+
+   auto result = !!GetThreadContext(handle, &context);
+   if (result) {
+      handler(userData, static_cast<uintptr_t>(context.Rip));
+   }
+
+   ResumeThread(handle);
+   return result;
+}
+
 } // namespace platform
 
 #endif
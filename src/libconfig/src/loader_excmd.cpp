@@ -66,6 +66,15 @@ getExcmdGroups(excmd::parser &parser)
                   } });
    groups.push_back(log_options.group);
 
+   auto replay_options = parser.add_option_group("Replay Options")
+      .add_option("replay-record",
+                  description { "Record the nondeterministic guest inputs to this file." },
+                  value<std::string> {})
+      .add_option("replay-playback",
+                  description { "Play back guest inputs previously recorded to this file." },
+                  value<std::string> {});
+   groups.push_back(replay_options.group);
+
    auto sys_options = parser.add_option_group("System Options")
       .add_option("region",
                   description { "Set the system region." },
@@ -87,7 +96,9 @@ getExcmdGroups(excmd::parser &parser)
                   value<std::string> {})
       .add_option("time-scale",
                   description { "Time scale factor for emulated clock." },
-                  default_value<double> { 1.0 });
+                  default_value<double> { 1.0 })
+      .add_option("hle-replace-routines",
+                  description { "Replace hot guest runtime routines such as memcpy with host versions." });
    groups.push_back(sys_options.group);
 
    return groups;
@@ -196,6 +207,14 @@ loadFromExcmd(excmd::option_state &options)
       decaf::config::log::level = options.get<std::string>("log-level");
    }
 
+   if (options.has("replay-record")) {
+      decaf::config::replay::record_path = options.get<std::string>("replay-record");
+   }
+
+   if (options.has("replay-playback")) {
+      decaf::config::replay::playback_path = options.get<std::string>("replay-playback");
+   }
+
    if (options.has("region")) {
       auto region = options.get<std::string>("region");
 
@@ -214,6 +233,10 @@ loadFromExcmd(excmd::option_state &options)
       }
    }
 
+   if (options.has("hle-replace-routines")) {
+      decaf::config::system::hle_replace_routines = true;
+   }
+
    if (options.has("mlc-path")) {
       decaf::config::system::mlc_path = options.get<std::string>("mlc-path");
    }
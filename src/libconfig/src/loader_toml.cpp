@@ -15,10 +15,12 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "debugger.break_on_entry", decaf::config::debugger::break_on_entry);
    readValue(config, "debugger.gdb_stub", decaf::config::debugger::gdb_stub);
    readValue(config, "debugger.gdb_stub_port", decaf::config::debugger::gdb_stub_port);
+   readValue(config, "debugger.profiler_frequency", decaf::config::debugger::profiler_frequency);
 
    readValue(config, "gpu.debug", gpu::config::debug);
    readArray(config, "gpu.debug_filters", gpu::config::debug_filters);
    readValue(config, "gpu.dump_shaders", gpu::config::dump_shaders);
+   readValue(config, "gpu.pipeline_pm4", gpu::config::pipeline_pm4);
 
    readValue(config, "gx2.dump_textures", decaf::config::gx2::dump_textures);
    readValue(config, "gx2.dump_shaders", decaf::config::gx2::dump_shaders);
@@ -30,6 +32,10 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "jit.data_cache_size_mb", cpu::config::jit::data_cache_size_mb);
    readArray(config, "jit.opt_flags", cpu::config::jit::opt_flags);
    readValue(config, "jit.rodata_read_only", cpu::config::jit::rodata_read_only);
+   readValue(config, "jit.perf_map", cpu::config::jit::perf_map);
+   readValue(config, "jit.perf_jitdump", cpu::config::jit::perf_jitdump);
+   readValue(config, "trace.enabled", cpu::config::trace::enabled);
+   readValue(config, "trace.stream_directory", cpu::config::trace::stream_directory);
 
    readValue(config, "log.async", decaf::config::log::async);
    readValue(config, "log.branch_trace", decaf::config::log::branch_trace);
@@ -41,6 +47,9 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "log.to_file", decaf::config::log::to_file);
    readValue(config, "log.to_stdout", decaf::config::log::to_stdout);
 
+   readValue(config, "replay.record_path", decaf::config::replay::record_path);
+   readValue(config, "replay.playback_path", decaf::config::replay::playback_path);
+
    readValue(config, "sound.dump_sounds", decaf::config::sound::dump_sounds);
 
    readValue(config, "system.region", decaf::config::system::region);
@@ -52,6 +61,9 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "system.time_scale", decaf::config::system::time_scale);
    readArray(config, "system.lle_modules", decaf::config::system::lle_modules);
    readValue(config, "system.dump_hle_rpl", decaf::config::system::dump_hle_rpl);
+   readValue(config, "system.rpl_cache_path", decaf::config::system::rpl_cache_path);
+   readValue(config, "system.scheduler_validation", decaf::config::system::scheduler_validation);
+   readValue(config, "system.hle_replace_routines", decaf::config::system::hle_replace_routines);
    return true;
 }
 
@@ -68,6 +80,7 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    debugger->insert("break_on_entry", decaf::config::debugger::break_on_entry);
    debugger->insert("gdb_stub", decaf::config::debugger::gdb_stub);
    debugger->insert("gdb_stub_port", decaf::config::debugger::gdb_stub_port);
+   debugger->insert("profiler_frequency", decaf::config::debugger::profiler_frequency);
    config->insert("debugger", debugger);
 
    // gpu
@@ -78,6 +91,7 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
 
    gpu->insert("debug", gpu::config::debug);
    gpu->insert("dump_shaders", gpu::config::dump_shaders);
+   gpu->insert("pipeline_pm4", gpu::config::pipeline_pm4);
 
    auto debug_filters = cpptoml::make_array();
    for (auto &filter : gpu::config::debug_filters) {
@@ -109,6 +123,8 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    jit->insert("code_cache_size_mb", cpu::config::jit::code_cache_size_mb);
    jit->insert("data_cache_size_mb", cpu::config::jit::data_cache_size_mb);
    jit->insert("rodata_read_only", cpu::config::jit::rodata_read_only);
+   jit->insert("perf_map", cpu::config::jit::perf_map);
+   jit->insert("perf_jitdump", cpu::config::jit::perf_jitdump);
 
    auto opt_flags = cpptoml::make_array();
    for (auto &flag : cpu::config::jit::opt_flags) {
@@ -118,6 +134,16 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    jit->insert("opt_flags", opt_flags);
    config->insert("jit", jit);
 
+   // trace
+   auto trace = config->get_table("trace");
+   if (!trace) {
+      trace = cpptoml::make_table();
+   }
+
+   trace->insert("enabled", cpu::config::trace::enabled);
+   trace->insert("stream_directory", cpu::config::trace::stream_directory);
+   config->insert("trace", trace);
+
    // log
    auto log = config->get_table("log");
    if (!log) {
@@ -141,6 +167,16 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    log->insert("kernel_trace_filters", kernel_trace_filters);
    config->insert("log", log);
 
+   // replay
+   auto replay = config->get_table("replay");
+   if (!replay) {
+      replay = cpptoml::make_table();
+   }
+
+   replay->insert("record_path", decaf::config::replay::record_path);
+   replay->insert("playback_path", decaf::config::replay::playback_path);
+   config->insert("replay", replay);
+
    // sound
    auto sound = config->get_table("sound");
    if (!sound) {
@@ -163,6 +199,9 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    system->insert("slc_path", decaf::config::system::slc_path);
    system->insert("content_path", decaf::config::system::content_path);
    system->insert("time_scale", decaf::config::system::time_scale);
+   system->insert("rpl_cache_path", decaf::config::system::rpl_cache_path);
+   system->insert("scheduler_validation", decaf::config::system::scheduler_validation);
+   system->insert("hle_replace_routines", decaf::config::system::hle_replace_routines);
 
    auto lle_modules = cpptoml::make_array();
    for (auto &name : decaf::config::system::lle_modules) {
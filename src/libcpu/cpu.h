@@ -7,6 +7,7 @@
 #include <common/platform_stacktrace.h>
 #include <cstdint>
 #include <functional>
+#include <string>
 #include <utility>
 #include <gsl.h>
 
@@ -40,6 +41,9 @@ using SegfaultHandler = void(*)(Core *core, uint32_t address, platform::StackTra
 using IllInstHandler = void(*)(Core *core, platform::StackTrace *hostStackTrace);
 using BranchTraceHandler = void(*)(Core *core, uint32_t target);
 using KernelCallHandler = void(*)(Core *core, uint32_t id);
+using KernelCallEntry = void(*)(Core *core, void *userData);
+using CodeSymbolHandler = std::string(*)(uint32_t address);
+using TimeBaseHandler = uint64_t(*)(Core *core, uint64_t tb);
 
 void
 initialise();
@@ -73,6 +77,38 @@ setBranchTraceHandler(BranchTraceHandler handler);
 void
 setKernelCallHandler(KernelCallHandler handler);
 
+/**
+ * Set the handler used to name guest code, it should return an empty string
+ * when the address does not belong to a known symbol.
+ *
+ * Only used when exporting JIT symbols for host profilers.
+ */
+void
+setCodeSymbolHandler(CodeSymbolHandler handler);
+
+/**
+ * Set a handler which is given the host time base and returns the value
+ * the guest should observe, for both mftb and Core::tb().
+ *
+ * Used to record and replay guest time.
+ */
+void
+setTimeBaseHandler(TimeBaseHandler handler);
+
+/**
+ * Bind a kernel call id directly to a host entry point.
+ *
+ * Bound ids bypass the KernelCallHandler. The entry may be re-bound at any
+ * time, for example to switch tracing on or off. Set leafReturn when every
+ * kc with this id is immediately followed by a blr so the JIT can return to
+ * lr without executing it.
+ */
+void
+setKernelCallTarget(uint32_t id,
+                    KernelCallEntry entry,
+                    void *userData,
+                    bool leafReturn);
+
 void
 start();
 
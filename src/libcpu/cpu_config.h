@@ -33,8 +33,25 @@ extern std::vector<std::string> opt_flags;
 //! Treat .rodata sections as read-only regardless of RPL/RPX flags
 extern bool rodata_read_only;
 
+//! Write /tmp/perf-<pid>.map entries for compiled code
+extern bool perf_map;
+
+//! Write /tmp/jit-<pid>.dump records, including code bytes, for perf inject
+extern bool perf_jitdump;
+
 } // namespace jit
 
+namespace trace
+{
+
+//! Record executed instructions, only the interpreter is traced
+extern bool enabled;
+
+//! Directory to stream binary instruction traces to, empty to disable
+extern std::string stream_directory;
+
+} // namespace trace
+
 } // namespace config
 
 } // namespace cpu
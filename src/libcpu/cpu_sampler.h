@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace cpu
+{
+
+struct Sample
+{
+   //! Maximum number of return addresses walked from the guest stack.
+   static constexpr auto MaxCallers = 32u;
+
+   //! Guest address being executed, inside JIT code this is the block start.
+   uint32_t nia;
+
+   //! Link register.
+   uint32_t lr;
+
+   //! Kernel call being executed, or InvalidKernelCallId.
+   uint32_t kernelCallId;
+
+   //! Number of valid entries in callers.
+   uint32_t numCallers;
+
+   //! Return addresses from the guest stack back chain, innermost first.
+   std::array<uint32_t, MaxCallers> callers;
+};
+
+void
+startSampling(unsigned frequency);
+
+void
+stopSampling();
+
+bool
+isSampling();
+
+void
+readSamples(uint32_t coreId,
+            uint64_t &position,
+            std::vector<Sample> &samples);
+
+} // namespace cpu
@@ -1,6 +1,7 @@
 #include "cpu.h"
 #include "cpu_config.h"
 #include "cpu_internal.h"
+#include "cpu_sampler.h"
 #include "espresso/espresso_instructionset.h"
 #include "interpreter/interpreter.h"
 #include "jit/jit.h"
@@ -39,6 +40,12 @@ gIllInstHandler;
 BranchTraceHandler
 gBranchTraceHandler;
 
+CodeSymbolHandler
+gCodeSymbolHandler;
+
+static TimeBaseHandler
+sTimeBaseHandler;
+
 jit_mode
 gJitMode = jit_mode::disabled;
 
@@ -222,6 +229,9 @@ start()
 void
 join()
 {
+   // The sampler must not signal core threads which are exiting.
+   stopSampling();
+
    for (auto core : gCore) {
       if (core && core->thread.joinable()) {
          core->thread.join();
@@ -272,6 +282,18 @@ setBranchTraceHandler(BranchTraceHandler handler)
    gBranchTraceHandler = handler;
 }
 
+void
+setCodeSymbolHandler(CodeSymbolHandler handler)
+{
+   gCodeSymbolHandler = handler;
+}
+
+void
+setTimeBaseHandler(TimeBaseHandler handler)
+{
+   sTimeBaseHandler = handler;
+}
+
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks)
 {
@@ -285,6 +307,11 @@ Core::tb()
 {
    auto now = std::chrono::steady_clock::now();
    auto ticks = std::chrono::duration_cast<TimerDuration>(now - sStartupTime);
+
+   if (sTimeBaseHandler) {
+      return sTimeBaseHandler(this, ticks.count());
+   }
+
    return ticks.count();
 }
 
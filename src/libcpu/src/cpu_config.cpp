@@ -15,6 +15,8 @@ uint32_t verify_addr = 0;
 unsigned int code_cache_size_mb = 1024;
 unsigned int data_cache_size_mb = 512;
 bool rodata_read_only = true;
+bool perf_map = false;
+bool perf_jitdump = false;
 
 std::vector<std::string> opt_flags =
 {
@@ -32,6 +34,14 @@ std::vector<std::string> opt_flags =
 
 } // namespace jit
 
+namespace trace
+{
+
+bool enabled = false;
+std::string stream_directory = "";
+
+} // namespace trace
+
 } // namespace config
 
 } // namespace cpu
@@ -23,6 +23,9 @@ gInterruptHandler;
 extern BranchTraceHandler
 gBranchTraceHandler;
 
+extern CodeSymbolHandler
+gCodeSymbolHandler;
+
 extern jit_mode
 gJitMode;
 
@@ -38,6 +41,16 @@ gTimerThread;
 void
 timerEntryPoint();
 
+struct KernelCallTarget
+{
+   std::atomic<KernelCallEntry> entry;
+   void *userData;
+   bool leafReturn;
+};
+
+const KernelCallTarget *
+getKernelCallTarget(uint32_t id);
+
 void
 onKernelCall(cpu::Core *core,
              uint32_t id);
@@ -1,24 +1,79 @@
 #include "cpu.h"
+#include "cpu_internal.h"
+
+#include <common/decaf_assert.h>
+#include <memory>
 #include <vector>
 
 namespace cpu
 {
 
+//! Number of kernel call ids which can be bound with setKernelCallTarget.
+static constexpr auto MaxKernelCallTargets = 0x8000u;
+
 static KernelCallHandler sHandler = nullptr;
 
+static std::unique_ptr<KernelCallTarget[]> sTargets;
+
 void
 setKernelCallHandler(KernelCallHandler handler)
 {
    sHandler = handler;
 }
 
+void
+setKernelCallTarget(uint32_t id,
+                    KernelCallEntry entry,
+                    void *userData,
+                    bool leafReturn)
+{
+   decaf_check(id < MaxKernelCallTargets);
+
+   if (!sTargets) {
+      sTargets = std::make_unique<KernelCallTarget[]>(MaxKernelCallTargets);
+   }
+
+   auto &target = sTargets[id];
+   target.userData = userData;
+   target.leafReturn = leafReturn;
+   target.entry.store(entry, std::memory_order_release);
+}
+
+const KernelCallTarget *
+getKernelCallTarget(uint32_t id)
+{
+   if (!sTargets || id >= MaxKernelCallTargets) {
+      return nullptr;
+   }
+
+   auto &target = sTargets[id];
+   if (!target.entry.load(std::memory_order_relaxed)) {
+      return nullptr;
+   }
+
+   return &target;
+}
+
 void
 onKernelCall(cpu::Core *core,
              uint32_t id)
 {
-   if (sHandler) {
+   core->kernelCallId.store(id, std::memory_order_relaxed);
+
+   if (auto target = getKernelCallTarget(id)) {
+      target->entry.load(std::memory_order_acquire)(core, target->userData);
+   } else if (sHandler) {
       sHandler(core, id);
    }
+
+   // We might have been rescheduled on a new core, clear the id on both so
+   // the core we left does not keep reporting it.
+   if (core->kernelCallId.load(std::memory_order_relaxed) == id) {
+      core->kernelCallId.store(InvalidKernelCallId, std::memory_order_relaxed);
+   }
+
+   this_core::state()->kernelCallId.store(InvalidKernelCallId,
+                                          std::memory_order_relaxed);
 }
 
 } // namespace cpu
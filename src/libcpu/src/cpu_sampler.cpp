@@ -0,0 +1,222 @@
+#include "cpu.h"
+#include "cpu_internal.h"
+#include "cpu_sampler.h"
+#include "jit/jit.h"
+#include "mem.h"
+#include "mmu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <common/platform_thread.h>
+#include <thread>
+
+namespace cpu
+{
+
+//! Number of samples kept per core, must be a power of two.
+static constexpr auto SampleRingSize = 0x4000u;
+
+/**
+ * A sample in the ring, guarded by a sequence number.
+ *
+ * The sequence is odd while the sampler is writing the slot and is
+ * (position + 1) * 2 once the sample for position has been written.
+ */
+struct SampleSlot
+{
+   std::atomic<uint64_t> sequence { 0 };
+   Sample sample;
+};
+
+/**
+ * Ring of the most recent samples taken from a core.
+ *
+ * Only the sampler writes to a ring, one core at a time, readers copy out
+ * everything published since their last read with readSamples.
+ */
+struct SampleRing
+{
+   std::atomic<uint64_t> next { 0 };
+   std::array<SampleSlot, SampleRingSize> slots;
+};
+
+static std::array<SampleRing, 3>
+sSampleRings;
+
+static std::thread
+sSamplerThread;
+
+static std::atomic<bool>
+sSamplerRunning { false };
+
+static bool
+isValidStackAddress(uint32_t address)
+{
+   return address && !(address & 3) &&
+      isValidAddress(VirtualAddress { address }) &&
+      isValidAddress(VirtualAddress { address + 7 });
+}
+
+/**
+ * Capture a sample of a stopped core, this may run from inside a signal
+ * handler so it must not allocate or take any locks.
+ */
+static void
+captureSample(void *userData,
+              uintptr_t hostInstructionPointer)
+{
+   auto core = reinterpret_cast<Core *>(userData);
+   auto &ring = sSampleRings[core->id];
+   auto pos = ring.next.load(std::memory_order_relaxed);
+   auto &slot = ring.slots[pos & (SampleRingSize - 1)];
+   auto &sample = slot.sample;
+
+   // Mark the slot as being written so a reader copying the sample which
+   // was previously in it knows to discard its copy.
+   slot.sequence.store(pos * 2 + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   // nia is only updated between blocks when executing JIT code, so prefer
+   // the address of the block which we interrupted.
+   sample.nia = core->nia;
+
+   if (auto backend = jit::getBackend()) {
+      if (auto block = backend->getBlockByHostAddress(hostInstructionPointer)) {
+         sample.nia = block->address;
+      }
+   }
+
+   sample.lr = core->lr;
+   sample.kernelCallId = core->kernelCallId.load(std::memory_order_relaxed);
+   sample.numCallers = 0;
+
+   // Walk the back chain, each frame's caller saved its lr at sp + 4 of
+   // the frame above.
+   auto sp = static_cast<uint32_t>(core->gpr[1]);
+   while (sample.numCallers < Sample::MaxCallers && isValidStackAddress(sp)) {
+      auto backchain = mem::read<uint32_t>(sp);
+      if (backchain <= sp || !isValidStackAddress(backchain)) {
+         break;
+      }
+
+      auto returnAddress = mem::read<uint32_t>(backchain + 4);
+      if (!returnAddress) {
+         break;
+      }
+
+      sample.callers[sample.numCallers++] = returnAddress;
+      sp = backchain;
+   }
+
+   slot.sequence.store((pos + 1) * 2, std::memory_order_release);
+   ring.next.store(pos + 1, std::memory_order_release);
+}
+
+static void
+samplerEntryPoint(unsigned frequency)
+{
+   auto interval = std::chrono::microseconds { 1000000 / frequency };
+   auto next = std::chrono::steady_clock::now();
+
+   while (sSamplerRunning.load()) {
+      next += interval;
+      std::this_thread::sleep_until(next);
+
+      for (auto core : gCore) {
+         if (core && core->thread.joinable()) {
+            platform::sampleThread(&core->thread, &captureSample, core);
+         }
+      }
+   }
+}
+
+/**
+ * Start sampling every core frequency times per second.
+ */
+void
+startSampling(unsigned frequency)
+{
+   if (sSamplerRunning.exchange(true)) {
+      return;
+   }
+
+   frequency = std::max(1u, std::min(frequency, 10000u));
+   sSamplerThread = std::thread { samplerEntryPoint, frequency };
+   platform::setThreadName(&sSamplerThread, "CPU Sampler");
+}
+
+void
+stopSampling()
+{
+   if (!sSamplerRunning.exchange(false)) {
+      return;
+   }
+
+   if (sSamplerThread.joinable()) {
+      sSamplerThread.join();
+   }
+}
+
+bool
+isSampling()
+{
+   return sSamplerRunning.load();
+}
+
+/**
+ * Copy the sample for position out of its slot.
+ *
+ * Returns false if the sampler has since overwritten, or is overwriting, the
+ * slot with a newer sample.
+ */
+static bool
+readSample(const SampleSlot &slot,
+           uint64_t position,
+           Sample &sample)
+{
+   auto expected = (position + 1) * 2;
+
+   while (true) {
+      auto before = slot.sequence.load(std::memory_order_acquire);
+      if (before != expected) {
+         return false;
+      }
+
+      sample = slot.sample;
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // If the sequence changed while we were copying then the copy may be
+      // torn, read it again to find out what the slot holds now.
+      if (slot.sequence.load(std::memory_order_relaxed) == before) {
+         return true;
+      }
+   }
+}
+
+/**
+ * Append every sample taken from coreId since position to samples.
+ *
+ * Samples which have been overwritten since the last read are skipped.
+ */
+void
+readSamples(uint32_t coreId,
+            uint64_t &position,
+            std::vector<Sample> &samples)
+{
+   auto &ring = sSampleRings[coreId];
+   auto end = ring.next.load(std::memory_order_acquire);
+   auto start = end > SampleRingSize ? end - SampleRingSize : 0;
+   start = std::max(start, position);
+
+   for (auto i = start; i < end; ++i) {
+      auto sample = Sample { };
+      if (readSample(ring.slots[i & (SampleRingSize - 1)], i, sample)) {
+         samples.push_back(sample);
+      }
+   }
+
+   position = end;
+}
+
+} // namespace cpu
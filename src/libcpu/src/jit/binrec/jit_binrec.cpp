@@ -468,6 +468,16 @@ BinrecBackend::getProfilingMask()
 }
 
 
+/**
+ * Find the compiled block containing a host code address.
+ */
+CodeBlock *
+BinrecBackend::getBlockByHostAddress(uintptr_t hostAddress)
+{
+   return mCodeCache.getBlockByHostAddress(hostAddress);
+}
+
+
 /**
  * Callback from libbinrec to look up translated blocks for function chaining.
  */
@@ -499,16 +509,34 @@ brTimeBaseHandler(BinrecCore *core)
 void
 brSyscallHandler(BinrecCore *core)
 {
-   auto instr = mem::read<espresso::Instruction>(core->nia - 4);
-   cpu::onKernelCall(core, instr.kcn);
+   // libbinrec does not pass us the kc operand so read it back from the site.
+   auto returnAddress = core->nia;
+   auto instr = mem::read<espresso::Instruction>(returnAddress - 4);
+   auto target = cpu::getKernelCallTarget(instr.kcn);
+
+   if (target) {
+      core->kernelCallId.store(instr.kcn, std::memory_order_relaxed);
+      target->entry.load(std::memory_order_acquire)(core, target->userData);
+   } else {
+      cpu::onKernelCall(core, instr.kcn);
+   }
+
+   // We might have been rescheduled on a new core, clear the id on both so
+   // the core we left does not keep reporting it.
+   if (core->kernelCallId.load(std::memory_order_relaxed) == instr.kcn) {
+      core->kernelCallId.store(InvalidKernelCallId, std::memory_order_relaxed);
+   }
 
-   // We might have been rescheduled on a new core.
    core = reinterpret_cast<BinrecCore *>(this_core::state());
+   core->kernelCallId.store(InvalidKernelCallId, std::memory_order_relaxed);
 
    // If the next instruction is a blr, execute it ourselves rather than
    // spending the overhead of calling into JIT for just that instruction.
-   auto next_instr = mem::read<uint32_t>(core->nia);
-   if (next_instr == 0x4E800020) {
+   // For a leaf HLE stub we know that without reading it, as long as we
+   // returned to the same site rather than into some other thread.
+   if (target && target->leafReturn && core->nia == returnAddress) {
+      core->nia = core->lr;
+   } else if (mem::read<uint32_t>(core->nia) == 0x4E800020) {
       core->nia = core->lr;
    }
 
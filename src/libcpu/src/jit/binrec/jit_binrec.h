@@ -86,6 +86,9 @@ public:
    unsigned
    getProfilingMask() override;
 
+   CodeBlock *
+   getBlockByHostAddress(uintptr_t hostAddress) override;
+
 public:
    void
    setOptFlags(const std::vector<std::string> &optList);
@@ -46,6 +46,10 @@ public:
    virtual unsigned
    getProfilingMask() = 0;
 
+   //! Find the compiled block containing a host code address, lock free.
+   virtual CodeBlock *
+   getBlockByHostAddress(uintptr_t hostAddress) = 0;
+
 private:
 };
 
@@ -1,6 +1,8 @@
 #include "jit_codecache.h"
+#include "jit_perfmap.h"
 #include "jit_stats.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstring>
@@ -224,6 +226,60 @@ CodeCache::getBlockByAddress(uint32_t address)
 }
 
 
+/**
+ * Find the compiled code block containing a host code address.
+ *
+ * Each block takes its data slot and its code range with two separate
+ * allocations, so blocks compiled at the same time on different cores may
+ * interleave and the block list is only sorted by host address to within a
+ * few entries. A binary search finds the neighbourhood which is then
+ * scanned. Used from the sampling profiler while the target thread is
+ * stopped, so must not take any locks.
+ */
+CodeBlock *
+CodeCache::getBlockByHostAddress(uintptr_t hostAddress)
+{
+   // Comfortably more than the number of blocks which can be in the middle
+   // of being registered at once.
+   static constexpr size_t ScanWindow = 16;
+
+   auto codeEnd = mCodeAllocator.baseAddress + mCodeAllocator.allocated.load();
+   if (hostAddress < mCodeAllocator.baseAddress || hostAddress >= codeEnd) {
+      return nullptr;
+   }
+
+   // Slots past the committed memory may not be readable yet
+   auto dataSize = std::min(mDataAllocator.allocated.load(), mDataAllocator.committed.load());
+   auto blocks = reinterpret_cast<CodeBlock *>(mDataAllocator.baseAddress);
+   auto count = dataSize / sizeof(CodeBlock);
+   auto first = size_t { 0 };
+   auto last = count;
+
+   while (first < last) {
+      auto mid = first + (last - first) / 2;
+      if (reinterpret_cast<uintptr_t>(blocks[mid].code) <= hostAddress) {
+         first = mid + 1;
+      } else {
+         last = mid;
+      }
+   }
+
+   auto scanStart = (first > ScanWindow) ? first - ScanWindow : 0;
+   auto scanEnd = std::min(first + ScanWindow, count);
+
+   for (auto i = scanStart; i < scanEnd; ++i) {
+      auto blockCode = reinterpret_cast<uintptr_t>(blocks[i].code);
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (blockCode && hostAddress >= blockCode && hostAddress < blockCode + blocks[i].codeSize) {
+         return &blocks[i];
+      }
+   }
+
+   return nullptr;
+}
+
+
 /**
  * Find a compiled code block's CodeBlockIndex.
  */
@@ -320,10 +376,10 @@ CodeCache::registerCodeBlock(uint32_t address,
 
    // Setup me block
    auto block = reinterpret_cast<CodeBlock *>(dataAddress);
+   block->code = nullptr;
    block->address = address;
-   block->code = reinterpret_cast<void *>(codeAddress);
    block->codeSize = static_cast<uint32_t>(size);
-   std::memcpy(block->code, code, size);
+   std::memcpy(reinterpret_cast<void *>(codeAddress), code, size);
 
    // Initialise profiling data
    block->profileData.count = 0;
@@ -342,6 +398,14 @@ CodeCache::registerCodeBlock(uint32_t address,
    RtlAddFunctionTable(&block->unwindInfo.rtlFuncTable, 1, mReserveAddress);
 #endif
 
+   // Publish the code pointer last, getBlockByHostAddress skips blocks
+   // which do not have one yet.
+   std::atomic_thread_fence(std::memory_order_release);
+   block->code = reinterpret_cast<void *>(codeAddress);
+
+   // Export the block to host profilers
+   writePerfMapEntry(block);
+
    auto index = getIndex(block);
    auto indexPtr = getIndexPointer(address);
    indexPtr->store(index);
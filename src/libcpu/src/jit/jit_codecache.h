@@ -78,6 +78,9 @@ public:
    CodeBlock *
    getBlockByAddress(uint32_t address);
 
+   CodeBlock *
+   getBlockByHostAddress(uintptr_t hostAddress);
+
    /**
     * Find a compiled code block from its CodeBlockIndex.
     */
@@ -0,0 +1,195 @@
+#include "jit_perfmap.h"
+#include "cpu_config.h"
+#include "cpu_internal.h"
+
+#include <common/platform.h>
+#include <cstdio>
+#include <fmt/format.h>
+#include <mutex>
+#include <string>
+
+#ifdef PLATFORM_LINUX
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace cpu
+{
+
+namespace jit
+{
+
+#ifdef PLATFORM_LINUX
+
+/*
+ * Record layout as described by tools/perf/Documentation/jitdump-specification.txt
+ * in the Linux kernel tree, use with `perf record -k mono` and `perf inject --jit`.
+ */
+static constexpr uint32_t JitDumpMagic = 0x4A695444;
+static constexpr uint32_t JitDumpVersion = 1;
+static constexpr uint32_t JitDumpCodeLoad = 0;
+
+struct JitDumpHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t totalSize;
+   uint32_t elfMach;
+   uint32_t pad1;
+   uint32_t pid;
+   uint64_t timestamp;
+   uint64_t flags;
+};
+
+struct JitDumpRecordHeader
+{
+   uint32_t id;
+   uint32_t totalSize;
+   uint64_t timestamp;
+};
+
+struct JitDumpCodeLoadRecord
+{
+   JitDumpRecordHeader header;
+   uint32_t pid;
+   uint32_t tid;
+   uint64_t vma;
+   uint64_t codeAddr;
+   uint64_t codeSize;
+   uint64_t codeIndex;
+};
+
+static std::mutex sPerfMapMutex;
+static bool sPerfMapOpened = false;
+static FILE *sPerfMapFile = nullptr;
+static FILE *sJitDumpFile = nullptr;
+static uint64_t sJitDumpCodeIndex = 0;
+
+//! jitdump timestamps must come from the same clock as perf record -k mono.
+static uint64_t
+getJitDumpTimestamp()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+          static_cast<uint64_t>(ts.tv_nsec);
+}
+
+static void
+openJitDump(uint32_t pid)
+{
+   auto path = fmt::format("/tmp/jit-{}.dump", pid);
+   auto fd = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+   if (fd < 0) {
+      return;
+   }
+
+   // perf record finds the jitdump file by this executable mapping of it,
+   // the mapping is intentionally kept for the lifetime of the process.
+   mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+
+   sJitDumpFile = fdopen(fd, "wb");
+   if (!sJitDumpFile) {
+      close(fd);
+      return;
+   }
+
+   auto header = JitDumpHeader { };
+   header.magic = JitDumpMagic;
+   header.version = JitDumpVersion;
+   header.totalSize = sizeof(JitDumpHeader);
+#ifdef __x86_64__
+   header.elfMach = EM_X86_64;
+#else
+   header.elfMach = EM_NONE;
+#endif
+   header.pid = pid;
+   header.timestamp = getJitDumpTimestamp();
+   std::fwrite(&header, sizeof(JitDumpHeader), 1, sJitDumpFile);
+   std::fflush(sJitDumpFile);
+}
+
+static void
+openPerfMapFiles()
+{
+   auto pid = static_cast<uint32_t>(getpid());
+
+   if (config::jit::perf_map) {
+      auto path = fmt::format("/tmp/perf-{}.map", pid);
+      sPerfMapFile = std::fopen(path.c_str(), "w");
+   }
+
+   if (config::jit::perf_jitdump) {
+      openJitDump(pid);
+   }
+}
+
+/**
+ * Export a newly compiled code block to host profilers.
+ *
+ * Entries are flushed as they are written so the files are usable even if
+ * the emulator does not exit cleanly. Blocks compiled after a code cache
+ * clear may reuse host addresses, only jitdump records that correctly.
+ */
+void
+writePerfMapEntry(const CodeBlock *block)
+{
+   if (!config::jit::perf_map && !config::jit::perf_jitdump) {
+      return;
+   }
+
+   auto symbol = gCodeSymbolHandler ? gCodeSymbolHandler(block->address) : std::string { };
+   auto name = symbol.empty() ?
+      fmt::format("guest @ 0x{:08X}", block->address) :
+      fmt::format("{} @ 0x{:08X}", symbol, block->address);
+
+   std::lock_guard<std::mutex> lock { sPerfMapMutex };
+   if (!sPerfMapOpened) {
+      openPerfMapFiles();
+      sPerfMapOpened = true;
+   }
+
+   if (sPerfMapFile) {
+      fmt::print(sPerfMapFile, "{:x} {:x} {}\n",
+                 reinterpret_cast<uintptr_t>(block->code),
+                 block->codeSize,
+                 name);
+      std::fflush(sPerfMapFile);
+   }
+
+   if (sJitDumpFile) {
+      auto record = JitDumpCodeLoadRecord { };
+      record.header.id = JitDumpCodeLoad;
+      record.header.totalSize =
+         static_cast<uint32_t>(sizeof(JitDumpCodeLoadRecord) + name.size() + 1 + block->codeSize);
+      record.header.timestamp = getJitDumpTimestamp();
+      record.pid = static_cast<uint32_t>(getpid());
+      record.tid = static_cast<uint32_t>(syscall(SYS_gettid));
+      record.vma = reinterpret_cast<uintptr_t>(block->code);
+      record.codeAddr = record.vma;
+      record.codeSize = block->codeSize;
+      record.codeIndex = sJitDumpCodeIndex++;
+
+      std::fwrite(&record, sizeof(JitDumpCodeLoadRecord), 1, sJitDumpFile);
+      std::fwrite(name.c_str(), name.size() + 1, 1, sJitDumpFile);
+      std::fwrite(block->code, block->codeSize, 1, sJitDumpFile);
+      std::fflush(sJitDumpFile);
+   }
+}
+
+#else
+
+void
+writePerfMapEntry(const CodeBlock *block)
+{
+}
+
+#endif
+
+} // namespace jit
+
+} // namespace cpu
@@ -0,0 +1,15 @@
+#pragma once
+#include "jit_stats.h"
+
+namespace cpu
+{
+
+namespace jit
+{
+
+void
+writePerfMapEntry(const CodeBlock *block);
+
+} // namespace jit
+
+} // namespace cpu
@@ -6,10 +6,18 @@
 #include "espresso/espresso_instructionset.h"
 #include "espresso/espresso_spr.h"
 
+#include "cpu_config.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <common/log.h>
 #include <common/debuglog.h>
 #include <common/decaf_assert.h>
+#include <cstdio>
+#include <cstring>
 #include <fmt/format.h>
+#include <mutex>
 
 using espresso::Instruction;
 using espresso::InstructionID;
@@ -17,40 +25,202 @@ using espresso::InstructionInfo;
 using espresso::InstructionField;
 using espresso::SPR;
 
-//#define TRACE_ENABLED
 //#define TRACE_SC_ENABLED
 //#define TRACE_VERIFICATION
 
+//! Record header flag set when cia == previous cia + 4 and so was omitted.
+static constexpr uint8_t TraceRecordSequential = 1 << 0;
+
+//! Worst case size of a single encoded record.
+static constexpr size_t MaxTraceRecordSize =
+   1 + 4 + 4 + 1 + 1 + 2 * StateField::Max * (1 + 8);
+
+//! Average record size used to size a tracer's byte ring.
+static constexpr size_t TraceBytesPerRecord = 16;
+
+//! Worst case size of a single record in a streamed trace file.
+static constexpr size_t MaxTraceStreamRecordSize =
+   1 + 4 + 4 + 1 + 1 + 2 * StateField::Max * (1 + 10);
+
+//! Magic at the start of a streamed trace file, followed by the version.
+static constexpr uint32_t TraceStreamMagic = 0x43525444;
+static constexpr uint32_t TraceStreamVersion = 2;
+
+//! Last value of each field seen in a streamed trace, used for delta encoding.
+using TraceStreamValues = std::array<uint64_t, StateField::Max>;
+
+struct TraceRecordInfo
+{
+   //! Absolute byte position of the record in the ring.
+   uint64_t position;
+
+   //! cia of the record, as it may have been delta encoded.
+   uint32_t cia;
+};
+
 struct Tracer
 {
-   size_t index;
-   size_t numTraces;
-   std::vector<Trace> traces;
+   //! Ring of encoded records, a record never straddles the end of the ring.
+   std::vector<uint8_t> buffer;
+
+   //! Ring of record start positions, indexed by absolute record number.
+   std::vector<TraceRecordInfo> records;
+
+   //! Absolute byte position to write the next record at.
+   uint64_t writePos = 0;
+
+   //! Absolute byte position to write the pending record's writes at.
+   uint64_t pendingPos = 0;
+
+   //! Absolute record number of the oldest record still in the ring.
+   uint64_t firstRecord = 0;
+
+   //! Absolute record number of the next record.
+   uint64_t nextRecord = 0;
+
+   //! cia of the previous record.
+   uint32_t prevCia = 0;
+
+   //! Fields written by the pending record, decided in traceInstructionStart.
+   std::array<uint8_t, StateField::Max> pendingWrites;
+   uint32_t numPendingWrites = 0;
+
+   //! Absolute byte position up to which the ring has been streamed to file.
+   uint64_t streamPos = 0;
+   FILE *stream = nullptr;
+   std::string streamPath;
+
+   //! Field values as of the last record streamed to file.
+   TraceStreamValues streamValues = { };
+
+   //! Delta encoded records waiting to be written to file.
+   std::vector<uint8_t> streamBuffer;
+
+   //! State before a kc or, when verifying traces, before any instruction.
    cpu::CoreRegs prevState;
 };
 
+/**
+ * The read and write fields of an instruction, precomputed from its
+ * InstructionInfo so tracing does not walk every InstructionInfo list.
+ */
+struct TraceInstructionFields
+{
+   std::vector<InstructionField> reads;
+   std::vector<InstructionField> writes;
+};
+
+static std::array<TraceInstructionFields, static_cast<size_t>(InstructionID::InstructionCount)>
+sTraceInstructionFields;
+
+static std::once_flag
+sTraceInstructionFieldsFlag;
+
+static std::atomic<uint32_t>
+sTracerStreamIndex { 0 };
+
+static void
+pushUniqueInstructionField(std::vector<InstructionField> &fields,
+                           InstructionField field)
+{
+   if (std::find(fields.begin(), fields.end(), field) == fields.end()) {
+      fields.push_back(field);
+   }
+}
+
+static void
+initialiseTraceInstructionFields()
+{
+   for (auto id = 0u; id < static_cast<size_t>(InstructionID::Invalid); ++id) {
+      auto data = espresso::findInstructionInfo(static_cast<InstructionID>(id));
+      auto &fields = sTraceInstructionFields[id];
+
+      for (auto field : data->read) {
+         pushUniqueInstructionField(fields.reads, field);
+      }
+
+      for (auto field : data->write) {
+         pushUniqueInstructionField(fields.writes, field);
+      }
+
+      for (auto field : data->flags) {
+         pushUniqueInstructionField(fields.writes, field);
+      }
+   }
+}
+
+static const uint8_t *
+streamTraceRecord(TraceStreamValues &values,
+                  const uint8_t *in,
+                  std::vector<uint8_t> &stream);
+
 namespace cpu
 {
 
 cpu::Tracer *
 allocTracer(size_t size)
 {
-   // TODO: TRACE_ENABLED should actually be handled by kernel
-#ifdef TRACE_ENABLED
+   if (!config::trace::enabled) {
+      return nullptr;
+   }
+
    auto tracer = new Tracer();
-   tracer->index = 0;
-   tracer->numTraces = 0;
-   tracer->traces.resize(size);
+   tracer->buffer.resize(std::max(size * TraceBytesPerRecord, 4 * MaxTraceRecordSize));
+   tracer->records.resize(size);
+
+   if (!config::trace::stream_directory.empty()) {
+      tracer->streamPath = fmt::format("{}/trace_{}.bin",
+                                       config::trace::stream_directory,
+                                       sTracerStreamIndex++);
+      tracer->stream = std::fopen(tracer->streamPath.c_str(), "wb");
+
+      if (tracer->stream) {
+         std::fwrite(&TraceStreamMagic, sizeof(TraceStreamMagic), 1, tracer->stream);
+         std::fwrite(&TraceStreamVersion, sizeof(TraceStreamVersion), 1, tracer->stream);
+         tracer->streamBuffer.reserve(tracer->buffer.size());
+      } else {
+         gLog->error("Could not open trace stream {}", tracer->streamPath);
+         tracer->streamPath.clear();
+      }
+   }
+
    return tracer;
-#else
-   return nullptr;
-#endif
+}
+
+/**
+ * Write the records added to the ring since the last call to the stream,
+ * re-encoding their field values as deltas.
+ */
+static void
+streamTrace(cpu::Tracer *tracer)
+{
+   if (tracer->stream && tracer->writePos > tracer->streamPos) {
+      auto offset = tracer->streamPos % tracer->buffer.size();
+      const uint8_t *in = tracer->buffer.data() + offset;
+      auto end = in + (tracer->writePos - tracer->streamPos);
+
+      tracer->streamBuffer.clear();
+
+      while (in < end) {
+         in = streamTraceRecord(tracer->streamValues, in, tracer->streamBuffer);
+      }
+
+      std::fwrite(tracer->streamBuffer.data(), 1,
+                  tracer->streamBuffer.size(), tracer->stream);
+   }
+
+   tracer->streamPos = tracer->writePos;
 }
 
 void
 freeTracer(cpu::Tracer *tracer)
 {
    if (tracer) {
+      if (tracer->stream) {
+         streamTrace(tracer);
+         std::fclose(tracer->stream);
+      }
+
       delete tracer;
    }
 }
@@ -145,39 +315,278 @@ printInstruction(fmt::memory_buffer &out, const Trace& trace, int index)
    }
 }
 
-const Trace&
+static size_t
+getStateFieldSize(TraceFieldType type)
+{
+   if (type >= StateField::FPR0 && type <= StateField::FPR31) {
+      return 8;
+   } else {
+      return 4;
+   }
+}
+
+static uint8_t *
+encodeField(uint8_t *out, const cpu::CoreRegs *state, TraceFieldType type)
+{
+   TraceFieldValue value;
+   saveStateField(state, type, value);
+
+   auto size = getStateFieldSize(type);
+   *out++ = static_cast<uint8_t>(type);
+   std::memcpy(out, &value, size);
+   return out + size;
+}
+
+static const uint8_t *
+decodeField(const uint8_t *in, TraceFieldType &type, TraceFieldValue &value)
+{
+   type = *in++;
+   value.u64v0 = 0;
+   value.u64v1 = 0;
+
+   auto size = getStateFieldSize(type);
+   std::memcpy(&value, in, size);
+   return in + size;
+}
+
+/**
+ * Decode a trace record, index 0 is the most recently traced instruction.
+ */
+Trace
 getTrace(Tracer *tracer, int index)
 {
-   auto tracerSize = tracer->numTraces;
    decaf_check(index >= 0);
-   decaf_check(index < tracerSize);
-   auto realIndex = (int)tracer->index - 1 - index;
-   while (realIndex < 0) {
-      realIndex += (int)tracerSize;
+   decaf_check(static_cast<size_t>(index) < getTracerNumTraces(tracer));
+
+   auto recordNumber = tracer->nextRecord - 1 - index;
+   auto &info = tracer->records[recordNumber % tracer->records.size()];
+   const uint8_t *in = tracer->buffer.data() + (info.position % tracer->buffer.size());
+   auto trace = Trace { };
+
+   auto header = *in++;
+   if (!(header & TraceRecordSequential)) {
+      in += 4;
    }
-   while (realIndex >= tracerSize) {
-      realIndex -= (int)tracerSize;
+
+   trace.cia = info.cia;
+   std::memcpy(&trace.instr.value, in, 4);
+   in += 4;
+
+   trace.reads.resize(*in++);
+   for (auto &read : trace.reads) {
+      in = decodeField(in, read.type, read.value);
    }
-   return tracer->traces[realIndex];
+
+   trace.writes.resize(*in++);
+   for (auto &write : trace.writes) {
+      in = decodeField(in, write.type, write.value);
+   }
+
+   return trace;
 }
 
 size_t
 getTracerNumTraces(Tracer *tracer)
 {
-   return tracer->numTraces;
+   return static_cast<size_t>(tracer->nextRecord - tracer->firstRecord);
+}
+
+std::string
+getTracerStreamPath(Tracer *tracer)
+{
+   return tracer->streamPath;
+}
+
+static uint8_t *
+encodeVarint(uint8_t *out, uint64_t value)
+{
+   while (value >= 0x80) {
+      *out++ = static_cast<uint8_t>(value | 0x80);
+      value >>= 7;
+   }
+
+   *out++ = static_cast<uint8_t>(value);
+   return out;
+}
+
+static const uint8_t *
+decodeVarint(const uint8_t *in, const uint8_t *end, uint64_t &value)
+{
+   value = 0;
+
+   for (auto shift = 0u; shift < 64 && in < end; shift += 7) {
+      auto byte = *in++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+      if (!(byte & 0x80)) {
+         return in;
+      }
+   }
+
+   return nullptr;
+}
+
+/**
+ * Re-encode a single ring record for the trace stream, returns the position
+ * of the next record in the ring.
+ *
+ * Streamed records have the same layout as ring records except that each
+ * field value is stored as a LEB128 varint of the value XOR the previous
+ * value streamed for that field. Registers which did not change since they
+ * were last traced take a single byte.
+ */
+static const uint8_t *
+streamTraceRecord(TraceStreamValues &values,
+                  const uint8_t *in,
+                  std::vector<uint8_t> &stream)
+{
+   uint8_t record[MaxTraceStreamRecordSize];
+   auto out = record;
+   auto header = *in++;
+   auto fixedSize = (header & TraceRecordSequential) ? 4 : 8;
+
+   *out++ = header;
+   std::memcpy(out, in, fixedSize);
+   in += fixedSize;
+   out += fixedSize;
+
+   // Reads then writes
+   for (auto list = 0; list < 2; ++list) {
+      auto count = *in++;
+      *out++ = count;
+
+      for (auto i = 0u; i < count; ++i) {
+         TraceFieldType type;
+         TraceFieldValue value;
+         in = decodeField(in, type, value);
+
+         *out++ = static_cast<uint8_t>(type);
+         out = encodeVarint(out, value.u64v0 ^ values[type]);
+         values[type] = value.u64v0;
+      }
+   }
+
+   stream.insert(stream.end(), record, out);
+   return in;
+}
+
+static const uint8_t *
+decodeStreamField(const uint8_t *in,
+                  const uint8_t *end,
+                  TraceStreamValues &values,
+                  TraceFieldType &type,
+                  TraceFieldValue &value)
+{
+   if (in >= end || *in == StateField::Invalid || *in >= StateField::Max) {
+      return nullptr;
+   }
+
+   auto delta = uint64_t { 0 };
+   type = *in++;
+   in = decodeVarint(in, end, delta);
+
+   if (!in) {
+      return nullptr;
+   }
+
+   values[type] ^= delta;
+   value.u64v0 = values[type];
+   value.u64v1 = 0;
+   return in;
+}
+
+bool
+readTraceStream(const std::string &path,
+                std::vector<Trace> &traces)
+{
+   auto file = std::fopen(path.c_str(), "rb");
+   if (!file) {
+      return false;
+   }
+
+   auto data = std::vector<uint8_t> { };
+   uint8_t chunk[4096];
+
+   while (auto read = std::fread(chunk, 1, sizeof(chunk), file)) {
+      data.insert(data.end(), chunk, chunk + read);
+   }
+
+   std::fclose(file);
+
+   auto in = static_cast<const uint8_t *>(data.data());
+   auto end = in + data.size();
+   uint32_t magic, version;
+
+   if (data.size() < 8) {
+      return false;
+   }
+
+   std::memcpy(&magic, in, 4);
+   std::memcpy(&version, in + 4, 4);
+   in += 8;
+
+   if (magic != TraceStreamMagic || version != TraceStreamVersion) {
+      return false;
+   }
+
+   auto values = TraceStreamValues { };
+   auto prevCia = uint32_t { 0 };
+
+   while (in < end) {
+      auto trace = Trace { };
+      auto header = *in++;
+
+      if (header & TraceRecordSequential) {
+         trace.cia = prevCia + 4;
+      } else {
+         if (end - in < 4) {
+            return false;
+         }
+
+         std::memcpy(&trace.cia, in, 4);
+         in += 4;
+      }
+
+      if (end - in < 5) {
+         return false;
+      }
+
+      std::memcpy(&trace.instr.value, in, 4);
+      in += 4;
+
+      trace.reads.resize(*in++);
+      for (auto &read : trace.reads) {
+         in = decodeStreamField(in, end, values, read.type, read.value);
+
+         if (!in) {
+            return false;
+         }
+      }
+
+      if (in >= end) {
+         return false;
+      }
+
+      trace.writes.resize(*in++);
+      for (auto &write : trace.writes) {
+         in = decodeStreamField(in, end, values, write.type, write.value);
+
+         if (!in) {
+            return false;
+         }
+      }
+
+      prevCia = trace.cia;
+      traces.emplace_back(std::move(trace));
+   }
+
+   return true;
 }
 
 void
 traceInit(cpu::Core *state, size_t size)
 {
-#ifdef TRACE_ENABLED
-   state->tracer = new Tracer();
-   state->tracer->index = 0;
-   state->tracer->numTraces = 0;
-   state->tracer->traces.resize(size);
-#else
-   state->tracer = nullptr;
-#endif
+   state->tracer = cpu::allocTracer(size);
 }
 
 static uint32_t
@@ -331,138 +740,203 @@ restoreStateField(cpu::CoreRegs *state, TraceFieldType type, const TraceFieldVal
    }
 }
 
-template<typename T>
+//! Set of StateField values, used to de-duplicate a record's fields.
+struct StateFieldSet
+{
+   bool
+   insert(TraceFieldType type)
+   {
+      auto &word = bits[type / 64];
+      auto bit = uint64_t { 1 } << (type % 64);
+
+      if (type == StateField::Invalid || (word & bit)) {
+         return false;
+      }
+
+      word |= bit;
+      return true;
+   }
+
+   std::array<uint64_t, (StateField::Max + 63) / 64> bits = { };
+};
+
+/**
+ * Make sure there is contiguous space for the next record in the ring,
+ * dropping the oldest records which will be overwritten.
+ */
 static void
-pushUniqueField(std::vector<T> &fields, uint32_t fieldId)
+reserveTraceRecord(Tracer *tracer)
 {
-   if (fieldId == StateField::Invalid) {
-      return;
+   auto size = tracer->buffer.size();
+   auto offset = tracer->writePos % size;
+
+   if (offset + MaxTraceRecordSize > size) {
+      // Records never straddle the end of the ring, so stream out what we
+      // have and skip the unused tail.
+      cpu::streamTrace(tracer);
+      tracer->writePos += size - offset;
+      tracer->streamPos = tracer->writePos;
    }
 
-   for (auto &i : fields) {
-      if (i.type == fieldId) {
-         return;
+   auto end = tracer->writePos + MaxTraceRecordSize;
+   auto numRecords = tracer->records.size();
+
+   while (tracer->firstRecord < tracer->nextRecord) {
+      auto &oldest = tracer->records[tracer->firstRecord % numRecords];
+
+      if (oldest.position + size >= end &&
+          tracer->nextRecord - tracer->firstRecord < numRecords) {
+         break;
       }
-   }
 
-   fields.push_back({ fieldId });
+      tracer->firstRecord++;
+   }
 }
 
-Trace *
+/**
+ * Record the instruction and the fields it reads, the fields it writes are
+ * recorded by traceInstructionEnd once it has executed.
+ *
+ * Record format, values are in host byte order:
+ *   u8 header, TraceRecordSequential when cia was omitted
+ *   u32 cia, only when not sequential
+ *   u32 instruction
+ *   u8 numReads, followed by numReads of { u8 StateField, u32 or u64 value }
+ *   u8 numWrites, followed by numWrites of { u8 StateField, u32 or u64 value }
+ *
+ * FPR values are 64 bit, every other field is 32 bit.
+ */
+Tracer *
 traceInstructionStart(Instruction instr, InstructionInfo *data, cpu::Core *state)
 {
-   if (!state->tracer) {
+   auto tracer = state->tracer;
+   if (!tracer) {
       return nullptr;
    }
 
-   auto tracer = state->tracer;
-   auto &trace = tracer->traces[tracer->index];
-   auto tracerSize = tracer->traces.size();
+   std::call_once(sTraceInstructionFieldsFlag, initialiseTraceInstructionFields);
+   reserveTraceRecord(tracer);
+
+   auto &fields = sTraceInstructionFields[static_cast<size_t>(data->id)];
+   auto start = tracer->buffer.data() + (tracer->writePos % tracer->buffer.size());
+   auto out = start;
+   auto cia = state->cia;
 
-   if (tracer->numTraces < tracerSize) {
-      tracer->numTraces++;
+   if (cia == tracer->prevCia + 4) {
+      *out++ = TraceRecordSequential;
+   } else {
+      *out++ = 0;
+      std::memcpy(out, &cia, 4);
+      out += 4;
    }
 
-   tracer->index = (tracer->index + 1) % tracerSize;
+   std::memcpy(out, &instr.value, 4);
+   out += 4;
+
+   // Save the read fields
+   auto numReads = out++;
+   auto reads = StateFieldSet { };
+   *numReads = 0;
 
-   // Setup Trace
-   trace.instr = instr;
-   trace.cia = state->cia;
-   trace.reads.clear();
-   trace.writes.clear();
+   for (auto field : fields.reads) {
+      auto type = getFieldStateField(instr, field);
 
-   // Automatically determine register changes
-   for (auto i = 0u; i < data->read.size(); ++i) {
-      auto stateField = getFieldStateField(instr, data->read[i]);
-      pushUniqueField(trace.reads, stateField);
+      if (reads.insert(type)) {
+         out = encodeField(out, state, type);
+         ++*numReads;
+      }
    }
 
-   for (auto i = 0u; i < data->write.size(); ++i) {
-      auto stateField = getFieldStateField(instr, data->write[i]);
-      pushUniqueField(trace.writes, stateField);
+   if (data->id == InstructionID::stmw) {
+      for (uint32_t i = StateField::GPR + instr.rS; i <= StateField::GPR31; ++i) {
+         if (reads.insert(i)) {
+            out = encodeField(out, state, i);
+            ++*numReads;
+         }
+      }
    }
 
-   for (auto i = 0u; i < data->flags.size(); ++i) {
-      auto stateField = getFieldStateField(instr, data->flags[i]);
-      pushUniqueField(trace.writes, stateField);
+   // Decide the write fields now as they may depend on the instruction.
+   auto writes = StateFieldSet { };
+   tracer->numPendingWrites = 0;
+
+   for (auto field : fields.writes) {
+      auto type = getFieldStateField(instr, field);
+
+      if (writes.insert(type)) {
+         tracer->pendingWrites[tracer->numPendingWrites++] = static_cast<uint8_t>(type);
+      }
    }
 
-   // Some special cases.
    if (data->id == InstructionID::lmw) {
       for (uint32_t i = StateField::GPR + instr.rD; i <= StateField::GPR31; ++i) {
-         pushUniqueField(trace.writes, i);
-      }
-   } else if (data->id == InstructionID::stmw) {
-      for (uint32_t i = StateField::GPR + instr.rS; i <= StateField::GPR31; ++i) {
-         pushUniqueField(trace.reads, i);
+         if (writes.insert(i)) {
+            tracer->pendingWrites[tracer->numPendingWrites++] = static_cast<uint8_t>(i);
+         }
       }
-   } else if (data->id == InstructionID::stswi) {
-      // TODO: Implement Me
-   } else if (data->id == InstructionID::stswx) {
-      // TODO: Implement Me
    }
 
 #ifdef TRACE_VERIFICATION
-   if (data->id == InstructionID::stswi) {
-      //assert(0);
-   } else if (data->id == InstructionID::stswx) {
-      //assert(0);
+   tracer->prevState = *state;
+#else
+   // A kc can change anything, so the writes are found by comparing state.
+   if (data->id == InstructionID::kc) {
+      tracer->prevState = *state;
    }
 #endif
 
-   // Save all state
-   for (auto &i : trace.reads) {
-      saveStateField(state, i.type, i.value);
-   }
-
-   for (auto &i : trace.writes) {
-      saveStateField(state, i.type, i.prevalue);
-   }
-
-   // TODO: This is a bit of a hack... We should probably not do this...
-   tracer->prevState = *state;
-   return &trace;
+   auto &info = tracer->records[tracer->nextRecord % tracer->records.size()];
+   info.position = tracer->writePos;
+   info.cia = cia;
+   tracer->pendingPos = tracer->writePos + (out - start);
+   return tracer;
 }
 
 void
-traceInstructionEnd(Trace *trace, Instruction instr, InstructionInfo *data, cpu::Core *state)
+traceInstructionEnd(Tracer *tracer, Instruction instr, InstructionInfo *data, cpu::Core *state)
 {
-   if (!trace) {
+   if (!tracer) {
       return;
    }
 
-   auto tracer = state->tracer;
-
    // Special hack for KC for now
    if (data->id == InstructionID::kc) {
-      trace->writes.clear();
+      tracer->numPendingWrites = 0;
 
-      for (int i = 0; i < StateField::Max; ++i) {
+      for (int i = StateField::Invalid + 1; i < StateField::Max; ++i) {
          TraceFieldValue curVal, prevVal;
          saveStateField(&tracer->prevState, i, prevVal);
          saveStateField(state, i, curVal);
+
          if (curVal.value != prevVal.value) {
-            pushUniqueField(trace->writes, i);
+            tracer->pendingWrites[tracer->numPendingWrites++] = static_cast<uint8_t>(i);
          }
       }
-
-      for (auto &i : trace->writes) {
-         saveStateField(&tracer->prevState, i.type, i.prevalue);
-      }
    }
 
-   for (auto &i : trace->writes) {
-      saveStateField(state, i.type, i.value);
+   auto start = tracer->buffer.data() + (tracer->pendingPos % tracer->buffer.size());
+   auto out = start;
+   *out++ = static_cast<uint8_t>(tracer->numPendingWrites);
+
+   for (auto i = 0u; i < tracer->numPendingWrites; ++i) {
+      out = encodeField(out, state, tracer->pendingWrites[i]);
    }
 
+   auto &info = tracer->records[tracer->nextRecord % tracer->records.size()];
+   tracer->prevCia = info.cia;
+   tracer->writePos = tracer->pendingPos + (out - start);
+   tracer->nextRecord++;
+
 #ifdef TRACE_VERIFICATION
-   if (tracer->numTraces > 0) {
+   if (getTracerNumTraces(tracer) > 1) {
       auto errors = std::vector<std::string> {};
       auto checkState = *state;
       checkState.nia = tracer->prevState.nia;
 
-      for (auto &i : trace->writes) {
-         restoreStateField(&checkState, i.type, i.prevalue);
+      for (auto i = 0u; i < tracer->numPendingWrites; ++i) {
+         TraceFieldValue prevVal;
+         saveStateField(&tracer->prevState, tracer->pendingWrites[i], prevVal);
+         restoreStateField(&checkState, tracer->pendingWrites[i], prevVal);
       }
 
       if (!dbgStateCmp(&checkState, &tracer->prevState, errors)) {
@@ -501,7 +975,7 @@ tracePrint(cpu::Core *state, int start, int count)
    fmt::format_to(out, "Trace - Print {} to {}\n", start, end);
 
    for (auto i = start; i < end; ++i) {
-      auto &trace = getTrace(tracer, i);
+      auto trace = getTrace(tracer, i);
       printInstruction(out, trace, i);
    }
 
@@ -522,7 +996,7 @@ traceReg(cpu::Core *state, int start, int regIdx)
    decaf_check(start < tracerSize);
 
    for (auto i = start; i < tracerSize; ++i) {
-      auto &trace = getTrace(tracer, i);
+      auto trace = getTrace(tracer, i);
 
       bool wasMatchedWrite = false;
       for (auto &j : trace.writes) {
@@ -575,7 +1049,7 @@ traceRegNext(int regIdx)
    }
 
    auto tracer = gRegTraceState->tracer;
-   auto &trace = getTrace(tracer, foundIndex);
+   auto trace = getTrace(tracer, foundIndex);
 
    if (trace.reads.size() == 1) {
       if (trace.reads.front().type >= StateField::GPR0 && trace.reads.front().type <= StateField::GPR31) {
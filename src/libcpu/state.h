@@ -11,6 +11,8 @@ struct Tracer;
 namespace cpu
 {
 
+static const uint32_t InvalidKernelCallId = 0xFFFFFFFF;
+
 static const uint32_t coreClockSpeed = 1243125000;
 static const uint32_t busClockSpeed = 248625000;
 static const uint32_t timerClockSpeed = busClockSpeed / 4;
@@ -82,6 +84,10 @@ struct Core : CoreRegs
    // Tracer used to record executed instructions
    Tracer *tracer;
 
+   // Kernel call currently being executed, read by the sampling profiler
+   // from another thread.
+   std::atomic<uint32_t> kernelCallId { InvalidKernelCallId };
+
    // Get current core time
    uint64_t tb();
 };
@@ -128,7 +128,6 @@ struct Trace
    {
       TraceFieldType type;
       TraceFieldValue value;
-      TraceFieldValue prevalue;
    };
 
    espresso::Instruction instr;
@@ -137,24 +136,39 @@ struct Trace
    std::vector<_W> writes;
 };
 
-const Trace &
+/**
+ * Traces are stored in a compact binary ring buffer, getTrace decodes a
+ * single record where index 0 is the most recently executed instruction.
+ */
+Trace
 getTrace(Tracer *tracer,
          int index);
 
 size_t
 getTracerNumTraces(Tracer *tracer);
 
+std::string
+getTracerStreamPath(Tracer *tracer);
+
+/**
+ * Decode a trace file streamed by a tracer when trace.stream_directory is
+ * set, traces are appended oldest first.
+ */
+bool
+readTraceStream(const std::string &path,
+                std::vector<Trace> &traces);
+
 void
 traceInit(cpu::Core *state,
           size_t size);
 
-Trace *
+Tracer *
 traceInstructionStart(espresso::Instruction instr,
                       espresso::InstructionInfo *data,
                       cpu::Core *state);
 
 void
-traceInstructionEnd(Trace *trace,
+traceInstructionEnd(Tracer *tracer,
                     espresso::Instruction instr,
                     espresso::InstructionInfo *data,
                     cpu::Core *state);
@@ -24,6 +24,9 @@ extern bool gdb_stub;
 //! What port to use for gdb stub
 extern unsigned gdb_stub_port;
 
+//! Number of samples per second taken by the sampling profiler
+extern unsigned profiler_frequency;
+
 } // namespace debugger
 
 namespace gx2
@@ -55,7 +58,8 @@ extern std::string level;
 //! Directory to output log file to
 extern std::string directory;
 
-//! Enable logging for all HLE function calls
+//! Enable recording of all HLE function calls to the per-core trace buffer,
+//! which is decoded to the log on exit or from the debugger.
 extern bool kernel_trace;
 
 //! Enable logging for all HLE function call results
@@ -69,6 +73,17 @@ extern std::vector<std::string> kernel_trace_filters;
 
 } // namespace log
 
+namespace replay
+{
+
+//! Record every nondeterministic guest input to this file, empty to disable
+extern std::string record_path;
+
+//! Replay guest inputs previously recorded to this file, empty to disable
+extern std::string playback_path;
+
+} // namespace replay
+
 namespace sound
 {
 
@@ -119,6 +134,17 @@ extern std::vector<std::string> lle_modules;
 //! Whether to dump HLE generated .rpl
 extern bool dump_hle_rpl;
 
+//! Path to cache inflated RPL sections in, caching is disabled when empty
+extern std::string rpl_cache_path;
+
+//! Validate every active thread on each coreinit thread switch
+extern bool scheduler_validation;
+
+//! Replace hot guest runtime routines (memcpy, strlen...) with host versions,
+//! off by default as they bypass guest MMU checks so faulting accesses are
+//! not reported to the guest
+extern bool hle_replace_routines;
+
 } // namespace system
 
 } // namespace config
@@ -25,26 +25,32 @@ readGpr(cpu::Core *core)
    }
 }
 
+//! Convert the raw value of a 32 bit gpr to ArgType
+template<typename ArgType>
+inline ArgType
+gpr32ToParam(uint32_t value)
+{
+   using ValueType = std::remove_cv_t<ArgType>;
+   if constexpr (is_virt_ptr<ValueType>::value) {
+      return virt_cast<typename ArgType::value_type *>(static_cast<virt_addr>(value));
+   } else if constexpr (is_phys_ptr<ValueType>::value) {
+      return phys_cast<typename ArgType::value_type *>(static_cast<phys_addr>(value));
+   } else if constexpr (is_virt_func_ptr<ValueType>::value) {
+      return virt_func_cast<typename ArgType::function_type>(static_cast<virt_addr>(value));
+   } else if constexpr (is_bitfield_type<ValueType>::value) {
+      return ArgType::get(value);
+   } else {
+      return static_cast<ArgType>(value);
+   }
+}
+
 template<typename ArgType, RegisterType regType, auto regIndex>
 inline ArgType
 readParam(cpu::Core *core,
           param_info_t<ArgType, regType, regIndex>)
 {
-   using ValueType = std::remove_cv_t<ArgType>;
    if constexpr (regType == RegisterType::Gpr32) {
-      auto value = readGpr<regIndex>(core);
-
-      if constexpr (is_virt_ptr<ValueType>::value) {
-         return virt_cast<typename ArgType::value_type *>(static_cast<virt_addr>(value));
-      } else if constexpr (is_phys_ptr<ValueType>::value) {
-         return phys_cast<typename ArgType::value_type *>(static_cast<phys_addr>(value));
-      } else if constexpr (is_virt_func_ptr<ValueType>::value) {
-         return virt_func_cast<typename ArgType::function_type>(static_cast<virt_addr>(value));
-      } else if constexpr (is_bitfield_type<ValueType>::value) {
-         return ArgType::get(value);
-      } else {
-         return static_cast<ArgType>(value);
-      }
+      return gpr32ToParam<ArgType>(readGpr<regIndex>(core));
    } else if constexpr (regType == RegisterType::Gpr64) {
       auto hi = static_cast<uint64_t>(readGpr<regIndex>(core)) << 32;
       auto lo = static_cast<uint64_t>(readGpr<regIndex + 1>(core));
@@ -1,70 +1,192 @@
 #pragma once
 #include "cafe_ppc_interface_invoke.h"
 
-#include <common/log.h>
+#include <cstdint>
 #include <fmt/format.h>
+#include <type_traits>
 
 namespace cafe
 {
 
+/**
+ * A binary record of a single HLE function call.
+ *
+ * Only the raw argument registers are captured at call time, the record is
+ * formatted later by invoke_trace_format using the function's param_info.
+ */
+struct CallTraceRecord
+{
+   //! Number of gpr argument slots captured, r3 - r10 then the stack.
+   static constexpr auto NumGprs = 12;
+
+   //! Number of fpr argument slots captured, f1 - f8.
+   static constexpr auto NumFprs = 8;
+
+   //! Core time base at the time of the call.
+   uint64_t timestamp;
+
+   //! Kernel call ID of the function which was called.
+   uint32_t syscallID;
+
+   //! Link register of the caller.
+   uint32_t lr;
+
+   //! Argument gprs, gpr[0] is r3.
+   uint32_t gpr[NumGprs];
+
+   //! Argument fprs, fpr[0] is f1.
+   double fpr[NumFprs];
+};
+
 namespace detail
 {
 
-template<int argIndex, typename ArgType, RegisterType regType, int regIndex>
+template<typename ArgType, RegisterType regType, auto regIndex>
+inline void
+recordParam(CallTraceRecord &record,
+            cpu::Core *core,
+            param_info_t<ArgType, regType, regIndex>)
+{
+   if constexpr (regType == RegisterType::Gpr32) {
+      if constexpr (regIndex - 3 < CallTraceRecord::NumGprs) {
+         record.gpr[regIndex - 3] = readGpr<regIndex>(core);
+      }
+   } else if constexpr (regType == RegisterType::Gpr64) {
+      if constexpr (regIndex - 2 < CallTraceRecord::NumGprs) {
+         record.gpr[regIndex - 3] = readGpr<regIndex>(core);
+         record.gpr[regIndex - 2] = readGpr<regIndex + 1>(core);
+      }
+   } else if constexpr (regType == RegisterType::Fpr) {
+      if constexpr (regIndex - 1 < CallTraceRecord::NumFprs) {
+         record.fpr[regIndex - 1] = core->fpr[regIndex].paired0;
+      }
+   }
+}
+
+template<typename ArgType, RegisterType regType, auto regIndex>
+inline void
+formatParam(fmt::memory_buffer &message,
+            const CallTraceRecord &record,
+            param_info_t<ArgType, regType, regIndex>)
+{
+   if constexpr (regType == RegisterType::Gpr32) {
+      if constexpr (regIndex - 3 < CallTraceRecord::NumGprs) {
+         if constexpr (std::is_same<ArgType, virt_ptr<const char>>::value ||
+                       std::is_same<ArgType, virt_ptr<char>>::value) {
+            // Only the pointer was recorded, the string it pointed to may
+            //  have changed since the call so print the address instead.
+            fmt::format_to(message, "0x{:08X}", record.gpr[regIndex - 3]);
+         } else {
+            fmt::format_to(message, "{}", gpr32ToParam<ArgType>(record.gpr[regIndex - 3]));
+         }
+      } else {
+         fmt::format_to(message, "?");
+      }
+   } else if constexpr (regType == RegisterType::Gpr64) {
+      if constexpr (regIndex - 2 < CallTraceRecord::NumGprs) {
+         auto hi = static_cast<uint64_t>(record.gpr[regIndex - 3]) << 32;
+         auto lo = static_cast<uint64_t>(record.gpr[regIndex - 2]);
+         fmt::format_to(message, "{}", static_cast<ArgType>(hi | lo));
+      } else {
+         fmt::format_to(message, "?");
+      }
+   } else if constexpr (regType == RegisterType::Fpr) {
+      if constexpr (regIndex - 1 < CallTraceRecord::NumFprs) {
+         fmt::format_to(message, "{}", static_cast<ArgType>(record.fpr[regIndex - 1]));
+      } else {
+         fmt::format_to(message, "?");
+      }
+   } else if constexpr (regType == RegisterType::VarArgs) {
+      fmt::format_to(message, "...");
+   }
+}
+
+template<int argIndex, typename ArgType, RegisterType regType, auto regIndex>
 inline void
 logParam(fmt::memory_buffer &message,
-         cpu::Core *core,
+         const CallTraceRecord &record,
          param_info_t<ArgType, regType, regIndex> paramInfo)
 {
    if (argIndex > 0) {
       fmt::format_to(message, ", ");
    }
 
-   if constexpr (regType == RegisterType::VarArgs) {
-      fmt::format_to(message, "...");
-   } else {
-      fmt::format_to(message, "{}", readParam(core, paramInfo));
-   }
+   formatParam(message, record, paramInfo);
 }
 
-template<typename HostFunctionType, typename FunctionTraitsType, std::size_t... I>
+template<typename FunctionTraitsType, std::size_t... I>
 void
 invoke_trace_host_impl(cpu::Core *core,
-                       HostFunctionType &&,
-                       const char *name,
+                       CallTraceRecord &record,
                        FunctionTraitsType &&,
                        std::index_sequence<I...>)
 {
-   fmt::memory_buffer message;
+   auto param_info = typename FunctionTraitsType::param_info { };
+
+   if constexpr (FunctionTraitsType::is_member_function) {
+      recordParam(record, core, typename FunctionTraitsType::object_info { });
+   }
+
+   if constexpr (FunctionTraitsType::num_args > 0) {
+      (recordParam(record, core, std::get<I>(param_info)), ...);
+   }
+}
+
+template<typename FunctionTraitsType, std::size_t... I>
+void
+invoke_trace_format_impl(fmt::memory_buffer &message,
+                         const CallTraceRecord &record,
+                         const char *name,
+                         FunctionTraitsType &&,
+                         std::index_sequence<I...>)
+{
    auto param_info = typename FunctionTraitsType::param_info { };
    fmt::format_to(message, "{}(", name);
 
    if constexpr (FunctionTraitsType::is_member_function) {
-      fmt::format_to(message, "this = {}, ", readParam(core, typename FunctionTraitsType::object_info { }));
+      fmt::format_to(message, "this = ");
+      formatParam(message, record, typename FunctionTraitsType::object_info { });
+      fmt::format_to(message, ", ");
    }
 
    if constexpr (FunctionTraitsType::num_args > 0) {
-      (logParam<I>(message, core, std::get<I>(param_info)), ...);
+      (logParam<I>(message, record, std::get<I>(param_info)), ...);
    }
 
-   fmt::format_to(message, ") from 0x{:08X}", core->lr);
-   gLog->debug(std::string_view { message.data(), message.size() });
+   fmt::format_to(message, ") from 0x{:08X}", record.lr);
 }
 
 } // namespace detail
 
-//! Trace log a host function call from a guest context
+//! Record the arguments of a host function call from a guest context
 template<typename FunctionType>
 void
 invoke_trace(cpu::Core *core,
-             FunctionType fn,
-             const char *name)
+             FunctionType,
+             CallTraceRecord &record)
 {
    using func_traits = detail::function_traits<FunctionType>;
+   record.lr = core->lr;
    invoke_trace_host_impl(core,
-                          fn, name,
+                          record,
                           func_traits { },
                           std::make_index_sequence<func_traits::num_args> {});
 }
 
+//! Format a trace record previously captured by invoke_trace
+template<typename FunctionType>
+void
+invoke_trace_format(fmt::memory_buffer &message,
+                    const CallTraceRecord &record,
+                    FunctionType,
+                    const char *name)
+{
+   using func_traits = detail::function_traits<FunctionType>;
+   invoke_trace_format_impl(message,
+                            record,
+                            name,
+                            func_traits { },
+                            std::make_index_sequence<func_traits::num_args> {});
+}
+
 } // namespace cafe
@@ -12,6 +12,7 @@
 #include "cafe_kernel_shareddata.h"
 
 #include "cafe/libraries/cafe_hle.h"
+#include "cafe/loader/cafe_loader_entry.h"
 #include "decaf_events.h"
 #include "decaf_game.h"
 #include "kernel/kernel_filesystem.h"
@@ -21,6 +22,7 @@
 #include <common/log.h>
 #include <common/platform_dir.h>
 #include <common/strutils.h>
+#include <libcpu/cpu_config.h>
 
 namespace cafe::kernel
 {
@@ -211,27 +213,45 @@ cpuBranchTraceHandler(cpu::Core *core,
    }
 }
 
-static void
-cpuKernelCallHandler(cpu::Core *core,
-                     uint32_t id)
+static std::string
+cpuCodeSymbolHandler(uint32_t address)
 {
-   // Save our original stack pointer for the backchain
-   auto backchainSp = core->gpr[1];
-
-   // Allocate callee backchain and lr space.
-   core->gpr[1] -= 2 * 4;
+   auto symbolDistance = uint32_t { 0 };
+   char symbolNameBuffer[256];
+   char moduleNameBuffer[256];
+
+   // This is called from the JIT, which may be compiling code for a guest
+   // thread which interrupted the loader on this core. Rather than risk
+   // waiting on ourselves go without a symbol while a module is being loaded
+   // or unloaded.
+   if (!loader::tryLockLoader()) {
+      return { };
+   }
 
-   // Write the backchain pointer
-   *virt_cast<uint32_t *>(virt_addr { core->gpr[1] }) = backchainSp;
+   auto error =
+      internal::findClosestSymbol(virt_addr { address },
+                                  &symbolDistance,
+                                  symbolNameBuffer, sizeof(symbolNameBuffer),
+                                  moduleNameBuffer, sizeof(moduleNameBuffer));
+   loader::unlockLoader();
 
-   // Handle the HLE function call
-   cafe::hle::Library::handleKernelCall(core, id);
+   if (error || !moduleNameBuffer[0]) {
+      return { };
+   }
 
-   // Grab the most recent core state as it may have changed.
-   core = cpu::this_core::state();
+   return fmt::format("{}:{}+0x{:X}",
+                      moduleNameBuffer, symbolNameBuffer, symbolDistance);
+}
 
-   // Release callee backchain and lr space.
-   core->gpr[1] += 2 * 4;
+static void
+cpuKernelCallHandler(cpu::Core *core,
+                     uint32_t id)
+{
+   // Handle the HLE function call, implemented functions are normally bound
+   // directly with cafe::hle::bindKernelCalls so only get here when not.
+   cafe::hle::internal::pushKernelCallFrame(core);
+   cafe::hle::Library::handleKernelCall(core, id);
+   cafe::hle::internal::popKernelCallFrame();
 }
 
 void
@@ -267,6 +287,10 @@ start()
 
    cpu::setKernelCallHandler(&cpuKernelCallHandler);
 
+   if (cpu::config::jit::perf_map || cpu::config::jit::perf_jitdump) {
+      cpu::setCodeSymbolHandler(&cpuCodeSymbolHandler);
+   }
+
    // Start the cpu
    cpu::start();
 }
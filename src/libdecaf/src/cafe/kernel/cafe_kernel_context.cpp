@@ -6,6 +6,7 @@
 #include "cafe/libraries/cafe_hle.h"
 
 #include <array>
+#include <common/byte_swap_array.h>
 #include <common/platform_fiber.h>
 #include <common/log.h>
 #include <libcpu/cpu.h>
@@ -45,23 +46,23 @@ checkDeadContext();
 
 using ContextEntryPoint = virt_func_ptr<void()>;
 
+// The register files are copied in bulk, which relies on their layout.
+static_assert(sizeof(espresso::GraphicsQuantisationRegister) == sizeof(uint32_t));
+static_assert(sizeof(espresso::FloatingPointRegister) == 2 * sizeof(uint64_t));
+
 void
 copyContextFromCpu(virt_ptr<Context> context)
 {
    auto state = cpu::this_core::state();
 
-   for (auto i = 0; i < 32; ++i) {
-      context->gpr[i] = state->gpr[i];
-   }
+   auto gpr = reinterpret_cast<uint32_t *>(virt_addrof(context->gpr).getRawPointer());
+   auto fpr = reinterpret_cast<uint64_t *>(virt_addrof(context->fpr).getRawPointer());
+   auto psf = reinterpret_cast<uint64_t *>(virt_addrof(context->psf).getRawPointer());
+   auto gqr = reinterpret_cast<uint32_t *>(virt_addrof(context->gqr).getRawPointer());
 
-   for (auto i = 0; i < 32; ++i) {
-      context->fpr[i] = state->fpr[i].value;
-      context->psf[i] = state->fpr[i].paired1;
-   }
-
-   for (auto i = 0; i < 8; ++i) {
-      context->gqr[i] = state->gqr[i].value;
-   }
+   byte_swap_copy(gpr, state->gpr, 32);
+   byte_swap_copy_deinterleave(fpr, psf, reinterpret_cast<uint64_t *>(state->fpr), 32);
+   byte_swap_copy(gqr, reinterpret_cast<uint32_t *>(state->gqr), 8);
 
    context->cr = state->cr.value;
    context->lr = state->lr;
@@ -79,18 +80,14 @@ copyContextToCpu(virt_ptr<Context> context)
 {
    auto state = cpu::this_core::state();
 
-   for (auto i = 0; i < 32; ++i) {
-      state->gpr[i] = context->gpr[i];
-   }
-
-   for (auto i = 0; i < 32; ++i) {
-      state->fpr[i].value = context->fpr[i];
-      state->fpr[i].paired1 = context->psf[i];
-   }
+   auto gpr = reinterpret_cast<uint32_t *>(virt_addrof(context->gpr).getRawPointer());
+   auto fpr = reinterpret_cast<uint64_t *>(virt_addrof(context->fpr).getRawPointer());
+   auto psf = reinterpret_cast<uint64_t *>(virt_addrof(context->psf).getRawPointer());
+   auto gqr = reinterpret_cast<uint32_t *>(virt_addrof(context->gqr).getRawPointer());
 
-   for (auto i = 0; i < 8; ++i) {
-      state->gqr[i].value = context->gqr[i];
-   }
+   byte_swap_copy(state->gpr, gpr, 32);
+   byte_swap_copy_interleave(reinterpret_cast<uint64_t *>(state->fpr), fpr, psf, 32);
+   byte_swap_copy(reinterpret_cast<uint32_t *>(state->gqr), gqr, 8);
 
    state->cr.value = context->cr;
    state->lr = context->lr;
@@ -7,6 +7,7 @@
 
 #include "decaf_config.h"
 #include "debugger/debugger.h"
+#include "replay/replay.h"
 #include "cafe/libraries/coreinit/coreinit_alarm.h"
 #include "cafe/libraries/coreinit/coreinit_interrupts.h"
 #include "cafe/libraries/coreinit/coreinit_scheduler.h"
@@ -109,6 +110,7 @@ handleCpuInterrupt(cpu::Core *core,
                    uint32_t flags)
 {
    auto interruptedContext = getCurrentContext();
+   replay::verifyValue(replay::EventType::Interrupt, flags);
 
    if (flags & cpu::SRESET_INTERRUPT) {
       dispatchException(ExceptionType::SystemReset, interruptedContext);
@@ -6,6 +6,7 @@
 #include "cafe/libraries/coreinit/coreinit_ipcdriver.h"
 #include "cafe/libraries/coreinit/coreinit_scheduler.h"
 #include "ios/kernel/ios_kernel_ipc_thread.h"
+#include "replay/replay.h"
 
 #include <condition_variable>
 #include <libcpu/cpu.h>
@@ -592,6 +593,14 @@ ipckDriverHandleInterrupt(InterruptType type,
 
    // Process replies into process queue
    for (auto response : responses) {
+      if (replay::getMode() != replay::Mode::Disabled) {
+         auto command = response->command.value();
+         auto reply = response->reply.value();
+         replay::verifyValue(replay::EventType::IpcReply, command);
+         replay::syncValue(replay::EventType::IpcReply, reply);
+         response->reply = reply;
+      }
+
       processReply(driver, response);
    }
 
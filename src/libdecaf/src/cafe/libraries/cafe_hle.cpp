@@ -1,4 +1,5 @@
 #include "cafe_hle.h"
+#include "cafe_hle_replace.h"
 
 #include "avm/avm.h"
 #include "camera/camera.h"
@@ -159,6 +160,8 @@ initialiseLibraries()
    registerLibrary(new vpad::Library { });
    registerLibrary(new zlib125::Library { });
    applyTraceFilters();
+   registerRoutineReplacements();
+   bindKernelCalls();
 }
 
 Library *
@@ -16,6 +16,15 @@ getLibrary(LibraryId id);
 Library *
 getLibrary(std::string_view name);
 
+LibraryFunction *
+getKernelCallFunction(uint32_t id);
+
+uint32_t
+registerKernelCall(LibraryFunction *function);
+
+void
+bindKernelCalls();
+
 void
 relocateLibrary(std::string_view name,
                 virt_addr textBaseAddress,
@@ -79,6 +79,33 @@ setUnimplementedFunctionStubMemory(virt_ptr<void> base,
    sUnimplementedFunctionStubMemory = base;
 }
 
+LibraryFunction *
+getKernelCallFunction(uint32_t id)
+{
+   if (id >= sKernelCalls.size()) {
+      return nullptr;
+   }
+
+   return sKernelCalls[id];
+}
+
+/**
+ * Bind every implemented function's kc directly to its host entry point,
+ * must be called again whenever kernel trace is enabled or disabled.
+ */
+void
+bindKernelCalls()
+{
+   for (auto id = 0u; id < sKernelCalls.size(); ++id) {
+      auto function = sKernelCalls[id];
+      auto trace = decaf::config::log::kernel_trace && function->traceEnabled;
+
+      // Every generated stub is a kc followed by a blr.
+      cpu::setKernelCallTarget(id, function->getKernelCallEntry(trace),
+                               function, true);
+   }
+}
+
 void
 Library::handleKernelCall(cpu::Core *state,
                           uint32_t id)
@@ -98,6 +125,18 @@ Library::handleKernelCall(cpu::Core *state,
    }
 }
 
+/**
+ * Register a function which does not belong to any library as a kernel call,
+ * must be called before bindKernelCalls.
+ */
+uint32_t
+registerKernelCall(LibraryFunction *function)
+{
+   function->syscallID = static_cast<uint32_t>(sKernelCalls.size());
+   sKernelCalls.push_back(function);
+   return function->syscallID;
+}
+
 void
 Library::registerKernelCalls()
 {
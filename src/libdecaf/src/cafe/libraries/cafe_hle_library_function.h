@@ -1,5 +1,6 @@
 #pragma once
 #include "cafe_hle_library_symbol.h"
+#include "cafe_hle_trace.h"
 #include "cafe/cafe_ppc_interface_invoke.h"
 #include "cafe/cafe_ppc_interface_invoke_trace.h"
 
@@ -32,6 +33,13 @@ struct LibraryFunction : public LibrarySymbol
 
    virtual void call(cpu::Core *state) = 0;
 
+   //! Format a call trace record made by this function.
+   virtual void formatTrace(fmt::memory_buffer &message,
+                            const CallTraceRecord &record) = 0;
+
+   //! Host entry point to bind this function's kc to, see bindKernelCalls.
+   virtual cpu::KernelCallEntry getKernelCallEntry(bool trace) = 0;
+
    //! ID number of syscall.
    uint32_t syscallID;
 
@@ -45,6 +53,26 @@ struct LibraryFunction : public LibrarySymbol
 namespace internal
 {
 
+/**
+ * Allocate the callee backchain and lr space around an HLE call, as the
+ * guest expects a called function to create a stack frame.
+ */
+inline void
+pushKernelCallFrame(cpu::Core *core)
+{
+   auto backchainSp = core->gpr[1];
+   core->gpr[1] -= 2 * 4;
+   *virt_cast<uint32_t *>(virt_addr { core->gpr[1] }) = backchainSp;
+}
+
+inline void
+popKernelCallFrame()
+{
+   // Grab the most recent core state as it may have changed.
+   auto core = cpu::this_core::state();
+   core->gpr[1] += 2 * 4;
+}
+
 /**
  * Handles call to both global functions and member functions.
  */
@@ -60,11 +88,40 @@ struct LibraryFunctionCall : LibraryFunction
    virtual void call(cpu::Core *state) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         invoke_trace(state, func, name.c_str());
+         auto &record = beginCallTraceRecord(state, syscallID);
+         invoke_trace(state, func, record);
+         endCallTraceRecord(state);
       }
 
       invoke(state, func);
    }
+
+   virtual void formatTrace(fmt::memory_buffer &message,
+                            const CallTraceRecord &record) override
+   {
+      invoke_trace_format(message, record, func, name.c_str());
+   }
+
+   template<bool Trace>
+   static void kernelCallEntry(cpu::Core *core, void *userData)
+   {
+      auto self = static_cast<LibraryFunctionCall *>(static_cast<LibraryFunction *>(userData));
+      pushKernelCallFrame(core);
+
+      if constexpr (Trace) {
+         auto &record = beginCallTraceRecord(core, self->syscallID);
+         invoke_trace(core, self->func, record);
+         endCallTraceRecord(core);
+      }
+
+      invoke(core, self->func);
+      popKernelCallFrame();
+   }
+
+   virtual cpu::KernelCallEntry getKernelCallEntry(bool trace) override
+   {
+      return trace ? &kernelCallEntry<true> : &kernelCallEntry<false>;
+   }
 };
 
 /**
@@ -85,11 +142,40 @@ struct LibraryConstructorFunction : LibraryFunction
    virtual void call(cpu::Core *state) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         invoke_trace(state, &LibraryConstructorFunction::wrapper, name.c_str());
+         auto &record = beginCallTraceRecord(state, syscallID);
+         invoke_trace(state, &LibraryConstructorFunction::wrapper, record);
+         endCallTraceRecord(state);
       }
 
       invoke(state, &LibraryConstructorFunction::wrapper);
    }
+
+   virtual void formatTrace(fmt::memory_buffer &message,
+                            const CallTraceRecord &record) override
+   {
+      invoke_trace_format(message, record, &LibraryConstructorFunction::wrapper, name.c_str());
+   }
+
+   template<bool Trace>
+   static void kernelCallEntry(cpu::Core *core, void *userData)
+   {
+      pushKernelCallFrame(core);
+
+      if constexpr (Trace) {
+         auto self = static_cast<LibraryFunction *>(userData);
+         auto &record = beginCallTraceRecord(core, self->syscallID);
+         invoke_trace(core, &LibraryConstructorFunction::wrapper, record);
+         endCallTraceRecord(core);
+      }
+
+      invoke(core, &LibraryConstructorFunction::wrapper);
+      popKernelCallFrame();
+   }
+
+   virtual cpu::KernelCallEntry getKernelCallEntry(bool trace) override
+   {
+      return trace ? &kernelCallEntry<true> : &kernelCallEntry<false>;
+   }
 };
 
 /**
@@ -110,11 +196,40 @@ struct LibraryDestructorFunction : LibraryFunction
    virtual void call(cpu::Core *state) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         invoke_trace(state, &LibraryDestructorFunction::wrapper, name.c_str());
+         auto &record = beginCallTraceRecord(state, syscallID);
+         invoke_trace(state, &LibraryDestructorFunction::wrapper, record);
+         endCallTraceRecord(state);
       }
 
       invoke(state, &LibraryDestructorFunction::wrapper);
    }
+
+   virtual void formatTrace(fmt::memory_buffer &message,
+                            const CallTraceRecord &record) override
+   {
+      invoke_trace_format(message, record, &LibraryDestructorFunction::wrapper, name.c_str());
+   }
+
+   template<bool Trace>
+   static void kernelCallEntry(cpu::Core *core, void *userData)
+   {
+      pushKernelCallFrame(core);
+
+      if constexpr (Trace) {
+         auto self = static_cast<LibraryFunction *>(userData);
+         auto &record = beginCallTraceRecord(core, self->syscallID);
+         invoke_trace(core, &LibraryDestructorFunction::wrapper, record);
+         endCallTraceRecord(core);
+      }
+
+      invoke(core, &LibraryDestructorFunction::wrapper);
+      popKernelCallFrame();
+   }
+
+   virtual cpu::KernelCallEntry getKernelCallEntry(bool trace) override
+   {
+      return trace ? &kernelCallEntry<true> : &kernelCallEntry<false>;
+   }
 };
 
 template<typename FunctionType>
@@ -0,0 +1,239 @@
+#include "cafe_hle.h"
+#include "cafe_hle_library_function.h"
+#include "cafe_hle_replace.h"
+
+#include "cafe/loader/cafe_loader_loaded_rpl.h"
+#include "cafe/loader/cafe_loader_rpl.h"
+#include "decaf_config.h"
+
+#include <array>
+#include <common/log.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <libcpu/espresso/espresso_instructionset.h>
+#include <string_view>
+
+namespace rpl = cafe::loader::rpl;
+
+namespace cafe::hle
+{
+
+/*
+ * Host implementations of the guest runtime routines which games statically
+ * link into their own code, these are called far too often for interpreting
+ * or recompiling the guest version to be worthwhile.
+ */
+
+/**
+ * Guest code does memcpy between overlapping ranges, which the guest
+ * implementation tolerates but std::memcpy does not, so use memmove.
+ */
+static virt_ptr<void>
+hostMemcpy(virt_ptr<void> dst,
+           virt_ptr<const void> src,
+           uint32_t size)
+{
+   std::memmove(dst.getRawPointer(), src.getRawPointer(), size);
+   return dst;
+}
+
+static virt_ptr<void>
+hostMemmove(virt_ptr<void> dst,
+            virt_ptr<const void> src,
+            uint32_t size)
+{
+   std::memmove(dst.getRawPointer(), src.getRawPointer(), size);
+   return dst;
+}
+
+static virt_ptr<void>
+hostMemset(virt_ptr<void> dst,
+           int32_t value,
+           uint32_t size)
+{
+   std::memset(dst.getRawPointer(), value, size);
+   return dst;
+}
+
+static uint32_t
+hostStrlen(virt_ptr<const char> str)
+{
+   return static_cast<uint32_t>(std::strlen(str.getRawPointer()));
+}
+
+static int32_t
+hostStrcmp(virt_ptr<const char> lhs,
+           virt_ptr<const char> rhs)
+{
+   return std::strcmp(lhs.getRawPointer(), rhs.getRawPointer());
+}
+
+static int32_t
+hostStrncmp(virt_ptr<const char> lhs,
+            virt_ptr<const char> rhs,
+            uint32_t count)
+{
+   return std::strncmp(lhs.getRawPointer(), rhs.getRawPointer(), count);
+}
+
+struct RoutineReplacement
+{
+   //! Name of the guest symbol to replace.
+   const char *name;
+
+   //! Host implementation, bound to its own kernel call.
+   std::unique_ptr<LibraryFunction> function;
+};
+
+static std::array<RoutineReplacement, 6>
+sRoutineReplacements;
+
+//! The patched routine is a kc followed by a blr, so it must fit 2 instructions.
+static constexpr auto MinReplacedRoutineSize = 8u;
+
+template<typename FunctionType>
+static void
+registerReplacement(RoutineReplacement &replacement,
+                    const char *name,
+                    FunctionType func)
+{
+   replacement.name = name;
+   replacement.function = internal::makeLibraryFunction(func);
+   replacement.function->name = name;
+   replacement.function->hostPtr = nullptr;
+
+   // These are hot enough to drown out everything else in a kernel trace.
+   replacement.function->traceEnabled = false;
+   registerKernelCall(replacement.function.get());
+}
+
+/**
+ * Register the kernel calls used by replaced routines, must be called before
+ * bindKernelCalls.
+ */
+void
+registerRoutineReplacements()
+{
+   registerReplacement(sRoutineReplacements[0], "memcpy", hostMemcpy);
+   registerReplacement(sRoutineReplacements[1], "memmove", hostMemmove);
+   registerReplacement(sRoutineReplacements[2], "memset", hostMemset);
+   registerReplacement(sRoutineReplacements[3], "strlen", hostStrlen);
+   registerReplacement(sRoutineReplacements[4], "strcmp", hostStrcmp);
+   registerReplacement(sRoutineReplacements[5], "strncmp", hostStrncmp);
+}
+
+static RoutineReplacement *
+findReplacement(std::string_view name)
+{
+   for (auto &replacement : sRoutineReplacements) {
+      if (replacement.function && name == replacement.name) {
+         return &replacement;
+      }
+   }
+
+   return nullptr;
+}
+
+/**
+ * Overwrite the entry of every recognised runtime routine in a freshly
+ * relocated module with a kc to its host implementation.
+ *
+ * A routine is only replaced when its symbol is a function which lies
+ * entirely within an executable section of the module, HLE stubs and imports
+ * are never touched.
+ */
+void
+replaceGuestRoutines(virt_ptr<loader::LOADED_RPL> rpl)
+{
+   if (!decaf::config::system::hle_replace_routines) {
+      return;
+   }
+
+   auto kcInstr = espresso::encodeInstruction(espresso::InstructionID::kc);
+   auto bclr = espresso::encodeInstruction(espresso::InstructionID::bclr);
+   bclr.bo = 20;
+   bclr.bi = 0;
+
+   auto numReplaced = 0u;
+   auto report = fmt::memory_buffer { };
+
+   for (auto i = 0u; i < rpl->elfHeader.shnum; ++i) {
+      auto sectionHeader =
+         virt_cast<rpl::SectionHeader *>(
+            virt_cast<virt_addr>(rpl->sectionHeaderBuffer) +
+            rpl->elfHeader.shentsize * i);
+      if (sectionHeader->type != rpl::SHT_SYMTAB ||
+          sectionHeader->link >= rpl->elfHeader.shnum) {
+         continue;
+      }
+
+      auto symTab = rpl->sectionAddressBuffer[i];
+      auto strTab = rpl->sectionAddressBuffer[sectionHeader->link];
+      if (!symTab || !strTab) {
+         continue;
+      }
+
+      auto symTabEntSize =
+         sectionHeader->entsize ?
+         static_cast<uint32_t>(sectionHeader->entsize) :
+         static_cast<uint32_t>(sizeof(rpl::Symbol));
+      auto numSymbols = sectionHeader->size / symTabEntSize;
+
+      for (auto j = 1u; j < numSymbols; ++j) {
+         auto symbol = virt_cast<rpl::Symbol *>(symTab + j * symTabEntSize);
+         if ((symbol->info & 0xf) != rpl::STT_FUNC ||
+             symbol->size < MinReplacedRoutineSize ||
+             symbol->shndx == 0 ||
+             symbol->shndx >= rpl->elfHeader.shnum) {
+            continue;
+         }
+
+         auto replacement =
+            findReplacement(virt_cast<const char *>(strTab + symbol->name).getRawPointer());
+         if (!replacement) {
+            continue;
+         }
+
+         auto targetSectionAddress = rpl->sectionAddressBuffer[symbol->shndx];
+         auto targetSectionHeader =
+            virt_cast<rpl::SectionHeader *>(
+               virt_cast<virt_addr>(rpl->sectionHeaderBuffer) +
+               rpl->elfHeader.shentsize * symbol->shndx);
+         auto symbolAddr = virt_addr { static_cast<uint32_t>(symbol->value) };
+         if (!targetSectionAddress ||
+             targetSectionHeader->type != rpl::SHT_PROGBITS ||
+             !(targetSectionHeader->flags & rpl::SHF_EXECINSTR) ||
+             (symbol->value & 3) ||
+             symbolAddr < targetSectionAddress ||
+             symbolAddr + static_cast<uint32_t>(symbol->size) >
+                targetSectionAddress + static_cast<uint32_t>(targetSectionHeader->size)) {
+            continue;
+         }
+
+         auto code = virt_cast<uint32_t *>(symbolAddr);
+         if (espresso::isA<espresso::InstructionID::kc>(espresso::Instruction { static_cast<uint32_t>(code[0]) })) {
+            continue;
+         }
+
+         kcInstr.kcn = replacement->function->syscallID;
+         code[0] = kcInstr.value;
+         code[1] = bclr.value;
+
+         fmt::format_to(report, "{}{}@{}",
+                        numReplaced ? ", " : "",
+                        replacement->name,
+                        symbolAddr);
+         ++numReplaced;
+      }
+   }
+
+   if (numReplaced) {
+      gLog->info("Replaced {} guest routines in {}: {}",
+                 numReplaced,
+                 std::string_view { rpl->moduleNameBuffer.getRawPointer(),
+                                    rpl->moduleNameLen },
+                 std::string_view { report.data(), report.size() });
+   }
+}
+
+} // namespace cafe::hle
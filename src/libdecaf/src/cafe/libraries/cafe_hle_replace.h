@@ -0,0 +1,18 @@
+#pragma once
+#include <libcpu/be2_struct.h>
+
+namespace cafe::loader
+{
+struct LOADED_RPL;
+} // namespace cafe::loader
+
+namespace cafe::hle
+{
+
+void
+registerRoutineReplacements();
+
+void
+replaceGuestRoutines(virt_ptr<loader::LOADED_RPL> rpl);
+
+} // namespace cafe::hle
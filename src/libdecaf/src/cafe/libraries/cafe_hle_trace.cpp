@@ -0,0 +1,100 @@
+#include "cafe_hle.h"
+#include "cafe_hle_trace.h"
+
+#include <array>
+#include <atomic>
+#include <common/log.h>
+#include <fmt/format.h>
+
+namespace cafe::hle
+{
+
+//! Number of records kept per core, must be a power of two.
+static constexpr auto CallTraceRingSize = 0x4000u;
+
+/**
+ * Ring of the most recent HLE calls made on a core.
+ *
+ * Each ring is only ever written to from its own core so recording a call
+ * needs no locking. The write position is published with release semantics
+ * after a record is complete, and dumpCallTrace discards any record it
+ * copied which the writer may have been overwriting at the time.
+ */
+struct CallTraceRing
+{
+   std::atomic<uint64_t> next { 0 };
+   std::array<CallTraceRecord, CallTraceRingSize> records;
+};
+
+static std::array<CallTraceRing, 3>
+sCallTraceRings;
+
+CallTraceRecord &
+beginCallTraceRecord(cpu::Core *core,
+                     uint32_t syscallID)
+{
+   auto &ring = sCallTraceRings[core->id];
+   auto pos = ring.next.load(std::memory_order_relaxed);
+   auto &record = ring.records[pos & (CallTraceRingSize - 1)];
+   record.timestamp = core->tb();
+   record.syscallID = syscallID;
+   return record;
+}
+
+void
+endCallTraceRecord(cpu::Core *core)
+{
+   auto &ring = sCallTraceRings[core->id];
+   auto pos = ring.next.load(std::memory_order_relaxed);
+   ring.next.store(pos + 1, std::memory_order_release);
+}
+
+void
+dumpCallTrace()
+{
+   auto message = fmt::memory_buffer { };
+
+   for (auto coreId = 0u; coreId < sCallTraceRings.size(); ++coreId) {
+      auto &ring = sCallTraceRings[coreId];
+      auto end = ring.next.load(std::memory_order_acquire);
+      auto start = end > CallTraceRingSize ? end - CallTraceRingSize : 0;
+
+      if (start == end) {
+         continue;
+      }
+
+      gLog->debug("Kernel trace for core {}, {} of {} calls",
+                  coreId, end - start, end);
+
+      for (auto i = start; i < end; ++i) {
+         // The core may still be running, so copy the record and then check
+         //  the writer has not since wrapped around and started overwriting it.
+         auto record = ring.records[i & (CallTraceRingSize - 1)];
+         std::atomic_thread_fence(std::memory_order_acquire);
+
+         if (i + CallTraceRingSize <= ring.next.load(std::memory_order_relaxed)) {
+            continue;
+         }
+
+         auto function = getKernelCallFunction(record.syscallID);
+         if (!function) {
+            continue;
+         }
+
+         message.clear();
+         fmt::format_to(message, "[{}] {} ", coreId, record.timestamp);
+         function->formatTrace(message, record);
+         gLog->debug(std::string_view { message.data(), message.size() });
+      }
+   }
+}
+
+void
+clearCallTrace()
+{
+   for (auto &ring : sCallTraceRings) {
+      ring.next.store(0, std::memory_order_release);
+   }
+}
+
+} // namespace cafe::hle
@@ -0,0 +1,22 @@
+#pragma once
+#include "cafe/cafe_ppc_interface_invoke_trace.h"
+
+#include <libcpu/cpu.h>
+
+namespace cafe::hle
+{
+
+CallTraceRecord &
+beginCallTraceRecord(cpu::Core *core,
+                     uint32_t syscallID);
+
+void
+endCallTraceRecord(cpu::Core *core);
+
+void
+dumpCallTrace();
+
+void
+clearCallTrace();
+
+} // namespace cafe::hle
@@ -534,6 +534,10 @@ initialiseAlarmThread()
    auto &coreData = sAlarmData->perCoreData[coreId];
 
    // Iniitalise data
+   if (!sAlarmData->lock.stats) {
+      initialiseIdLock(sAlarmData->lock, "Alarm");
+   }
+
    coreData.threadName = fmt::format("Alarm Thread {}", coreId);
    OSInitAlarmQueue(virt_addrof(coreData.alarmQueue));
    OSInitAlarmQueue(virt_addrof(coreData.callbackAlarmQueue));
@@ -1,9 +1,35 @@
 #include "coreinit_internal_idlock.h"
+
+#include <algorithm>
+#include <common/bitutils.h>
+#include <common/platform_thread.h>
+#include <common/platform_time.h>
 #include <libcpu/cpu.h>
+#include <memory>
+#include <mutex>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IDLOCK_PAUSE() _mm_pause()
+#else
+#define IDLOCK_PAUSE() std::this_thread::yield()
+#endif
 
 namespace cafe::coreinit::internal
 {
 
+//! Number of failed attempts to take the lock before we sleep.
+static constexpr auto MaxSpinAttempts = 16u;
+
+//! Maximum number of pause instructions between attempts.
+static constexpr auto MaxSpinBackoff = 64u;
+
+static std::mutex
+sIdLockStatsMutex;
+
+static std::vector<std::unique_ptr<IdLockStats>>
+sIdLockStats;
+
 static uint32_t
 getCoreLockId()
 {
@@ -17,6 +43,71 @@ getCoreLockId()
    return core;
 }
 
+static void
+recordHoldTime(IdLockStats *stats,
+               uint64_t ticks)
+{
+   auto ns = platform::hostTicksToNanoseconds(ticks);
+   auto bucket = 0;
+
+   if (ns) {
+      bucket = std::clamp(63 - clz64(ns) - 6, 0, static_cast<int>(IdLockHoldTimeBuckets) - 1);
+   }
+
+   stats->holdTime[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+initialiseIdLock(IdLock &lock,
+                 const char *name)
+{
+   std::unique_lock<std::mutex> guard { sIdLockStatsMutex };
+   auto itr = std::find_if(sIdLockStats.begin(), sIdLockStats.end(),
+                           [&](const auto &stats) { return stats->name == name; });
+
+   if (itr != sIdLockStats.end()) {
+      lock.stats = itr->get();
+   } else {
+      auto stats = std::make_unique<IdLockStats>();
+      stats->name = name;
+      lock.stats = stats.get();
+      sIdLockStats.emplace_back(std::move(stats));
+   }
+}
+
+std::vector<IdLockStats *>
+getIdLockStats()
+{
+   std::unique_lock<std::mutex> guard { sIdLockStatsMutex };
+   auto result = std::vector<IdLockStats *> { };
+
+   for (auto &stats : sIdLockStats) {
+      result.push_back(stats.get());
+   }
+
+   return result;
+}
+
+void
+resetIdLockStats()
+{
+   std::unique_lock<std::mutex> guard { sIdLockStatsMutex };
+
+   for (auto &stats : sIdLockStats) {
+      stats->acquireCount.store(0);
+      stats->contendedCount.store(0);
+      stats->sleepCount.store(0);
+
+      for (auto &bucket : stats->holdTime) {
+         bucket.store(0);
+      }
+   }
+}
+
+/**
+ * Acquire the lock, spinning with exponential backoff for a short while
+ * before sleeping on the owner field until it is released.
+ */
 bool
 acquireIdLock(IdLock &lock,
               uint32_t id)
@@ -26,8 +117,52 @@ acquireIdLock(IdLock &lock,
       return false;
    }
 
-   while (!lock.owner.compare_exchange_weak(expected, id, std::memory_order_acquire)) {
-      expected = 0;
+   if (!lock.owner.compare_exchange_strong(expected, id, std::memory_order_acquire)) {
+      auto acquired = false;
+
+      if (lock.stats) {
+         lock.stats->contendedCount.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      for (auto attempt = 0u, backoff = 1u; attempt < MaxSpinAttempts; ++attempt) {
+         for (auto i = 0u; i < backoff; ++i) {
+            IDLOCK_PAUSE();
+         }
+
+         backoff = std::min(backoff * 2, MaxSpinBackoff);
+         expected = 0u;
+
+         if (lock.owner.load(std::memory_order_relaxed) == 0 &&
+             lock.owner.compare_exchange_weak(expected, id, std::memory_order_acquire)) {
+            acquired = true;
+            break;
+         }
+      }
+
+      if (!acquired) {
+         if (lock.stats) {
+            lock.stats->sleepCount.fetch_add(1, std::memory_order_relaxed);
+         }
+
+         lock.sleepers.fetch_add(1);
+
+         while (true) {
+            expected = 0u;
+
+            if (lock.owner.compare_exchange_strong(expected, id)) {
+               break;
+            }
+
+            platform::waitOnAddress(&lock.owner, expected);
+         }
+
+         lock.sleepers.fetch_sub(1);
+      }
+   }
+
+   if (lock.stats) {
+      lock.stats->acquireCount.fetch_add(1, std::memory_order_relaxed);
+      lock.acquireTicks = platform::readHostTicks();
    }
 
    return true;
@@ -51,7 +186,16 @@ bool
 releaseIdLock(IdLock &lock,
               uint32_t id)
 {
-   auto owner = lock.owner.exchange(0, std::memory_order_release);
+   if (lock.stats) {
+      recordHoldTime(lock.stats, platform::readHostTicks() - lock.acquireTicks);
+   }
+
+   auto owner = lock.owner.exchange(0);
+
+   if (lock.sleepers.load()) {
+      platform::wakeOnAddress(&lock.owner);
+   }
+
    return (owner == id);
 }
 
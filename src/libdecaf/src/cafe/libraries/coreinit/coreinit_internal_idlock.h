@@ -1,15 +1,59 @@
 #pragma once
+#include <array>
 #include <atomic>
 #include <libcpu/be2_struct.h>
+#include <string>
+#include <vector>
 
 namespace cafe::coreinit::internal
 {
 
+//! Number of buckets in IdLockStats::holdTime, bucket N counts hold times
+//! of [2^(N + 6), 2^(N + 7)) nanoseconds with the first and last open ended.
+static constexpr auto IdLockHoldTimeBuckets = 16u;
+
+struct IdLockStats
+{
+   //! Name of the lock, as given to initialiseIdLock.
+   std::string name;
+
+   //! Number of times the lock was acquired.
+   std::atomic<uint64_t> acquireCount { 0 };
+
+   //! Number of acquires which found the lock already held.
+   std::atomic<uint64_t> contendedCount { 0 };
+
+   //! Number of acquires which gave up spinning and slept.
+   std::atomic<uint64_t> sleepCount { 0 };
+
+   //! Histogram of how long the lock was held for.
+   std::array<std::atomic<uint64_t>, IdLockHoldTimeBuckets> holdTime { };
+};
+
 struct IdLock
 {
    std::atomic<uint32_t> owner;
+
+   //! Number of threads sleeping in acquireIdLock.
+   std::atomic<uint32_t> sleepers;
+
+   //! Host ticks at which the current owner acquired the lock.
+   uint64_t acquireTicks;
+
+   //! Contention statistics, nullptr until initialiseIdLock is called.
+   IdLockStats *stats;
 };
 
+void
+initialiseIdLock(IdLock &lock,
+                 const char *name);
+
+std::vector<IdLockStats *>
+getIdLockStats();
+
+void
+resetIdLockStats();
+
 bool
 acquireIdLock(IdLock &lock,
               uint32_t id);
@@ -404,6 +404,8 @@ namespace internal
 void
 initialiseMemory()
 {
+   initialiseIdLock(sMemoryData->boundsLock, "Memory Bounds");
+
    sMemoryData->mem1BaseAddress = virt_addr { 0xF4000000 };
    sMemoryData->mem1Size = 0x2000000u;
 
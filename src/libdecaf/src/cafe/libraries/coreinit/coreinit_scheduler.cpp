@@ -9,13 +9,16 @@
 
 #include "cafe/kernel/cafe_kernel_context.h"
 #include "debugger/debugger.h"
+#include "decaf_config.h"
 
 #include <array>
 #include <atomic>
-#include <chrono>
+#include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <common/platform_time.h>
 #include <fmt/format.h>
+#include <limits>
 
 namespace cafe::coreinit
 {
@@ -23,19 +26,41 @@ namespace cafe::coreinit
 static constexpr uint32_t
 SchedulerLockNonCpuCoreId = 1u << 31;
 
+static constexpr uint64_t
+CoreTimeNotPaused = std::numeric_limits<uint64_t>::max();
+
+//! Thread priorities range from 0 to 95, Driver, AppIo then App threads.
+static constexpr uint32_t
+NumThreadPriorities = 96;
+
+static constexpr uint32_t
+NumRunQueueMaskWords = NumThreadPriorities / 32;
+
 struct StaticSchedulerData
 {
    struct PerCoreData
    {
       be2_val<bool> schedulerEnabled;
-      be2_struct<OSThreadQueue> runQueue;
+
+      //! FIFO of ready threads for each priority which can run on this core.
+      be2_array<OSThreadQueue, NumThreadPriorities> runQueues;
+
+      //! Bit (priority % 32) of word (priority / 32) is set when
+      //! runQueues[priority] is not empty.
+      std::array<uint32_t, NumRunQueueMaskWords> runQueueMask;
+
       be2_virt_ptr<OSThread> currentThread;
-      std::chrono::time_point<std::chrono::high_resolution_clock> lastSwitchTime;
-      std::chrono::time_point<std::chrono::high_resolution_clock> pauseTime;
+
+      //! Host ticks at the last thread switch, from platform::readHostTicks.
+      uint64_t lastSwitchTime;
+
+      //! Host ticks when core time was paused, or CoreTimeNotPaused.
+      uint64_t pauseTime;
    };
 
    internal::IdLock schedulerLock;
    be2_struct<OSThreadQueue> activeThreadQueue;
+   be2_val<int32_t> numActiveThreads;
    be2_array<PerCoreData, 3> perCoreData;
 };
 
@@ -46,9 +71,9 @@ namespace internal
 {
 
 using ActiveQueue = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::activeLink>;
-using CoreRunQueue0 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink0, ThreadIsLess>;
-using CoreRunQueue1 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink1, ThreadIsLess>;
-using CoreRunQueue2 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink2, ThreadIsLess>;
+using CoreRunQueue0 = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink0>;
+using CoreRunQueue1 = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink1>;
+using CoreRunQueue2 = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink2>;
 
 virt_ptr<OSThread>
 getCoreRunningThread(uint32_t coreId)
@@ -64,13 +89,13 @@ uint64_t
 getCoreThreadRunningTime(uint32_t coreId)
 {
    auto &perCoreData = sSchedulerData->perCoreData[coreId];
-   auto now = std::chrono::high_resolution_clock::now();
+   auto now = platform::readHostTicks();
 
-   if (perCoreData.pauseTime != std::chrono::time_point<std::chrono::high_resolution_clock>::max()) {
+   if (perCoreData.pauseTime != CoreTimeNotPaused) {
       now = perCoreData.pauseTime;
    }
 
-   return (now - perCoreData.lastSwitchTime).count();
+   return platform::hostTicksToNanoseconds(now - perCoreData.lastSwitchTime);
 }
 
 void
@@ -78,13 +103,13 @@ pauseCoreTime(bool isPaused)
 {
    auto coreId = cpu::this_core::id();
    auto &perCoreData = sSchedulerData->perCoreData[coreId];
-   auto now = std::chrono::high_resolution_clock::now();
+   auto now = platform::readHostTicks();
 
    if (isPaused) {
       perCoreData.pauseTime = now;
    } else {
       perCoreData.lastSwitchTime += now - perCoreData.pauseTime;
-      perCoreData.pauseTime = std::chrono::time_point<std::chrono::high_resolution_clock>::max();
+      perCoreData.pauseTime = CoreTimeNotPaused;
    }
 }
 
@@ -149,7 +174,8 @@ markThreadActiveNoLock(virt_ptr<OSThread> thread)
    auto activeThreadQueue = virt_addrof(sSchedulerData->activeThreadQueue);
    decaf_check(!ActiveQueue::contains(activeThreadQueue, thread));
    ActiveQueue::append(activeThreadQueue, thread);
-   checkActiveThreadsNoLock();
+   sSchedulerData->numActiveThreads++;
+   validateActiveThreadsNoLock();
 }
 
 void
@@ -158,7 +184,8 @@ markThreadInactiveNoLock(virt_ptr<OSThread> thread)
    auto activeThreadQueue = virt_addrof(sSchedulerData->activeThreadQueue);
    decaf_check(ActiveQueue::contains(activeThreadQueue, thread));
    ActiveQueue::erase(activeThreadQueue, thread);
-   checkActiveThreadsNoLock();
+   sSchedulerData->numActiveThreads--;
+   validateActiveThreadsNoLock();
 }
 
 bool
@@ -172,46 +199,97 @@ isThreadActiveNoLock(virt_ptr<OSThread> thread)
    return ActiveQueue::contains(activeThreadQueue, thread);
 }
 
+template<typename RunQueue>
+static void
+queueThreadOnCoreNoLock(uint32_t core,
+                        virt_ptr<OSThread> thread)
+{
+   auto &perCoreData = sSchedulerData->perCoreData[core];
+   auto priority = static_cast<uint32_t>(thread->priority);
+   RunQueue::append(virt_addrof(perCoreData.runQueues[priority]), thread);
+   perCoreData.runQueueMask[priority / 32] |= 1u << (priority % 32);
+}
+
+template<typename RunQueue>
+static void
+unqueueThreadOnCoreNoLock(uint32_t core,
+                          virt_ptr<OSThread> thread,
+                          be2_struct<OSThreadLink> &link)
+{
+   auto &perCoreData = sSchedulerData->perCoreData[core];
+   auto priority = static_cast<uint32_t>(thread->priority);
+   auto queue = virt_addrof(perCoreData.runQueues[priority]);
+
+   // A thread is in this queue if it is the head or has a previous link
+   if (queue->head != thread && !link.prev) {
+      return;
+   }
+
+   RunQueue::erase(queue, thread);
+
+   if (!queue->head) {
+      perCoreData.runQueueMask[priority / 32] &= ~(1u << (priority % 32));
+   }
+}
+
+/**
+ * Add a ready thread to the run queue of every core it has affinity for.
+ *
+ * The thread's priority and affinity must not change while it is queued,
+ * callers must unqueue the thread first.
+ */
 static void
 queueThreadNoLock(virt_ptr<OSThread> thread)
 {
    decaf_check(isSchedulerLocked());
    decaf_check(!OSIsThreadSuspended(thread));
    decaf_check(thread->state == OSThreadState::Ready);
+   decaf_check(thread->priority >= 0 && thread->priority < static_cast<int32_t>(NumThreadPriorities));
 
    // Schedule this thread on any cores which can run it!
    if (thread->attr & OSThreadAttributes::AffinityCPU0) {
-      CoreRunQueue0::insert(virt_addrof(sSchedulerData->perCoreData[0].runQueue), thread);
+      queueThreadOnCoreNoLock<CoreRunQueue0>(0, thread);
    }
 
    if (thread->attr & OSThreadAttributes::AffinityCPU1) {
-      CoreRunQueue1::insert(virt_addrof(sSchedulerData->perCoreData[1].runQueue), thread);
+      queueThreadOnCoreNoLock<CoreRunQueue1>(1, thread);
    }
 
    if (thread->attr & OSThreadAttributes::AffinityCPU2) {
-      CoreRunQueue2::insert(virt_addrof(sSchedulerData->perCoreData[2].runQueue), thread);
+      queueThreadOnCoreNoLock<CoreRunQueue2>(2, thread);
    }
 }
 
 static void
 unqueueThreadNoLock(virt_ptr<OSThread> thread)
 {
-   CoreRunQueue0::erase(virt_addrof(sSchedulerData->perCoreData[0].runQueue), thread);
-   CoreRunQueue1::erase(virt_addrof(sSchedulerData->perCoreData[1].runQueue), thread);
-   CoreRunQueue2::erase(virt_addrof(sSchedulerData->perCoreData[2].runQueue), thread);
+   if (thread->attr & OSThreadAttributes::AffinityCPU0) {
+      unqueueThreadOnCoreNoLock<CoreRunQueue0>(0, thread, thread->coreRunQueueLink0);
+   }
+
+   if (thread->attr & OSThreadAttributes::AffinityCPU1) {
+      unqueueThreadOnCoreNoLock<CoreRunQueue1>(1, thread, thread->coreRunQueueLink1);
+   }
+
+   if (thread->attr & OSThreadAttributes::AffinityCPU2) {
+      unqueueThreadOnCoreNoLock<CoreRunQueue2>(2, thread, thread->coreRunQueueLink2);
+   }
 }
 
 void
 setThreadAffinityNoLock(virt_ptr<OSThread> thread, uint32_t affinity)
 {
+   auto queued = thread->state == OSThreadState::Ready && thread->suspendCounter == 0;
+
+   if (queued) {
+      unqueueThreadNoLock(thread);
+   }
+
    thread->attr &= ~OSThreadAttributes::AffinityAny;
    thread->attr |= affinity;
 
-   if (thread->state == OSThreadState::Ready) {
-      if (thread->suspendCounter == 0) {
-         unqueueThreadNoLock(thread);
-         queueThreadNoLock(thread);
-      }
+   if (queued) {
+      queueThreadNoLock(thread);
    }
 }
 
@@ -219,7 +297,17 @@ static virt_ptr<OSThread>
 peekNextThreadNoLock(uint32_t core)
 {
    decaf_check(isSchedulerLocked());
-   auto thread = sSchedulerData->perCoreData[core].runQueue.head;
+   auto &perCoreData = sSchedulerData->perCoreData[core];
+   auto thread = virt_ptr<OSThread> { nullptr };
+
+   for (auto i = 0u; i < NumRunQueueMaskWords; ++i) {
+      auto bit = 0ul;
+
+      if (bit_scan_forward(&bit, perCoreData.runQueueMask[i])) {
+         thread = perCoreData.runQueues[i * 32 + bit].head;
+         break;
+      }
+   }
 
    if (thread) {
       decaf_check(thread->state == OSThreadState::Ready);
@@ -248,16 +336,31 @@ checkActiveThreadsNoLock()
       threadCount++;
    }
 
+   decaf_check(threadCount == sSchedulerData->numActiveThreads);
    return threadCount;
 }
 
+/**
+ * Walk and validate every active thread when scheduler validation is enabled.
+ *
+ * This is O(threads) so is only done when requested by
+ * decaf::config::system::scheduler_validation.
+ */
+void
+validateActiveThreadsNoLock()
+{
+   if (decaf::config::system::scheduler_validation) {
+      checkActiveThreadsNoLock();
+   }
+}
+
 void
 checkRunningThreadNoLock(bool yielding)
 {
    decaf_check(isSchedulerLocked());
    auto coreId = cpu::this_core::id();
    auto &perCoreData = sSchedulerData->perCoreData[coreId];
-   checkActiveThreadsNoLock();
+   validateActiveThreadsNoLock();
 
    if (!perCoreData.schedulerEnabled) {
       return;
@@ -270,7 +373,7 @@ checkRunningThreadNoLock(bool yielding)
       return;
    }
 
-   auto switchTime = std::chrono::high_resolution_clock::now();
+   auto switchTime = platform::readHostTicks();
    if (currThread) {
       if (currThread->state == OSThreadState::Running) {
          // If we're not ready to suspend check the priority vs next thread
@@ -296,7 +399,7 @@ checkRunningThreadNoLock(bool yielding)
 
       // Update thread run time
       auto diff = switchTime - perCoreData.lastSwitchTime;
-      currThread->coreTimeConsumedNs += diff.count();
+      currThread->coreTimeConsumedNs += platform::hostTicksToNanoseconds(diff);
    }
 
    // Trace log the thread switch
@@ -349,7 +452,7 @@ checkRunningThreadNoLock(bool yielding)
 
    // Restore interrupts to whatever state they were in
    coreinit::OSRestoreInterrupts(prevState);
-   checkActiveThreadsNoLock();
+   validateActiveThreadsNoLock();
 }
 
 void
@@ -564,14 +667,18 @@ virt_ptr<OSThread>
 setThreadActualPriorityNoLock(virt_ptr<OSThread> thread, int32_t priority)
 {
    decaf_check(isSchedulerLocked());
+
+   if (thread->state == OSThreadState::Ready && thread->suspendCounter == 0) {
+      // Run queues are indexed by priority so we must unqueue first
+      unqueueThreadNoLock(thread);
+      thread->priority = priority;
+      queueThreadNoLock(thread);
+      return nullptr;
+   }
+
    thread->priority = priority;
 
-   if (thread->state == OSThreadState::Ready) {
-      if (thread->suspendCounter == 0) {
-         unqueueThreadNoLock(thread);
-         queueThreadNoLock(thread);
-      }
-   } else if (thread->state == OSThreadState::Waiting) {
+   if (thread->state == OSThreadState::Waiting) {
       // Move towards head of queue if needed
       while (thread->link.prev && priority < thread->link.prev->priority) {
          auto prev = thread->link.prev;
@@ -635,17 +742,23 @@ promoteThreadPriorityNoLock(virt_ptr<OSThread> thread,
 void
 initialiseScheduler()
 {
+   initialiseIdLock(sSchedulerData->schedulerLock, "Scheduler");
    OSInitThreadQueue(virt_addrof(sSchedulerData->activeThreadQueue));
+   sSchedulerData->numActiveThreads = 0;
 
    for (auto i = 0u; i < sSchedulerData->perCoreData.size(); ++i) {
       auto &perCoreData = sSchedulerData->perCoreData[i];
       perCoreData.schedulerEnabled = true;
       perCoreData.currentThread = nullptr;
 
-      OSInitThreadQueue(virt_addrof(perCoreData.runQueue));
+      for (auto j = 0u; j < NumThreadPriorities; ++j) {
+         OSInitThreadQueue(virt_addrof(perCoreData.runQueues[j]));
+      }
+
+      perCoreData.runQueueMask.fill(0u);
 
-      perCoreData.lastSwitchTime = std::chrono::high_resolution_clock::now();
-      perCoreData.pauseTime = std::chrono::time_point<std::chrono::high_resolution_clock>::max();
+      perCoreData.lastSwitchTime = platform::readHostTicks();
+      perCoreData.pauseTime = CoreTimeNotPaused;
    }
 }
 
@@ -61,6 +61,9 @@ setThreadAffinityNoLock(virt_ptr<OSThread> thread,
 int32_t
 checkActiveThreadsNoLock();
 
+void
+validateActiveThreadsNoLock();
+
 void
 checkRunningThreadNoLock(bool yielding);
 
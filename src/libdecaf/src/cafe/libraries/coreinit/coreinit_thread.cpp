@@ -922,6 +922,10 @@ BOOL
 OSSetThreadPriority(virt_ptr<OSThread> thread,
                     int32_t priority)
 {
+   if (priority < 0 || priority >= 32) {
+      return FALSE;
+   }
+
    auto realPriority = priority;
    if (thread->type == OSThreadType::Driver) {
       realPriority = priority;
@@ -5,13 +5,17 @@
 #include "gx2_state.h"
 
 #include "cafe/libraries/coreinit/coreinit_core.h"
+#include "cafe/libraries/coreinit/coreinit_memdefaultheap.h"
 #include "cafe/libraries/coreinit/coreinit_memory.h"
+#include "cafe/libraries/coreinit/coreinit_thread.h"
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <common/align.h>
 #include <common/log.h>
 #include <common/decaf_assert.h>
+#include <deque>
 #include <libcpu/mmu.h>
 #include <libgpu/gpu.h>
 #include <libgpu/gpu_ringbuffer.h>
@@ -24,11 +28,52 @@ namespace cafe::gx2::internal
 
 using namespace cafe::coreinit;
 
+/**
+ * A range of the pool which has been handed out to a command buffer.
+ *
+ * Each core leases its own command buffer from the shared pool, so buffers
+ * are not necessarily retired in the order they were allocated. Ranges
+ * are kept in allocation order and the tail only moves past a range once
+ * it and every range before it has been freed.
+ */
+struct PoolAllocation
+{
+   virt_ptr<uint32_t> buffer;
+   uint32_t size;
+   bool freed;
+};
+
+/**
+ * A buffer used once the pool is exhausted, so recording does not have to
+ * wait for the GPU to catch up. These are allocated from the default heap
+ * on demand, up to the size of the pool again, and reused while the pool is
+ * under pressure. Once they have sat idle for a while they are given back
+ * to the heap, so the title only loses the memory during a burst.
+ */
+struct OverflowBuffer
+{
+   virt_ptr<uint32_t> buffer;
+   uint32_t size;
+
+   //! When the buffer was retired to the free list.
+   std::chrono::steady_clock::time_point idleSince;
+};
+
+//! How long an overflow buffer may stay unused before it is freed.
+static constexpr auto OverflowIdleTime = std::chrono::seconds { 1 };
+
+//! Free buffer objects, pushed without a lock but popped under
+//! sBufferItemPopMutex. Every core allocates, so two unguarded pops could
+//! see a popped and re-pushed head as unchanged and publish a stale next.
 static std::atomic<CommandBuffer *>
 sBufferItemPool;
 
-static bool
-sBufferPoolLeased = false;
+static std::mutex
+sBufferItemPopMutex;
+
+//! Buffers retired by the GPU which have not yet been returned to the pool.
+static std::atomic<CommandBuffer *>
+sRetiredBuffers;
 
 static virt_ptr<uint32_t>
 sBufferPoolBase = nullptr;
@@ -42,12 +87,25 @@ sBufferPoolHeadPtr = nullptr;
 static virt_ptr<uint32_t>
 sBufferPoolTailPtr = nullptr;
 
-static uint32_t
-sBufferPoolSkipped = 0;
+static std::deque<PoolAllocation>
+sBufferPoolAllocations;
+
+static std::vector<OverflowBuffer>
+sOverflowFreeList;
+
+//! Set once the default heap could not fit another overflow buffer.
+static bool
+sOverflowExhausted = false;
+
+static CommandBufferPoolStats
+sPoolStats;
 
 static std::mutex
 sBufferPoolMutex;
 
+static std::mutex
+sSubmitMutex;
+
 static CommandBuffer *
 sActiveBuffer[OSGetCoreCount()] = { nullptr, nullptr, nullptr };
 
@@ -57,6 +115,9 @@ allocateCommandBuffer(uint32_t size);
 static void
 submitCommandBuffer(CommandBuffer *cb);
 
+static void
+recycleRetiredBuffersNoLock();
+
 void
 initCommandBufferPool(virt_ptr<uint32_t> base,
                       uint32_t size)
@@ -68,15 +129,51 @@ initCommandBufferPool(virt_ptr<uint32_t> base,
    sBufferPoolEnd = sBufferPoolBase + size;
    sBufferPoolHeadPtr = sBufferPoolBase;
    sBufferPoolTailPtr = nullptr;
+   sBufferPoolAllocations.clear();
+
+   // Any overflow buffers belonged to the previous GX2Init's heap state
+   sOverflowFreeList.clear();
+   sOverflowExhausted = false;
+
+   sPoolStats = CommandBufferPoolStats { };
+   sPoolStats.poolSize = size;
 
    sActiveBuffer[core] = allocateCommandBuffer(0x100);
 }
 
+static void
+releaseFreedAllocations()
+{
+   while (!sBufferPoolAllocations.empty() && sBufferPoolAllocations.front().freed) {
+      sPoolStats.poolUsed -= sBufferPoolAllocations.front().size;
+      sBufferPoolAllocations.pop_front();
+   }
+
+   if (sBufferPoolAllocations.empty()) {
+      sBufferPoolHeadPtr = sBufferPoolBase;
+      sBufferPoolTailPtr = nullptr;
+   } else {
+      sBufferPoolTailPtr = sBufferPoolAllocations.front().buffer;
+   }
+}
+
+static std::deque<PoolAllocation>::iterator
+findAllocation(virt_ptr<uint32_t> buffer)
+{
+   auto itr = std::find_if(sBufferPoolAllocations.begin(), sBufferPoolAllocations.end(),
+                           [&](const PoolAllocation &allocation) {
+                              return allocation.buffer == buffer;
+                           });
+   decaf_check(itr != sBufferPoolAllocations.end());
+   return itr;
+}
+
 static virt_ptr<uint32_t>
 allocateFromPool(uint32_t wantedSize,
                  uint32_t &allocatedSize)
 {
    std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+   recycleRetiredBuffersNoLock();
 
    // Minimum allocation is 0x100 dwords
    wantedSize = std::max(0x100u, wantedSize);
@@ -86,13 +183,29 @@ allocateFromPool(uint32_t wantedSize,
       decaf_abort("Command buffer allocation greater than entire pool size");
    }
 
+   auto poolSize = static_cast<uint32_t>(sBufferPoolEnd - sBufferPoolBase);
    auto availableSize = uint32_t { 0 };
 
+   // Worker cores may not lease the last share of the pool, so whatever the
+   //  workers are holding on to the main core can always make progress.
+   auto workerLimit = poolSize;
+
+   if (OSGetCoreId() != getMainCoreId()) {
+      workerLimit = poolSize - poolSize / OSGetCoreCount();
+
+      if (sPoolStats.poolUsed + wantedSize > workerLimit) {
+         return nullptr;
+      }
+   }
+
    if (sBufferPoolTailPtr == nullptr) {
       decaf_check(sBufferPoolHeadPtr == sBufferPoolBase);
 
-      availableSize = static_cast<uint32_t>(sBufferPoolEnd - sBufferPoolBase);
+      availableSize = poolSize;
       sBufferPoolTailPtr = sBufferPoolHeadPtr;
+   } else if (sBufferPoolHeadPtr == sBufferPoolTailPtr) {
+      // Every dword of the pool is in use
+      return nullptr;
    } else {
       if (sBufferPoolHeadPtr < sBufferPoolTailPtr) {
          availableSize = static_cast<uint32_t>(sBufferPoolTailPtr - sBufferPoolHeadPtr);
@@ -110,20 +223,40 @@ allocateFromPool(uint32_t wantedSize,
                return nullptr;
             }
 
-            // Lets mark down that we wasted some space so that returnToPool is able
-            //  to verify that pool releases are always happening in-order.  Then we
+            // Lets mark down the space we wasted at the end of the pool as an
+            //  already freed allocation, so the tail can move past it.  Then we
             //  move the head to the base of the pool to allocate from there.
-            sBufferPoolSkipped = static_cast<uint32_t>(sBufferPoolEnd - sBufferPoolHeadPtr);
+            auto skipped = static_cast<uint32_t>(sBufferPoolEnd - sBufferPoolHeadPtr);
+
+            if (skipped) {
+               sBufferPoolAllocations.push_back({ sBufferPoolHeadPtr, skipped, true });
+               sPoolStats.poolUsed += skipped;
+            }
+
             sBufferPoolHeadPtr = sBufferPoolBase;
          }
       }
    }
 
-   allocatedSize = std::min(0x20000u, availableSize);
+   // Leave room in the pool for the other cores to lease a buffer
+   auto leaseSize = std::max(wantedSize, poolSize / OSGetCoreCount());
+   allocatedSize = std::min({ 0x20000u, leaseSize, availableSize });
+
+   if (sPoolStats.poolUsed + allocatedSize > workerLimit) {
+      // Wrapping may have used up some of the worker's share
+      if (sPoolStats.poolUsed + wantedSize > workerLimit) {
+         return nullptr;
+      }
+
+      allocatedSize = workerLimit - sPoolStats.poolUsed;
+   }
 
    auto allocatedBuffer = sBufferPoolHeadPtr;
    sBufferPoolHeadPtr += allocatedSize;
+   sBufferPoolAllocations.push_back({ allocatedBuffer, allocatedSize, false });
 
+   sPoolStats.poolUsed += allocatedSize;
+   sPoolStats.poolPeakUsed = std::max(sPoolStats.poolPeakUsed, sPoolStats.poolUsed);
    return allocatedBuffer;
 }
 
@@ -140,34 +273,147 @@ returnToPool(virt_ptr<uint32_t> buffer,
       return;
    }
 
-   decaf_check(sBufferPoolHeadPtr == buffer + originalSize);
-   sBufferPoolHeadPtr = buffer + usedSize;
+   auto itr = findAllocation(buffer);
+   decaf_check(itr->size == originalSize);
+
+   if (sBufferPoolHeadPtr == buffer + originalSize) {
+      // This is the most recent allocation, so the unused space can go
+      //  straight back to the head of the pool
+      sBufferPoolHeadPtr = buffer + usedSize;
+      sPoolStats.poolUsed -= originalSize - usedSize;
+      itr->size = usedSize;
+
+      if (usedSize == 0) {
+         sBufferPoolAllocations.erase(itr);
+         releaseFreedAllocations();
+      }
+   } else if (usedSize == 0) {
+      // Another core has allocated since, so we can only free the range
+      //  once it reaches the tail
+      itr->freed = true;
+      releaseFreedAllocations();
+   }
 }
 
 static void
-freeToPool(virt_ptr<uint32_t> buffer,
-           uint32_t size)
+freeToPoolNoLock(virt_ptr<uint32_t> buffer)
+{
+   auto itr = findAllocation(buffer);
+   decaf_check(!itr->freed);
+
+   itr->freed = true;
+   releaseFreedAllocations();
+}
+
+static void
+freeToOverflowNoLock(virt_ptr<uint32_t> buffer,
+                     uint32_t size)
+{
+   sOverflowFreeList.push_back({ buffer, size, std::chrono::steady_clock::now() });
+   sPoolStats.overflowUsed -= size;
+}
+
+/**
+ * Give overflow buffers which have been idle for a while back to the
+ * default heap, called once the pool is able to satisfy allocations again.
+ */
+static void
+releaseIdleOverflowBuffers()
+{
+   auto release = std::vector<virt_ptr<uint32_t>> { };
+
+   {
+      std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+
+      if (sOverflowFreeList.empty()) {
+         return;
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      auto itr = std::remove_if(sOverflowFreeList.begin(), sOverflowFreeList.end(),
+                                [&](const OverflowBuffer &overflow) {
+                                   if (now - overflow.idleSince < OverflowIdleTime) {
+                                      return false;
+                                   }
+
+                                   release.push_back(overflow.buffer);
+                                   sPoolStats.overflowSize -= overflow.size;
+                                   return true;
+                                });
+      sOverflowFreeList.erase(itr, sOverflowFreeList.end());
+
+      if (!release.empty()) {
+         // The heap has room again
+         sOverflowExhausted = false;
+      }
+   }
+
+   for (auto buffer : release) {
+      MEMFreeToDefaultHeap(buffer);
+   }
+}
+
+static virt_ptr<uint32_t>
+allocateFromOverflow(uint32_t wantedSize,
+                     uint32_t &allocatedSize)
 {
    std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+   recycleRetiredBuffersNoLock();
+   wantedSize = std::max(0x100u, wantedSize);
 
-   if (sBufferPoolTailPtr + sBufferPoolSkipped == sBufferPoolEnd) {
-      sBufferPoolSkipped = 0;
-      sBufferPoolTailPtr = sBufferPoolBase;
+   // Reuse the smallest free overflow buffer which is big enough
+   auto best = sOverflowFreeList.end();
+
+   for (auto itr = sOverflowFreeList.begin(); itr != sOverflowFreeList.end(); ++itr) {
+      if (itr->size >= wantedSize && (best == sOverflowFreeList.end() || itr->size < best->size)) {
+         best = itr;
+      }
    }
 
-   decaf_check(sBufferPoolTailPtr == buffer);
+   if (best != sOverflowFreeList.end()) {
+      auto buffer = best->buffer;
+      allocatedSize = best->size;
+      sOverflowFreeList.erase(best);
+      sPoolStats.overflowUsed += allocatedSize;
+      sPoolStats.overflowAllocations++;
+      return buffer;
+   }
 
-   sBufferPoolTailPtr += size;
+   // Grow the overflow region by another buffer, up to the size of the pool
+   auto poolSize = static_cast<uint32_t>(sBufferPoolEnd - sBufferPoolBase);
+   auto size = std::max(wantedSize, std::min(0x20000u, poolSize / OSGetCoreCount()));
 
-   if (sBufferPoolTailPtr == sBufferPoolHeadPtr) {
-      sBufferPoolHeadPtr = sBufferPoolBase;
-      sBufferPoolTailPtr = nullptr;
+   if (sOverflowExhausted || sPoolStats.overflowSize + size > poolSize) {
+      return nullptr;
+   }
+
+   sPoolStats.overflowSize += size;
+   lock.unlock();
+
+   auto buffer = virt_cast<uint32_t *>(MEMAllocFromDefaultHeapEx(size * 4, 0x100));
+   lock.lock();
+
+   if (!buffer) {
+      gLog->warn("Unable to allocate 0x{:X} byte command buffer overflow, the command buffer pool may need to be larger", size * 4);
+      sOverflowExhausted = true;
+      sPoolStats.overflowSize -= size;
+      return nullptr;
    }
+
+   gLog->info("Command buffer pool of 0x{:X} bytes exhausted, overflow grown to 0x{:X} bytes",
+              poolSize * 4, sPoolStats.overflowSize * 4);
+
+   allocatedSize = size;
+   sPoolStats.overflowUsed += allocatedSize;
+   sPoolStats.overflowAllocations++;
+   return buffer;
 }
 
 static CommandBuffer *
 allocateBufferObj()
 {
+   std::unique_lock<std::mutex> lock { sBufferItemPopMutex };
+
    while (true) {
       auto buffer = sBufferItemPool.load(std::memory_order_acquire);
 
@@ -182,6 +428,7 @@ allocateBufferObj()
       }
    }
 
+   lock.unlock();
    return new CommandBuffer();
 }
 
@@ -202,28 +449,57 @@ freeBufferObj(CommandBuffer *cb)
 static CommandBuffer *
 allocateCommandBuffer(uint32_t size)
 {
-   // This is to ensure that only one command buffer is lease from our
-   //  pool at any particular time.
-   decaf_check(!sBufferPoolLeased);
-
-   // Only the main core can have command buffers
-   if (gx2::internal::getMainCoreId() != coreinit::OSGetCoreId()) {
-      gLog->warn("Tried to allocate command buffer on non-main graphics core");
-      return nullptr;
-   }
+   // Each core may only lease one command buffer from our pool at a time
+   decaf_check(!sActiveBuffer[coreinit::OSGetCoreId()]);
 
    // Lets try to get ourselves a buffer from the pool
    auto allocatedBuffer = virt_ptr<uint32_t> { nullptr };
    auto allocatedSize = uint32_t { 0 };
 
-   while (!allocatedBuffer) {
+   auto overflowSize = uint32_t { 0 };
+   auto lastWarning = std::chrono::steady_clock::now();
+
+   while (true) {
       allocatedBuffer = allocateFromPool(size, allocatedSize);
 
-      if (!allocatedBuffer) {
-         // If we failed to allocate from the pool, lets wait till
-         //  a buffer has been freed, and then try again
+      if (allocatedBuffer) {
+         releaseIdleOverflowBuffers();
+         break;
+      }
+
+      // If the pool is full, rather than waiting for the GPU lets try
+      //  to carry on recording into an overflow buffer
+      allocatedBuffer = allocateFromOverflow(size, allocatedSize);
+
+      if (allocatedBuffer) {
+         overflowSize = allocatedSize;
+         break;
+      }
+
+      // If we failed to allocate anywhere, lets wait till a buffer has
+      //  been retired, and then try again
+      auto stallStart = std::chrono::steady_clock::now();
+
+      if (GX2GetLastSubmittedTimeStamp() > GX2GetRetiredTimeStamp()) {
          GX2WaitTimeStamp(GX2GetRetiredTimeStamp() + 1);
+      } else {
+         // Nothing is in flight, so the space must be leased by another
+         //  core which has not flushed yet. Worker leases are capped so the
+         //  main core should only get here if the pool is tiny.
+         OSYieldThread();
+
+         if (stallStart - lastWarning > std::chrono::seconds { 1 }) {
+            auto stats = getCommandBufferPoolStats();
+            gLog->warn("Core {} waiting for command buffer pool space leased by other cores, 0x{:X} of 0x{:X} bytes used",
+                       OSGetCoreId(), stats.poolUsed * 4, stats.poolSize * 4);
+            lastWarning = stallStart;
+         }
       }
+
+      auto stallTime = std::chrono::steady_clock::now() - stallStart;
+      std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+      sPoolStats.stallCount++;
+      sPoolStats.stallTime += std::chrono::duration_cast<std::chrono::nanoseconds>(stallTime).count();
    }
 
    // We need to grab a buffer object to hold the info
@@ -232,45 +508,103 @@ allocateCommandBuffer(uint32_t size)
    cb->submitTime = 0;
    cb->curSize = 0;
    cb->maxSize = allocatedSize;
+   cb->overflowSize = overflowSize;
    cb->buffer = allocatedBuffer;
-
-   sBufferPoolLeased = true;
    return cb;
 }
 
 static void
 submitCommandBuffer(CommandBuffer *cb)
 {
+   // Buffers are recorded on every core in parallel, but they must enter
+   //  the ring buffer in the same order as their timestamps so that the
+   //  retired timestamp only ever moves forward.
+   std::unique_lock<std::mutex> lock { sSubmitMutex };
+   auto submitTime = coreinit::OSGetTime();
+   auto lastSubmitTime = GX2GetLastSubmittedTimeStamp();
+
+   if (submitTime <= lastSubmitTime) {
+      submitTime = lastSubmitTime + 1;
+   }
+
    captureCommandBuffer(cb);
-   cb->submitTime = coreinit::OSGetTime();
+   cb->submitTime = submitTime;
    gx2::internal::setLastSubmittedTimestamp(cb->submitTime);
    gpu::ringbuffer::submit(cb,
                            phys_cast<uint32_t *>(OSEffectiveToPhysical(virt_cast<virt_addr>(cb->buffer))),
                            cb->curSize);
 }
 
-void
-freeCommandBuffer(CommandBuffer *cb)
+static void
+freeCommandBufferNoLock(CommandBuffer *cb)
 {
    // Lets just check this to make sure nothing funny happened
    decaf_check(cb->curSize == cb->maxSize);
 
    // Free the buffer back to the pool if its not a direct-called
    //  display list sent by the application.
-   if (!cb->displayList) {
-      freeToPool(cb->buffer, cb->maxSize);
+   if (cb->overflowSize) {
+      freeToOverflowNoLock(cb->buffer, cb->overflowSize);
+   } else if (!cb->displayList) {
+      freeToPoolNoLock(cb->buffer);
    }
 
    // Save its buffer object for later
    freeBufferObj(cb);
 }
 
+void
+freeCommandBuffer(CommandBuffer *cb)
+{
+   std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+   freeCommandBufferNoLock(cb);
+}
+
+static void
+recycleRetiredBuffersNoLock()
+{
+   auto cb = sRetiredBuffers.exchange(nullptr, std::memory_order_acquire);
+
+   // The list is newest first, but ranges of the pool only need to be
+   //  released in order once they reach the tail, which freeToPool handles.
+   while (cb) {
+      auto next = cb->next.load(std::memory_order_relaxed);
+      freeCommandBufferNoLock(cb);
+      cb = next;
+   }
+}
+
 void
 onRetireCommandBuffer(void *context)
 {
    auto buf = reinterpret_cast<CommandBuffer *>(context);
    setRetiredTimestamp(buf->submitTime);
-   freeCommandBuffer(buf);
+
+   // Rather than taking the pool lock on the GPU thread for every buffer,
+   //  retired buffers are returned to the pool in one batch the next time
+   //  a core needs to allocate.
+   auto top = sRetiredBuffers.load(std::memory_order_relaxed);
+
+   do {
+      buf->next.store(top, std::memory_order_relaxed);
+   } while (!sRetiredBuffers.compare_exchange_weak(top, buf, std::memory_order_release, std::memory_order_relaxed));
+}
+
+CommandBufferPoolStats
+getCommandBufferPoolStats()
+{
+   std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+   return sPoolStats;
+}
+
+void
+resetCommandBufferPoolStats()
+{
+   std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+   sPoolStats.poolPeakUsed = sPoolStats.poolUsed;
+   sPoolStats.overflowAllocations = 0;
+   sPoolStats.stallCount = 0;
+   sPoolStats.stallTime = 0;
 }
 
 static void
@@ -279,16 +613,22 @@ flushActiveCommandBuffer()
    auto core = coreinit::OSGetCoreId();
    auto cb = sActiveBuffer[core];
 
-   decaf_check(cb);
-   decaf_check(!cb->displayList);
+   if (!cb) {
+      // Worker cores only hold a buffer while they have commands pending
+      return;
+   }
 
-   // Lets make sure our lease is still active, and then release it.
-   decaf_check(sBufferPoolLeased);
-   sBufferPoolLeased = false;
+   decaf_check(!cb->displayList);
 
    // Release the remaining space from the buffer back to the
    //  pool so it can be used by the next command buffer!
-   returnToPool(cb->buffer, cb->curSize, cb->maxSize);
+   if (!cb->overflowSize) {
+      returnToPool(cb->buffer, cb->curSize, cb->maxSize);
+   } else if (cb->curSize == 0) {
+      std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+      freeToOverflowNoLock(cb->buffer, cb->overflowSize);
+   }
+
    cb->maxSize = cb->curSize;
 
    if (cb->curSize == 0) {
@@ -309,9 +649,7 @@ flushCommandBuffer(uint32_t neededSize)
    auto core = coreinit::OSGetCoreId();
    auto cb = sActiveBuffer[core];
 
-   decaf_check(cb);
-
-   if (cb->displayList) {
+   if (cb && cb->displayList) {
       virt_ptr<void> newList = nullptr;
       uint32_t newSize = 0;
 
@@ -337,8 +675,11 @@ flushCommandBuffer(uint32_t neededSize)
    // Flush the existing buffer
    flushActiveCommandBuffer();
 
-   // Allocate new buffer
-   sActiveBuffer[core] = allocateCommandBuffer(neededSize);
+   // Allocate new buffer, worker cores wait until their next write so they
+   //  do not hold on to pool space while idle
+   if (core == getMainCoreId()) {
+      sActiveBuffer[core] = allocateCommandBuffer(neededSize);
+   }
 
    return sActiveBuffer[core];
 }
@@ -348,12 +689,15 @@ getCommandBuffer(uint32_t size)
 {
    auto core = coreinit::OSGetCoreId();
    auto &cb = sActiveBuffer[core];
-   decaf_check(cb);
 
-   if (cb->curSize + size > cb->maxSize) {
+   if (cb && cb->curSize + size > cb->maxSize) {
       cb = flushCommandBuffer(size);
    }
 
+   if (!cb) {
+      cb = allocateCommandBuffer(size);
+   }
+
    return cb;
 }
 
@@ -377,6 +721,7 @@ queueDisplayList(virt_ptr<uint32_t> buffer,
    // Set up our buffer object
    auto cb = allocateBufferObj();
    cb->displayList = true;
+   cb->overflowSize = 0;
    cb->curSize = size;
    cb->maxSize = size;
    cb->buffer = buffer;
@@ -413,14 +758,13 @@ beginUserCommandBuffer(virt_ptr<uint32_t> buffer,
 {
    auto core = coreinit::OSGetCoreId();
 
-   if (core == getMainCoreId()) {
-      // Flush any commands that were already pending
-      flushActiveCommandBuffer();
-   }
+   // Flush any commands that were already pending
+   flushActiveCommandBuffer();
 
    // Set up our buffer object
    auto cb = allocateBufferObj();
    cb->displayList = true;
+   cb->overflowSize = 0;
    cb->submitTime = 0;
    cb->curSize = 0;
    cb->maxSize = size;
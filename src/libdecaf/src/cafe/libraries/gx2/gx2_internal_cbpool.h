@@ -16,9 +16,45 @@ struct CommandBuffer
    virt_ptr<uint32_t> buffer = nullptr;
    uint32_t curSize = 0;
    uint32_t maxSize = 0;
+
+   //! Size of the overflow buffer this was allocated from, or 0 if it was
+   //! allocated from the pool.
+   uint32_t overflowSize = 0;
+
    std::atomic<CommandBuffer *> next;
 };
 
+/**
+ * Occupancy of the command buffer pool, used to pick a pool size for
+ * GX2InitAttrib::CommandBufferPoolSize. Sizes are in words.
+ */
+struct CommandBufferPoolStats
+{
+   //! Size of the pool given to GX2Init.
+   uint32_t poolSize = 0;
+
+   //! Space in the pool which is leased or waiting for the GPU to retire.
+   uint32_t poolUsed = 0;
+
+   //! Highest poolUsed since the stats were last reset.
+   uint32_t poolPeakUsed = 0;
+
+   //! Space allocated for overflow buffers once the pool was exhausted.
+   uint32_t overflowSize = 0;
+
+   //! Space in overflow buffers which is leased or waiting to retire.
+   uint32_t overflowUsed = 0;
+
+   //! Number of command buffers which did not fit in the pool.
+   uint64_t overflowAllocations = 0;
+
+   //! Number of times allocation had to wait for the GPU.
+   uint64_t stallCount = 0;
+
+   //! Total time spent waiting for the GPU, in nanoseconds.
+   uint64_t stallTime = 0;
+};
+
 void
 initCommandBufferPool(virt_ptr<uint32_t> base,
                       uint32_t size);
@@ -29,6 +65,19 @@ flushCommandBuffer(uint32_t neededSize);
 void
 freeCommandBuffer(CommandBuffer *cb);
 
+/**
+ * Get the current core's active command buffer, leasing or flushing one as
+ * needed so that size more words fit.
+ *
+ * Each core records into its own buffer. Buffers enter the GPU ring in the
+ * order they are flushed, so a worker core's commands execute between
+ * whichever of the main core's buffers were flushed around them. GPU
+ * register state is shared: a buffer starts with whatever state the buffer
+ * submitted before it left behind. Commands recorded on a worker core must
+ * therefore set all the state they depend on, as a display list would, and
+ * the title must use GX2Flush and its own synchronisation if it needs them
+ * ordered relative to the main core's frame.
+ */
 CommandBuffer *
 getCommandBuffer(uint32_t size);
 
@@ -53,6 +102,12 @@ endUserCommandBuffer(virt_ptr<uint32_t> buffer);
 void
 onRetireCommandBuffer(void *context);
 
+CommandBufferPoolStats
+getCommandBufferPoolStats();
+
+void
+resetCommandBufferPoolStats();
+
 /**
  * Write a PM4 command to the active command buffer.
  */
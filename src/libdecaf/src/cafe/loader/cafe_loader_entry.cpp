@@ -163,6 +163,12 @@ lockLoader()
    sLoaderMutex.lock();
 }
 
+bool
+tryLockLoader()
+{
+   return sLoaderMutex.try_lock();
+}
+
 void
 unlockLoader()
 {
@@ -66,6 +66,10 @@ LoaderStart(BOOL isEntryCall,
 void
 lockLoader();
 
+//! Lock the loader if it is not already locked, returns false if it is.
+bool
+tryLockLoader();
+
 void
 unlockLoader();
 
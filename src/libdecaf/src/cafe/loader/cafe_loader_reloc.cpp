@@ -10,16 +10,24 @@
 #include "cafe_loader_utils.h"
 
 #include "cafe/libraries/cafe_hle.h"
+#include "cafe/libraries/cafe_hle_replace.h"
 #include <libcpu/be2_struct.h>
 #include <libcpu/espresso/espresso_instructionset.h>
 #include <libcpu/espresso/espresso_spr.h>
+#include <chrono>
 #include <zlib.h>
 
 namespace cafe::loader::internal
 {
 
 constexpr auto TrampSize = uint32_t { 16 };
-static std::array<uint8_t, 0x1FF8> sRelocBuffer;
+
+// The real loader uses a 0x1FF8 byte buffer, we use a much larger one to
+// reduce the number of inflate calls for large relocation sections.
+static std::array<uint8_t, sizeof(rpl::Rela) * 0x4000> sRelocBuffer;
+
+// How many relocations to apply between checks for interrupts.
+constexpr auto RelocInterruptCheckInterval = 0x100u;
 
 static virt_ptr<rpl::Export>
 LiBinSearchExport(virt_ptr<rpl::Export> exports,
@@ -546,7 +554,9 @@ sExecReloc(virt_ptr<LOADED_RPL> rpl,
          auto symbolIndex = rela.info >> 8;
          auto relaType = static_cast<rpl::RelocationType>(rela.info & 0xFF);
 
-         LiCheckAndHandleInterrupts();
+         if ((relaIndex % RelocInterruptCheckInterval) == 0) {
+            LiCheckAndHandleInterrupts();
+         }
 
          if (symbolIndex > symbolCount) {
             Loader_ReportError(
@@ -705,6 +715,8 @@ LiFixupRelocOneRPL(virt_ptr<LOADED_RPL> rpl,
    auto textMax = rpl->postTrampBuffer + (postTrampAvailable * TrampSize);
 
    // Apply relocations
+   auto relocStartTime = std::chrono::steady_clock::now();
+
    for (auto i = 1u; i < static_cast<unsigned int>(rpl->elfHeader.shnum - 2); ++i) {
       auto sectionHeader = getSectionHeader(rpl, i);
       if (sectionHeader->type == rpl::SHT_RELA) {
@@ -722,6 +734,11 @@ LiFixupRelocOneRPL(virt_ptr<LOADED_RPL> rpl,
       }
    }
 
+   gLog->debug("LiFixupRelocOneRPL({}) applied relocations in {} us",
+               rpl->moduleNameBuffer,
+               std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - relocStartTime).count());
+
    // Flush the code cache
    if (textAddress) {
       if (textMax - textAddress > rpl->textBufferSize) {
@@ -730,6 +747,9 @@ LiFixupRelocOneRPL(virt_ptr<LOADED_RPL> rpl,
          return -470069;
       }
 
+      // Replace hot runtime routines with their host implementations
+      cafe::hle::replaceGuestRoutines(rpl);
+
       LiSafeFlushCode(textAddress, rpl->textBufferSize);
    }
 
@@ -0,0 +1,165 @@
+#include "cafe_loader_sectioncache.h"
+#include "cafe_loader_log.h"
+#include "decaf_config.h"
+#include "filesystem/filesystem_host_path.h"
+
+#include <common/murmur3.h>
+#include <atomic>
+#include <common/platform_dir.h>
+#include <cstdio>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <zlib.h>
+
+namespace cafe::loader::internal
+{
+
+static constexpr uint32_t SectionCacheMagic = 0x53435044; // "DPCS"
+static constexpr uint32_t SectionCacheVersion = 1;
+
+struct SectionCacheHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t size;
+   uint32_t crc;
+};
+
+/**
+ * Every write goes through its own temporary file, the nonce keeps names
+ * unique across instances sharing a cache and the counter within one.
+ */
+static std::string
+getTemporaryPath(const fs::HostPath &path)
+{
+   static const auto sNonce = std::random_device { }();
+   static std::atomic<uint32_t> sCounter { 0 };
+   return fmt::format("{}.{:08X}.{}.tmp", path.path(), sNonce, sCounter++);
+}
+
+static fs::HostPath
+getCachePath(const LiSectionCacheKey &key)
+{
+   auto path = fs::HostPath { decaf::config::system::rpl_cache_path };
+   return path.join(fmt::format("{:016x}{:016x}.bin", key[0], key[1]));
+}
+
+bool
+LiSectionCacheEnabled()
+{
+   return !decaf::config::system::rpl_cache_path.empty();
+}
+
+
+/**
+ * The key is a hash of the module name, the section header before it is
+ * modified by setup and the module's section CRC table. The CRC table covers
+ * the contents of every section so it stands in for hashing the whole file,
+ * which we never have in memory at once.
+ */
+bool
+LiSectionCacheGetKey(virt_ptr<LOADED_RPL> rpl,
+                     uint32_t sectionIndex,
+                     virt_ptr<rpl::SectionHeader> sectionHeader,
+                     LiSectionCacheKey &key)
+{
+   if (!rpl->crcBuffer || !rpl->moduleNameBuffer) {
+      return false;
+   }
+
+   auto crcs = virt_cast<uint32_t *>(rpl->crcBuffer);
+   auto numCrcs = static_cast<uint32_t>(rpl->elfHeader.shnum);
+   if (sectionIndex >= numCrcs || crcs[sectionIndex] == 0) {
+      // A module without section CRCs can not be safely identified
+      return false;
+   }
+
+   auto data = std::vector<uint8_t> { };
+   auto append =
+      [&](const void *ptr, size_t size) {
+         auto bytes = reinterpret_cast<const uint8_t *>(ptr);
+         data.insert(data.end(), bytes, bytes + size);
+      };
+
+   append(rpl->moduleNameBuffer.getRawPointer(), rpl->moduleNameLen);
+   append(&sectionIndex, sizeof(sectionIndex));
+   append(sectionHeader.getRawPointer(), sizeof(rpl::SectionHeader));
+   append(crcs.getRawPointer(), numCrcs * sizeof(uint32_t));
+
+   MurmurHash3_x64_128(data.data(), static_cast<int>(data.size()), 0, key.data());
+   return true;
+}
+
+bool
+LiSectionCacheLoad(const LiSectionCacheKey &key,
+                   virt_ptr<void> dst,
+                   uint32_t size)
+{
+   auto path = getCachePath(key);
+   std::ifstream file { path.path(), std::ios::in | std::ios::binary };
+   if (!file.is_open()) {
+      return false;
+   }
+
+   auto header = SectionCacheHeader { };
+   file.read(reinterpret_cast<char *>(&header), sizeof(header));
+   if (!file ||
+       header.magic != SectionCacheMagic ||
+       header.version != SectionCacheVersion ||
+       header.size != size) {
+      return false;
+   }
+
+   auto buffer = reinterpret_cast<Bytef *>(dst.getRawPointer());
+   file.read(reinterpret_cast<char *>(buffer), size);
+   if (!file || crc32(0, buffer, size) != header.crc) {
+      Loader_ReportWarn("Ignoring corrupt section cache entry {}", path.path());
+      return false;
+   }
+
+   return true;
+}
+
+void
+LiSectionCacheStore(const LiSectionCacheKey &key,
+                    virt_ptr<void> src,
+                    uint32_t size)
+{
+   auto path = getCachePath(key);
+   auto tmpPath = getTemporaryPath(path);
+   auto buffer = reinterpret_cast<const Bytef *>(src.getRawPointer());
+
+   auto header = SectionCacheHeader { };
+   header.magic = SectionCacheMagic;
+   header.version = SectionCacheVersion;
+   header.size = size;
+   header.crc = static_cast<uint32_t>(crc32(0, buffer, size));
+
+   platform::createDirectory(decaf::config::system::rpl_cache_path);
+
+   {
+      std::ofstream file { tmpPath, std::ios::out | std::ios::binary | std::ios::trunc };
+      if (!file.is_open()) {
+         return;
+      }
+
+      file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char *>(buffer), size);
+      if (!file) {
+         file.close();
+         std::remove(tmpPath.c_str());
+         return;
+      }
+   }
+
+   // Write to a temporary file first so concurrent instances never see a
+   // partially written entry.
+   std::remove(path.path().c_str());
+   if (std::rename(tmpPath.c_str(), path.path().c_str())) {
+      std::remove(tmpPath.c_str());
+   }
+}
+
+} // namespace cafe::loader::internal
@@ -0,0 +1,37 @@
+#pragma once
+#include "cafe_loader_loaded_rpl.h"
+#include "cafe_loader_rpl.h"
+
+#include <array>
+#include <cstdint>
+#include <libcpu/be2_struct.h>
+
+namespace cafe::loader::internal
+{
+
+/**
+ * Host side cache of inflated RPL sections, this is not something the real
+ * loader does. It is enabled by setting decaf::config::system::rpl_cache_path.
+ */
+using LiSectionCacheKey = std::array<uint64_t, 2>;
+
+bool
+LiSectionCacheEnabled();
+
+bool
+LiSectionCacheGetKey(virt_ptr<LOADED_RPL> rpl,
+                     uint32_t sectionIndex,
+                     virt_ptr<rpl::SectionHeader> sectionHeader,
+                     LiSectionCacheKey &key);
+
+bool
+LiSectionCacheLoad(const LiSectionCacheKey &key,
+                   virt_ptr<void> dst,
+                   uint32_t size);
+
+void
+LiSectionCacheStore(const LiSectionCacheKey &key,
+                    virt_ptr<void> src,
+                    uint32_t size);
+
+} // namespace cafe::loader::internal
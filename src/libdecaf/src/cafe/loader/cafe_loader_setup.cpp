@@ -9,8 +9,10 @@
 #include "cafe_loader_query.h"
 #include "cafe_loader_log.h"
 #include "cafe_loader_minfileinfo.h"
+#include "cafe_loader_sectioncache.h"
 #include "cafe/cafe_stackobject.h"
 
+#include <chrono>
 #include <common/align.h>
 #include <zlib.h>
 
@@ -65,8 +67,16 @@ LiClearUserBss(bool userHasControl,
    std::memset(base.getRawPointer(), 0, size);
 }
 
+/**
+ * Wait for the upcoming bounce buffer and start reading the next one.
+ *
+ * When skipToOffset is set, whole chunks which end at or before it are not
+ * read at all. This is only done when the next chunk goes into buffer 1, as
+ * that is where virtualFileBase gets rebased so it can absorb the gap.
+ */
 static int32_t
-GetNextBounce(virt_ptr<LOADED_RPL> rpl)
+GetNextBounce(virt_ptr<LOADED_RPL> rpl,
+              uint32_t skipToOffset = 0)
 {
    uint32_t chunkBytesRead = 0;
    auto error = LiWaitOneChunk(&chunkBytesRead,
@@ -94,6 +104,16 @@ GetNextBounce(virt_ptr<LOADED_RPL> rpl)
    }
 
    if (chunkBytesRead == 0x400000) {
+      if (readBufferNumber == 1) {
+         auto skipBytes = 0u;
+         while (rpl->upcomingFileOffset + skipBytes + 0x400000 <= skipToOffset) {
+            skipBytes += 0x400000;
+         }
+
+         rpl->upcomingFileOffset += skipBytes;
+         rpl->virtualFileBaseOffset += skipBytes;
+      }
+
       return LiRefillUpcomingBounceBuffer(rpl, readBufferNumber);
    }
 
@@ -238,7 +258,6 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
       }
    }
 
-   constexpr auto InflateChunkSize = 0x3000u;
    rpl->lastSectionCrc = 0u;
 
    stream.next_out = reinterpret_cast<Bytef *>(inflatedBuffer.getRawPointer());
@@ -250,8 +269,11 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
       stream.next_in = reinterpret_cast<Bytef *>(bounceBuffer.getRawPointer());
 
       while (stream.avail_in) {
+         // The real loader inflates in 0x3000 byte steps so it can keep its
+         // heartbeat alive, we do not need that so inflate the whole bounce
+         // buffer in one call.
          LiCheckAndHandleInterrupts();
-         stream.avail_out = std::min<uInt>(InflateChunkSize, inflatedBytesMax - stream.total_out);
+         stream.avail_out = static_cast<uInt>(inflatedBytesMax - stream.total_out);
 
          zlibError = inflate(&stream, 0);
          if (zlibError != Z_OK && zlibError != Z_STREAM_END) {
@@ -278,6 +300,10 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
          }
 
          decaf_check(stream.total_out <= inflatedBytesMax);
+
+         if (zlibError == Z_STREAM_END) {
+            break;
+         }
       }
 
       deflatedBytesRemaining -= bounceBufferSize;
@@ -299,6 +325,46 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
    return 0;
 }
 
+/**
+ * Advance the bounce buffers past a section's data, this leaves them in the
+ * same state as ZLIB_UncompressFromStream would. Chunks which hold nothing
+ * but this section's data are never read from the file.
+ */
+static int32_t
+sLiSkipFromStream(virt_ptr<LOADED_RPL> rpl,
+                  uint32_t sectionIndex,
+                  std::string_view boundsName,
+                  uint32_t fileOffset,
+                  uint32_t size)
+{
+   auto endOffset = fileOffset + size;
+   auto bounceBuffer = virt_ptr<void> { nullptr };
+   auto bounceBufferSize = uint32_t { 0 };
+
+   auto error =
+      sLiPrepareBounceBufferForReading(rpl, sectionIndex, boundsName,
+                                       fileOffset, &bounceBufferSize,
+                                       size, &bounceBuffer);
+   if (error) {
+      return error;
+   }
+
+   while (rpl->upcomingFileOffset < endOffset) {
+      LiCheckAndHandleInterrupts();
+      auto previousOffset = rpl->upcomingFileOffset;
+
+      error = GetNextBounce(rpl, endOffset);
+      if (error || rpl->upcomingFileOffset == previousOffset) {
+         Loader_ReportError("*** {} Segment {}: failed to skip cached section {} data.",
+                            rpl->moduleNameBuffer, boundsName, sectionIndex);
+         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "sLiSkipFromStream", 359);
+         return error ? error : -470087;
+      }
+   }
+
+   return 0;
+}
+
 static int32_t
 LiSetupOneAllocSection(kernel::UniqueProcessId upid,
                        virt_ptr<LOADED_RPL> rpl,
@@ -374,7 +440,26 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
          auto inflatedExpectedSize =
             *reinterpret_cast<be2_val<uint32_t> *>(
                inflatedExpectedSizeBuffer.data());
-         if (inflatedExpectedSize) {
+         auto cacheKey = LiSectionCacheKey { };
+         auto useCache = LiSectionCacheEnabled() &&
+            LiSectionCacheGetKey(rpl, sectionIndex, sectionHeader, cacheKey);
+
+         if (inflatedExpectedSize && useCache &&
+             LiSectionCacheLoad(cacheKey, virt_cast<void *>(sectionAddress),
+                                inflatedExpectedSize)) {
+            error = sLiSkipFromStream(rpl,
+                                      sectionIndex,
+                                      bounds->name,
+                                      sectionHeader->offset + 4,
+                                      sectionHeader->size - 4);
+            if (error) {
+               return error;
+            }
+
+            // Match the state ZLIB_UncompressFromStream leaves behind
+            rpl->lastSectionCrc = 0u;
+            sectionHeader->size = inflatedExpectedSize;
+         } else if (inflatedExpectedSize) {
             auto inflatedBytes = static_cast<uint32_t>(inflatedExpectedSize);
             error = ZLIB_UncompressFromStream(rpl,
                                               sectionIndex,
@@ -408,6 +493,10 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
                return -470090;
             }
 
+            if (useCache) {
+               LiSectionCacheStore(cacheKey, virt_cast<void *>(sectionAddress), inflatedBytes);
+            }
+
             sectionHeader->size = inflatedBytes;
          }
       } else {
@@ -458,6 +547,7 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
               virt_ptr<TinyHeap> codeHeapTracking,
               virt_ptr<TinyHeap> dataHeapTracking)
 {
+   auto startTime = std::chrono::steady_clock::now();
    int32_t result = 0;
 
    // Calculate segment bounds
@@ -750,6 +840,12 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
       goto error;
    }
 
+   // Most of the time to set up a module is spent reading and inflating its
+   // sections, log it so changes to the loader can be measured.
+   gLog->debug("LiSetupOneRPL({}) took {} us",
+               rpl->moduleNameBuffer,
+               std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - startTime).count());
    return 0;
 
 error:
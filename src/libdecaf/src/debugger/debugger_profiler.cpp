@@ -0,0 +1,300 @@
+#include "debugger_profiler.h"
+
+#include "cafe/libraries/cafe_hle.h"
+#include "cafe/loader/cafe_loader_entry.h"
+#include "cafe/loader/cafe_loader_loaded_rpl.h"
+#include "decaf_config.h"
+
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+#include <fstream>
+#include <libcpu/cpu_sampler.h>
+#include <libcpu/state.h>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace debugger
+{
+
+namespace profiler
+{
+
+struct SymbolInfo
+{
+   uint32_t start;
+   uint32_t size;
+   std::string name;
+};
+
+struct ModuleInfo
+{
+   uint32_t textStart;
+   uint32_t textEnd;
+   std::string name;
+};
+
+static std::mutex sProfileMutex;
+static std::array<uint64_t, 3> sSamplePositions = { };
+static std::vector<cpu::Sample> sSampleBuffer;
+static uint64_t sTotalSamples = 0;
+
+//! Sample count for each unique stack, frames separated by ;, root first.
+static std::map<std::string, uint64_t> sCollapsedStacks;
+static std::unordered_map<std::string, FunctionProfile> sFunctions;
+
+static std::vector<SymbolInfo> sSymbols;
+static std::vector<ModuleInfo> sModules;
+static uint32_t sNumLoadedModules = 0;
+
+/**
+ * Rebuild the function symbol table from every loaded module, only done when
+ * the number of loaded modules has changed.
+ */
+static void
+updateSymbolsNoLock()
+{
+   auto numModules = 0u;
+   cafe::loader::lockLoader();
+   for (auto rpl = cafe::loader::getLoadedRplLinkedList(); rpl; rpl = rpl->nextLoadedRpl) {
+      ++numModules;
+   }
+
+   if (numModules == sNumLoadedModules) {
+      cafe::loader::unlockLoader();
+      return;
+   }
+
+   sNumLoadedModules = numModules;
+   sSymbols.clear();
+   sModules.clear();
+
+   for (auto rpl = cafe::loader::getLoadedRplLinkedList(); rpl; rpl = rpl->nextLoadedRpl) {
+      auto textStart = static_cast<uint32_t>(virt_addr { rpl->textAddr });
+      auto textEnd = textStart + static_cast<uint32_t>(rpl->textSize);
+      sModules.push_back({
+         textStart, textEnd,
+         std::string { rpl->moduleNameBuffer.getRawPointer(), rpl->moduleNameLen }
+      });
+
+      if (!rpl->sectionHeaderBuffer) {
+         continue;
+      }
+
+      for (auto i = 0u; i < rpl->elfHeader.shnum; ++i) {
+         auto sectionHeader =
+            virt_cast<cafe::loader::rpl::SectionHeader *>(
+               virt_cast<virt_addr>(rpl->sectionHeaderBuffer) +
+               (i * rpl->elfHeader.shentsize));
+         if (sectionHeader->type != cafe::loader::rpl::SHT_SYMTAB) {
+            continue;
+         }
+
+         auto symTabAddr = rpl->sectionAddressBuffer[i];
+         auto strTabAddr = rpl->sectionAddressBuffer[sectionHeader->link];
+         if (!symTabAddr || !strTabAddr) {
+            continue;
+         }
+
+         auto symTabEntSize =
+            sectionHeader->entsize ?
+            static_cast<size_t>(sectionHeader->entsize) :
+            sizeof(cafe::loader::rpl::Symbol);
+         auto symTabEntries = sectionHeader->size / symTabEntSize;
+
+         for (auto j = 0u; j < symTabEntries; ++j) {
+            auto symbol =
+               virt_cast<cafe::loader::rpl::Symbol *>(
+                  symTabAddr + (j * symTabEntSize));
+            auto symbolAddress = static_cast<uint32_t>(symbol->value);
+            if ((symbol->info & 0xf) == cafe::loader::rpl::STT_FUNC &&
+                symbolAddress >= textStart && symbolAddress < textEnd) {
+               auto name = virt_cast<const char *>(strTabAddr + symbol->name);
+               sSymbols.push_back({ symbolAddress,
+                                     static_cast<uint32_t>(symbol->size),
+                                     name.getRawPointer() });
+            }
+         }
+      }
+   }
+   cafe::loader::unlockLoader();
+
+   std::sort(sSymbols.begin(), sSymbols.end(),
+             [](const SymbolInfo &lhs, const SymbolInfo &rhs) {
+                return lhs.start < rhs.start;
+             });
+}
+
+static std::string
+getFrameNameNoLock(uint32_t address)
+{
+   auto itr = std::upper_bound(sSymbols.begin(), sSymbols.end(), address,
+                               [](uint32_t address, const SymbolInfo &symbol) {
+                                  return address < symbol.start;
+                               });
+   if (itr != sSymbols.begin()) {
+      --itr;
+
+      if (!itr->size || address < itr->start + itr->size) {
+         return itr->name;
+      }
+   }
+
+   for (auto &module : sModules) {
+      if (address >= module.textStart && address < module.textEnd) {
+         return fmt::format("{}:0x{:08X}", module.name, address);
+      }
+   }
+
+   return fmt::format("0x{:08X}", address);
+}
+
+static void
+addSampleNoLock(uint32_t coreId,
+                const cpu::Sample &sample)
+{
+   auto frames = std::vector<std::string> { };
+   frames.push_back(fmt::format("core{}", coreId));
+
+   for (auto i = sample.numCallers; i > 0; --i) {
+      frames.push_back(getFrameNameNoLock(sample.callers[i - 1]));
+   }
+
+   if (sample.nia == 0xFFFFFFFF) {
+      frames.push_back("idle");
+   } else if (sample.kernelCallId != cpu::InvalidKernelCallId) {
+      auto function = cafe::hle::getKernelCallFunction(sample.kernelCallId);
+      frames.push_back(function ? "hle:" + function->name : "hle:unknown");
+   } else {
+      frames.push_back(getFrameNameNoLock(sample.nia));
+   }
+
+   auto stack = fmt::memory_buffer { };
+   auto seen = std::unordered_set<std::string> { };
+
+   for (auto i = 0u; i < frames.size(); ++i) {
+      auto &frame = frames[i];
+      fmt::format_to(stack, "{}{}", i ? ";" : "", frame);
+
+      if (i > 0 && seen.insert(frame).second) {
+         auto &function = sFunctions[frame];
+         function.name = frame;
+         function.totalSamples++;
+      }
+   }
+
+   sFunctions[frames.back()].selfSamples++;
+   sCollapsedStacks[std::string { stack.data(), stack.size() }]++;
+   sTotalSamples++;
+}
+
+void
+start()
+{
+   cpu::startSampling(decaf::config::debugger::profiler_frequency);
+}
+
+void
+stop()
+{
+   cpu::stopSampling();
+}
+
+bool
+isRunning()
+{
+   return cpu::isSampling();
+}
+
+void
+reset()
+{
+   std::lock_guard<std::mutex> lock { sProfileMutex };
+
+   // Discard anything sampled before now.
+   for (auto coreId = 0u; coreId < sSamplePositions.size(); ++coreId) {
+      sSampleBuffer.clear();
+      cpu::readSamples(coreId, sSamplePositions[coreId], sSampleBuffer);
+   }
+
+   sSampleBuffer.clear();
+   sCollapsedStacks.clear();
+   sFunctions.clear();
+   sTotalSamples = 0;
+}
+
+/**
+ * Aggregate every sample taken since the last update.
+ */
+void
+update()
+{
+   std::lock_guard<std::mutex> lock { sProfileMutex };
+   updateSymbolsNoLock();
+
+   for (auto coreId = 0u; coreId < sSamplePositions.size(); ++coreId) {
+      sSampleBuffer.clear();
+      cpu::readSamples(coreId, sSamplePositions[coreId], sSampleBuffer);
+
+      for (auto &sample : sSampleBuffer) {
+         addSampleNoLock(coreId, sample);
+      }
+   }
+}
+
+uint64_t
+getTotalSamples()
+{
+   std::lock_guard<std::mutex> lock { sProfileMutex };
+   return sTotalSamples;
+}
+
+//! Returns the profile of every sampled function, sorted by self samples.
+std::vector<FunctionProfile>
+getFunctionProfiles()
+{
+   auto profiles = std::vector<FunctionProfile> { };
+
+   {
+      std::lock_guard<std::mutex> lock { sProfileMutex };
+      profiles.reserve(sFunctions.size());
+
+      for (auto &pair : sFunctions) {
+         profiles.push_back(pair.second);
+      }
+   }
+
+   std::sort(profiles.begin(), profiles.end(),
+             [](const FunctionProfile &lhs, const FunctionProfile &rhs) {
+                return lhs.selfSamples > rhs.selfSamples;
+             });
+   return profiles;
+}
+
+/**
+ * Write the profile in the collapsed stack format used by flamegraph.pl and
+ * most other flame graph tools.
+ */
+bool
+exportCollapsedStacks(const std::string &path)
+{
+   update();
+
+   auto out = std::ofstream { path, std::ofstream::out };
+   if (!out.is_open()) {
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock { sProfileMutex };
+   for (auto &pair : sCollapsedStacks) {
+      out << pair.first << ' ' << pair.second << '\n';
+   }
+
+   return true;
+}
+
+} // namespace profiler
+
+} // namespace debugger
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace debugger
+{
+
+namespace profiler
+{
+
+struct FunctionProfile
+{
+   std::string name;
+
+   //! Samples where this function was executing.
+   uint64_t selfSamples;
+
+   //! Samples where this function was anywhere on the stack.
+   uint64_t totalSamples;
+};
+
+void start();
+void stop();
+bool isRunning();
+void reset();
+void update();
+
+uint64_t getTotalSamples();
+std::vector<FunctionProfile> getFunctionProfiles();
+bool exportCollapsedStacks(const std::string &path);
+
+} // namespace profiler
+
+} // namespace debugger
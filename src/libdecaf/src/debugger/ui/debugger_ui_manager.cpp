@@ -15,6 +15,8 @@
 #include "debugger_ui_window_voices.h"
 #include "debugger_ui_window_performance.h"
 
+#include "cafe/libraries/cafe_hle.h"
+#include "cafe/libraries/cafe_hle_trace.h"
 #include "cafe/loader/cafe_loader_entry.h"
 #include "cafe/loader/cafe_loader_loaded_rpl.h"
 #include "cafe/libraries/coreinit/coreinit_thread.h"
@@ -391,6 +393,16 @@ void Manager::drawMenu()
 
       if (ImGui::MenuItem("Kernel Trace Enabled", nullptr, decaf::config::log::kernel_trace, true)) {
          decaf::config::log::kernel_trace = !decaf::config::log::kernel_trace;
+         cafe::hle::bindKernelCalls();
+      }
+
+      if (ImGui::MenuItem("Dump Kernel Trace", nullptr, false, decaf::config::log::kernel_trace)) {
+         cafe::hle::dumpCallTrace();
+         cafe::hle::clearCallTrace();
+      }
+
+      if (ImGui::MenuItem("Scheduler Validation", nullptr, decaf::config::system::scheduler_validation, true)) {
+         decaf::config::system::scheduler_validation = !decaf::config::system::scheduler_validation;
       }
 
       auto pm4Enable = false;
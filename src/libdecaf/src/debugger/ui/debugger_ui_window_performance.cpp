@@ -60,6 +60,19 @@ PerformanceWindow::drawTextAndValue(const char *text, uint64_t val)
    ImGui::PopStyleColor();
 }
 
+void
+PerformanceWindow::drawTextAndValue(const char *text, double val)
+{
+   ImGui::PushStyleColor(ImGuiCol_Text, TitleTextColor);
+   ImGui::Text("%s", text);
+   ImGui::PopStyleColor();
+
+   ImGui::PushStyleColor(ImGuiCol_Text, ValueTextColor);
+   ImGui::SameLine();
+   ImGui::Text("%.2f", val);
+   ImGui::PopStyleColor();
+}
+
 void
 PerformanceWindow::draw()
 {
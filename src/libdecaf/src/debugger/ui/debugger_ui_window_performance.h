@@ -21,6 +21,7 @@ public:
    void draw() override;
 
    void drawTextAndValue(const char *text, uint64_t val);
+   void drawTextAndValue(const char *text, double val);
 
    virtual void drawGraphs();
    virtual void drawBackendInfo();
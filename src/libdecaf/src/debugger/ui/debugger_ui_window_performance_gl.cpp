@@ -40,6 +40,22 @@ void PerformanceWindowGL::drawBackendInfo()
    drawTextAndValue("Shader Pipelines:", mInfo->numShaderPipelines);
    drawTextAndValue("Surfaces:", mInfo->numSurfaces);
    drawTextAndValue("Data Buffers:", mInfo->numDataBuffers);
+
+   // Time spent in each PM4 stage during the last frame
+   ImGui::Columns(1);
+   ImGui::Separator();
+   ImGui::Text("%s", mInfo->pm4Pipelined ? "PM4 (pipelined)" : "PM4 (serial)");
+   ImGui::Columns(2);
+
+   drawTextAndValue("Parse ms:", mInfo->pm4ParseMs);
+   drawTextAndValue("Parse Stall ms:", mInfo->pm4ParseStallMs);
+   drawTextAndValue("Queue Depth:", mInfo->pm4QueueDepth);
+
+   ImGui::NextColumn();
+
+   drawTextAndValue("Submit ms:", mInfo->pm4SubmitMs);
+   drawTextAndValue("Submit Stall ms:", mInfo->pm4SubmitStallMs);
+   drawTextAndValue("Max Queue Depth:", mInfo->pm4MaxQueueDepth);
 }
 
 } // namespace ui
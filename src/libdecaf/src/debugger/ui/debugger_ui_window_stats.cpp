@@ -1,7 +1,13 @@
 #include "debugger_ui_window_stats.h"
+#include "cafe/libraries/coreinit/coreinit_internal_idlock.h"
+#include "cafe/libraries/gx2/gx2_internal_cbpool.h"
+#include "debugger/debugger_profiler.h"
+#include "decaf_config.h"
 
 #include <algorithm>
+#include <cfloat>
 #include <cinttypes>
+#include <fmt/format.h>
 #include <imgui.h>
 #include <libcpu/jit_stats.h>
 
@@ -128,9 +134,172 @@ StatsWindow::draw()
    }
 
    ImGui::Columns(1);
+
+   if (ImGui::TreeNode("Lock Contention")) {
+      drawLockStats();
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("Sampling Profiler")) {
+      drawSamplingProfile();
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("GX2 Command Buffer Pool")) {
+      drawCommandBufferPoolStats();
+      ImGui::TreePop();
+   }
+
    ImGui::End();
 }
 
+void
+StatsWindow::drawLockStats()
+{
+   using cafe::coreinit::internal::IdLockHoldTimeBuckets;
+
+   if (ImGui::Button("Reset")) {
+      cafe::coreinit::internal::resetIdLockStats();
+   }
+
+   ImGui::Columns(5, "lockList", false);
+   ImGui::Text("Lock"); ImGui::NextColumn();
+   ImGui::Text("Acquired"); ImGui::NextColumn();
+   ImGui::Text("Contended"); ImGui::NextColumn();
+   ImGui::Text("Slept"); ImGui::NextColumn();
+   ImGui::Text("Hold Time"); ImGui::NextColumn();
+   ImGui::Separator();
+
+   for (auto stats : cafe::coreinit::internal::getIdLockStats()) {
+      auto acquired = stats->acquireCount.load();
+      auto contended = stats->contendedCount.load();
+      float holdTime[IdLockHoldTimeBuckets];
+
+      for (auto i = 0u; i < IdLockHoldTimeBuckets; ++i) {
+         holdTime[i] = static_cast<float>(stats->holdTime[i].load());
+      }
+
+      ImGui::Text("%s", stats->name.c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, acquired);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64 " (%.2f%%)", contended,
+                  acquired ? 100.0 * contended / acquired : 0.0);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, stats->sleepCount.load());
+      ImGui::NextColumn();
+      ImGui::PushID(stats);
+      ImGui::PlotHistogram("", holdTime, IdLockHoldTimeBuckets, 0,
+                           "<128ns .. 2ms+", 0.0f, FLT_MAX, ImVec2 { 0, 32 });
+      ImGui::PopID();
+      ImGui::NextColumn();
+   }
+
+   ImGui::Columns(1);
+}
+
+void
+StatsWindow::drawCommandBufferPoolStats()
+{
+   if (ImGui::Button("Reset")) {
+      cafe::gx2::internal::resetCommandBufferPoolStats();
+   }
+
+   auto stats = cafe::gx2::internal::getCommandBufferPoolStats();
+   auto poolSize = stats.poolSize * 4;
+
+   ImGui::Columns(2, "cbPoolStats", false);
+
+   ImGui::Text("Pool Size");
+   ImGui::NextColumn();
+   ImGui::Text("%.2f MB", poolSize / 1.0e6);
+   ImGui::NextColumn();
+
+   ImGui::Text("Pool Used");
+   ImGui::NextColumn();
+   ImGui::Text("%.2f MB (%.2f%%)", stats.poolUsed * 4 / 1.0e6,
+               poolSize ? 100.0 * stats.poolUsed * 4 / poolSize : 0.0);
+   ImGui::NextColumn();
+
+   ImGui::Text("Peak Pool Used");
+   ImGui::NextColumn();
+   ImGui::Text("%.2f MB (%.2f%%)", stats.poolPeakUsed * 4 / 1.0e6,
+               poolSize ? 100.0 * stats.poolPeakUsed * 4 / poolSize : 0.0);
+   ImGui::NextColumn();
+
+   ImGui::Text("Overflow Used");
+   ImGui::NextColumn();
+   ImGui::Text("%.2f MB of %.2f MB", stats.overflowUsed * 4 / 1.0e6,
+               stats.overflowSize * 4 / 1.0e6);
+   ImGui::NextColumn();
+
+   ImGui::Text("Overflow Allocations");
+   ImGui::NextColumn();
+   ImGui::Text("%" PRIu64, stats.overflowAllocations);
+   ImGui::NextColumn();
+
+   ImGui::Text("Stalls");
+   ImGui::NextColumn();
+   ImGui::Text("%" PRIu64 " (%.2f ms)", stats.stallCount, stats.stallTime / 1.0e6);
+   ImGui::NextColumn();
+
+   ImGui::Columns(1);
+}
+
+void
+StatsWindow::drawSamplingProfile()
+{
+   // Show at most this many of the functions with the most self samples.
+   static constexpr auto MaxProfileFunctions = 100u;
+
+   if (profiler::isRunning()) {
+      if (ImGui::Button("Stop")) {
+         profiler::stop();
+      }
+   } else if (ImGui::Button("Start")) {
+      profiler::start();
+   }
+
+   ImGui::SameLine();
+   if (ImGui::Button("Reset")) {
+      profiler::reset();
+   }
+
+   ImGui::SameLine();
+   if (ImGui::Button("Export")) {
+      auto path = fmt::format("{}/decaf_profile.folded",
+                              decaf::config::log::directory);
+      profiler::exportCollapsedStacks(path);
+   }
+
+   profiler::update();
+
+   auto totalSamples = profiler::getTotalSamples();
+   ImGui::Text("%" PRIu64 " samples", totalSamples);
+
+   ImGui::Columns(3, "profileList", false);
+   ImGui::Text("Function"); ImGui::NextColumn();
+   ImGui::Text("Self %%"); ImGui::NextColumn();
+   ImGui::Text("Total %%"); ImGui::NextColumn();
+   ImGui::Separator();
+
+   auto profiles = profiler::getFunctionProfiles();
+   if (profiles.size() > MaxProfileFunctions) {
+      profiles.resize(MaxProfileFunctions);
+   }
+
+   for (auto &profile : profiles) {
+      ImGui::Text("%s", profile.name.c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%.2f%%", 100.0 * profile.selfSamples / totalSamples);
+      ImGui::NextColumn();
+      ImGui::Text("%.2f%%", 100.0 * profile.totalSamples / totalSamples);
+      ImGui::NextColumn();
+   }
+
+   ImGui::Columns(1);
+}
+
 } // namespace ui
 
 } // namespace debugger
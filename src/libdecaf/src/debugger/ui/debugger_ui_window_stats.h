@@ -31,6 +31,15 @@ public:
    update();
 
 private:
+   void
+   drawLockStats();
+
+   void
+   drawSamplingProfile();
+
+   void
+   drawCommandBufferPoolStats();
+
    std::chrono::time_point<std::chrono::system_clock> mLastProfileListUpdate;
    bool mNeedProfileListUpdate = true;
    std::vector<cpu::jit::CodeBlock *> mProfileList;
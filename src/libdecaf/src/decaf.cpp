@@ -10,11 +10,13 @@
 #include "input/input.h"
 #include "ios/ios.h"
 #include "kernel/kernel_filesystem.h"
+#include "replay/replay.h"
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
 
 #include "cafe/kernel/cafe_kernel.h"
 #include "cafe/kernel/cafe_kernel_process.h"
+#include "cafe/libraries/cafe_hle_trace.h"
 #include "cafe/libraries/coreinit/coreinit_scheduler.h"
 #include "cafe/libraries/coreinit/coreinit_thread.h"
 #include "cafe/libraries/swkbd/swkbd_keyboard.h"
@@ -22,6 +24,7 @@
 #include <chrono>
 #include <common/platform.h>
 #include <common/platform_dir.h>
+#include <common/platform_time.h>
 #include <condition_variable>
 #include <fmt/format.h>
 #include <mutex>
@@ -153,9 +156,18 @@ initialise(const std::string &gamePath)
    WSAStartup(MAKEWORD(2, 2), &wsaInitData);
 #endif
 
+   // Calibrate host ticks now rather than on first use, which happens with
+   //  the scheduler lock held
+   platform::calibrateHostTicks();
+
    // Initialise cpu (because this initialises memory)
    ::cpu::initialise();
 
+   // Setup record or playback of guest inputs
+   if (!replay::initialise()) {
+      return false;
+   }
+
    // Setup debugger
    debugger::initialise(makeConfigPath("imgui.ini"),
                         sClipboardTextGetCallbackFn,
@@ -168,6 +180,7 @@ initialise(const std::string &gamePath)
    auto path = fs::HostPath { gamePath };
    auto volPath = fs::HostPath { };
    auto rpxPath = fs::HostPath { };
+   auto archive = std::shared_ptr<fs::Archive> { };
 
    if (platform::isDirectory(path.path())) {
       if (platform::isFile(path.join("code").join("cos.xml").path())) {
@@ -181,7 +194,10 @@ initialise(const std::string &gamePath)
       auto parent1 = fs::HostPath { path.parentPath() };
       auto parent2 = fs::HostPath { parent1.parentPath() };
 
-      if (platform::isFile(parent2.join("code").join("cos.xml").path())) {
+      if (path.extension().compare("dtar") == 0) {
+         // Found packed title archive
+         archive = fs::Archive::open(path.path());
+      } else if (platform::isFile(parent2.join("code").join("cos.xml").path())) {
          // Found file/../code/cos.xml
          volPath = parent2.path();
       } else if (path.extension().compare("rpx") == 0) {
@@ -190,7 +206,11 @@ initialise(const std::string &gamePath)
       }
    }
 
-   if (!volPath.path().empty()) {
+   if (archive) {
+      filesystem->mountArchiveFolder("/vol/code", archive, "code", fs::Permissions::Read);
+      filesystem->mountArchiveFolder("/vol/content", archive, "content", fs::Permissions::Read);
+      filesystem->mountArchiveFolder("/vol/meta", archive, "meta", fs::Permissions::Read);
+   } else if (!volPath.path().empty()) {
       filesystem->mountHostFolder("/vol/code", volPath.join("code"), fs::Permissions::Read);
       filesystem->mountHostFolder("/vol/content", volPath.join("content"), fs::Permissions::Read);
       filesystem->mountHostFolder("/vol/meta", volPath.join("meta"), fs::Permissions::Read);
@@ -266,6 +286,11 @@ waitForExit()
    // Make sure we clean up
    decaf::shutdown();
 
+   // A playback which diverged did not reproduce the recorded run
+   if (replay::hasDiverged()) {
+      return -1;
+   }
+
    return cafe::kernel::getProcessExitCode(cafe::kernel::RamPartitionId::MainApplication);
 }
 
@@ -281,6 +306,14 @@ shutdown()
    // Wait for PPC to finish
    cafe::kernel::join();
 
+   // Decode any recorded kernel trace to the log
+   if (decaf::config::log::kernel_trace) {
+      cafe::hle::dumpCallTrace();
+   }
+
+   // Finish any replay recording
+   replay::shutdown();
+
    // Stop graphics driver
    auto graphicsDriver = getGraphicsDriver();
 
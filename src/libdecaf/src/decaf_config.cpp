@@ -13,6 +13,7 @@ bool enabled = true;
 bool break_on_entry = false;
 bool gdb_stub = false;
 unsigned gdb_stub_port = 2159;
+unsigned profiler_frequency = 1000;
 
 } // namespace debugger
 
@@ -51,6 +52,14 @@ std::vector<std::string> kernel_trace_filters =
 
 } // namespace log
 
+namespace replay
+{
+
+std::string record_path = {};
+std::string playback_path = {};
+
+} // namespace replay
+
 namespace sound
 {
 
@@ -70,6 +79,9 @@ std::string resources_path = "resources";
 double time_scale = 1.0;
 std::vector<std::string> lle_modules;
 bool dump_hle_rpl = false;
+std::string rpl_cache_path = {};
+bool scheduler_validation = false;
+bool hle_replace_routines = false;
 
 } // namespace system
 
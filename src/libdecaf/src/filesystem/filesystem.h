@@ -1,4 +1,6 @@
 #pragma once
+#include "filesystem_archive.h"
+#include "filesystem_archive_folder.h"
 #include "filesystem_error.h"
 #include "filesystem_file.h"
 #include "filesystem_filehandle.h"
@@ -159,6 +161,36 @@ public:
       return folder->addChild(new HostFolder { src, name, permissions });
    }
 
+   Result<Node *>
+   mountArchiveFolder(Path dst,
+                      std::shared_ptr<Archive> archive,
+                      const std::string &src,
+                      Permissions permissions)
+   {
+      auto index = archive->findPath(src);
+
+      if (index == ArchiveInvalidIndex || !archive->isFolder(index)) {
+         return { Error::NotFound };
+      }
+
+      auto result = createPath(dst.parentPath());
+
+      if (!result) {
+         return result;
+      }
+
+      auto parent = result.value();
+
+      if (parent->type() != Node::FolderNode || parent->deviceType() != Node::VirtualDevice) {
+         return { Error::NotDirectory };
+      }
+
+      gLog->debug("Mount archive folder {} to {}", src, dst.path());
+      auto folder = reinterpret_cast<VirtualFolder *>(parent);
+      auto name = dst.filename();
+      return folder->addChild(new ArchiveFolder { std::move(archive), index, name, permissions });
+   }
+
    Result<Node *>
    mountHostFile(Path dst,
                  HostPath src,
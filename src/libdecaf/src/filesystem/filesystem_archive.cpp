@@ -0,0 +1,365 @@
+#include "filesystem_archive.h"
+#include "filesystem_archive_filehandle.h"
+
+#include <algorithm>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <cstring>
+#include <zlib.h>
+
+namespace fs
+{
+
+Archive::~Archive()
+{
+   if (mView) {
+      platform::unmapViewOfFile(mView, mSize);
+      mView = nullptr;
+   }
+
+   if (mFile != platform::InvalidMapFileHandle) {
+      platform::closeMemoryMappedFile(mFile);
+      mFile = platform::InvalidMapFileHandle;
+   }
+}
+
+
+std::shared_ptr<Archive>
+Archive::open(const std::string &path)
+{
+   auto archive = std::shared_ptr<Archive> { new Archive { } };
+   archive->mFile = platform::openMemoryMappedFile(path,
+                                                   platform::ProtectFlags::ReadOnly,
+                                                   &archive->mSize);
+
+   if (archive->mFile == platform::InvalidMapFileHandle) {
+      return nullptr;
+   }
+
+   if (archive->mSize < sizeof(ArchiveHeader)) {
+      gLog->error("Archive {} is too small to be valid", path);
+      return nullptr;
+   }
+
+   archive->mView = reinterpret_cast<uint8_t *>(
+      platform::mapViewOfFile(archive->mFile, platform::ProtectFlags::ReadOnly,
+                              0, archive->mSize));
+
+   if (!archive->mView) {
+      gLog->error("Could not map archive {}", path);
+      return nullptr;
+   }
+
+   archive->mHeader = reinterpret_cast<const ArchiveHeader *>(archive->mView);
+
+   if (archive->mHeader->magic != ArchiveMagic ||
+       archive->mHeader->version != ArchiveVersion) {
+      gLog->error("Archive {} has an unexpected magic or version", path);
+      return nullptr;
+   }
+
+   archive->mEntries = reinterpret_cast<const ArchiveEntry *>(
+      archive->mView + archive->mHeader->entriesOffset);
+   archive->mNames = reinterpret_cast<const char *>(
+      archive->mView + archive->mHeader->namesOffset);
+
+   if (!archive->validate()) {
+      gLog->error("Archive {} is corrupt", path);
+      return nullptr;
+   }
+
+   return archive;
+}
+
+
+/**
+ * Check every offset in the index once up front so lookups and reads do not
+ * have to bounds check against the mapping.
+ */
+bool
+Archive::validate() const
+{
+   auto inRange =
+      [this](uint64_t offset, uint64_t size) {
+         return offset <= mSize && size <= mSize - offset;
+      };
+
+   auto &header = *mHeader;
+
+   if (header.numEntries == 0 || header.blockSize == 0 ||
+       !inRange(header.entriesOffset, uint64_t { header.numEntries } * sizeof(ArchiveEntry)) ||
+       !inRange(header.namesOffset, header.namesSize) ||
+       !(mEntries[0].flags & ArchiveEntryFolder)) {
+      return false;
+   }
+
+   for (auto i = 0u; i < header.numEntries; ++i) {
+      auto &entry = mEntries[i];
+
+      if (uint64_t { entry.nameOffset } + entry.nameLength > header.namesSize) {
+         return false;
+      }
+
+      if (entry.flags & ArchiveEntryFolder) {
+         if (uint64_t { entry.firstChild } + entry.numChildren > header.numEntries) {
+            return false;
+         }
+      } else if (entry.flags & ArchiveEntryCompressed) {
+         auto expectedBlocks = (entry.size + header.blockSize - 1) / header.blockSize;
+
+         if (entry.numBlocks != expectedBlocks ||
+             !inRange(entry.offset, (uint64_t { entry.numBlocks } + 1) * sizeof(uint64_t))) {
+            return false;
+         }
+
+         auto blocks = reinterpret_cast<const uint64_t *>(mView + entry.offset);
+
+         for (auto j = 0u; j < entry.numBlocks; ++j) {
+            if (blocks[j] > blocks[j + 1] || !inRange(blocks[j], blocks[j + 1] - blocks[j])) {
+               return false;
+            }
+         }
+      } else if (!inRange(entry.offset, entry.size)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+uint32_t
+Archive::findChild(uint32_t folder,
+                   std::string_view name) const
+{
+   auto &entry = mEntries[folder];
+
+   if (!(entry.flags & ArchiveEntryFolder)) {
+      return ArchiveInvalidIndex;
+   }
+
+   auto first = entry.firstChild;
+   auto last = entry.firstChild + entry.numChildren;
+   auto itr = std::lower_bound(mEntries + first, mEntries + last, name,
+      [this](const ArchiveEntry &child, std::string_view name) {
+         return std::string_view { mNames + child.nameOffset, child.nameLength } < name;
+      });
+
+   if (itr == mEntries + last || this->name(static_cast<uint32_t>(itr - mEntries)) != name) {
+      return ArchiveInvalidIndex;
+   }
+
+   return static_cast<uint32_t>(itr - mEntries);
+}
+
+
+uint32_t
+Archive::findPath(std::string_view path) const
+{
+   auto index = 0u;
+
+   while (!path.empty() && index != ArchiveInvalidIndex) {
+      auto pos = path.find('/');
+      auto component = path.substr(0, pos);
+
+      if (!component.empty()) {
+         index = findChild(index, component);
+      }
+
+      if (pos == std::string_view::npos) {
+         break;
+      }
+
+      path.remove_prefix(pos + 1);
+   }
+
+   return index;
+}
+
+
+bool
+Archive::readBlock(uint32_t index,
+                   uint32_t block,
+                   BlockCache &cache) const
+{
+   if (cache.entry == index && cache.block == block) {
+      return true;
+   }
+
+   auto &entry = mEntries[index];
+   auto blocks = reinterpret_cast<const uint64_t *>(mView + entry.offset);
+   auto blockStart = uint64_t { block } * mHeader->blockSize;
+   auto blockSize = std::min<uint64_t>(mHeader->blockSize, entry.size - blockStart);
+   auto storedSize = blocks[block + 1] - blocks[block];
+
+   cache.entry = ArchiveInvalidIndex;
+   cache.block = ArchiveInvalidIndex;
+   cache.data.resize(static_cast<size_t>(blockSize));
+
+   if (storedSize == blockSize) {
+      std::memcpy(cache.data.data(), mView + blocks[block], cache.data.size());
+   } else {
+      auto destLen = static_cast<uLongf>(blockSize);
+      auto result = uncompress(cache.data.data(), &destLen,
+                               mView + blocks[block],
+                               static_cast<uLong>(storedSize));
+
+      if (result != Z_OK || destLen != blockSize) {
+         gLog->error("Failed to decompress archive entry {} block {}, zlib error {}",
+                     name(index), block, result);
+         return false;
+      }
+   }
+
+   cache.entry = index;
+   cache.block = block;
+   return true;
+}
+
+
+size_t
+Archive::read(uint32_t index,
+              size_t position,
+              void *data,
+              size_t size,
+              BlockCache &cache) const
+{
+   auto &entry = mEntries[index];
+   decaf_check(!(entry.flags & ArchiveEntryFolder));
+
+   if (position >= entry.size) {
+      return 0;
+   }
+
+   size = static_cast<size_t>(std::min<uint64_t>(size, entry.size - position));
+
+   if (!(entry.flags & ArchiveEntryCompressed)) {
+      std::memcpy(data, mView + entry.offset + position, size);
+      return size;
+   }
+
+   auto dst = reinterpret_cast<uint8_t *>(data);
+   auto bytesRead = size_t { 0 };
+
+   while (bytesRead < size) {
+      auto block = static_cast<uint32_t>(position / mHeader->blockSize);
+      auto blockOffset = position % mHeader->blockSize;
+
+      if (!readBlock(index, block, cache)) {
+         break;
+      }
+
+      auto count = std::min(size - bytesRead, cache.data.size() - blockOffset);
+      std::memcpy(dst + bytesRead, cache.data.data() + blockOffset, count);
+      bytesRead += count;
+      position += count;
+   }
+
+   return bytesRead;
+}
+
+
+bool
+ArchiveFileHandle::open()
+{
+   return !!mArchive;
+}
+
+
+void
+ArchiveFileHandle::close()
+{
+   mArchive = nullptr;
+   mCache.data.clear();
+}
+
+
+bool
+ArchiveFileHandle::eof()
+{
+   decaf_check(mArchive);
+   return mEof;
+}
+
+
+bool
+ArchiveFileHandle::flush()
+{
+   decaf_check(mArchive);
+   return true;
+}
+
+
+bool
+ArchiveFileHandle::seek(size_t position)
+{
+   decaf_check(mArchive);
+   mPosition = position;
+   mEof = false;
+   return true;
+}
+
+
+size_t
+ArchiveFileHandle::size()
+{
+   decaf_check(mArchive);
+   return static_cast<size_t>(mArchive->entry(mIndex).size);
+}
+
+
+size_t
+ArchiveFileHandle::tell()
+{
+   decaf_check(mArchive);
+   return mPosition;
+}
+
+
+size_t
+ArchiveFileHandle::truncate()
+{
+   // Archives are read only
+   return 0;
+}
+
+
+size_t
+ArchiveFileHandle::read(void *data,
+                        size_t size,
+                        size_t count)
+{
+   return readAt(data, size, count, mPosition);
+}
+
+
+size_t
+ArchiveFileHandle::readAt(void *data,
+                          size_t size,
+                          size_t count,
+                          size_t position)
+{
+   decaf_check(mArchive);
+   auto bytes = size * count;
+
+   if (bytes == 0) {
+      return 0;
+   }
+
+   auto bytesRead = mArchive->read(mIndex, position, data, bytes, mCache);
+   mPosition = position + bytesRead;
+   mEof = (bytesRead < bytes);
+   return bytesRead / size;
+}
+
+
+size_t
+ArchiveFileHandle::write(const void *data,
+                         size_t size,
+                         size_t count)
+{
+   // Archives are read only
+   return 0;
+}
+
+} // namespace fs
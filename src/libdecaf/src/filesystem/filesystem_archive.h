@@ -0,0 +1,87 @@
+#pragma once
+#include "filesystem_archive_format.h"
+
+#include <common/platform_memory.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs
+{
+
+/**
+ * A read-only packed title archive, memory mapped from a single host file.
+ */
+class Archive
+{
+public:
+   //! Holds the most recently decompressed block of a compressed file.
+   struct BlockCache
+   {
+      uint32_t entry = ArchiveInvalidIndex;
+      uint32_t block = ArchiveInvalidIndex;
+      std::vector<uint8_t> data;
+   };
+
+public:
+   ~Archive();
+
+   static std::shared_ptr<Archive>
+   open(const std::string &path);
+
+   const ArchiveEntry &
+   entry(uint32_t index) const
+   {
+      return mEntries[index];
+   }
+
+   std::string_view
+   name(uint32_t index) const
+   {
+      auto &entry = mEntries[index];
+      return { mNames + entry.nameOffset, entry.nameLength };
+   }
+
+   bool
+   isFolder(uint32_t index) const
+   {
+      return !!(mEntries[index].flags & ArchiveEntryFolder);
+   }
+
+   uint32_t
+   findChild(uint32_t folder,
+             std::string_view name) const;
+
+   uint32_t
+   findPath(std::string_view path) const;
+
+   size_t
+   read(uint32_t index,
+        size_t position,
+        void *data,
+        size_t size,
+        BlockCache &cache) const;
+
+private:
+   Archive() = default;
+
+   bool
+   validate() const;
+
+   bool
+   readBlock(uint32_t index,
+             uint32_t block,
+             BlockCache &cache) const;
+
+private:
+   platform::MapFileHandle mFile = platform::InvalidMapFileHandle;
+   uint8_t *mView = nullptr;
+   size_t mSize = 0;
+   const ArchiveHeader *mHeader = nullptr;
+   const ArchiveEntry *mEntries = nullptr;
+   const char *mNames = nullptr;
+};
+
+} // namespace fs
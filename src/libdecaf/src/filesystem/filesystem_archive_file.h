@@ -0,0 +1,54 @@
+#pragma once
+#include "filesystem_archive.h"
+#include "filesystem_archive_filehandle.h"
+#include "filesystem_file.h"
+
+#include <memory>
+#include <string>
+
+namespace fs
+{
+
+class ArchiveFile : public File
+{
+public:
+   ArchiveFile(std::shared_ptr<Archive> archive,
+               uint32_t index,
+               const std::string &name,
+               Permissions permissions) :
+      File(DeviceType::ArchiveDevice, permissions, name),
+      mArchive(std::move(archive)),
+      mIndex(index)
+   {
+      setSize(static_cast<size_t>(mArchive->entry(index).size));
+   }
+
+   virtual ~ArchiveFile() override = default;
+
+   virtual FileHandle
+   open(OpenMode mode) override
+   {
+      if (!checkOpenPermissions(mode)) {
+         return nullptr;
+      }
+
+      if ((mode & File::Write) || (mode & File::Append)) {
+         return nullptr;
+      }
+
+      auto handle = new ArchiveFileHandle { mArchive, mIndex };
+
+      if (!handle->open()) {
+         delete handle;
+         return nullptr;
+      }
+
+      return FileHandle { handle };
+   }
+
+private:
+   std::shared_ptr<Archive> mArchive;
+   uint32_t mIndex;
+};
+
+} // namespace fs
@@ -0,0 +1,72 @@
+#pragma once
+#include "filesystem_archive.h"
+#include "filesystem_filehandle.h"
+
+#include <memory>
+
+namespace fs
+{
+
+struct ArchiveFileHandle : public IFileHandle
+{
+   ArchiveFileHandle(std::shared_ptr<Archive> archive,
+                     uint32_t index) :
+      mArchive(std::move(archive)),
+      mIndex(index)
+   {
+   }
+
+   virtual ~ArchiveFileHandle() override
+   {
+      close();
+   }
+
+   virtual bool
+   open() override;
+
+   virtual void
+   close() override;
+
+   virtual bool
+   eof() override;
+
+   virtual bool
+   flush() override;
+
+   virtual bool
+   seek(size_t position) override;
+
+   virtual size_t
+   size() override;
+
+   virtual size_t
+   tell() override;
+
+   virtual size_t
+   truncate() override;
+
+   virtual size_t
+   read(void *data,
+        size_t size,
+        size_t count) override;
+
+   virtual size_t
+   readAt(void *data,
+          size_t size,
+          size_t count,
+          size_t position) override;
+
+   virtual size_t
+   write(const void *data,
+         size_t size,
+         size_t count) override;
+
+private:
+   std::shared_ptr<Archive> mArchive;
+   uint32_t mIndex;
+   size_t mPosition = 0;
+   bool mEof = false;
+   Archive::BlockCache mCache;
+};
+
+} // namespace fs
@@ -0,0 +1,138 @@
+#pragma once
+#include "filesystem_archive.h"
+#include "filesystem_archive_file.h"
+#include "filesystem_archive_folderhandle.h"
+#include "filesystem_folder.h"
+#include "filesystem_virtual_folder.h"
+
+#include <memory>
+
+namespace fs
+{
+
+/**
+ * A read-only folder inside a packed title archive.
+ *
+ * Nodes for children are only created when they are first looked up and are
+ * then kept in mVirtual, the same as HostFolder does.
+ */
+class ArchiveFolder : public Folder
+{
+public:
+   ArchiveFolder(std::shared_ptr<Archive> archive,
+                 uint32_t index,
+                 const std::string &name,
+                 Permissions permissions) :
+      Folder(DeviceType::ArchiveDevice, permissions, name),
+      mArchive(std::move(archive)),
+      mIndex(index),
+      mVirtual(permissions, name)
+   {
+   }
+
+   virtual ~ArchiveFolder() override = default;
+
+   virtual Result<Folder *>
+   addFolder(const std::string &name) override
+   {
+      auto child = findChild(name);
+
+      if (child) {
+         if (child->type() != fs::Node::FolderNode) {
+            return { Error::AlreadyExists, nullptr };
+         }
+
+         return { Error::AlreadyExists, reinterpret_cast<Folder *>(child) };
+      }
+
+      return Error::InvalidPermission;
+   }
+
+   virtual Result<Error>
+   remove(const std::string &name) override
+   {
+      if (!findChild(name)) {
+         return Error::NotFound;
+      }
+
+      return Error::InvalidPermission;
+   }
+
+   virtual Node *
+   findChild(const std::string &name) override
+   {
+      if (auto child = mVirtual.findChild(name)) {
+         return child;
+      }
+
+      auto index = mArchive->findChild(mIndex, name);
+
+      if (index == ArchiveInvalidIndex) {
+         return nullptr;
+      }
+
+      if (mArchive->isFolder(index)) {
+         return mVirtual.addChild(new ArchiveFolder { mArchive, index, name, mPermissions });
+      } else {
+         return mVirtual.addChild(new ArchiveFile { mArchive, index, name, mPermissions });
+      }
+   }
+
+   virtual Result<FileHandle>
+   openFile(const std::string &name,
+            File::OpenMode mode) override
+   {
+      if ((mode & File::Write) || (mode & File::Append)) {
+         return Error::InvalidPermission;
+      }
+
+      if (!checkPermission(Permissions::Read)) {
+         return Error::InvalidPermission;
+      }
+
+      auto child = findChild(name);
+
+      if (!child) {
+         return Error::NotFound;
+      }
+
+      if (child->type() != NodeType::FileNode) {
+         return Error::NotFile;
+      }
+
+      return reinterpret_cast<File *>(child)->open(mode);
+   }
+
+   virtual Result<FolderHandle>
+   openDirectory() override
+   {
+      if (!checkPermission(Permissions::Read)) {
+         return Error::InvalidPermission;
+      }
+
+      auto handle = new ArchiveFolderHandle { mArchive, mIndex };
+
+      if (!handle->open()) {
+         delete handle;
+         return Error::UnsupportedOperation;
+      }
+
+      return FolderHandle { handle };
+   }
+
+   virtual void
+   setPermissions(Permissions permissions,
+                  PermissionFlags flags) override
+   {
+      // Archives are never writable
+      mPermissions = static_cast<Permissions>(permissions & Permissions::Read);
+      mVirtual.setPermissions(mPermissions, flags);
+   }
+
+private:
+   std::shared_ptr<Archive> mArchive;
+   uint32_t mIndex;
+   VirtualFolder mVirtual;
+};
+
+} // namespace fs
@@ -0,0 +1,72 @@
+#pragma once
+#include "filesystem_archive.h"
+#include "filesystem_folderhandle.h"
+
+#include <memory>
+
+namespace fs
+{
+
+struct ArchiveFolderHandle : public IFolderHandle
+{
+public:
+   ArchiveFolderHandle(std::shared_ptr<Archive> archive,
+                       uint32_t index) :
+      mArchive(std::move(archive)),
+      mIndex(index)
+   {
+   }
+
+   virtual ~ArchiveFolderHandle() override = default;
+
+   virtual bool
+   open() override
+   {
+      mPosition = 0;
+      return mArchive->isFolder(mIndex);
+   }
+
+   virtual void
+   close() override
+   {
+      mPosition = mArchive->entry(mIndex).numChildren;
+   }
+
+   virtual bool
+   read(FolderEntry &entry) override
+   {
+      auto &folder = mArchive->entry(mIndex);
+
+      if (mPosition >= folder.numChildren) {
+         return false;
+      }
+
+      auto child = folder.firstChild + mPosition;
+      entry.name = std::string { mArchive->name(child) };
+
+      if (mArchive->isFolder(child)) {
+         entry.type = FolderEntry::Folder;
+         entry.size = 0;
+      } else {
+         entry.type = FolderEntry::File;
+         entry.size = static_cast<size_t>(mArchive->entry(child).size);
+      }
+
+      mPosition++;
+      return true;
+   }
+
+   virtual bool
+   rewind() override
+   {
+      mPosition = 0;
+      return true;
+   }
+
+private:
+   std::shared_ptr<Archive> mArchive;
+   uint32_t mIndex;
+   uint32_t mPosition = 0;
+};
+
+} // namespace fs
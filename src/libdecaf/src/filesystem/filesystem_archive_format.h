@@ -0,0 +1,69 @@
+#pragma once
+#include <common/structsize.h>
+#include <cstdint>
+
+namespace fs
+{
+
+/*
+ * Layout of a packed title archive.
+ *
+ * All fields are stored little endian. The file starts with an ArchiveHeader,
+ * followed by the entry table, the name table and then the file data. Every
+ * file's data starts on an ArchiveDataAlignment boundary so it can be read
+ * straight out of a memory mapping.
+ *
+ * Entry 0 is the root folder. The children of a folder are stored
+ * contiguously and sorted by name so a lookup is a binary search.
+ *
+ * A compressed file is split into blockSize chunks which are zlib compressed
+ * individually, its offset points to a table of numBlocks + 1 absolute
+ * offsets. A block whose stored size equals its uncompressed size is stored
+ * uncompressed.
+ */
+
+static constexpr uint32_t ArchiveMagic = 0x52415444; // "DTAR"
+static constexpr uint32_t ArchiveVersion = 1;
+static constexpr uint32_t ArchiveDataAlignment = 4096;
+static constexpr uint32_t ArchiveInvalidIndex = 0xFFFFFFFF;
+
+struct ArchiveHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t numEntries;
+   uint32_t blockSize;
+   uint64_t entriesOffset;
+   uint64_t namesOffset;
+   uint64_t namesSize;
+};
+CHECK_SIZE(ArchiveHeader, 0x28);
+
+enum ArchiveEntryFlags : uint32_t
+{
+   ArchiveEntryFolder      = 1 << 0,
+   ArchiveEntryCompressed  = 1 << 1,
+};
+
+struct ArchiveEntry
+{
+   uint32_t nameOffset;
+   uint32_t nameLength;
+   uint32_t flags;
+
+   //! Folders only: index of the first child entry and the number of children.
+   uint32_t firstChild;
+   uint32_t numChildren;
+
+   //! Compressed files only: number of compressed blocks.
+   uint32_t numBlocks;
+
+   //! Uncompressed size of the file.
+   uint64_t size;
+
+   //! Offset of the file data, or of the block table for compressed files.
+   uint64_t offset;
+};
+CHECK_SIZE(ArchiveEntry, 0x28);
+
+} // namespace fs
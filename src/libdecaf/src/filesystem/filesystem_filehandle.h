@@ -40,6 +40,25 @@ public:
         size_t size,
         size_t count) = 0;
 
+   /**
+    * Read from an absolute position in the file.
+    *
+    * Leaves the file position at the end of the read data, the same as a
+    * seek followed by a read, which is what the default implementation does.
+    */
+   virtual size_t
+   readAt(void *data,
+          size_t size,
+          size_t count,
+          size_t position)
+   {
+      if (!seek(position)) {
+         return 0;
+      }
+
+      return read(data, size, count);
+   }
+
    virtual size_t
    write(const void *data,
          size_t size,
@@ -1,6 +1,8 @@
 #pragma once
 #include "filesystem_file.h"
 #include "filesystem_filehandle.h"
+
+#include <common/platform.h>
 #include <cstdio>
 
 namespace fs
@@ -44,13 +46,29 @@ struct HostFileHandle : public IFileHandle
         size_t size,
         size_t count) override;
 
+#ifdef PLATFORM_POSIX
+   virtual size_t
+   readAt(void *data,
+          size_t size,
+          size_t count,
+          size_t position) override;
+#endif
+
    virtual size_t
    write(const void *data,
          size_t size,
          size_t count) override;
 
 private:
+#ifdef PLATFORM_POSIX
+   //! We use an unbuffered file descriptor with pread / pwrite so reads go
+   //! straight from the page cache into the caller's buffer.
+   int mHandle = -1;
+   size_t mPosition = 0;
+   bool mEof = false;
+#else
    FILE *mHandle = nullptr;
+#endif
    File::OpenMode mMode;
 };
 
@@ -21,6 +21,7 @@ public:
       VirtualDevice,
       HostDevice,
       LinkDevice,
+      ArchiveDevice,
    };
 
    Node(NodeType type,
@@ -3,123 +3,136 @@
 
 #ifdef PLATFORM_POSIX
 #include <common/decaf_assert.h>
-#include <cstdio>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
 #include <string>
+#include <sys/stat.h>
 #include <unistd.h>
 
 namespace fs
 {
 
-static std::string
+/**
+ * Reads at least this size are followed by a readahead hint for the next
+ * window of the same size, games tend to stream large files sequentially.
+ */
+static constexpr size_t ReadAheadThreshold = 256 * 1024;
+
+/**
+ * Translate to open flags, matching what fopen would do with the mode string
+ * we used to generate: the first of r, w, a decides the access mode.
+ */
+static int
 translateMode(File::OpenMode mode)
 {
-   std::string out;
+   auto update = !!(mode & File::Update);
 
    if (mode & File::Read) {
-      out.push_back('r');
+      return update ? O_RDWR : O_RDONLY;
    }
 
    if (mode & File::Write) {
-      out.push_back('w');
+      return (update ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
    }
 
    if (mode & File::Append) {
-      out.push_back('a');
+      return (update ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
    }
 
-   out.push_back('b');
-
-   if (mode & File::Update) {
-      out.push_back('+');
-   }
-
-   return out;
+   return O_RDONLY;
 }
 
 
 HostFileHandle::HostFileHandle(const std::string &path, File::OpenMode mode) :
    mMode(mode)
 {
-   auto hostMode = translateMode(mode);
-   mHandle = fopen(path.c_str(), hostMode.c_str());
+   auto flags = translateMode(mode);
+   mHandle = ::open(path.c_str(), flags | O_CLOEXEC, 0666);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+   if (mHandle != -1 && (flags & O_ACCMODE) == O_RDONLY) {
+      posix_fadvise(mHandle, 0, 0, POSIX_FADV_SEQUENTIAL);
+   }
+#endif
 }
 
 
 bool
 HostFileHandle::open()
 {
-   return !!mHandle;
+   return mHandle != -1;
 }
 
 
 void
 HostFileHandle::close()
 {
-   if (mHandle) {
-      fclose(mHandle);
+   if (mHandle != -1) {
+      ::close(mHandle);
    }
 
-   mHandle = nullptr;
+   mHandle = -1;
 }
 
 
 bool
 HostFileHandle::eof()
 {
-   decaf_check(mHandle);
-   return !!feof(mHandle);
+   decaf_check(mHandle != -1);
+   return mEof;
 }
 
 
 bool
 HostFileHandle::flush()
 {
-   decaf_check(mHandle);
-   return !!fflush(mHandle);
+   // We do no buffering of our own so there is nothing to flush.
+   decaf_check(mHandle != -1);
+   return true;
 }
 
 
 bool
 HostFileHandle::seek(size_t position)
 {
-   decaf_check(mHandle);
-   return fseeko(mHandle, position, SEEK_SET) == 0;
+   decaf_check(mHandle != -1);
+   mPosition = position;
+   mEof = false;
+   return true;
 }
 
 
 size_t
 HostFileHandle::tell()
 {
-   decaf_check(mHandle);
-   auto pos = ftello(mHandle);
-
-   decaf_check(pos >= 0)
-   return static_cast<size_t>(pos);
+   decaf_check(mHandle != -1);
+   return mPosition;
 }
 
 
 size_t
 HostFileHandle::size()
 {
-   decaf_check(mHandle);
-   auto pos = tell();
+   decaf_check(mHandle != -1);
+   struct stat st;
 
-   fseeko(mHandle, 0, SEEK_END);
-   auto length = tell();
+   if (fstat(mHandle, &st) != 0) {
+      return 0;
+   }
 
-   seek(pos);
-   return length;
+   return static_cast<size_t>(st.st_size);
 }
 
 
 size_t
 HostFileHandle::truncate()
 {
-   decaf_check(mHandle);
+   decaf_check(mHandle != -1);
    decaf_check((mMode & File::Write) || (mMode & File::Update));
    auto length = size();
 
-   if (ftruncate(fileno(mHandle), static_cast<off_t>(length))) {
+   if (ftruncate(mHandle, static_cast<off_t>(length))) {
       return 0;
    }
 
@@ -132,9 +145,54 @@ HostFileHandle::read(void *data,
                      size_t size,
                      size_t count)
 {
-   decaf_check(mHandle);
+   return readAt(data, size, count, mPosition);
+}
+
+
+size_t
+HostFileHandle::readAt(void *data,
+                       size_t size,
+                       size_t count,
+                       size_t position)
+{
+   decaf_check(mHandle != -1);
    decaf_check((mMode & File::Read) || (mMode & File::Update));
-   return fread(data, size, count, mHandle);
+   auto bytes = size * count;
+   auto total = size_t { 0 };
+
+   if (bytes == 0) {
+      return 0;
+   }
+
+   while (total < bytes) {
+      auto result = pread(mHandle,
+                          static_cast<uint8_t *>(data) + total,
+                          bytes - total,
+                          static_cast<off_t>(position + total));
+
+      if (result < 0 && errno == EINTR) {
+         continue;
+      } else if (result <= 0) {
+         break;
+      }
+
+      total += static_cast<size_t>(result);
+   }
+
+   // Like fread, a partial element still advances the file position
+   mPosition = position + total;
+   mEof = (total < bytes);
+
+#ifdef POSIX_FADV_WILLNEED
+   if (!mEof && bytes >= ReadAheadThreshold) {
+      posix_fadvise(mHandle,
+                    static_cast<off_t>(mPosition),
+                    static_cast<off_t>(bytes),
+                    POSIX_FADV_WILLNEED);
+   }
+#endif
+
+   return total / size;
 }
 
 
@@ -143,9 +201,39 @@ HostFileHandle::write(const void *data,
                       size_t size,
                       size_t count)
 {
-   decaf_check(mHandle);
+   decaf_check(mHandle != -1);
    decaf_check((mMode & File::Write) || (mMode & File::Update));
-   return fwrite(data, size, count, mHandle);
+   auto bytes = size * count;
+   auto total = size_t { 0 };
+
+   while (total < bytes) {
+      auto ptr = static_cast<const uint8_t *>(data) + total;
+      auto result = ssize_t { 0 };
+
+      if (mMode & File::Append) {
+         // pwrite ignores the offset for O_APPEND on Linux, so be explicit
+         result = ::write(mHandle, ptr, bytes - total);
+      } else {
+         result = pwrite(mHandle, ptr, bytes - total,
+                         static_cast<off_t>(mPosition + total));
+      }
+
+      if (result < 0 && errno == EINTR) {
+         continue;
+      } else if (result <= 0) {
+         break;
+      }
+
+      total += static_cast<size_t>(result);
+   }
+
+   if (mMode & File::Append) {
+      mPosition = this->size();
+   } else {
+      mPosition += total;
+   }
+
+   return size ? total / size : 0;
 }
 
 } // namespace fs
@@ -1,5 +1,6 @@
 #include "decaf.h"
 #include "input.h"
+#include "replay/replay.h"
 
 namespace input
 {
@@ -7,76 +8,99 @@ namespace input
 vpad::Type
 getControllerType(vpad::Channel channel)
 {
-   return decaf::getInputDriver()->getControllerType(channel);
+   auto value = decaf::getInputDriver()->getControllerType(channel);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 ButtonStatus
 getButtonStatus(vpad::Channel channel,
                 vpad::Core button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   auto value = decaf::getInputDriver()->getButtonStatus(channel, button);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 float
 getAxisValue(vpad::Channel channel,
              vpad::CoreAxis axis)
 {
-   return decaf::getInputDriver()->getAxisValue(channel, axis);
+   auto value = decaf::getInputDriver()->getAxisValue(channel, axis);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 bool
 getTouchPosition(input::vpad::Channel channel,
                  input::vpad::TouchPosition &position)
 {
-   return decaf::getInputDriver()->getTouchPosition(channel, position);
+   auto touched = decaf::getInputDriver()->getTouchPosition(channel, position);
+   replay::syncValue(replay::EventType::Input, touched);
+   replay::syncValue(replay::EventType::Input, position);
+   return touched;
 }
 
 wpad::Type
 getControllerType(wpad::Channel channel)
 {
-   return decaf::getInputDriver()->getControllerType(channel);
+   auto value = decaf::getInputDriver()->getControllerType(channel);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Core button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   auto value = decaf::getInputDriver()->getButtonStatus(channel, button);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Nunchuck button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   auto value = decaf::getInputDriver()->getButtonStatus(channel, button);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Classic button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   auto value = decaf::getInputDriver()->getButtonStatus(channel, button);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Pro button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   auto value = decaf::getInputDriver()->getButtonStatus(channel, button);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 float
 getAxisValue(wpad::Channel channel,
              wpad::NunchuckAxis axis)
 {
-   return decaf::getInputDriver()->getAxisValue(channel, axis);
+   auto value = decaf::getInputDriver()->getAxisValue(channel, axis);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 float
 getAxisValue(wpad::Channel channel,
              wpad::ProAxis axis)
 {
-   return decaf::getInputDriver()->getAxisValue(channel, axis);
+   auto value = decaf::getInputDriver()->getAxisValue(channel, axis);
+   replay::syncValue(replay::EventType::Input, value);
+   return value;
 }
 
 } // namespace input
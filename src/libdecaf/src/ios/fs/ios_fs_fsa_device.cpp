@@ -1,5 +1,6 @@
 #include "ios_fs_fsa_device.h"
 #include "ios/ios.h"
+#include "replay/replay.h"
 
 #include <common/strutils.h>
 
@@ -457,12 +458,30 @@ FSADevice::readFile(phys_ptr<FSARequestReadFile> request,
       return error;
    }
 
+   auto elemsRead = size_t { 0 };
+   auto readPos = size_t { 0 };
+
    if (request->readFlags & FSAReadFlag::ReadWithPos) {
-      file->seek(request->pos);
+      readPos = request->pos;
+      elemsRead = file->readAt(buffer.getRawPointer(), request->size, request->count, request->pos);
+   } else {
+      readPos = file->tell();
+      elemsRead = file->read(buffer.getRawPointer(), request->size, request->count);
+   }
+
+   auto bytesRead = static_cast<uint32_t>(elemsRead * request->size);
+
+   if (replay::getMode() != replay::Mode::Disabled) {
+      replay::syncData(replay::EventType::FsRead, buffer.getRawPointer(),
+                       bytesRead, bufferLen);
+
+      // The live read moved the file position by the live number of bytes,
+      // move it to where the recorded read would have left it.
+      if (replay::getMode() == replay::Mode::Playback) {
+         file->seek(readPos + bytesRead);
+      }
    }
 
-   auto elemsRead = file->read(buffer.getRawPointer(), request->size, request->count);
-   auto bytesRead = elemsRead * request->size;
    return static_cast<FSAStatus>(bytesRead);
 }
 
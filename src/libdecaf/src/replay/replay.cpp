@@ -0,0 +1,358 @@
+#include "replay.h"
+#include "decaf_config.h"
+#include "libcpu/cpu.h"
+#include "libcpu/state.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <common/log.h>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace replay
+{
+
+static constexpr uint32_t ReplayMagic = 0x59504C52; // "RLPY"
+static constexpr uint32_t ReplayVersion = 1;
+
+//! Events from each core are kept separate, the last stream is for events
+//! observed on host threads such as the IOS worker threads.
+static constexpr auto NumStreams = 4u;
+static constexpr auto HostStream = NumStreams - 1;
+
+//! Size of buffered records before they are written to file.
+static constexpr auto RecordFlushSize = 1u * 1024 * 1024;
+
+#pragma pack(push, 1)
+struct EventHeader
+{
+   uint8_t type;
+   uint8_t stream;
+   uint16_t reserved;
+   uint32_t size;
+};
+#pragma pack(pop)
+
+struct EventQueue
+{
+   //! Recorded events, each is a uint32_t size followed by its data.
+   std::vector<uint8_t> data;
+
+   //! Read position in data of the next event.
+   size_t readPos = 0;
+
+   //! Number of events played back from this queue.
+   uint64_t numEvents = 0;
+};
+
+static Mode
+sMode = Mode::Disabled;
+
+static std::mutex
+sMutex;
+
+static std::ofstream
+sRecordFile;
+
+static std::vector<uint8_t>
+sRecordBuffer;
+
+static std::array<std::array<EventQueue, NumStreams>, static_cast<size_t>(EventType::Max)>
+sEventQueues;
+
+static std::atomic<bool>
+sDiverged { false };
+
+static std::array<uint64_t, NumStreams>
+sLastTimeBase;
+
+static const char *
+getEventTypeName(EventType type)
+{
+   switch (type) {
+   case EventType::TimeBase:
+      return "TimeBase";
+   case EventType::Interrupt:
+      return "Interrupt";
+   case EventType::IpcReply:
+      return "IpcReply";
+   case EventType::FsRead:
+      return "FsRead";
+   case EventType::Input:
+      return "Input";
+   default:
+      return "Unknown";
+   }
+}
+
+static uint32_t
+getCurrentStream()
+{
+   if (auto core = cpu::this_core::state()) {
+      return core->id;
+   }
+
+   return HostStream;
+}
+
+static void
+flushRecordBuffer()
+{
+   if (!sRecordBuffer.empty()) {
+      sRecordFile.write(reinterpret_cast<const char *>(sRecordBuffer.data()),
+                        sRecordBuffer.size());
+      sRecordBuffer.clear();
+   }
+}
+
+static void
+recordEvent(EventType type,
+            uint32_t stream,
+            const void *data,
+            uint32_t size)
+{
+   auto header = EventHeader { };
+   header.type = static_cast<uint8_t>(type);
+   header.stream = static_cast<uint8_t>(stream);
+   header.size = size;
+
+   std::unique_lock<std::mutex> lock { sMutex };
+   auto offset = sRecordBuffer.size();
+   sRecordBuffer.resize(offset + sizeof(EventHeader) + size);
+   std::memcpy(sRecordBuffer.data() + offset, &header, sizeof(EventHeader));
+   std::memcpy(sRecordBuffer.data() + offset + sizeof(EventHeader), data, size);
+
+   if (sRecordBuffer.size() >= RecordFlushSize) {
+      flushRecordBuffer();
+   }
+}
+
+static void
+diverge(EventType type,
+        uint32_t stream,
+        uint64_t index,
+        const char *reason)
+{
+   if (!sDiverged.exchange(true)) {
+      gLog->warn("Replay diverged at {} event {} on stream {}: {}",
+                 getEventTypeName(type), index, stream, reason);
+   }
+}
+
+/**
+ * Pop the next event from a playback queue.
+ *
+ * Must be called with sMutex held.
+ */
+static const uint8_t *
+popEvent(EventType type,
+         uint32_t stream,
+         uint32_t &size)
+{
+   auto &queue = sEventQueues[static_cast<size_t>(type)][stream];
+
+   if (queue.readPos + sizeof(uint32_t) > queue.data.size()) {
+      diverge(type, stream, queue.numEvents, "no more recorded events");
+      return nullptr;
+   }
+
+   std::memcpy(&size, queue.data.data() + queue.readPos, sizeof(uint32_t));
+   auto data = queue.data.data() + queue.readPos + sizeof(uint32_t);
+   queue.readPos += sizeof(uint32_t) + size;
+   queue.numEvents++;
+   return data;
+}
+
+static uint64_t
+timeBaseHandler(cpu::Core *core,
+                uint64_t tb)
+{
+   syncValue(EventType::TimeBase, tb);
+
+   // Never let guest time run backwards when playback falls back to host time
+   auto &last = sLastTimeBase[core->id];
+   tb = std::max(tb, last);
+   last = tb;
+   return tb;
+}
+
+static bool
+loadPlayback(const std::string &path)
+{
+   auto file = std::ifstream { path, std::ifstream::in | std::ifstream::binary };
+   if (!file.is_open()) {
+      gLog->error("Could not open replay {}", path);
+      return false;
+   }
+
+   uint32_t magic, version;
+   file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+   file.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+   if (!file || magic != ReplayMagic || version != ReplayVersion) {
+      gLog->error("Invalid replay file {}", path);
+      return false;
+   }
+
+   auto header = EventHeader { };
+   auto numEvents = uint64_t { 0 };
+
+   while (file.read(reinterpret_cast<char *>(&header), sizeof(EventHeader))) {
+      if (header.type >= static_cast<uint8_t>(EventType::Max) ||
+          header.stream >= NumStreams) {
+         gLog->error("Invalid event in replay file {}", path);
+         return false;
+      }
+
+      auto &queue = sEventQueues[header.type][header.stream];
+      auto offset = queue.data.size();
+      queue.data.resize(offset + sizeof(uint32_t) + header.size);
+      std::memcpy(queue.data.data() + offset, &header.size, sizeof(uint32_t));
+      file.read(reinterpret_cast<char *>(queue.data.data() + offset + sizeof(uint32_t)),
+                header.size);
+
+      if (!file) {
+         gLog->error("Truncated event in replay file {}", path);
+         return false;
+      }
+
+      ++numEvents;
+   }
+
+   gLog->info("Loaded {} events from replay {}", numEvents, path);
+   return true;
+}
+
+bool
+initialise()
+{
+   auto &playbackPath = decaf::config::replay::playback_path;
+   auto &recordPath = decaf::config::replay::record_path;
+   sDiverged = false;
+
+   if (!playbackPath.empty()) {
+      if (!loadPlayback(playbackPath)) {
+         return false;
+      }
+
+      sMode = Mode::Playback;
+   } else if (!recordPath.empty()) {
+      sRecordFile.open(recordPath, std::ofstream::out | std::ofstream::binary);
+      if (!sRecordFile.is_open()) {
+         gLog->error("Could not open replay {} for recording", recordPath);
+         return false;
+      }
+
+      sRecordFile.write(reinterpret_cast<const char *>(&ReplayMagic), sizeof(ReplayMagic));
+      sRecordFile.write(reinterpret_cast<const char *>(&ReplayVersion), sizeof(ReplayVersion));
+      sRecordBuffer.reserve(RecordFlushSize + 4096);
+      sMode = Mode::Record;
+   } else {
+      sMode = Mode::Disabled;
+      return true;
+   }
+
+   sLastTimeBase.fill(0);
+   cpu::setTimeBaseHandler(timeBaseHandler);
+   return true;
+}
+
+void
+shutdown()
+{
+   if (sMode == Mode::Disabled) {
+      return;
+   }
+
+   cpu::setTimeBaseHandler(nullptr);
+
+   if (sMode == Mode::Record) {
+      std::unique_lock<std::mutex> lock { sMutex };
+      flushRecordBuffer();
+      sRecordFile.close();
+   } else if (sMode == Mode::Playback && !sDiverged) {
+      gLog->info("Replay completed without divergence");
+   }
+
+   for (auto &queues : sEventQueues) {
+      for (auto &queue : queues) {
+         queue = EventQueue { };
+      }
+   }
+
+   sMode = Mode::Disabled;
+}
+
+Mode
+getMode()
+{
+   return sMode;
+}
+
+bool
+hasDiverged()
+{
+   return sDiverged;
+}
+
+void
+syncData(EventType type,
+         void *data,
+         uint32_t &size,
+         uint32_t capacity)
+{
+   auto stream = getCurrentStream();
+
+   if (sMode == Mode::Record) {
+      recordEvent(type, stream, data, size);
+   } else if (sMode == Mode::Playback) {
+      // Once diverged the recording is out of step, so keep the live value
+      if (sDiverged) {
+         return;
+      }
+
+      std::unique_lock<std::mutex> lock { sMutex };
+      auto recordedSize = uint32_t { 0 };
+      auto recorded = popEvent(type, stream, recordedSize);
+
+      if (!recorded) {
+         return;
+      }
+
+      if (recordedSize > capacity) {
+         auto &queue = sEventQueues[static_cast<size_t>(type)][stream];
+         diverge(type, stream, queue.numEvents - 1, "recorded data is too large");
+         return;
+      }
+
+      std::memcpy(data, recorded, recordedSize);
+      size = recordedSize;
+   }
+}
+
+void
+verifyData(EventType type,
+           const void *data,
+           uint32_t size)
+{
+   auto stream = getCurrentStream();
+
+   if (sMode == Mode::Record) {
+      recordEvent(type, stream, data, size);
+   } else if (sMode == Mode::Playback) {
+      std::unique_lock<std::mutex> lock { sMutex };
+      auto recordedSize = uint32_t { 0 };
+      auto recorded = popEvent(type, stream, recordedSize);
+
+      if (recorded &&
+          (recordedSize != size || std::memcmp(recorded, data, size) != 0)) {
+         auto &queue = sEventQueues[static_cast<size_t>(type)][stream];
+         diverge(type, stream, queue.numEvents - 1, "value does not match recording");
+      }
+   }
+}
+
+} // namespace replay
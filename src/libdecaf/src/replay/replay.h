@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Record and playback of the nondeterministic inputs to guest execution.
+ *
+ * Every input which crosses the HLE / IOS boundary from the host (time base
+ * reads, IPC replies, file reads and controller samples) is recorded in the
+ * order it was observed by each core. During playback the recorded value
+ * replaces the live one so the guest sees identical inputs.
+ *
+ * Interrupt delivery can not be forced to the same instruction, instead the
+ * order of delivered interrupts is recorded and verified during playback so
+ * a divergence is reported rather than silently producing a different run.
+ */
+namespace replay
+{
+
+enum class Mode
+{
+   Disabled,
+   Record,
+   Playback,
+};
+
+//! Each event type is recorded and played back in its own order per core.
+enum class EventType : uint8_t
+{
+   TimeBase,
+   Interrupt,
+   IpcReply,
+
+   //! File reads are performed on IOS threads, which all share the host
+   //! stream and are not ordered relative to the guest or each other. A
+   //! title with several file reads in flight at once may therefore be
+   //! given their recorded data in a different order than it was read.
+   FsRead,
+   Input,
+   Max,
+};
+
+bool
+initialise();
+
+void
+shutdown();
+
+Mode
+getMode();
+
+bool
+hasDiverged();
+
+/**
+ * When recording write the data to the replay, when playing back replace it
+ * with the recorded data.
+ *
+ * size is updated to the size of the recorded data, which must be no larger
+ * than capacity.
+ */
+void
+syncData(EventType type,
+         void *data,
+         uint32_t &size,
+         uint32_t capacity);
+
+/**
+ * When recording write the data to the replay, when playing back check that
+ * it matches the recorded data.
+ */
+void
+verifyData(EventType type,
+           const void *data,
+           uint32_t size);
+
+template<typename Type>
+inline void
+syncValue(EventType type,
+          Type &value)
+{
+   static_assert(std::is_trivially_copyable<Type>::value);
+
+   if (getMode() != Mode::Disabled) {
+      auto size = static_cast<uint32_t>(sizeof(Type));
+      syncData(type, &value, size, size);
+   }
+}
+
+template<typename Type>
+inline void
+verifyValue(EventType type,
+            const Type &value)
+{
+   static_assert(std::is_trivially_copyable<Type>::value);
+
+   if (getMode() != Mode::Disabled) {
+      verifyData(type, &value, static_cast<uint32_t>(sizeof(Type)));
+   }
+}
+
+} // namespace replay
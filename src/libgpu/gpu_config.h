@@ -17,6 +17,9 @@ extern std::vector<int64_t> debug_filters;
 //! Dump shaders
 extern bool dump_shaders;
 
+//! Parse command buffers on a separate thread from backend submission
+extern bool pipeline_pm4;
+
 } // namespace config
 
 } // namespace gpu
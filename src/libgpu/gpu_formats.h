@@ -0,0 +1,150 @@
+#pragma once
+#include "latte/latte_enum_sq.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Conversion kernels for Latte surface and vertex data formats, shared by all
+ * of the graphics backends.
+ *
+ * Every kernel has a scalar reference implementation, and the hot ones also
+ * have an AVX2 implementation which is selected at runtime when the host
+ * supports it. The two must always produce identical results.
+ *
+ * All element data is expected to be untiled and in host endian, unless
+ * otherwise stated. Block compressed formats are handled as opaque 4x4 blocks.
+ */
+
+namespace gpu
+{
+
+namespace formats
+{
+
+enum class Implementation
+{
+   Scalar,
+   AVX2,
+};
+
+struct FormatComponent
+{
+   //! Offset of the lowest bit of the component within the element.
+   uint32_t offset = 0;
+
+   //! Width of the component in bits, 0 if the component is not present.
+   uint32_t bits = 0;
+};
+
+/**
+ * The memory layout of a single element of a data format.
+ *
+ * Packed component orders match the packed types the OpenGL backend uploads
+ * with, e.g. FMT_5_6_5 has X in the most significant bits as in
+ * GL_UNSIGNED_SHORT_5_6_5, whereas FMT_1_5_5_5 has X in the least significant
+ * bits as in GL_UNSIGNED_SHORT_1_5_5_5_REV.
+ *
+ * For depth stencil formats X is depth and Y is stencil.
+ */
+struct FormatLayout
+{
+   //! Bits per element, for block compressed formats an element is a block.
+   uint32_t elementBits = 0;
+
+   //! Width and height in pixels covered by one element.
+   uint32_t blockSize = 1;
+
+   //! Number of components in use.
+   uint32_t numComponents = 0;
+
+   //! Components X, Y, Z, W, for block compressed formats these are the
+   //! 32 bit words of the block.
+   std::array<FormatComponent, 4> components;
+
+   //! Endian swap which converts an element between host and big endian.
+   latte::SQ_ENDIAN endianSwap = latte::SQ_ENDIAN::NONE;
+
+   bool isCompressed = false;
+   bool isDepthStencil = false;
+};
+
+bool
+getFormatLayout(latte::SQ_DATA_FORMAT format,
+                FormatLayout &layout);
+
+Implementation
+getImplementation();
+
+bool
+isImplementationSupported(Implementation implementation);
+
+//! Force an implementation, returns false if the host does not support it.
+bool
+setImplementation(Implementation implementation);
+
+//! Copy size bytes from src to dst applying an endian swap, src and dst may
+//! be the same. SQ_ENDIAN::AUTO must be resolved by the caller, for example
+//! from FormatLayout::endianSwap.
+bool
+endianSwap(void *dst,
+           const void *src,
+           size_t size,
+           latte::SQ_ENDIAN endian);
+
+//! Unpack each element into 4 uint32_t, one for each of X, Y, Z and W, with
+//! the raw bits of the component zero extended.
+bool
+unpack(latte::SQ_DATA_FORMAT format,
+       uint32_t *dst,
+       const void *src,
+       size_t numElements);
+
+//! The inverse of unpack, bits which do not belong to a component are written
+//! as zero.
+bool
+pack(latte::SQ_DATA_FORMAT format,
+     void *dst,
+     const uint32_t *src,
+     size_t numElements);
+
+//! Repack elements between two formats which have the same component widths,
+//! e.g. FMT_10_10_10_2 to FMT_2_10_10_10 or FMT_8_24 to FMT_24_8. src and dst
+//! may be the same.
+bool
+convert(latte::SQ_DATA_FORMAT dstFormat,
+        void *dst,
+        latte::SQ_DATA_FORMAT srcFormat,
+        const void *src,
+        size_t numElements);
+
+//! Expand an unsigned normalised format of at most 8 bits per component to
+//! R8G8B8A8 by bit replication, missing components are 0 and missing alpha is
+//! 255. This is for backends which lack an equivalent packed format.
+bool
+expandToRGBA8(latte::SQ_DATA_FORMAT format,
+              uint8_t *dst,
+              const void *src,
+              size_t numElements);
+
+//! Split a depth stencil format into separate depth and stencil planes, depth
+//! holds the raw depth bits, for FMT_X24_8_32_FLOAT these are float bits.
+bool
+splitDepthStencil(latte::SQ_DATA_FORMAT format,
+                  uint32_t *depth,
+                  uint8_t *stencil,
+                  const void *src,
+                  size_t numElements);
+
+//! The inverse of splitDepthStencil.
+bool
+mergeDepthStencil(latte::SQ_DATA_FORMAT format,
+                  void *dst,
+                  const uint32_t *depth,
+                  const uint8_t *stencil,
+                  size_t numElements);
+
+} // namespace formats
+
+} // namespace gpu
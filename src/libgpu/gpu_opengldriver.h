@@ -17,6 +17,20 @@ public:
       uint64_t numShaderPipelines = 0;
       uint64_t numSurfaces = 0;
       uint64_t numDataBuffers = 0;
+
+      //! Command buffer parsing runs on its own thread, when false the
+      //! parse times are included in the submit times.
+      bool pm4Pipelined = false;
+
+      //! Time spent in each PM4 stage during the last frame.
+      double pm4ParseMs = 0.0;
+      double pm4SubmitMs = 0.0;
+      double pm4ParseStallMs = 0.0;
+      double pm4SubmitStallMs = 0.0;
+
+      //! Command buffers parsed but not yet submitted.
+      uint64_t pm4QueueDepth = 0;
+      uint64_t pm4MaxQueueDepth = 0;
    };
 
    virtual ~OpenGLDriver() = default;
@@ -1,6 +1,8 @@
 #include "glsl2_alu.h"
+#include "glsl2_ir.h"
 #include "latte/latte_instructions.h"
 
+#include <cstdlib>
 #include <fmt/format.h>
 
 using namespace latte;
@@ -63,6 +65,58 @@ insertChannel(fmt::memory_buffer &out,
    }
 }
 
+void
+insertFloatConstant(fmt::memory_buffer &out,
+                    uint32_t bits)
+{
+   LiteralValue value;
+   value.asUint = bits;
+
+   auto exponent = (bits >> 23) & 0xFF;
+   auto mantissa = bits & 0x7FFFFF;
+
+   // NaN, infinity and denormals can not be written as a float literal
+   if (exponent == 0xFF || (exponent == 0 && mantissa != 0)) {
+      fmt::format_to(out, "uintBitsToFloat(0x{:08X}u)", bits);
+      return;
+   }
+
+   // Use the shortest representation which reads back as the same float
+   auto str = std::string { };
+
+   for (auto precision = 6; precision <= 9; ++precision) {
+      str = fmt::format("{:.{}g}", value.asFloat, precision);
+
+      if (std::strtof(str.c_str(), nullptr) == value.asFloat) {
+         break;
+      }
+   }
+
+   // GLSL float literals must have a decimal point or an exponent
+   if (str.find_first_of(".e") == std::string::npos) {
+      str += ".0";
+   }
+
+   fmt::format_to(out, "{}f", str);
+}
+
+static void
+insertConstantValue(fmt::memory_buffer &out,
+                    SQ_ALU_FLAGS flags,
+                    uint32_t bits)
+{
+   LiteralValue value;
+   value.asUint = bits;
+
+   if (flags & SQ_ALU_FLAG_INT_IN) {
+      fmt::format_to(out, "{}", value.asInt);
+   } else if (flags & SQ_ALU_FLAG_UINT_IN) {
+      fmt::format_to(out, "{}", value.asUint);
+   } else {
+      insertFloatConstant(out, bits);
+   }
+}
+
 void
 insertSource0(State &state,
               fmt::memory_buffer &out,
@@ -194,7 +248,7 @@ insertSource(State &state,
    auto didTypeConversion = false;
    auto needsChannelSelect = false;
    auto flags = SQ_ALU_FLAG_NONE;
-   LiteralValue value;
+   auto constantValue = uint32_t { 0 };
 
    if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
       flags = getInstructionFlags(inst.op2.ALU_INST());
@@ -202,6 +256,9 @@ insertSource(State &state,
       flags = getInstructionFlags(inst.op3.ALU_INST());
    }
 
+   // PV / PS values which were folded to a constant are substituted directly
+   auto isPreviousConstant = getPreviousConstant(state.aluPreviousGroup, sel, chan, constantValue);
+
    if (abs) {
       fmt::format_to(out, "abs(");
    }
@@ -227,7 +284,9 @@ insertSource(State &state,
       case SQ_ALU_SRC::PV:
       case SQ_ALU_SRC::PS:
          // PreviousVector, PreviousScalar
-         if (flags & SQ_ALU_FLAG_INT_IN) {
+         if (isPreviousConstant) {
+            break;
+         } else if (flags & SQ_ALU_FLAG_INT_IN) {
             fmt::format_to(out, "floatBitsToInt(");
             didTypeConversion = true;
          } else if (flags & SQ_ALU_FLAG_UINT_IN) {
@@ -340,11 +399,19 @@ insertSource(State &state,
    } else {
       switch (sel) {
       case SQ_ALU_SRC::PV:
-         fmt::format_to(out, "PV");
-         needsChannelSelect = true;
+         if (isPreviousConstant) {
+            insertConstantValue(out, flags, constantValue);
+         } else {
+            fmt::format_to(out, "PV");
+            needsChannelSelect = true;
+         }
          break;
       case SQ_ALU_SRC::PS:
-         fmt::format_to(out, "PS");
+         if (isPreviousConstant) {
+            insertConstantValue(out, flags, constantValue);
+         } else {
+            fmt::format_to(out, "PS");
+         }
          break;
       case SQ_ALU_SRC::IMM_0:
          fmt::format_to(out, "0.0f");
@@ -362,15 +429,7 @@ insertSource(State &state,
          fmt::format_to(out, "-1");
          break;
       case SQ_ALU_SRC::LITERAL:
-         value.asUint = state.literals[chan];
-
-         if (flags & SQ_ALU_FLAG_INT_IN) {
-            fmt::format_to(out, "{}", value.asInt);
-         } else if (flags & SQ_ALU_FLAG_UINT_IN) {
-            fmt::format_to(out, "{}", value.asUint);
-         } else {
-            fmt::format_to(out, "{:.6f}f", value.asFloat);
-         }
+         insertConstantValue(out, flags, state.literals[chan]);
          break;
       case SQ_ALU_SRC::IMM_1_DBL_L:
       case SQ_ALU_SRC::IMM_1_DBL_M:
@@ -454,26 +513,22 @@ insertPreviousValueUpdate(fmt::memory_buffer &out,
    }
 }
 
-void
-insertDestBegin(State &state,
-                const ControlFlowInst &cf,
-                const AluInst &inst,
-                SQ_CHAN unit)
+static void
+insertDestAssignment(State &state,
+                     const AluInst &inst,
+                     SQ_CHAN unit,
+                     bool writeMask)
 {
-   auto flags = SQ_ALU_FLAG_NONE;
-   auto omod = SQ_ALU_OMOD::OFF;
-   auto writeMask = true;
+   if (state.aluNode && state.aluNode->writeGprDirectly) {
+      // Nothing reads PVo / PSo, so skip it and write the GPR directly
+      fmt::format_to(state.out, "R[{}].", inst.word1.DST_GPR());
+      insertChannel(state.out, inst.word1.DST_CHAN());
+      fmt::format_to(state.out, " = ");
+      return;
+   }
 
    insertPreviousValueUpdate(state.out, unit);
 
-   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
-      writeMask = inst.op2.WRITE_MASK();
-      omod = inst.op2.OMOD();
-      flags = getInstructionFlags(inst.op2.ALU_INST());
-   } else {
-      flags = getInstructionFlags(inst.op3.ALU_INST());
-   }
-
    if (writeMask) {
       fmt::memory_buffer postWrite;
 
@@ -505,6 +560,27 @@ insertDestBegin(State &state,
 
       state.postGroupWrites.push_back(to_string(postWrite));
    }
+}
+
+void
+insertDestBegin(State &state,
+                const ControlFlowInst &cf,
+                const AluInst &inst,
+                SQ_CHAN unit)
+{
+   auto flags = SQ_ALU_FLAG_NONE;
+   auto omod = SQ_ALU_OMOD::OFF;
+   auto writeMask = true;
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      writeMask = inst.op2.WRITE_MASK();
+      omod = inst.op2.OMOD();
+      flags = getInstructionFlags(inst.op2.ALU_INST());
+   } else {
+      flags = getInstructionFlags(inst.op3.ALU_INST());
+   }
+
+   insertDestAssignment(state, inst, unit, writeMask);
 
    if (flags & SQ_ALU_FLAG_INT_OUT) {
       fmt::format_to(state.out, "intBitsToFloat(");
@@ -561,6 +637,24 @@ insertDestEnd(State &state,
    }
 }
 
+void
+insertConstantResult(State &state,
+                     const AluInst &inst,
+                     uint32_t value)
+{
+   auto writeMask = true;
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      writeMask = inst.op2.WRITE_MASK();
+   }
+
+   insertLineStart(state);
+   insertDestAssignment(state, inst, state.unit, writeMask);
+   insertFloatConstant(state.out, value);
+   fmt::format_to(state.out, ";");
+   insertLineEnd(state);
+}
+
 void
 updatePredicate(State &state, const ControlFlowInst &cf, const AluInst &inst, const std::string &condition)
 {
@@ -12,6 +12,10 @@ void
 insertChannel(fmt::memory_buffer &out,
               latte::SQ_CHAN channel);
 
+void
+insertFloatConstant(fmt::memory_buffer &out,
+                    uint32_t bits);
+
 void
 insertSource0(State &state,
               fmt::memory_buffer &out,
@@ -82,6 +86,11 @@ insertDestEnd(State &state,
               const latte::ControlFlowInst &cf,
               const latte::AluInst &inst);
 
+void
+insertConstantResult(State &state,
+                     const latte::AluInst &inst,
+                     uint32_t value);
+
 void
 updatePredicate(State &state,
                 const latte::ControlFlowInst &cf,
@@ -0,0 +1,501 @@
+#include "glsl2_ir.h"
+#include "glsl2_translate.h"
+#include "latte/latte_decoders.h"
+
+#include <bitset>
+#include <cmath>
+#include <common/bit_cast.h>
+
+using namespace latte;
+
+namespace glsl2
+{
+
+struct AluSource
+{
+   SQ_ALU_SRC sel;
+   SQ_REL rel;
+   SQ_CHAN chan;
+   bool abs;
+   bool neg;
+};
+
+static unsigned
+getSources(const AluInst &inst,
+           std::array<AluSource, 3> &sources)
+{
+   auto numSrcs = 0u;
+   auto abs0 = false;
+   auto abs1 = false;
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      numSrcs = getInstructionNumSrcs(inst.op2.ALU_INST());
+      abs0 = inst.op2.SRC0_ABS();
+      abs1 = inst.op2.SRC1_ABS();
+   } else {
+      numSrcs = getInstructionNumSrcs(inst.op3.ALU_INST());
+   }
+
+   sources[0] = { inst.word0.SRC0_SEL(), inst.word0.SRC0_REL(), inst.word0.SRC0_CHAN(), abs0, inst.word0.SRC0_NEG() };
+   sources[1] = { inst.word0.SRC1_SEL(), inst.word0.SRC1_REL(), inst.word0.SRC1_CHAN(), abs1, inst.word0.SRC1_NEG() };
+
+   if (numSrcs > 2) {
+      sources[2] = { inst.op3.SRC2_SEL(), inst.op3.SRC2_REL(), inst.op3.SRC2_CHAN(), false, inst.op3.SRC2_NEG() };
+   }
+
+   return std::min(numSrcs, 3u);
+}
+
+static bool
+hasSideEffects(const AluInst &inst,
+               SQ_ALU_FLAGS flags)
+{
+   if (flags & SQ_ALU_FLAG_PRED_SET) {
+      return true;
+   }
+
+   if (inst.word1.ENCODING() != SQ_ALU_ENCODING::OP2) {
+      return false;
+   }
+
+   if (inst.op2.UPDATE_EXECUTE_MASK() || inst.op2.UPDATE_PRED()) {
+      return true;
+   }
+
+   switch (inst.op2.ALU_INST()) {
+   case SQ_OP2_INST_KILLE:
+   case SQ_OP2_INST_KILLE_INT:
+   case SQ_OP2_INST_KILLGE:
+   case SQ_OP2_INST_KILLGE_INT:
+   case SQ_OP2_INST_KILLGE_UINT:
+   case SQ_OP2_INST_KILLGT:
+   case SQ_OP2_INST_KILLGT_INT:
+   case SQ_OP2_INST_KILLGT_UINT:
+   case SQ_OP2_INST_KILLNE:
+   case SQ_OP2_INST_KILLNE_INT:
+   case SQ_OP2_INST_MOVA:
+   case SQ_OP2_INST_MOVA_FLOOR:
+   case SQ_OP2_INST_MOVA_INT:
+   case SQ_OP2_INST_MOVA_GPR_INT:
+   case SQ_OP2_INST_SET_CF_IDX0:
+   case SQ_OP2_INST_SET_CF_IDX1:
+      return true;
+   default:
+      return false;
+   }
+}
+
+void
+buildAluClauseIr(AluClauseIr &ir,
+                 const AluInst *clause,
+                 size_t slots)
+{
+   ir.groups.clear();
+
+   for (size_t slot = 0u; slot < slots; ) {
+      auto units = AluGroupUnits { };
+      auto group = AluGroup { clause + slot };
+      auto &irGroup = ir.groups.emplace_back();
+      irGroup.instructions = group.instructions;
+      irGroup.literals = group.literals;
+      irGroup.nodes.resize(group.instructions.size());
+
+      for (auto i = 0u; i < group.instructions.size(); ++i) {
+         auto &inst = group.instructions[i];
+         auto &node = irGroup.nodes[i];
+         node.inst = inst;
+         node.unit = units.addInstructionUnit(inst);
+
+         if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+            node.flags = getInstructionFlags(inst.op2.ALU_INST());
+            node.writesGpr = inst.op2.WRITE_MASK();
+         } else {
+            node.flags = getInstructionFlags(inst.op3.ALU_INST());
+            node.writesGpr = true;
+         }
+
+         node.hasSideEffects = hasSideEffects(inst, node.flags);
+         irGroup.unitNode[node.unit] = static_cast<int>(i);
+
+         if (node.flags & SQ_ALU_FLAG_REDUCTION) {
+            irGroup.isReduction = true;
+         }
+
+         // Until optimised, we copy every PV / PS which was written
+         if (node.unit == SQ_CHAN::T) {
+            irGroup.psCopy = true;
+         } else {
+            irGroup.pvCopyMask = 0xF;
+         }
+      }
+
+      slot = group.getNextSlot(slot);
+   }
+}
+
+bool
+getPreviousConstant(const AluGroupIr *previous,
+                    SQ_ALU_SRC sel,
+                    SQ_CHAN chan,
+                    uint32_t &value)
+{
+   if (!previous) {
+      return false;
+   }
+
+   auto node = static_cast<const AluNode *>(nullptr);
+
+   if (sel == SQ_ALU_SRC::PV) {
+      node = previous->getUnitNode(chan);
+   } else if (sel == SQ_ALU_SRC::PS) {
+      node = previous->getUnitNode(SQ_CHAN::T);
+   }
+
+   if (!node || !node->isConstant) {
+      return false;
+   }
+
+   value = node->constantValue;
+   return true;
+}
+
+static bool
+isFoldableFloat(float value)
+{
+   // The GPU flushes denormals, and we do not want to reason about NaN
+   return value == 0.0f || std::isnormal(value);
+}
+
+/**
+ * Read a constant source in the domain the instruction reads it in, matching
+ * what insertSource would emit: integer instructions see 0.5 as 0 and float
+ * instructions see the integer immediates as 1.0 and -1.0.
+ */
+static bool
+getConstantSource(const AluGroupIr *previous,
+                  const AluGroupIr &group,
+                  const AluSource &source,
+                  bool isInt,
+                  uint32_t &value)
+{
+   if (source.rel) {
+      return false;
+   }
+
+   switch (source.sel) {
+   case SQ_ALU_SRC::IMM_0:
+      value = isInt ? 0u : bit_cast<uint32_t>(0.0f);
+      break;
+   case SQ_ALU_SRC::IMM_1:
+      value = isInt ? 1u : bit_cast<uint32_t>(1.0f);
+      break;
+   case SQ_ALU_SRC::IMM_0_5:
+      value = isInt ? 0u : bit_cast<uint32_t>(0.5f);
+      break;
+   case SQ_ALU_SRC::IMM_1_INT:
+      value = isInt ? 1u : bit_cast<uint32_t>(1.0f);
+      break;
+   case SQ_ALU_SRC::IMM_M_1_INT:
+      value = isInt ? static_cast<uint32_t>(-1) : bit_cast<uint32_t>(-1.0f);
+      break;
+   case SQ_ALU_SRC::LITERAL:
+      if (source.chan >= group.literals.size()) {
+         return false;
+      }
+
+      value = group.literals[source.chan];
+      break;
+   case SQ_ALU_SRC::PV:
+   case SQ_ALU_SRC::PS:
+      if (!getPreviousConstant(previous, source.sel, source.chan, value)) {
+         return false;
+      }
+      break;
+   default:
+      return false;
+   }
+
+   // insertSource emits abs(-(x))
+   if (source.neg) {
+      value = isInt ? (0u - value) : (value ^ 0x80000000u);
+   }
+
+   if (source.abs) {
+      if (isInt) {
+         value = static_cast<int32_t>(value) < 0 ? 0u - value : value;
+      } else {
+         value &= 0x7FFFFFFFu;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Evaluate an instruction whose sources are all constant, only for the
+ * simple arithmetic which is common in compiler output and which the host
+ * evaluates exactly as the GLSL we would otherwise emit.
+ */
+static bool
+foldConstant(const AluGroupIr *previous,
+             const AluGroupIr &group,
+             AluNode &node)
+{
+   auto &inst = node.inst;
+   auto sources = std::array<AluSource, 3> { };
+   auto values = std::array<uint32_t, 3> { };
+   auto numSrcs = getSources(inst, sources);
+   auto isIntIn = !!(node.flags & (SQ_ALU_FLAG_INT_IN | SQ_ALU_FLAG_UINT_IN));
+   auto isIntOut = !!(node.flags & (SQ_ALU_FLAG_INT_OUT | SQ_ALU_FLAG_UINT_OUT));
+   auto omod = SQ_ALU_OMOD::OFF;
+   auto result = uint32_t { 0 };
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      omod = inst.op2.OMOD();
+   }
+
+   if (isIntOut && (omod != SQ_ALU_OMOD::OFF || inst.word1.CLAMP())) {
+      return false;
+   }
+
+   for (auto i = 0u; i < numSrcs; ++i) {
+      if (!getConstantSource(previous, group, sources[i], isIntIn, values[i])) {
+         return false;
+      }
+   }
+
+   auto f = [&](unsigned i) { return bit_cast<float>(values[i]); };
+   auto s = [&](unsigned i) { return static_cast<int32_t>(values[i]); };
+
+   if (!isIntIn) {
+      for (auto i = 0u; i < numSrcs; ++i) {
+         if (!isFoldableFloat(f(i))) {
+            return false;
+         }
+      }
+   }
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      switch (inst.op2.ALU_INST()) {
+      case SQ_OP2_INST_MOV:
+         result = values[0];
+         break;
+      case SQ_OP2_INST_ADD:
+         result = bit_cast<uint32_t>(f(0) + f(1));
+         break;
+      case SQ_OP2_INST_MUL:
+      case SQ_OP2_INST_MUL_IEEE:
+         result = bit_cast<uint32_t>(f(0) * f(1));
+         break;
+      case SQ_OP2_INST_MAX:
+         result = bit_cast<uint32_t>(std::max(f(0), f(1)));
+         break;
+      case SQ_OP2_INST_MIN:
+         result = bit_cast<uint32_t>(std::min(f(0), f(1)));
+         break;
+      case SQ_OP2_INST_FLOOR:
+         result = bit_cast<uint32_t>(std::floor(f(0)));
+         break;
+      case SQ_OP2_INST_CEIL:
+         result = bit_cast<uint32_t>(std::ceil(f(0)));
+         break;
+      case SQ_OP2_INST_TRUNC:
+         result = bit_cast<uint32_t>(std::trunc(f(0)));
+         break;
+      case SQ_OP2_INST_ADD_INT:
+         result = values[0] + values[1];
+         break;
+      case SQ_OP2_INST_SUB_INT:
+         result = values[0] - values[1];
+         break;
+      case SQ_OP2_INST_AND_INT:
+         result = values[0] & values[1];
+         break;
+      case SQ_OP2_INST_OR_INT:
+         result = values[0] | values[1];
+         break;
+      case SQ_OP2_INST_XOR_INT:
+         result = values[0] ^ values[1];
+         break;
+      case SQ_OP2_INST_INT_TO_FLT:
+         result = bit_cast<uint32_t>(static_cast<float>(s(0)));
+         break;
+      case SQ_OP2_INST_UINT_TO_FLT:
+         result = bit_cast<uint32_t>(static_cast<float>(values[0]));
+         break;
+      default:
+         return false;
+      }
+   } else {
+      switch (inst.op3.ALU_INST()) {
+      case SQ_OP3_INST_MULADD:
+      case SQ_OP3_INST_MULADD_IEEE:
+         result = bit_cast<uint32_t>(f(0) * f(1) + f(2));
+         break;
+      default:
+         return false;
+      }
+   }
+
+   if (!isIntOut) {
+      auto value = bit_cast<float>(result);
+
+      switch (omod) {
+      case SQ_ALU_OMOD::OFF:
+         break;
+      case SQ_ALU_OMOD::M2:
+         value *= 2.0f;
+         break;
+      case SQ_ALU_OMOD::M4:
+         value *= 4.0f;
+         break;
+      case SQ_ALU_OMOD::D2:
+         value /= 2.0f;
+         break;
+      default:
+         return false;
+      }
+
+      if (inst.word1.CLAMP()) {
+         value = std::min(std::max(value, 0.0f), 1.0f);
+      }
+
+      // A plain MOV may move any bits, anything else must stay well behaved
+      auto isPlainMove = inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2
+                      && inst.op2.ALU_INST() == SQ_OP2_INST_MOV
+                      && omod == SQ_ALU_OMOD::OFF
+                      && !inst.word1.CLAMP();
+
+      if (!isPlainMove) {
+         if (!isFoldableFloat(value)) {
+            return false;
+         }
+
+         result = bit_cast<uint32_t>(value);
+      }
+   }
+
+   node.isConstant = true;
+   node.constantValue = result;
+   return true;
+}
+
+void
+optimiseAluClauseIr(AluClauseIr &ir,
+                    TranslateStats &stats)
+{
+   auto sources = std::array<AluSource, 3> { };
+
+   // Fold constants, forwards so that folded PV / PS values propagate into
+   // the next group.
+   for (auto i = 0u; i < ir.groups.size(); ++i) {
+      auto &group = ir.groups[i];
+      auto previous = i > 0 ? &ir.groups[i - 1] : nullptr;
+      stats.aluInstructions += static_cast<unsigned>(group.nodes.size());
+
+      if (group.isReduction) {
+         continue;
+      }
+
+      for (auto &node : group.nodes) {
+         if (!node.hasSideEffects && foldConstant(previous, group, node)) {
+            stats.foldedInstructions++;
+         }
+      }
+   }
+
+   // Find which PV / PS values are read by the next group. PV / PS are not
+   // carried across clauses, but be conservative with the last group anyway.
+   for (auto i = 0u; i + 1 < ir.groups.size(); ++i) {
+      auto &group = ir.groups[i];
+      auto &next = ir.groups[i + 1];
+      auto pvReadMask = 0u;
+      auto psRead = false;
+
+      for (auto &node : next.nodes) {
+         auto numSrcs = getSources(node.inst, sources);
+
+         for (auto j = 0u; j < numSrcs; ++j) {
+            auto value = uint32_t { 0 };
+
+            // Constant PV / PS reads are substituted by insertSource
+            if (getPreviousConstant(&group, sources[j].sel, sources[j].chan, value)) {
+               continue;
+            }
+
+            if (sources[j].sel == SQ_ALU_SRC::PV) {
+               pvReadMask |= 1 << sources[j].chan;
+            } else if (sources[j].sel == SQ_ALU_SRC::PS) {
+               psRead = true;
+            }
+         }
+      }
+
+      group.pvCopyMask &= pvReadMask;
+      group.psCopy = group.psCopy && psRead;
+
+      if (group.isReduction) {
+         continue;
+      }
+
+      for (auto &node : group.nodes) {
+         if (node.unit == SQ_CHAN::T) {
+            node.resultUsed = psRead;
+         } else {
+            node.resultUsed = !!(pvReadMask & (1 << node.unit));
+         }
+
+         if (node.isDead()) {
+            stats.deadInstructions++;
+         }
+      }
+   }
+
+   // Write GPRs directly when nothing needs the PVo / PSo value and no other
+   // instruction in the group reads the old value of the GPR.
+   for (auto &group : ir.groups) {
+      auto gprReads = std::bitset<128 * 4> { };
+      auto hasRelativeRead = false;
+
+      if (group.isReduction) {
+         continue;
+      }
+
+      for (auto &node : group.nodes) {
+         auto numSrcs = getSources(node.inst, sources);
+
+         for (auto j = 0u; j < numSrcs; ++j) {
+            auto sel = sources[j].sel;
+
+            if (sel >= SQ_ALU_SRC::REGISTER_FIRST && sel <= SQ_ALU_SRC::REGISTER_LAST) {
+               if (sources[j].rel) {
+                  hasRelativeRead = true;
+               } else {
+                  gprReads.set((sel - SQ_ALU_SRC::REGISTER_FIRST) * 4 + sources[j].chan);
+               }
+            }
+         }
+      }
+
+      if (hasRelativeRead) {
+         continue;
+      }
+
+      for (auto &node : group.nodes) {
+         auto &inst = node.inst;
+
+         if (!node.writesGpr || node.resultUsed || node.hasSideEffects || inst.word1.DST_REL()) {
+            continue;
+         }
+
+         if (gprReads.test(inst.word1.DST_GPR() * 4 + inst.word1.DST_CHAN())) {
+            continue;
+         }
+
+         node.writeGprDirectly = true;
+         stats.forwardedWrites++;
+      }
+   }
+}
+
+} // namespace glsl2
@@ -0,0 +1,107 @@
+#pragma once
+#include "latte/latte_instructions.h"
+
+#include <array>
+#include <cstdint>
+#include <gsl.h>
+#include <vector>
+
+namespace glsl2
+{
+
+struct TranslateStats;
+
+/**
+ * A single ALU instruction of a clause, along with what the optimiser has
+ * learnt about it.
+ */
+struct AluNode
+{
+   latte::AluInst inst;
+   latte::SQ_CHAN unit;
+   latte::SQ_ALU_FLAGS flags;
+
+   //! Result is written to a GPR at the end of the group.
+   bool writesGpr = false;
+
+   //! Updates the predicate, execute mask or AR, or may discard.
+   bool hasSideEffects = false;
+
+   //! Result may be read from PV / PS by the next group.
+   bool resultUsed = true;
+
+   //! Result was evaluated at translation time, constantValue holds the
+   //! bits which are written to PV / PS.
+   bool isConstant = false;
+   uint32_t constantValue = 0;
+
+   //! Result is written straight to the GPR rather than through PVo / PSo.
+   bool writeGprDirectly = false;
+
+   bool
+   isDead() const
+   {
+      return !writesGpr && !hasSideEffects && !resultUsed;
+   }
+};
+
+/**
+ * An ALU instruction group, which executes as a single VLIW bundle.
+ */
+struct AluGroupIr
+{
+   gsl::span<const latte::AluInst> instructions;
+   gsl::span<const uint32_t> literals;
+
+   //! One node per instruction, in the same order as instructions.
+   std::vector<AluNode> nodes;
+
+   //! Index into nodes for each unit X, Y, Z, W, T or -1 if unused.
+   std::array<int, 5> unitNode = { -1, -1, -1, -1, -1 };
+
+   bool isReduction = false;
+
+   //! Channels of PVo which must be copied to PV after this group.
+   unsigned pvCopyMask = 0;
+
+   //! PSo must be copied to PS after this group.
+   bool psCopy = false;
+
+   const AluNode *
+   getUnitNode(latte::SQ_CHAN unit) const
+   {
+      auto index = unitNode[unit];
+      return index >= 0 ? &nodes[index] : nullptr;
+   }
+};
+
+/**
+ * The instruction groups of one ALU clause.
+ *
+ * A PV or PS value is only visible to the group immediately following the
+ * one which produced it, so each is effectively an SSA value with a single
+ * consumer group. That lets us fold constants through PV / PS, drop values
+ * which are never read and write GPRs directly when the intermediate PVo /
+ * PSo is not needed, before any GLSL is emitted.
+ */
+struct AluClauseIr
+{
+   std::vector<AluGroupIr> groups;
+};
+
+void
+buildAluClauseIr(AluClauseIr &ir,
+                 const latte::AluInst *clause,
+                 size_t slots);
+
+void
+optimiseAluClauseIr(AluClauseIr &ir,
+                    TranslateStats &stats);
+
+bool
+getPreviousConstant(const AluGroupIr *previous,
+                    latte::SQ_ALU_SRC sel,
+                    latte::SQ_CHAN chan,
+                    uint32_t &value);
+
+} // namespace glsl2
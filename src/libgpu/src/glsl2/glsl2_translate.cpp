@@ -1,5 +1,7 @@
 #include "glsl2_translate.h"
+#include "glsl2_alu.h"
 #include "glsl2_cf.h"
+#include "glsl2_ir.h"
 #include "latte/latte_constants.h"
 #include "latte/latte_decoders.h"
 #include "latte/latte_disassembler.h"
@@ -10,6 +12,7 @@
 #include <common/log.h>
 #include <fmt/format.h>
 #include <map>
+#include <mutex>
 
 using namespace latte;
 
@@ -264,22 +267,27 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
       break;
    }
 
+   auto ir = AluClauseIr { };
+   buildAluClauseIr(ir, clause, count);
+
+   if (state.shader && state.shader->optimiseAlu) {
+      optimiseAluClauseIr(ir, state.shader->stats);
+   }
+
    condStart(state, latte::SQ_CF_COND::ACTIVE);
 
-   for (size_t slot = 0u; slot < count; ) {
-      auto units = AluGroupUnits {};
-      auto group = AluGroup { clause + slot };
+   for (auto groupIndex = 0u; groupIndex < ir.groups.size(); ++groupIndex) {
+      auto &irGroup = ir.groups[groupIndex];
+      auto group = AluGroup { irGroup.instructions.data() };
       auto didReduction = false;
-      auto updatePreviousVector = false;
-      auto updatePreviousScalar = false;
-      state.literals = group.literals;
+      state.literals = irGroup.literals;
+      state.aluPreviousGroup = groupIndex > 0 ? &ir.groups[groupIndex - 1] : nullptr;
 
-      for (auto j = 0u; j < group.instructions.size(); ++j) {
-         auto &inst = group.instructions[j];
-         auto unit = units.addInstructionUnit(inst);
+      for (auto j = 0u; j < irGroup.nodes.size(); ++j) {
+         auto &node = irGroup.nodes[j];
+         auto &inst = node.inst;
          auto func = TranslateFuncALU { nullptr };
-         auto flags = SQ_ALU_FLAG_NONE;
-         state.unit = unit;
+         state.unit = node.unit;
 
          // Process all reduction instructions once as a group
          if (isReductionInstruction(inst)) {
@@ -288,14 +296,12 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
             }
 
             didReduction = true;
-            updatePreviousVector = true;
             continue;
          }
 
          if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
             auto instId = inst.op2.ALU_INST();
             auto itr = sInstructionMapOP2.find(instId);
-            flags = getInstructionFlags(instId);
 
             if (itr != sInstructionMapOP2.end()) {
                func = itr->second;
@@ -305,7 +311,6 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
          } else {
             auto instId = inst.op3.ALU_INST();
             auto itr = sInstructionMapOP3.find(instId);
-            flags = getInstructionFlags(instId);
 
             if (itr != sInstructionMapOP3.end()) {
                func = itr->second;
@@ -314,20 +319,24 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
             }
          }
 
-         if (unit < SQ_CHAN::T) {
-            updatePreviousVector = true;
-         } else {
-            updatePreviousScalar = true;
-         }
-
          insertLineStart(state);
          fmt::format_to(state.out, "// {:02} ", state.groupPC);
          latte::disassembler::disassembleAluInstruction(state.out, cf, inst, state.groupPC, state.unit, state.literals);
          insertLineEnd(state);
 
-         if (func) {
+         if (node.isDead()) {
+            continue;
+         }
+
+         state.aluNode = &node;
+
+         if (node.isConstant) {
+            insertConstantResult(state, inst, node.constantValue);
+         } else if (func) {
             func(state, cf, inst);
          }
+
+         state.aluNode = nullptr;
       }
 
       insertLineStart(state);
@@ -341,24 +350,36 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
       }
       state.postGroupWrites.clear();
 
-      if (updatePreviousVector) {
+      if (irGroup.pvCopyMask == 0xF) {
          insertLineStart(state);
          fmt::format_to(state.out, "PV = PVo;");
          insertLineEnd(state);
+      } else if (irGroup.pvCopyMask) {
+         auto channels = std::string { };
+
+         for (auto c = 0u; c < 4; ++c) {
+            if (irGroup.pvCopyMask & (1 << c)) {
+               channels.push_back("xyzw"[c]);
+            }
+         }
+
+         insertLineStart(state);
+         fmt::format_to(state.out, "PV.{} = PVo.{};", channels, channels);
+         insertLineEnd(state);
       }
 
-      if (updatePreviousScalar) {
+      if (irGroup.psCopy) {
          insertLineStart(state);
          fmt::format_to(state.out, "PS = PSo;");
          insertLineEnd(state);
       }
 
-      slot = group.getNextSlot(slot);
       state.groupPC++;
 
       fmt::format_to(state.out, "\n");
    }
 
+   state.aluPreviousGroup = nullptr;
    condEnd(state);
 
    switch (id) {
@@ -407,21 +428,19 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
 static void
 initialise()
 {
-   static bool didRegister = false;
-
-   if (didRegister) {
-      return;
-   }
-
-   didRegister = true;
-   registerCfFunctions();
-   registerExpFunctions();
-   registerTexFunctions();
-   registerVtxFunctions();
-   registerOP2Functions();
-   registerOP3Functions();
-   registerOP2ReductionFunctions();
-   registerOP3ReductionFunctions();
+   // Shaders may be translated from several threads at once
+   static std::once_flag didRegister;
+
+   std::call_once(didRegister, [] {
+      registerCfFunctions();
+      registerExpFunctions();
+      registerTexFunctions();
+      registerVtxFunctions();
+      registerOP2Functions();
+      registerOP3Functions();
+      registerOP2ReductionFunctions();
+      registerOP3ReductionFunctions();
+   });
 }
 
 void
@@ -708,58 +727,70 @@ insertCodeHeader(State &state)
    }
 }
 
-bool
-translate(Shader &shader, const gsl::span<const uint8_t> &binary)
+static void
+translateShader(State &state,
+                Shader &shader,
+                const gsl::span<const uint8_t> &binary)
 {
-   State state;
    state.binary = binary;
    state.shader = &shader;
    state.shader->usedUniformBlocks.fill(false);
    state.shader->samplerUsage.fill(SamplerUsage::Invalid);
    initialise();
 
-   try {
-      for (auto i = 0; i < binary.size(); i += sizeof(ControlFlowInst)) {
-         auto cf = *reinterpret_cast<const ControlFlowInst *>(binary.data() + i);
-         auto id = cf.word1.CF_INST();
+   for (auto i = 0; i < binary.size(); i += sizeof(ControlFlowInst)) {
+      auto cf = *reinterpret_cast<const ControlFlowInst *>(binary.data() + i);
+      auto id = cf.word1.CF_INST();
+
+      switch (cf.word1.CF_INST_TYPE()) {
+      case SQ_CF_INST_TYPE_NORMAL:
+         translateNormal(state, cf);
+         break;
+      case SQ_CF_INST_TYPE_EXPORT:
+         translateExport(state, cf);
+         break;
+      case SQ_CF_INST_TYPE_ALU:
+      case SQ_CF_INST_TYPE_ALU_EXTENDED:
+         translateControlFlowALU(state, cf);
+         break;
+      default:
+         throw translate_exception("Invalid top level instruction type");
+      }
 
-         switch (cf.word1.CF_INST_TYPE()) {
-         case SQ_CF_INST_TYPE_NORMAL:
-            translateNormal(state, cf);
-            break;
-         case SQ_CF_INST_TYPE_EXPORT:
-            translateExport(state, cf);
+      if (cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_NORMAL
+       || cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_EXPORT) {
+         if (cf.word1.END_OF_PROGRAM()) {
             break;
-         case SQ_CF_INST_TYPE_ALU:
-         case SQ_CF_INST_TYPE_ALU_EXTENDED:
-            translateControlFlowALU(state, cf);
-            break;
-         default:
-            throw translate_exception("Invalid top level instruction type");
          }
+      }
 
-         if (cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_NORMAL
-          || cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_EXPORT) {
-            if (cf.word1.END_OF_PROGRAM()) {
-               break;
-            }
-         }
+      state.cfPC++;
+   }
 
-         state.cfPC++;
-      }
-   } catch (const translate_exception &e) {
-      auto assembly = disassemble(binary);
-      gLog->critical("GLSL translate exception: {}\nDisassembly:\n{}", e.what(), assembly);
-      decaf_abort(fmt::format("GLSL translate exception: {}", e.what()));
+   if (state.loopStack.size() != 0) {
+      throw translate_exception("Unterminated loop at end of program");
    }
 
-   decaf_check(state.loopStack.size() == 0);
    insertFileHeader(state);
    insertCodeHeader(state);
 
    shader.codeBody = to_string(state.out);
    shader.fileHeader = to_string(state.outFileHeader);
    shader.codeHeader = to_string(state.outCodeHeader);
+}
+
+bool
+translate(Shader &shader, const gsl::span<const uint8_t> &binary)
+{
+   State state;
+
+   try {
+      translateShader(state, shader, binary);
+   } catch (const translate_exception &e) {
+      auto assembly = disassemble(binary);
+      gLog->critical("GLSL translate exception: {}\nDisassembly:\n{}", e.what(), assembly);
+      decaf_abort(fmt::format("GLSL translate exception: {}", e.what()));
+   }
 
    if (state.printMyCode) {
       gLog->debug("File Header:\n{}\nCode Header:\n{}\nCode Body:\n{}", shader.fileHeader, shader.codeHeader, shader.codeBody);
@@ -768,4 +799,21 @@ translate(Shader &shader, const gsl::span<const uint8_t> &binary)
    return true;
 }
 
+bool
+tryTranslate(Shader &shader,
+             const gsl::span<const uint8_t> &binary,
+             std::string &error)
+{
+   State state;
+
+   try {
+      translateShader(state, shader, binary);
+   } catch (const translate_exception &e) {
+      error = e.what();
+      return false;
+   }
+
+   return true;
+}
+
 } // namespace glsl2
@@ -47,6 +47,21 @@ struct Feedback
    unsigned size;  // Number of components (1-4)
 };
 
+struct TranslateStats
+{
+   //! Number of ALU instructions translated.
+   unsigned aluInstructions = 0;
+
+   //! ALU instructions whose result was never read, these are not emitted.
+   unsigned deadInstructions = 0;
+
+   //! ALU instructions evaluated at translation time.
+   unsigned foldedInstructions = 0;
+
+   //! ALU results written straight to a GPR rather than through PVo / PSo.
+   unsigned forwardedWrites = 0;
+};
+
 struct Shader
 {
    enum Type
@@ -62,6 +77,7 @@ struct Shader
    std::array<latte::SQ_TEX_DIM, 16> samplerDim;
    bool uniformRegistersEnabled = false;
    bool uniformBlocksEnabled = false;
+   bool optimiseAlu = true;
 
    // Output (maybe)
    std::string fileHeader;
@@ -72,8 +88,12 @@ struct Shader
    std::array<SamplerUsage, latte::MaxSamplers> samplerUsage;
    std::array<bool, latte::MaxUniformBlocks> usedUniformBlocks;
    bool usesDiscard = false;
+   TranslateStats stats;
 };
 
+struct AluNode;
+struct AluGroupIr;
+
 struct LoopState
 {
    uint32_t startPC;
@@ -93,6 +113,8 @@ struct State
    latte::SQ_CHAN unit;
    gsl::span<const uint32_t> literals;
    std::vector<std::string> postGroupWrites;
+   const AluNode *aluNode = nullptr;
+   const AluGroupIr *aluPreviousGroup = nullptr;
    std::stack<LoopState> loopStack;
    bool printMyCode = false;
 };
@@ -100,6 +122,13 @@ struct State
 bool
 translate(Shader &shader, const gsl::span<const uint8_t> &binary);
 
+//! Like translate, but returns false with a description of the problem
+//! rather than aborting when the shader can not be translated.
+bool
+tryTranslate(Shader &shader,
+             const gsl::span<const uint8_t> &binary,
+             std::string &error);
+
 using TranslateFuncCF = void(*)(State &state, const latte::ControlFlowInst &cf);
 using TranslateFuncEXP = void(*)(State &state, const latte::ControlFlowInst &cf);
 using TranslateFuncALU = void(*)(State &state, const latte::ControlFlowInst &cf, const latte::AluInst &inst);
@@ -9,6 +9,7 @@ namespace config
 bool debug = false;
 std::vector<int64_t> debug_filters = { };
 bool dump_shaders = false;
+bool pipeline_pm4 = true;
 
 } // namespace config
 
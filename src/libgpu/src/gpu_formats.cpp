@@ -0,0 +1,677 @@
+#include "gpu_formats.h"
+#include "gpu_formats_avx2.h"
+
+#include <atomic>
+#include <common/byte_swap.h>
+#include <cstring>
+#include <initializer_list>
+
+namespace gpu
+{
+
+namespace formats
+{
+
+static Implementation
+getDefaultImplementation()
+{
+   if (avx2::isSupported()) {
+      return Implementation::AVX2;
+   }
+
+   return Implementation::Scalar;
+}
+
+static std::atomic<Implementation>
+sImplementation { getDefaultImplementation() };
+
+static bool
+useAvx2()
+{
+   return sImplementation.load(std::memory_order_relaxed) == Implementation::AVX2;
+}
+
+static void
+setComponents(FormatLayout &layout,
+              std::initializer_list<FormatComponent> components)
+{
+   auto index = 0u;
+
+   for (auto &component : components) {
+      layout.components[index++] = component;
+   }
+
+   layout.numComponents = index;
+}
+
+//! A layout where each component is a separate word of bits.
+static void
+setWordComponents(FormatLayout &layout,
+                  uint32_t numComponents,
+                  uint32_t bits)
+{
+   for (auto i = 0u; i < numComponents; ++i) {
+      layout.components[i] = FormatComponent { i * bits, bits };
+   }
+
+   layout.numComponents = numComponents;
+   layout.elementBits = numComponents * bits;
+
+   if (bits == 16) {
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN16;
+   } else if (bits == 32) {
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+   }
+}
+
+bool
+getFormatLayout(latte::SQ_DATA_FORMAT format,
+                FormatLayout &layout)
+{
+   layout = FormatLayout { };
+
+   switch (format) {
+   case latte::SQ_DATA_FORMAT::FMT_1:
+      setWordComponents(layout, 1, 1);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8:
+      setWordComponents(layout, 1, 8);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_4_4:
+      setWordComponents(layout, 2, 4);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_3_3_2:
+      layout.elementBits = 8;
+      setComponents(layout, { { 5, 3 }, { 2, 3 }, { 0, 2 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16:
+   case latte::SQ_DATA_FORMAT::FMT_16_FLOAT:
+      setWordComponents(layout, 1, 16);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_8:
+      setWordComponents(layout, 2, 8);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_5_6_5:
+      layout.elementBits = 16;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN16;
+      setComponents(layout, { { 11, 5 }, { 5, 6 }, { 0, 5 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_6_5_5:
+      layout.elementBits = 16;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN16;
+      setComponents(layout, { { 10, 6 }, { 5, 5 }, { 0, 5 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_1_5_5_5:
+      layout.elementBits = 16;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN16;
+      setComponents(layout, { { 0, 5 }, { 5, 5 }, { 10, 5 }, { 15, 1 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_4_4_4_4:
+      layout.elementBits = 16;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN16;
+      setComponents(layout, { { 12, 4 }, { 8, 4 }, { 4, 4 }, { 0, 4 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_5_5_5_1:
+      layout.elementBits = 16;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN16;
+      setComponents(layout, { { 11, 5 }, { 6, 5 }, { 1, 5 }, { 0, 1 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32:
+   case latte::SQ_DATA_FORMAT::FMT_32_FLOAT:
+   case latte::SQ_DATA_FORMAT::FMT_32_AS_8:
+   case latte::SQ_DATA_FORMAT::FMT_32_AS_8_8:
+      setWordComponents(layout, 1, 32);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16:
+   case latte::SQ_DATA_FORMAT::FMT_16_16_FLOAT:
+      setWordComponents(layout, 2, 16);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_24:
+   case latte::SQ_DATA_FORMAT::FMT_8_24_FLOAT:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      layout.isDepthStencil = true;
+      setComponents(layout, { { 0, 24 }, { 24, 8 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_24_8:
+   case latte::SQ_DATA_FORMAT::FMT_24_8_FLOAT:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      layout.isDepthStencil = true;
+      setComponents(layout, { { 8, 24 }, { 0, 8 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_10_11_11:
+   case latte::SQ_DATA_FORMAT::FMT_10_11_11_FLOAT:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      setComponents(layout, { { 0, 11 }, { 11, 11 }, { 22, 10 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_11_11_10:
+   case latte::SQ_DATA_FORMAT::FMT_11_11_10_FLOAT:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      setComponents(layout, { { 0, 10 }, { 10, 11 }, { 21, 11 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_2_10_10_10:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      setComponents(layout, { { 0, 10 }, { 10, 10 }, { 20, 10 }, { 30, 2 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_8_8_8:
+      setWordComponents(layout, 4, 8);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_10_10_10_2:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      setComponents(layout, { { 22, 10 }, { 12, 10 }, { 2, 10 }, { 0, 2 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_X24_8_32_FLOAT:
+      layout.elementBits = 64;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      layout.isDepthStencil = true;
+      setComponents(layout, { { 0, 32 }, { 32, 8 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32:
+   case latte::SQ_DATA_FORMAT::FMT_32_32_FLOAT:
+      setWordComponents(layout, 2, 32);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16_16:
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16_16_FLOAT:
+      setWordComponents(layout, 4, 16);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32_32:
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32_32_FLOAT:
+      setWordComponents(layout, 4, 32);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_GB_GR:
+   case latte::SQ_DATA_FORMAT::FMT_BG_RG:
+      // One element holds two horizontally adjacent pixels
+      setWordComponents(layout, 4, 8);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_5_9_9_9_SHAREDEXP:
+      layout.elementBits = 32;
+      layout.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      setComponents(layout, { { 0, 9 }, { 9, 9 }, { 18, 9 }, { 27, 5 } });
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_8_8:
+      setWordComponents(layout, 3, 8);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16:
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16_FLOAT:
+      setWordComponents(layout, 3, 16);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32:
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32_FLOAT:
+      setWordComponents(layout, 3, 32);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_BC1:
+   case latte::SQ_DATA_FORMAT::FMT_BC4:
+   case latte::SQ_DATA_FORMAT::FMT_CTX1:
+      setWordComponents(layout, 2, 32);
+      layout.endianSwap = latte::SQ_ENDIAN::NONE;
+      layout.blockSize = 4;
+      layout.isCompressed = true;
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_BC2:
+   case latte::SQ_DATA_FORMAT::FMT_BC3:
+   case latte::SQ_DATA_FORMAT::FMT_BC5:
+      setWordComponents(layout, 4, 32);
+      layout.endianSwap = latte::SQ_ENDIAN::NONE;
+      layout.blockSize = 4;
+      layout.isCompressed = true;
+      break;
+   default:
+      // FMT_APC0 - FMT_APC7 have no documented layout
+      return false;
+   }
+
+   return true;
+}
+
+Implementation
+getImplementation()
+{
+   return sImplementation.load(std::memory_order_relaxed);
+}
+
+bool
+isImplementationSupported(Implementation implementation)
+{
+   switch (implementation) {
+   case Implementation::Scalar:
+      return true;
+   case Implementation::AVX2:
+      return avx2::isSupported();
+   default:
+      return false;
+   }
+}
+
+bool
+setImplementation(Implementation implementation)
+{
+   if (!isImplementationSupported(implementation)) {
+      return false;
+   }
+
+   sImplementation.store(implementation, std::memory_order_relaxed);
+   return true;
+}
+
+//! Read bits at bitOffset from little endian data.
+static uint32_t
+readBits(const uint8_t *data,
+         size_t bitOffset,
+         uint32_t bits)
+{
+   auto bytes = data + bitOffset / 8;
+   auto shift = static_cast<uint32_t>(bitOffset % 8);
+   auto numBytes = (shift + bits + 7) / 8;
+   auto value = uint64_t { 0 };
+
+   for (auto i = 0u; i < numBytes; ++i) {
+      value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+   }
+
+   return static_cast<uint32_t>((value >> shift) & ((uint64_t { 1 } << bits) - 1));
+}
+
+//! Write bits at bitOffset to little endian data, other bits are preserved.
+static void
+writeBits(uint8_t *data,
+          size_t bitOffset,
+          uint32_t bits,
+          uint32_t value)
+{
+   auto bytes = data + bitOffset / 8;
+   auto shift = static_cast<uint32_t>(bitOffset % 8);
+   auto numBytes = (shift + bits + 7) / 8;
+   auto mask = ((uint64_t { 1 } << bits) - 1) << shift;
+   auto bitsValue = (static_cast<uint64_t>(value) << shift) & mask;
+
+   for (auto i = 0u; i < numBytes; ++i) {
+      auto byteMask = static_cast<uint8_t>(mask >> (i * 8));
+      auto byteValue = static_cast<uint8_t>(bitsValue >> (i * 8));
+      bytes[i] = static_cast<uint8_t>((bytes[i] & ~byteMask) | byteValue);
+   }
+}
+
+//! Read an element of 32 bits or less which is byte aligned.
+static uint32_t
+readElement(const uint8_t *src,
+            size_t index,
+            uint32_t elementBits)
+{
+   switch (elementBits) {
+   case 8:
+      return src[index];
+   case 16:
+   {
+      uint16_t value;
+      std::memcpy(&value, src + index * 2, 2);
+      return value;
+   }
+   case 32:
+   {
+      uint32_t value;
+      std::memcpy(&value, src + index * 4, 4);
+      return value;
+   }
+   default:
+      return readBits(src, index * elementBits, elementBits);
+   }
+}
+
+static uint32_t
+getComponent(uint32_t element,
+             const FormatComponent &component)
+{
+   return static_cast<uint32_t>((element >> component.offset) & ((uint64_t { 1 } << component.bits) - 1));
+}
+
+//! Replicate the bits of an unsigned normalised value to fill 8 bits.
+static uint8_t
+expandUnorm8(uint32_t value,
+             uint32_t bits)
+{
+   auto width = static_cast<int>(bits);
+   auto result = 0u;
+
+   for (auto shift = 8 - width; shift > -width; shift -= width) {
+      result |= (shift >= 0) ? (value << shift) : (value >> -shift);
+   }
+
+   return static_cast<uint8_t>(result);
+}
+
+bool
+endianSwap(void *dst,
+           const void *src,
+           size_t size,
+           latte::SQ_ENDIAN endian)
+{
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+   auto i = size_t { 0 };
+
+   switch (endian) {
+   case latte::SQ_ENDIAN::NONE:
+      if (dst != src) {
+         std::memmove(dst, src, size);
+      }
+      return true;
+   case latte::SQ_ENDIAN::SWAP_8IN16:
+   {
+      if (size % 2) {
+         return false;
+      }
+
+      auto count = size / 2;
+
+      if (useAvx2()) {
+         i = avx2::endianSwap16(dstBytes, srcBytes, count);
+      }
+
+      for (; i < count; ++i) {
+         uint16_t value;
+         std::memcpy(&value, srcBytes + i * 2, 2);
+         value = byte_swap(value);
+         std::memcpy(dstBytes + i * 2, &value, 2);
+      }
+
+      return true;
+   }
+   case latte::SQ_ENDIAN::SWAP_8IN32:
+   {
+      if (size % 4) {
+         return false;
+      }
+
+      auto count = size / 4;
+
+      if (useAvx2()) {
+         i = avx2::endianSwap32(dstBytes, srcBytes, count);
+      }
+
+      for (; i < count; ++i) {
+         uint32_t value;
+         std::memcpy(&value, srcBytes + i * 4, 4);
+         value = byte_swap(value);
+         std::memcpy(dstBytes + i * 4, &value, 4);
+      }
+
+      return true;
+   }
+   default:
+      return false;
+   }
+}
+
+bool
+unpack(latte::SQ_DATA_FORMAT format,
+       uint32_t *dst,
+       const void *src,
+       size_t numElements)
+{
+   auto layout = FormatLayout { };
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+
+   if (!getFormatLayout(format, layout)) {
+      return false;
+   }
+
+   for (auto i = size_t { 0 }; i < numElements; ++i) {
+      auto base = i * layout.elementBits;
+      auto out = dst + i * 4;
+
+      for (auto c = 0u; c < 4; ++c) {
+         auto &component = layout.components[c];
+
+         if (component.bits) {
+            out[c] = readBits(srcBytes, base + component.offset, component.bits);
+         } else {
+            out[c] = 0;
+         }
+      }
+   }
+
+   return true;
+}
+
+bool
+pack(latte::SQ_DATA_FORMAT format,
+     void *dst,
+     const uint32_t *src,
+     size_t numElements)
+{
+   auto layout = FormatLayout { };
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+
+   if (!getFormatLayout(format, layout)) {
+      return false;
+   }
+
+   if (layout.elementBits % 8 == 0) {
+      std::memset(dst, 0, numElements * layout.elementBits / 8);
+   }
+
+   for (auto i = size_t { 0 }; i < numElements; ++i) {
+      auto base = i * layout.elementBits;
+      auto in = src + i * 4;
+
+      if (layout.elementBits % 8) {
+         writeBits(dstBytes, base, layout.elementBits, 0);
+      }
+
+      for (auto c = 0u; c < layout.numComponents; ++c) {
+         auto &component = layout.components[c];
+         writeBits(dstBytes, base + component.offset, component.bits, in[c]);
+      }
+   }
+
+   return true;
+}
+
+bool
+convert(latte::SQ_DATA_FORMAT dstFormat,
+        void *dst,
+        latte::SQ_DATA_FORMAT srcFormat,
+        const void *src,
+        size_t numElements)
+{
+   auto dstLayout = FormatLayout { };
+   auto srcLayout = FormatLayout { };
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+
+   if (!getFormatLayout(dstFormat, dstLayout) ||
+       !getFormatLayout(srcFormat, srcLayout)) {
+      return false;
+   }
+
+   if (dstLayout.elementBits != srcLayout.elementBits ||
+       dstLayout.isCompressed || srcLayout.isCompressed) {
+      return false;
+   }
+
+   for (auto c = 0u; c < 4; ++c) {
+      if (dstLayout.components[c].bits != srcLayout.components[c].bits) {
+         return false;
+      }
+   }
+
+   auto i = size_t { 0 };
+
+   if (useAvx2() && srcLayout.elementBits == 32) {
+      i = avx2::convert32(dstLayout,
+                          reinterpret_cast<uint32_t *>(dstBytes),
+                          srcLayout,
+                          reinterpret_cast<const uint32_t *>(srcBytes),
+                          numElements);
+   }
+
+   if (srcLayout.elementBits <= 32) {
+      for (; i < numElements; ++i) {
+         auto element = readElement(srcBytes, i, srcLayout.elementBits);
+         auto result = uint32_t { 0 };
+
+         for (auto c = 0u; c < srcLayout.numComponents; ++c) {
+            result |= getComponent(element, srcLayout.components[c]) << dstLayout.components[c].offset;
+         }
+
+         if (dstLayout.elementBits % 8) {
+            writeBits(dstBytes, i * dstLayout.elementBits, dstLayout.elementBits, result);
+         } else {
+            std::memcpy(dstBytes + i * dstLayout.elementBits / 8, &result, dstLayout.elementBits / 8);
+         }
+      }
+   } else {
+      uint32_t components[4];
+
+      for (; i < numElements; ++i) {
+         unpack(srcFormat, components, srcBytes + i * srcLayout.elementBits / 8, 1);
+         pack(dstFormat, dstBytes + i * dstLayout.elementBits / 8, components, 1);
+      }
+   }
+
+   return true;
+}
+
+bool
+expandToRGBA8(latte::SQ_DATA_FORMAT format,
+              uint8_t *dst,
+              const void *src,
+              size_t numElements)
+{
+   auto layout = FormatLayout { };
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+
+   if (!getFormatLayout(format, layout)) {
+      return false;
+   }
+
+   if (layout.isCompressed || layout.isDepthStencil || layout.elementBits > 32 ||
+       format == latte::SQ_DATA_FORMAT::FMT_GB_GR ||
+       format == latte::SQ_DATA_FORMAT::FMT_BG_RG) {
+      return false;
+   }
+
+   for (auto c = 0u; c < layout.numComponents; ++c) {
+      if (layout.components[c].bits > 8) {
+         return false;
+      }
+   }
+
+   auto i = size_t { 0 };
+
+   if (useAvx2() &&
+       (layout.elementBits == 8 || layout.elementBits == 16 || layout.elementBits == 32)) {
+      i = avx2::expandToRGBA8(layout, dst, srcBytes, numElements);
+   }
+
+   for (; i < numElements; ++i) {
+      auto element = readElement(srcBytes, i, layout.elementBits);
+      auto out = dst + i * 4;
+
+      for (auto c = 0u; c < 4; ++c) {
+         auto &component = layout.components[c];
+
+         if (component.bits) {
+            out[c] = expandUnorm8(getComponent(element, component), component.bits);
+         } else {
+            out[c] = (c == 3) ? 0xFF : 0;
+         }
+      }
+   }
+
+   return true;
+}
+
+bool
+splitDepthStencil(latte::SQ_DATA_FORMAT format,
+                  uint32_t *depth,
+                  uint8_t *stencil,
+                  const void *src,
+                  size_t numElements)
+{
+   auto layout = FormatLayout { };
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+
+   if (!getFormatLayout(format, layout) || !layout.isDepthStencil) {
+      return false;
+   }
+
+   auto &depthComponent = layout.components[0];
+   auto &stencilComponent = layout.components[1];
+   auto i = size_t { 0 };
+
+   if (layout.elementBits == 32) {
+      if (useAvx2()) {
+         i = avx2::splitDepthStencil32(layout, depth, stencil,
+                                       reinterpret_cast<const uint32_t *>(srcBytes),
+                                       numElements);
+      }
+
+      for (; i < numElements; ++i) {
+         auto element = readElement(srcBytes, i, 32);
+         depth[i] = getComponent(element, depthComponent);
+         stencil[i] = static_cast<uint8_t>(getComponent(element, stencilComponent));
+      }
+   } else {
+      for (; i < numElements; ++i) {
+         auto base = i * layout.elementBits;
+         depth[i] = readBits(srcBytes, base + depthComponent.offset, depthComponent.bits);
+         stencil[i] = static_cast<uint8_t>(readBits(srcBytes, base + stencilComponent.offset, stencilComponent.bits));
+      }
+   }
+
+   return true;
+}
+
+bool
+mergeDepthStencil(latte::SQ_DATA_FORMAT format,
+                  void *dst,
+                  const uint32_t *depth,
+                  const uint8_t *stencil,
+                  size_t numElements)
+{
+   auto layout = FormatLayout { };
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+
+   if (!getFormatLayout(format, layout) || !layout.isDepthStencil) {
+      return false;
+   }
+
+   auto &depthComponent = layout.components[0];
+   auto &stencilComponent = layout.components[1];
+   auto depthMask = static_cast<uint32_t>((uint64_t { 1 } << depthComponent.bits) - 1);
+   auto i = size_t { 0 };
+
+   if (layout.elementBits == 32) {
+      if (useAvx2()) {
+         i = avx2::mergeDepthStencil32(layout,
+                                       reinterpret_cast<uint32_t *>(dstBytes),
+                                       depth, stencil, numElements);
+      }
+
+      for (; i < numElements; ++i) {
+         auto element = ((depth[i] & depthMask) << depthComponent.offset)
+                      | (static_cast<uint32_t>(stencil[i]) << stencilComponent.offset);
+         std::memcpy(dstBytes + i * 4, &element, 4);
+      }
+   } else {
+      std::memset(dst, 0, numElements * layout.elementBits / 8);
+
+      for (; i < numElements; ++i) {
+         auto base = i * layout.elementBits;
+         writeBits(dstBytes, base + depthComponent.offset, depthComponent.bits, depth[i]);
+         writeBits(dstBytes, base + stencilComponent.offset, stencilComponent.bits, stencil[i]);
+      }
+   }
+
+   return true;
+}
+
+} // namespace formats
+
+} // namespace gpu
@@ -0,0 +1,322 @@
+#include "gpu_formats_avx2.h"
+
+#ifdef GPU_FORMATS_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace gpu
+{
+
+namespace formats
+{
+
+namespace avx2
+{
+
+#ifdef GPU_FORMATS_AVX2
+
+bool
+isSupported()
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 0);
+
+   if (info[0] < 7) {
+      return false;
+   }
+
+   // The OS must save the AVX state on context switch
+   __cpuid(info, 1);
+
+   if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) {
+      return false;
+   }
+
+   if ((_xgetbv(0) & 6) != 6) {
+      return false;
+   }
+
+   __cpuidex(info, 7, 0);
+   return !!(info[1] & (1 << 5));
+#else
+   __builtin_cpu_init();
+   return !!__builtin_cpu_supports("avx2");
+#endif
+}
+
+static AVX2_FUNCTION inline __m256i
+load(const void *src)
+{
+   return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+}
+
+static AVX2_FUNCTION inline void
+store(void *dst, __m256i x)
+{
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), x);
+}
+
+//! Load 8 elements of elementBits each, zero extended to 32 bits.
+static AVX2_FUNCTION inline __m256i
+loadElements(const uint8_t *src,
+             uint32_t elementBits)
+{
+   if (elementBits == 8) {
+      return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+   } else if (elementBits == 16) {
+      return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+   } else {
+      return load(src);
+   }
+}
+
+static AVX2_FUNCTION inline __m256i
+extractComponent(__m256i x,
+                 const FormatComponent &component)
+{
+   auto mask = static_cast<uint32_t>((uint64_t { 1 } << component.bits) - 1);
+   x = _mm256_srl_epi32(x, _mm_cvtsi32_si128(static_cast<int>(component.offset)));
+   return _mm256_and_si256(x, _mm256_set1_epi32(static_cast<int>(mask)));
+}
+
+//! Store the low byte of each 32 bit lane to 8 consecutive bytes.
+static AVX2_FUNCTION inline void
+storeLowBytes(uint8_t *dst,
+              __m256i x)
+{
+   auto gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+                                  -1, -1, -1, -1, -1, -1, -1, -1,
+                                  0, 4, 8, 12, -1, -1, -1, -1,
+                                  -1, -1, -1, -1, -1, -1, -1, -1);
+   x = _mm256_shuffle_epi8(x, gather);
+   x = _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+   _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(x));
+}
+
+AVX2_FUNCTION size_t
+endianSwap16(uint8_t *dst,
+             const uint8_t *src,
+             size_t count)
+{
+   auto shuffle = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                   1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+   auto i = size_t { 0 };
+
+   for (; i + 16 <= count; i += 16) {
+      store(dst + i * 2, _mm256_shuffle_epi8(load(src + i * 2), shuffle));
+   }
+
+   return i;
+}
+
+AVX2_FUNCTION size_t
+endianSwap32(uint8_t *dst,
+             const uint8_t *src,
+             size_t count)
+{
+   auto shuffle = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      store(dst + i * 4, _mm256_shuffle_epi8(load(src + i * 4), shuffle));
+   }
+
+   return i;
+}
+
+AVX2_FUNCTION size_t
+expandToRGBA8(const FormatLayout &layout,
+              uint8_t *dst,
+              const uint8_t *src,
+              size_t count)
+{
+   auto elementBytes = layout.elementBits / 8;
+   auto missing = _mm256_setzero_si256();
+   auto i = size_t { 0 };
+
+   if (layout.components[3].bits == 0) {
+      missing = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+   }
+
+   for (; i + 8 <= count; i += 8) {
+      auto x = loadElements(src + i * elementBytes, layout.elementBits);
+      auto result = missing;
+
+      for (auto c = 0u; c < 4; ++c) {
+         auto &component = layout.components[c];
+
+         if (!component.bits) {
+            continue;
+         }
+
+         // Replicate the component bits to fill 8 bits
+         auto value = extractComponent(x, component);
+         auto bits = static_cast<int>(component.bits);
+         auto expanded = _mm256_setzero_si256();
+
+         for (auto shift = 8 - bits; shift > -bits; shift -= bits) {
+            if (shift >= 0) {
+               expanded = _mm256_or_si256(expanded, _mm256_sll_epi32(value, _mm_cvtsi32_si128(shift)));
+            } else {
+               expanded = _mm256_or_si256(expanded, _mm256_srl_epi32(value, _mm_cvtsi32_si128(-shift)));
+            }
+         }
+
+         expanded = _mm256_and_si256(expanded, _mm256_set1_epi32(0xFF));
+         result = _mm256_or_si256(result, _mm256_sll_epi32(expanded, _mm_cvtsi32_si128(static_cast<int>(c * 8))));
+      }
+
+      store(dst + i * 4, result);
+   }
+
+   return i;
+}
+
+AVX2_FUNCTION size_t
+convert32(const FormatLayout &dstLayout,
+          uint32_t *dst,
+          const FormatLayout &srcLayout,
+          const uint32_t *src,
+          size_t count)
+{
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto x = load(src + i);
+      auto result = _mm256_setzero_si256();
+
+      for (auto c = 0u; c < 4; ++c) {
+         if (!srcLayout.components[c].bits) {
+            continue;
+         }
+
+         auto value = extractComponent(x, srcLayout.components[c]);
+         auto offset = _mm_cvtsi32_si128(static_cast<int>(dstLayout.components[c].offset));
+         result = _mm256_or_si256(result, _mm256_sll_epi32(value, offset));
+      }
+
+      store(dst + i, result);
+   }
+
+   return i;
+}
+
+AVX2_FUNCTION size_t
+splitDepthStencil32(const FormatLayout &layout,
+                    uint32_t *depth,
+                    uint8_t *stencil,
+                    const uint32_t *src,
+                    size_t count)
+{
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto x = load(src + i);
+      store(depth + i, extractComponent(x, layout.components[0]));
+      storeLowBytes(stencil + i, extractComponent(x, layout.components[1]));
+   }
+
+   return i;
+}
+
+AVX2_FUNCTION size_t
+mergeDepthStencil32(const FormatLayout &layout,
+                    uint32_t *dst,
+                    const uint32_t *depth,
+                    const uint8_t *stencil,
+                    size_t count)
+{
+   auto depthMask = static_cast<uint32_t>((uint64_t { 1 } << layout.components[0].bits) - 1);
+   auto depthOffset = _mm_cvtsi32_si128(static_cast<int>(layout.components[0].offset));
+   auto stencilOffset = _mm_cvtsi32_si128(static_cast<int>(layout.components[1].offset));
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto d = _mm256_and_si256(load(depth + i), _mm256_set1_epi32(static_cast<int>(depthMask)));
+      auto s = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(stencil + i)));
+      store(dst + i, _mm256_or_si256(_mm256_sll_epi32(d, depthOffset),
+                                     _mm256_sll_epi32(s, stencilOffset)));
+   }
+
+   return i;
+}
+
+#else
+
+bool
+isSupported()
+{
+   return false;
+}
+
+size_t
+endianSwap16(uint8_t *dst,
+             const uint8_t *src,
+             size_t count)
+{
+   return 0;
+}
+
+size_t
+endianSwap32(uint8_t *dst,
+             const uint8_t *src,
+             size_t count)
+{
+   return 0;
+}
+
+size_t
+expandToRGBA8(const FormatLayout &layout,
+              uint8_t *dst,
+              const uint8_t *src,
+              size_t count)
+{
+   return 0;
+}
+
+size_t
+convert32(const FormatLayout &dstLayout,
+          uint32_t *dst,
+          const FormatLayout &srcLayout,
+          const uint32_t *src,
+          size_t count)
+{
+   return 0;
+}
+
+size_t
+splitDepthStencil32(const FormatLayout &layout,
+                    uint32_t *depth,
+                    uint8_t *stencil,
+                    const uint32_t *src,
+                    size_t count)
+{
+   return 0;
+}
+
+size_t
+mergeDepthStencil32(const FormatLayout &layout,
+                    uint32_t *dst,
+                    const uint32_t *depth,
+                    const uint8_t *stencil,
+                    size_t count)
+{
+   return 0;
+}
+
+#endif // GPU_FORMATS_AVX2
+
+} // namespace avx2
+
+} // namespace formats
+
+} // namespace gpu
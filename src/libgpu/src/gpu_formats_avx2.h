@@ -0,0 +1,74 @@
+#pragma once
+#include "gpu_formats.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GPU_FORMATS_AVX2
+#endif
+
+namespace gpu
+{
+
+namespace formats
+{
+
+namespace avx2
+{
+
+/*
+ * Each kernel processes as many whole vectors of elements as it can and
+ * returns the number of elements it processed, the caller is responsible for
+ * finishing the remainder with the scalar implementation.
+ */
+
+bool
+isSupported();
+
+size_t
+endianSwap16(uint8_t *dst,
+             const uint8_t *src,
+             size_t count);
+
+size_t
+endianSwap32(uint8_t *dst,
+             const uint8_t *src,
+             size_t count);
+
+//! Element size must be 8, 16 or 32 bits.
+size_t
+expandToRGBA8(const FormatLayout &layout,
+              uint8_t *dst,
+              const uint8_t *src,
+              size_t count);
+
+//! Both formats must have 32 bit elements.
+size_t
+convert32(const FormatLayout &dstLayout,
+          uint32_t *dst,
+          const FormatLayout &srcLayout,
+          const uint32_t *src,
+          size_t count);
+
+//! Depth stencil format must have 32 bit elements.
+size_t
+splitDepthStencil32(const FormatLayout &layout,
+                    uint32_t *depth,
+                    uint8_t *stencil,
+                    const uint32_t *src,
+                    size_t count);
+
+//! Depth stencil format must have 32 bit elements.
+size_t
+mergeDepthStencil32(const FormatLayout &layout,
+                    uint32_t *dst,
+                    const uint32_t *depth,
+                    const uint8_t *stencil,
+                    size_t count);
+
+} // namespace avx2
+
+} // namespace formats
+
+} // namespace gpu
@@ -0,0 +1,338 @@
+#include "gpu_indexbuffer.h"
+#include "gpu_memory.h"
+
+#include <algorithm>
+#include <common/byte_swap_array.h>
+#include <common/decaf_assert.h>
+#include <common/murmur3.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define INDEXBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace gpu
+{
+
+//! Once the converted buffers exceed this size the cache is emptied.
+static constexpr size_t MaxCacheSize = 32 * 1024 * 1024;
+
+//! Once this many auto index buffers exist they are all discarded.
+static constexpr size_t MaxAutoBuffers = 256;
+
+static bool
+isExpandedPrimitive(latte::VGT_DI_PRIMITIVE_TYPE primType)
+{
+   return primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST
+       || primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST;
+}
+
+static uint32_t
+getConvertedCount(uint32_t count,
+                  latte::VGT_DI_PRIMITIVE_TYPE primType)
+{
+   if (isExpandedPrimitive(primType)) {
+      return (count / 4) * 6;
+   }
+
+   return count;
+}
+
+/**
+ * Expand each group of 4 indices to 2 triangles.
+ *
+ * Quads are split into [0, 1, 2] [0, 2, 3], rectangles use a different
+ * winding order and are split into [0, 1, 2] [2, 1, 3].
+ */
+template<typename IndexType>
+static void
+expandQuadIndices(IndexType *dst,
+                  const IndexType *src,
+                  uint32_t numQuads,
+                  bool isRects)
+{
+   auto i = 0u;
+
+#ifdef INDEXBUFFER_SSE2
+   if constexpr (std::is_same<IndexType, uint32_t>::value) {
+      // Two quads at a time, 8 indices in to 12 indices out
+      for (; i + 2 <= numQuads; i += 2) {
+         auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+         auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4 + 4));
+         auto out = reinterpret_cast<__m128i *>(dst + i * 6);
+
+         if (!isRects) {
+            _mm_storeu_si128(out + 0, _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 2, 1, 0)));
+            _mm_storeu_si128(out + 1, _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 2, 3, 2)), b));
+            _mm_storeu_si128(out + 2, _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 2, 0, 2)));
+         } else {
+            _mm_storeu_si128(out + 0, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 2, 1, 0)));
+            _mm_storeu_si128(out + 1, _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 3, 1)), b));
+            _mm_storeu_si128(out + 2, _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 2)));
+         }
+      }
+   }
+#endif
+
+   for (; i < numQuads; ++i) {
+      auto index_0 = src[i * 4 + 0];
+      auto index_1 = src[i * 4 + 1];
+      auto index_2 = src[i * 4 + 2];
+      auto index_3 = src[i * 4 + 3];
+      auto out = dst + i * 6;
+
+      out[0] = index_0;
+      out[1] = index_1;
+      out[2] = index_2;
+
+      if (!isRects) {
+         out[3] = index_0;
+         out[4] = index_2;
+         out[5] = index_3;
+      } else {
+         out[3] = index_2;
+         out[4] = index_1;
+         out[5] = index_3;
+      }
+   }
+}
+
+//! Generate the indices for a non-indexed draw of numQuads quads.
+static void
+generateQuadIndices(uint32_t *dst,
+                    uint32_t numQuads,
+                    bool isRects)
+{
+   auto i = 0u;
+
+#ifdef INDEXBUFFER_SSE2
+   auto pattern = isRects ? _mm_setr_epi32(0, 1, 2, 2) : _mm_setr_epi32(0, 1, 2, 0);
+   auto patternTail = isRects ? _mm_setr_epi32(1, 3, 4, 5) : _mm_setr_epi32(2, 3, 4, 5);
+   auto patternNext = isRects ? _mm_setr_epi32(6, 6, 5, 7) : _mm_setr_epi32(6, 4, 6, 7);
+
+   for (; i + 2 <= numQuads; i += 2) {
+      auto base = _mm_set1_epi32(static_cast<int>(i * 4));
+      auto out = reinterpret_cast<__m128i *>(dst + i * 6);
+      _mm_storeu_si128(out + 0, _mm_add_epi32(pattern, base));
+      _mm_storeu_si128(out + 1, _mm_add_epi32(patternTail, base));
+      _mm_storeu_si128(out + 2, _mm_add_epi32(patternNext, base));
+   }
+#endif
+
+   for (; i < numQuads; ++i) {
+      auto index = i * 4;
+      auto out = dst + i * 6;
+
+      out[0] = index + 0;
+      out[1] = index + 1;
+      out[2] = index + 2;
+
+      if (!isRects) {
+         out[3] = index + 0;
+         out[4] = index + 2;
+         out[5] = index + 3;
+      } else {
+         out[3] = index + 2;
+         out[4] = index + 1;
+         out[5] = index + 3;
+      }
+   }
+}
+
+static void
+convertIndices(IndexBuffer &buffer,
+               const void *src,
+               uint32_t count,
+               latte::VGT_INDEX_TYPE indexType,
+               latte::VGT_DMA_SWAP swapMode,
+               latte::VGT_DI_PRIMITIVE_TYPE primType)
+{
+   // Swap and index size are separate because you can have 32-bit swap,
+   //   but 16-bit indices in some cases...
+   if (swapMode == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
+      if (indexType != latte::VGT_INDEX_TYPE::INDEX_16) {
+         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", indexType));
+      }
+   } else if (swapMode == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
+      if (indexType != latte::VGT_INDEX_TYPE::INDEX_32) {
+         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", indexType));
+      }
+   } else if (swapMode != latte::VGT_DMA_SWAP::NONE) {
+      decaf_abort(fmt::format("Unimplemented VGT_DMA_SWAP {}", swapMode));
+   }
+
+   buffer.indexSize = (indexType == latte::VGT_INDEX_TYPE::INDEX_16) ? 2 : 4;
+   buffer.count = getConvertedCount(count, primType);
+   buffer.data.resize(buffer.count * buffer.indexSize);
+   buffer.generation++;
+
+   // Expand first, then swap the expanded indices in place, the expansion is
+   // only a permutation so the order of the two does not matter.
+   auto isRects = (primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST);
+
+   if (buffer.indexSize == 2) {
+      auto dst = reinterpret_cast<uint16_t *>(buffer.data.data());
+
+      if (isExpandedPrimitive(primType)) {
+         expandQuadIndices(dst, reinterpret_cast<const uint16_t *>(src), count / 4, isRects);
+      } else {
+         std::memcpy(dst, src, buffer.data.size());
+      }
+
+      if (swapMode == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
+         byte_swap_copy(dst, dst, buffer.count);
+      }
+   } else {
+      auto dst = reinterpret_cast<uint32_t *>(buffer.data.data());
+
+      if (isExpandedPrimitive(primType)) {
+         expandQuadIndices(dst, reinterpret_cast<const uint32_t *>(src), count / 4, isRects);
+      } else {
+         std::memcpy(dst, src, buffer.data.size());
+      }
+
+      if (swapMode == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
+         byte_swap_copy(dst, dst, buffer.count);
+      }
+   }
+}
+
+IndexBuffer *
+IndexBufferCache::getIndices(phys_addr address,
+                             uint32_t count,
+                             latte::VGT_INDEX_TYPE indexType,
+                             latte::VGT_DMA_SWAP swapMode,
+                             latte::VGT_DI_PRIMITIVE_TYPE primType)
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   auto key = Key { static_cast<uint32_t>(address), count, indexType, swapMode, primType };
+   auto itr = mBuffers.find(key);
+
+   if (itr == mBuffers.end()) {
+      evictIfFull();
+      itr = mBuffers.emplace(key, IndexBuffer { }).first;
+
+      auto size = count * ((indexType == latte::VGT_INDEX_TYPE::INDEX_16) ? 2u : 4u);
+      itr->second.cpuMemStart = address;
+      itr->second.cpuMemEnd = address + size;
+      mMaxBufferSize = std::max(mMaxBufferSize, size);
+   }
+
+   auto &buffer = itr->second;
+
+   if (buffer.dirtyMemory) {
+      auto src = gpu::internal::translateAddress(buffer.cpuMemStart);
+      auto size = static_cast<uint32_t>(buffer.cpuMemEnd - buffer.cpuMemStart);
+      uint64_t hash[2];
+      MurmurHash3_x64_128(src, size, 0, hash);
+
+      if (buffer.generation == 0 ||
+          hash[0] != buffer.cpuMemHash[0] ||
+          hash[1] != buffer.cpuMemHash[1]) {
+         mTotalSize -= buffer.data.size();
+         convertIndices(buffer, src, count, indexType, swapMode, primType);
+         mTotalSize += buffer.data.size();
+         buffer.cpuMemHash[0] = hash[0];
+         buffer.cpuMemHash[1] = hash[1];
+      }
+
+      buffer.dirtyMemory = false;
+   }
+
+   return &buffer;
+}
+
+IndexBuffer *
+IndexBufferCache::getImmediateIndices(const void *indices,
+                                      uint32_t count,
+                                      latte::VGT_INDEX_TYPE indexType,
+                                      latte::VGT_DMA_SWAP swapMode,
+                                      latte::VGT_DI_PRIMITIVE_TYPE primType)
+{
+   convertIndices(mImmediateBuffer, indices, count, indexType, swapMode, primType);
+   return &mImmediateBuffer;
+}
+
+IndexBuffer *
+IndexBufferCache::getAutoIndices(uint32_t count,
+                                 latte::VGT_DI_PRIMITIVE_TYPE primType)
+{
+   if (!isExpandedPrimitive(primType)) {
+      return nullptr;
+   }
+
+   std::unique_lock<std::mutex> lock { mMutex };
+   auto key = std::make_pair(count, primType);
+
+   if (mAutoBuffers.size() >= MaxAutoBuffers && !mAutoBuffers.count(key)) {
+      mAutoBuffers.clear();
+   }
+
+   auto &buffer = mAutoBuffers[key];
+
+   if (buffer.generation == 0) {
+      buffer.indexSize = 4;
+      buffer.count = getConvertedCount(count, primType);
+      buffer.data.resize(buffer.count * buffer.indexSize);
+      buffer.generation++;
+      buffer.dirtyMemory = false;
+      generateQuadIndices(reinterpret_cast<uint32_t *>(buffer.data.data()),
+                          count / 4,
+                          primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST);
+   }
+
+   return &buffer;
+}
+
+void
+IndexBufferCache::invalidate(phys_addr address,
+                             uint32_t size)
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   auto start = static_cast<uint32_t>(address);
+   auto end = start + size;
+
+   // Buffers are ordered by address so only those which start within
+   // mMaxBufferSize before the flushed range can overlap it.
+   auto first = (start > mMaxBufferSize) ? (start - mMaxBufferSize) : 0u;
+   auto itr = mBuffers.lower_bound(Key { first, 0, latte::VGT_INDEX_TYPE::INDEX_16,
+                                         latte::VGT_DMA_SWAP::NONE,
+                                         latte::VGT_DI_PRIMITIVE_TYPE::NONE });
+
+   for (; itr != mBuffers.end(); ++itr) {
+      auto &buffer = itr->second;
+
+      if (static_cast<uint32_t>(buffer.cpuMemStart) >= end) {
+         break;
+      }
+
+      if (static_cast<uint32_t>(buffer.cpuMemEnd) > start) {
+         buffer.dirtyMemory = true;
+      }
+   }
+}
+
+void
+IndexBufferCache::clear()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   mBuffers.clear();
+   mAutoBuffers.clear();
+   mMaxBufferSize = 0;
+   mTotalSize = 0;
+}
+
+void
+IndexBufferCache::evictIfFull()
+{
+   if (mTotalSize > MaxCacheSize) {
+      mBuffers.clear();
+      mMaxBufferSize = 0;
+      mTotalSize = 0;
+   }
+}
+
+} // namespace gpu
@@ -0,0 +1,111 @@
+#pragma once
+#include "latte/latte_enum_vgt.h"
+
+#include <cstdint>
+#include <libcpu/be2_struct.h>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace gpu
+{
+
+/**
+ * Host ready index data for a draw.
+ *
+ * Indices are in host endian and QUADLIST / RECTLIST draws have already been
+ * expanded to triangle lists.
+ */
+struct IndexBuffer
+{
+   //! Converted indices.
+   std::vector<uint8_t> data;
+
+   //! Number of indices in data.
+   uint32_t count = 0;
+
+   //! Size of each index in bytes, 2 or 4.
+   uint32_t indexSize = 4;
+
+   //! Incremented every time data is converted.
+   uint64_t generation = 0;
+
+   //! Backend owned, the generation of data which was last uploaded.
+   uint64_t uploadGeneration = ~0ull;
+
+   //! Backend owned, identifies where data was last uploaded to.
+   uint64_t uploadTag = 0;
+   uint64_t uploadOffset = 0;
+
+   //! Source range in guest memory.
+   phys_addr cpuMemStart;
+   phys_addr cpuMemEnd;
+
+   //! Hash of the source memory, used to skip conversion after a flush
+   //! which did not actually change the indices.
+   uint64_t cpuMemHash[2] = { 0, 0 };
+
+   //! True if a DCFlush has been received for the source memory.
+   bool dirtyMemory = true;
+};
+
+/**
+ * Converts guest index buffers to host ready index data and caches the
+ * result, so each unique buffer is only swapped and expanded once rather than
+ * on every draw.
+ *
+ * Buffers are keyed by guest address, index count, index type, swap mode and
+ * primitive type, and are revalidated when their memory is flushed by the CPU.
+ */
+class IndexBufferCache
+{
+public:
+   //! Indices for a draw from guest memory, e.g. DRAW_INDEX_2.
+   IndexBuffer *
+   getIndices(phys_addr address,
+              uint32_t count,
+              latte::VGT_INDEX_TYPE indexType,
+              latte::VGT_DMA_SWAP swapMode,
+              latte::VGT_DI_PRIMITIVE_TYPE primType);
+
+   //! Indices which do not live in guest memory, e.g. DRAW_INDEX_IMMD, these
+   //! are converted every time.
+   IndexBuffer *
+   getImmediateIndices(const void *indices,
+                       uint32_t count,
+                       latte::VGT_INDEX_TYPE indexType,
+                       latte::VGT_DMA_SWAP swapMode,
+                       latte::VGT_DI_PRIMITIVE_TYPE primType);
+
+   //! Indices for a non-indexed draw, only needed for primitive types which
+   //! have to be expanded. Returns nullptr if no indices are needed.
+   IndexBuffer *
+   getAutoIndices(uint32_t count,
+                  latte::VGT_DI_PRIMITIVE_TYPE primType);
+
+   //! Mark any buffers overlapping the memory range as dirty, this may be
+   //! called from any thread.
+   void
+   invalidate(phys_addr address,
+              uint32_t size);
+
+   void
+   clear();
+
+private:
+   using Key = std::tuple<uint32_t, uint32_t, latte::VGT_INDEX_TYPE,
+                          latte::VGT_DMA_SWAP, latte::VGT_DI_PRIMITIVE_TYPE>;
+
+   void
+   evictIfFull();
+
+   std::mutex mMutex;
+   std::map<Key, IndexBuffer> mBuffers;
+   std::map<std::pair<uint32_t, latte::VGT_DI_PRIMITIVE_TYPE>, IndexBuffer> mAutoBuffers;
+   IndexBuffer mImmediateBuffer;
+   uint32_t mMaxBufferSize = 0;
+   size_t mTotalSize = 0;
+};
+
+} // namespace gpu
@@ -0,0 +1,242 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gpu
+{
+
+/**
+ * An index of half open address ranges [start, end) which supports fast
+ * overlap queries.
+ *
+ * The ranges are kept in a flat array sorted by start address which is
+ * indexed as an implicit, augmented binary search tree: every element stores
+ * the maximum end address of its subtree. An overlap query is then
+ * O(log n + k) and touches only contiguous memory.
+ *
+ * Modifications take a lock and mark the index as stale, the next query
+ * rebuilds it and publishes an immutable snapshot. Queries on an up to date
+ * index do not take any lock, so frequent queries from many threads (such as
+ * DCFlush notifications) do not contend with each other. The values stored in
+ * the map must remain valid for as long as a query may be visiting them.
+ */
+template<typename ValueType>
+class IntervalMap
+{
+   struct Entry
+   {
+      uint32_t start;
+      uint32_t end;
+
+      //! Maximum end of all the entries in this entry's subtree.
+      uint32_t maxEnd;
+      ValueType value;
+   };
+
+   struct Index
+   {
+      std::vector<Entry> entries;
+      int rootLevel = -1;
+   };
+
+public:
+   IntervalMap() :
+      mIndex(std::make_shared<const Index>())
+   {
+   }
+
+   void
+   insert(uint32_t start,
+          uint32_t end,
+          ValueType value)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      auto entry = Entry { start, end, end, value };
+      auto pos = std::upper_bound(mEntries.begin(), mEntries.end(), start,
+                                  [](uint32_t start, const Entry &entry) {
+                                     return start < entry.start;
+                                  });
+      mEntries.insert(pos, entry);
+      mStale.store(true, std::memory_order_release);
+   }
+
+   bool
+   erase(uint32_t start,
+         uint32_t end,
+         ValueType value)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      auto pos = std::lower_bound(mEntries.begin(), mEntries.end(), start,
+                                  [](const Entry &entry, uint32_t start) {
+                                     return entry.start < start;
+                                  });
+
+      for (; pos != mEntries.end() && pos->start == start; ++pos) {
+         if (pos->end == end && pos->value == value) {
+            mEntries.erase(pos);
+            mStale.store(true, std::memory_order_release);
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   void
+   clear()
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mEntries.clear();
+      mStale.store(true, std::memory_order_release);
+   }
+
+   size_t
+   size()
+   {
+      return getIndex()->entries.size();
+   }
+
+   /**
+    * Call func(value, start, end) for every range which overlaps
+    * [start, end), in order of start address.
+    */
+   template<typename Func>
+   void
+   forEachOverlapping(uint32_t start,
+                      uint32_t end,
+                      Func &&func)
+   {
+      auto index = getIndex();
+      auto &entries = index->entries;
+      auto n = static_cast<int64_t>(entries.size());
+
+      if (n == 0 || start >= end) {
+         return;
+      }
+
+      struct StackEntry
+      {
+         int64_t x;
+         int level;
+         bool leftDone;
+      };
+
+      StackEntry stack[64];
+      auto top = 0;
+      stack[top++] = { (int64_t { 1 } << index->rootLevel) - 1, index->rootLevel, false };
+
+      while (top) {
+         auto node = stack[--top];
+
+         if (node.level <= 3) {
+            // Small subtree, a linear scan is faster than descending further
+            auto i0 = node.x >> node.level << node.level;
+            auto i1 = std::min(i0 + (int64_t { 1 } << (node.level + 1)) - 1, n);
+
+            for (auto i = i0; i < i1 && entries[i].start < end; ++i) {
+               if (start < entries[i].end) {
+                  func(entries[i].value, entries[i].start, entries[i].end);
+               }
+            }
+         } else if (!node.leftDone) {
+            // Revisit this node after its left subtree, which is only visited
+            // if it may contain an overlapping range. The left child may be
+            // past the end of the array when the tree is not full.
+            auto left = node.x - (int64_t { 1 } << (node.level - 1));
+            stack[top++] = { node.x, node.level, true };
+
+            if (left >= n || entries[left].maxEnd > start) {
+               stack[top++] = { left, node.level - 1, false };
+            }
+         } else if (node.x < n && entries[node.x].start < end) {
+            if (start < entries[node.x].end) {
+               func(entries[node.x].value, entries[node.x].start, entries[node.x].end);
+            }
+
+            stack[top++] = { node.x + (int64_t { 1 } << (node.level - 1)), node.level - 1, false };
+         }
+      }
+   }
+
+private:
+   std::shared_ptr<const Index>
+   getIndex()
+   {
+      if (mStale.load(std::memory_order_acquire)) {
+         std::unique_lock<std::mutex> lock { mMutex };
+
+         if (mStale.load(std::memory_order_relaxed)) {
+            std::atomic_store(&mIndex, rebuildIndex());
+            mStale.store(false, std::memory_order_release);
+         }
+      }
+
+      return std::atomic_load(&mIndex);
+   }
+
+   //! Build an index from mEntries, must be called with mMutex held.
+   std::shared_ptr<const Index>
+   rebuildIndex()
+   {
+      auto index = std::make_shared<Index>();
+      auto &entries = index->entries;
+      auto n = static_cast<int64_t>(mEntries.size());
+      entries = mEntries;
+
+      if (n == 0) {
+         return index;
+      }
+
+      // Leaves are the even indices
+      auto lastIndex = int64_t { 0 };
+      auto lastMax = uint32_t { 0 };
+
+      for (auto i = int64_t { 0 }; i < n; i += 2) {
+         lastIndex = i;
+         lastMax = entries[i].maxEnd = entries[i].end;
+      }
+
+      // Then each level of internal nodes from the bottom up
+      auto level = 1;
+
+      for (; (int64_t { 1 } << level) <= n; ++level) {
+         auto x = int64_t { 1 } << (level - 1);
+         auto first = (x << 1) - 1;
+         auto step = x << 2;
+
+         for (auto i = first; i < n; i += step) {
+            auto leftMax = entries[i - x].maxEnd;
+            auto rightMax = (i + x < n) ? entries[i + x].maxEnd : lastMax;
+            entries[i].maxEnd = std::max({ entries[i].end, leftMax, rightMax });
+         }
+
+         // Move lastIndex up to its parent
+         lastIndex = ((lastIndex >> level) & 1) ? lastIndex - x : lastIndex + x;
+
+         if (lastIndex < n && entries[lastIndex].maxEnd > lastMax) {
+            lastMax = entries[lastIndex].maxEnd;
+         }
+      }
+
+      index->rootLevel = level - 1;
+      return index;
+   }
+
+private:
+   std::mutex mMutex;
+
+   //! All ranges sorted by start, protected by mMutex.
+   std::vector<Entry> mEntries;
+
+   //! Set when mEntries has changed since mIndex was built.
+   std::atomic<bool> mStale { false };
+
+   //! Only accessed through std::atomic_load and std::atomic_store.
+   std::shared_ptr<const Index> mIndex;
+};
+
+} // namespace gpu
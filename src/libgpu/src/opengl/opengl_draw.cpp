@@ -2,7 +2,9 @@
 #include "gpu_memory.h"
 #include "opengl_driver.h"
 
+#include <common/align.h>
 #include <common/decaf_assert.h>
+#include <cstring>
 #include <fmt/format.h>
 #include <glbinding/gl/gl.h>
 #include <glbinding/Meta.h>
@@ -105,103 +107,97 @@ getPrimitiveMode(latte::VGT_DI_PRIMITIVE_TYPE type)
    }
 }
 
-template<typename IndexType>
 static void
 drawPrimitives2(gl::GLenum mode,
                 uint32_t count,
-                const IndexType *indices,
+                gl::GLenum indexType,
+                const void *indices,
                 uint32_t baseVertex,
                 uint32_t numInstances,
                 uint32_t baseInstance)
 {
-   static_assert(std::is_same<IndexType, uint16_t>::value || std::is_same<IndexType, uint32_t>::value);
-
    if (numInstances == 1) {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArrays(mode, baseVertex, count);
-      } else if constexpr (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_SHORT, indices, baseVertex);
-      } else if constexpr (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_INT, indices, baseVertex);
+      } else {
+         gl::glDrawElementsBaseVertex(mode, count, indexType, indices, baseVertex);
       }
    } else {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArraysInstancedBaseInstance(mode, 0, count, numInstances, baseInstance);
-      } else if constexpr (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_SHORT, indices, numInstances, baseInstance);
-      } else if constexpr (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_INT, indices, numInstances, baseInstance);
+      } else {
+         gl::glDrawElementsInstancedBaseInstance(mode, count, indexType, indices, numInstances, baseInstance);
       }
    }
 }
 
-template<bool IsRects, typename IndexType>
-static void
-unpackQuadRectList(uint32_t count,
-               const IndexType *src,
-               uint32_t baseVertex,
-               uint32_t numInstances,
-               uint32_t baseInstance)
+/**
+ * Copy converted indices to the index ring and bind it.
+ *
+ * Returns the offset of the indices in the bound element array buffer, an
+ * upload is reused if it is in the segment of the ring currently being filled.
+ */
+const void *
+GLDriver::uploadIndices(gpu::IndexBuffer *indices)
 {
-   auto tris = (count / 4) * 6;
-   auto unpacked = std::vector<IndexType>(tris);
-   auto dst = &unpacked[0];
-
-   // Unpack quad indices into triangle indices
-   if (src) {
-      for (auto i = 0u; i < count / 4; ++i) {
-         auto index_0 = *src++;
-         auto index_1 = *src++;
-         auto index_2 = *src++;
-         auto index_3 = *src++;
-
-         *(dst++) = index_0;
-         *(dst++) = index_1;
-         *(dst++) = index_2;
-
-         if (!IsRects) {
-            *(dst++) = index_0;
-            *(dst++) = index_2;
-            *(dst++) = index_3;
-         } else {
-            // Rectangles use a different winding order apparently...
-            *(dst++) = index_2;
-            *(dst++) = index_1;
-            *(dst++) = index_3;
-         }
-      }
-   } else {
-      auto index_0 = 0u;
-      auto index_1 = 1u;
-      auto index_2 = 2u;
-      auto index_3 = 3u;
-
-      for (auto i = 0u; i < count / 4; ++i) {
-         auto index = i * 4;
-         *(dst++) = index_0 + index;
-         *(dst++) = index_1 + index;
-         *(dst++) = index_2 + index;
-
-         if (!IsRects) {
-            *(dst++) = index_0 + index;
-            *(dst++) = index_2 + index;
-            *(dst++) = index_3 + index;
-         } else {
-            // Rectangles use a different winding order apparently...
-            *(dst++) = index_2 + index;
-            *(dst++) = index_1 + index;
-            *(dst++) = index_3 + index;
+   auto size = indices->data.size();
+
+   if (!mIndexRingBuffer || size > IndexRingSegmentSize) {
+      // Too large for the ring, fall back to a client side array
+      gl::glBindBuffer(gl::GL_ELEMENT_ARRAY_BUFFER, 0);
+      return indices->data.data();
+   }
+
+   gl::glBindBuffer(gl::GL_ELEMENT_ARRAY_BUFFER, mIndexRingBuffer);
+
+   auto segmentIndex = mIndexRingOffset / IndexRingSegmentSize;
+
+   // Only reuse uploads in the current segment, an older segment's fence was
+   // created when the ring left it so it does not cover draws issued since.
+   if (indices->uploadGeneration == indices->generation &&
+       indices->uploadTag == mIndexRingSegments[segmentIndex].tag) {
+      return reinterpret_cast<const void *>(static_cast<uintptr_t>(indices->uploadOffset));
+   }
+
+   if (mIndexRingOffset + size > (segmentIndex + 1) * IndexRingSegmentSize) {
+      // Fence the current segment and move on to the next one, waiting for
+      // the GPU to finish with it if needed.
+      auto &current = mIndexRingSegments[segmentIndex];
+      current.fence = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, static_cast<gl::UnusedMask>(0));
+
+      segmentIndex = (segmentIndex + 1) % IndexRingNumSegments;
+      auto &next = mIndexRingSegments[segmentIndex];
+
+      if (next.fence) {
+         auto result = gl::glClientWaitSync(next.fence, gl::GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+
+         while (result == gl::GL_TIMEOUT_EXPIRED) {
+            gLog->warn("Still waiting for GPU to release index ring segment {}", segmentIndex);
+            result = gl::glClientWaitSync(next.fence, gl::GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
          }
+
+         decaf_check(result != gl::GL_WAIT_FAILED);
+         gl::glDeleteSync(next.fence);
+         next.fence = nullptr;
       }
+
+      next.tag = ++mIndexRingTagCounter;
+      mIndexRingOffset = segmentIndex * IndexRingSegmentSize;
    }
 
-   drawPrimitives2(gl::GL_TRIANGLES, tris, unpacked.data(), baseVertex, numInstances, baseInstance);
+   auto offset = mIndexRingOffset;
+   std::memcpy(mIndexRingMapped + offset, indices->data.data(), size);
+   mIndexRingOffset = align_up(offset + size, 4);
+
+   indices->uploadGeneration = indices->generation;
+   indices->uploadTag = mIndexRingSegments[segmentIndex].tag;
+   indices->uploadOffset = offset;
+   return reinterpret_cast<const void *>(static_cast<uintptr_t>(offset));
 }
 
 void
 GLDriver::drawPrimitives(uint32_t count,
-                         const void *indices,
-                         latte::VGT_INDEX_TYPE indexFmt)
+                         gpu::IndexBuffer *indices)
 {
    auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
    auto vgt_dma_num_instances = getRegister<latte::VGT_DMA_NUM_INSTANCES>(latte::Register::VGT_DMA_NUM_INSTANCES);
@@ -236,24 +232,12 @@ GLDriver::drawPrimitives(uint32_t count,
       }
    }
 
-   if (primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST) {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
-   } else if (primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST) {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
+   if (indices) {
+      auto indexType = (indices->indexSize == 2) ? gl::GL_UNSIGNED_SHORT : gl::GL_UNSIGNED_INT;
+      auto offset = uploadIndices(indices);
+      drawPrimitives2(mode, indices->count, indexType, offset, baseVertex, numInstances, baseInstance);
    } else {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
+      drawPrimitives2(mode, count, gl::GL_NONE, nullptr, baseVertex, numInstances, baseInstance);
    }
 
    if (vgt_strmout_en.STREAMOUT()) {
@@ -262,80 +246,64 @@ GLDriver::drawPrimitives(uint32_t count,
 }
 
 void
-GLDriver::drawPrimitivesIndexed(const void *buffer,
-                                uint32_t count)
+GLDriver::drawIndexAuto(const latte::pm4::DrawIndexAuto &data)
 {
    if (!checkReadyDraw()) {
       return;
    }
 
-   auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
-
-   // Swap and indexBytes are separate because you can have 32-bit swap,
-   //   but 16-bit indices in some cases...  This is also why we pre-swap
-   //   the data before intercepting QUAD and POLYGON draws.
-   if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
-      auto *src = reinterpret_cast<const uint16_t *>(buffer);
-      auto indices = std::vector<uint16_t>(count);
+   auto indices = getPreparedIndices();
 
-      if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_16) {
-         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
-      }
-
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
-      drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
-      auto *src = reinterpret_cast<const uint32_t *>(buffer);
-      auto indices = std::vector<uint32_t>(count);
-
-      if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_32) {
-         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
-      }
-
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
-      drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::NONE) {
-      drawPrimitives(count,
-                     buffer,
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else {
-      decaf_abort(fmt::format("Unimplemented vgt_dma_index_type.SWAP_MODE {}", vgt_dma_index_type.SWAP_MODE()));
+   if (!indices) {
+      auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+      indices = mIndexBufferCache.getAutoIndices(data.count, vgt_primitive_type.PRIM_TYPE());
    }
+
+   drawPrimitives(data.count, indices);
 }
 
 void
-GLDriver::drawIndexAuto(const latte::pm4::DrawIndexAuto &data)
+GLDriver::drawIndex2(const latte::pm4::DrawIndex2 &data)
 {
    if (!checkReadyDraw()) {
       return;
    }
 
-   drawPrimitives(data.count,
-                  nullptr,
-                  latte::VGT_INDEX_TYPE::INDEX_32);
-}
+   auto indices = getPreparedIndices();
 
-void
-GLDriver::drawIndex2(const latte::pm4::DrawIndex2 &data)
-{
-   drawPrimitivesIndexed(phys_cast<void *>(data.addr).getRawPointer(),
-                         data.count);
+   if (!indices) {
+      auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+      auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
+      indices = mIndexBufferCache.getIndices(data.addr,
+                                             data.count,
+                                             vgt_dma_index_type.INDEX_TYPE(),
+                                             vgt_dma_index_type.SWAP_MODE(),
+                                             vgt_primitive_type.PRIM_TYPE());
+   }
+
+   drawPrimitives(data.count, indices);
 }
 
 void
 GLDriver::drawIndexImmd(const latte::pm4::DrawIndexImmd &data)
 {
-   drawPrimitivesIndexed(data.indices.data(), data.count);
+   if (!checkReadyDraw()) {
+      return;
+   }
+
+   auto indices = getPreparedIndices();
+
+   if (!indices) {
+      auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+      auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
+      indices = mIndexBufferCache.getImmediateIndices(data.indices.data(),
+                                                      data.count,
+                                                      vgt_dma_index_type.INDEX_TYPE(),
+                                                      vgt_dma_index_type.SWAP_MODE(),
+                                                      vgt_primitive_type.PRIM_TYPE());
+   }
+
+   drawPrimitives(data.count, indices);
 }
 
 void
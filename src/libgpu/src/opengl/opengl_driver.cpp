@@ -1,6 +1,7 @@
 #ifdef DECAF_GL
 #include "gpu_config.h"
 #include "gpu_event.h"
+#include "gpu_formats.h"
 #include "gpu_ringbuffer.h"
 #include "gpu_memory.h"
 #include "latte/latte_registers.h"
@@ -38,6 +39,8 @@ GLDriver::initialise()
       applyRegister(static_cast<latte::Register>(i * 4));
    }
 
+   markAllRegisterGroupsDirty();
+
    mActiveShader = nullptr;
    mDrawBuffers.fill(gl::GL_NONE);
    mGLStateCache.blendEnable.fill(false);
@@ -78,6 +81,32 @@ GLDriver::initialise()
    gl::GLint value;
    gl::glGetIntegerv(gl::GL_MAX_UNIFORM_BLOCK_SIZE, &value);
    MaxUniformBlockSize = value;
+
+   // Create the persistently mapped ring which index data is uploaded to
+   auto ringUsage = gl::BufferStorageMask::GL_NONE_BIT;
+   ringUsage |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+
+   auto ringAccess = gl::BufferAccessMask::GL_NONE_BIT;
+   ringAccess |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+
+   gl::glCreateBuffers(1, &mIndexRingBuffer);
+   gl::glNamedBufferStorage(mIndexRingBuffer, IndexRingSize, nullptr, ringUsage);
+   mIndexRingMapped = static_cast<uint8_t *>(gl::glMapNamedBufferRange(mIndexRingBuffer, 0, IndexRingSize, ringAccess));
+
+   if (!mIndexRingMapped) {
+      gLog->warn("Could not map index ring, falling back to client side index arrays");
+      gl::glDeleteBuffers(1, &mIndexRingBuffer);
+      mIndexRingBuffer = 0;
+   } else if (gpu::config::debug) {
+      gl::glObjectLabel(gl::GL_BUFFER, mIndexRingBuffer, -1, "index ring");
+   }
+
+   for (auto &segment : mIndexRingSegments) {
+      segment.fence = nullptr;
+      segment.tag = ++mIndexRingTagCounter;
+   }
+
+   mIndexRingOffset = 0;
 }
 
 void
@@ -313,6 +342,13 @@ GLDriver::decafCopySurface(const latte::pm4::DecafCopySurface &data)
    decaf_check(data.dstDepth == data.srcDepth);
    decaf_check(data.dstDim == data.srcDim);
 
+   // Depth stencil surfaces must be copied between the depth buffer host
+   // surfaces, as those are what hold the rendered data
+   auto dstLayout = gpu::formats::FormatLayout { };
+   auto srcLayout = gpu::formats::FormatLayout { };
+   gpu::formats::getFormatLayout(data.dstFormat, dstLayout);
+   gpu::formats::getFormatLayout(data.srcFormat, srcLayout);
+
    auto dstBuffer = getSurfaceBuffer(
       data.dstImage,
       data.dstPitch,
@@ -325,7 +361,7 @@ GLDriver::decafCopySurface(const latte::pm4::DecafCopySurface &data)
       data.dstNumFormat,
       data.dstFormatComp,
       data.dstDegamma,
-      false,
+      dstLayout.isDepthStencil,
       data.dstTileMode,
       true,
       true);
@@ -342,7 +378,7 @@ GLDriver::decafCopySurface(const latte::pm4::DecafCopySurface &data)
       data.srcNumFormat,
       data.srcFormatComp,
       data.srcDegamma,
-      false,
+      srcLayout.isDepthStencil,
       data.srcTileMode,
       false,
       false);
@@ -402,10 +438,8 @@ GLDriver::surfaceSync(const latte::pm4::SurfaceSync &data)
    }
 
    std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
-   auto iter = mResourceMap.getIterator(memStart, memEnd - memStart);
 
-   Resource *resource;
-   while ((resource = iter.next()) != nullptr) {
+   mResourceMap.forEachResource(memStart, memEnd - memStart, [&](Resource *resource) {
       switch (resource->type) {
 
       case Resource::SURFACE:
@@ -435,7 +469,7 @@ GLDriver::surfaceSync(const latte::pm4::SurfaceSync &data)
             }
          }
       }
-   }
+   });
 }
 
 void
@@ -480,6 +514,17 @@ GLDriver::updateDebuggerInfo()
    mDebuggerInfo.numShaderPipelines = mShaderPipelines.size();
    mDebuggerInfo.numSurfaces = mSurfaces.size();
    mDebuggerInfo.numDataBuffers = mDataBuffers.size();
+
+   auto stats = mPipeline ? mPipeline->getStats() : mSerialStats;
+   auto toMs = [](uint64_t ns) { return static_cast<double>(ns) / 1000000.0; };
+   mDebuggerInfo.pm4Pipelined = !!mPipeline;
+   mDebuggerInfo.pm4ParseMs = toMs(stats.parseTime - mLastFrameStats.parseTime);
+   mDebuggerInfo.pm4SubmitMs = toMs(stats.submitTime - mLastFrameStats.submitTime);
+   mDebuggerInfo.pm4ParseStallMs = toMs(stats.parseStallTime - mLastFrameStats.parseStallTime);
+   mDebuggerInfo.pm4SubmitStallMs = toMs(stats.submitStallTime - mLastFrameStats.submitStallTime);
+   mDebuggerInfo.pm4QueueDepth = stats.queueDepth;
+   mDebuggerInfo.pm4MaxQueueDepth = stats.maxQueueDepth;
+   mLastFrameStats = stats;
 }
 
 uint64_t
@@ -639,14 +684,42 @@ GLDriver::executeBuffer(const gpu::ringbuffer::Item &item)
    runRemoteThreadTasks();
 
    // Execute command buffer
+   auto start = std::chrono::steady_clock::now();
    runCommandBuffer(item.buffer.getRawPointer(), item.numWords);
 
+   auto elapsed = std::chrono::steady_clock::now() - start;
+   mSerialStats.numBuffers++;
+   mSerialStats.submitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
    // Release command buffer when it finishes executing
    addFenceSync([=](){
       gpu::onRetire(item.context);
    });
 }
 
+void
+GLDriver::executeStream(Pm4CommandStream *stream)
+{
+   // Run any remote tasks first
+   runRemoteThreadTasks();
+
+   // Execute the already parsed command buffer
+   auto start = std::chrono::steady_clock::now();
+   runCommandStream(*stream);
+
+   auto elapsed = std::chrono::steady_clock::now() - start;
+   auto context = stream->item.context;
+   auto retireItem = stream->retireItem;
+   mPipeline->releaseStream(stream, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+   // Release command buffer when its last stream finishes executing
+   if (retireItem) {
+      addFenceSync([=](){
+         gpu::onRetire(context);
+      });
+   }
+}
+
 void
 GLDriver::addFenceSync(std::function<void()> func)
 {
@@ -756,12 +829,12 @@ GLDriver::notifyCpuFlush(phys_addr address,
                          uint32_t size)
 {
    std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
-   auto iter = mResourceMap.getIterator(phys_addr { address }, size);
 
-   Resource *resource;
-   while ((resource = iter.next()) != nullptr) {
+   mResourceMap.forEachResource(address, size, [](Resource *resource) {
       resource->dirtyMemory = true;
-   }
+   });
+
+   mIndexBufferCache.invalidate(address, size);
 }
 
 void
@@ -772,31 +845,20 @@ GLDriver::notifyGpuFlush(phys_addr address,
 
    auto memStart = phys_addr { address };
    auto memEnd = memStart + size;
-   auto iter = mOutputBufferMap.getIterator(memStart, size);
-
-   // This allows us to avoid downloading a buffer twice if we hit both its
-   //  endpoints in the scan (as will happen if memStart/memEnd coincide
-   //  with a buffer's range).
-   auto flushStamp = ++mGpuFlushCounter;
 
-   Resource *resource;
-   while ((resource = iter.next()) != nullptr) {
+   mOutputBufferMap.forEachResource(memStart, size, [&](Resource *resource) {
       decaf_check(resource->type == Resource::DATA_BUFFER);
       DataBuffer *buffer = reinterpret_cast<DataBuffer *>(resource);
 
-      if (buffer->lastGpuFlush != flushStamp) {
-         buffer->lastGpuFlush = flushStamp;
+      auto copyOffset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
+      auto copySize = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - copyOffset;
 
-         auto copyOffset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
-         auto copySize = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - copyOffset;
-
-         runOnGLThread([=](){
-            downloadDataBuffer(buffer, copyOffset, copySize);
-         });
+      runOnGLThread([=](){
+         downloadDataBuffer(buffer, copyOffset, copySize);
+      });
 
-         buffer->dirtyMemory = false;
-      }
-   }
+      buffer->dirtyMemory = false;
+   });
 }
 
 void
@@ -833,6 +895,11 @@ GLDriver::run()
 
    mRunState = RunState::Running;
 
+   if (gpu::config::pipeline_pm4) {
+      runPipelined();
+      return;
+   }
+
    while (mRunState == RunState::Running) {
       auto item = gpu::ringbuffer::Item { };
 
@@ -851,6 +918,34 @@ GLDriver::run()
    }
 }
 
+void
+GLDriver::runPipelined()
+{
+   mPipeline = std::make_unique<Pm4Pipeline>(mIndexBufferCache);
+   mPipeline->start();
+
+   while (mRunState == RunState::Running) {
+      auto stream = static_cast<Pm4CommandStream *>(nullptr);
+
+      if (mSyncList.empty()) {
+         stream = mPipeline->waitForStream();
+      } else {
+         stream = mPipeline->dequeueStream();
+      }
+
+      if (stream) {
+         executeStream(stream);
+         checkSyncObjects(0);
+      } else {
+         // Woken by runOnGLThread or stop
+         runRemoteThreadTasks();
+         checkSyncObjects(10000);  // 10 usec
+      }
+   }
+
+   mPipeline->stop();
+}
+
 void
 GLDriver::stop()
 {
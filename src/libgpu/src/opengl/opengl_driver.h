@@ -2,12 +2,14 @@
 #ifdef DECAF_GL
 
 #include "glsl2/glsl2_translate.h"
+#include "gpu_indexbuffer.h"
 #include "gpu_ringbuffer.h"
 #include "gpu_opengldriver.h"
 #include "latte/latte_constants.h"
 #include "latte/latte_contextstate.h"
 #include "latte/latte_pm4_commands.h"
 #include "opengl_resource.h"
+#include "pm4_pipeline.h"
 #include "pm4_processor.h"
 
 #include <chrono>
@@ -20,6 +22,7 @@
 #include <libcpu/mem.h>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
@@ -163,7 +166,6 @@ struct DataBuffer : public Resource
    bool isInput = false;  // Uniform or attribute buffers
    bool isOutput = false;  // Transform feedback buffers
    bool dirtyMap = false;  // True if we need to glFlushMappedBufferRange
-   uint32_t lastGpuFlush = 0;  // Last time we touched this buffer in notifyGpuFlush()
 
    DataBuffer() : Resource(Resource::DATA_BUFFER) { }
 };
@@ -181,6 +183,21 @@ struct FeedbackBufferState
    uint32_t currentOffset;
 };
 
+//! Size of the persistently mapped ring which index data is uploaded to.
+static constexpr size_t IndexRingSize = 16 * 1024 * 1024;
+static constexpr size_t IndexRingNumSegments = 8;
+static constexpr size_t IndexRingSegmentSize = IndexRingSize / IndexRingNumSegments;
+
+struct IndexRingSegment
+{
+   //! Signalled once the GPU has finished with the draws using this segment.
+   gl::GLsync fence = nullptr;
+
+   //! Changed every time the segment is reused, so cached uploads to the
+   //! segment can be detected as overwritten.
+   uint64_t tag = 0;
+};
+
 struct ColorBufferCache
 {
    gl::GLuint object = 0;
@@ -345,7 +362,9 @@ public:
    stopFrameCapture() override;
 
 private:
+   void runPipelined();
    void executeBuffer(const gpu::ringbuffer::Item &item);
+   void executeStream(Pm4CommandStream *stream);
    uint64_t getGpuClock();
 
    void decafSetBuffer(const latte::pm4::DecafSetBuffer &data) override;
@@ -496,14 +515,12 @@ private:
    void
    runRemoteThreadTasks();
 
-   void
-   drawPrimitives(uint32_t count,
-                  const void *indices,
-                  latte::VGT_INDEX_TYPE indexFmt);
+   const void *
+   uploadIndices(gpu::IndexBuffer *indices);
 
    void
-   drawPrimitivesIndexed(const void *indices,
-                         uint32_t count);
+   drawPrimitives(uint32_t count,
+                  gpu::IndexBuffer *indices);
 
    bool
    dumpScanBuffer(const std::string &filename,
@@ -524,10 +541,6 @@ private:
    std::thread mThread;
    unsigned mSwapInterval = 1;
 
-   bool mViewportDirty = false;
-   bool mDepthRangeDirty = false;
-   bool mScissorDirty = false;
-
    std::unordered_map<uint64_t, FetchShader *> mFetchShaders;
    std::unordered_map<uint64_t, VertexShader *> mVertexShaders;
    std::unordered_map<uint64_t, PixelShader *> mPixelShaders;
@@ -537,7 +550,13 @@ private:
 
    ResourceMemoryMap mResourceMap;
    ResourceMemoryMap mOutputBufferMap;
-   uint32_t mGpuFlushCounter = 0;
+
+   gpu::IndexBufferCache mIndexBufferCache;
+   gl::GLuint mIndexRingBuffer = 0;
+   uint8_t *mIndexRingMapped = nullptr;
+   size_t mIndexRingOffset = 0;
+   uint64_t mIndexRingTagCounter = 0;
+   std::array<IndexRingSegment, IndexRingNumSegments> mIndexRingSegments;
 
    std::array<Sampler, latte::MaxSamplers> mVertexSamplers;
    std::array<Sampler, latte::MaxSamplers> mPixelSamplers;
@@ -589,6 +608,10 @@ private:
    bool mFrameCaptureTV = false;
    bool mFrameCaptureDRC = false;
 
+   std::unique_ptr<Pm4Pipeline> mPipeline;
+   Pm4PipelineStats mSerialStats;      // Stats when not pipelined
+   Pm4PipelineStats mLastFrameStats;   // Stats at the last swap
+
    gpu::OpenGLDriver::DebuggerInfo mDebuggerInfo;
 };
 
@@ -208,25 +208,6 @@ GLDriver::applyRegister(latte::Register reg)
                        cb_blend_alpha.BLEND_ALPHA());
    } break;
 
-   case latte::Register::PA_CL_VPORT_XSCALE_0:
-   case latte::Register::PA_CL_VPORT_XOFFSET_0:
-   case latte::Register::PA_CL_VPORT_YSCALE_0:
-   case latte::Register::PA_CL_VPORT_YOFFSET_0:
-      mViewportDirty = true;
-      break;
-
-   case latte::Register::PA_CL_VPORT_ZSCALE_0:
-   case latte::Register::PA_CL_VPORT_ZOFFSET_0:
-   case latte::Register::PA_SC_VPORT_ZMIN_0:
-   case latte::Register::PA_SC_VPORT_ZMAX_0:
-      mDepthRangeDirty = true;
-      break;
-
-   case latte::Register::PA_SC_GENERIC_SCISSOR_TL:
-   case latte::Register::PA_SC_GENERIC_SCISSOR_BR:
-      mScissorDirty = true;
-      break;
-
    case latte::Register::PA_SU_SC_MODE_CNTL:
    {
       auto pa_su_sc_mode_cntl = latte::PA_SU_SC_MODE_CNTL::get(value);
@@ -5,11 +5,6 @@
 namespace opengl
 {
 
-ResourceMemoryMap::ResourceMemoryMap()
-   : mCounter(0)
-{
-}
-
 void
 ResourceMemoryMap::addResource(Resource *resource)
 {
@@ -19,21 +14,12 @@ ResourceMemoryMap::addResource(Resource *resource)
       return;
    }
 
-   // mCounter serves to differentiate multiple resources with the same
-   //  start or end address.
-   auto counter = mCounter++;
-   auto keyStart = static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter;
-   auto keyEnd = static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter;
-   mKnownResources[resource] = counter;
-
-   // We insert entries for both the start (first byte) and end (last byte)
-   //  of the resource.  Then in markDirty(), we can simply set the dirty
-   //  flag on every resource with at least one key (region endpoint) in
-   //  the dirty region.
-   decaf_check(mMemoryMap.find(keyStart) == mMemoryMap.end());
-   mMemoryMap[keyStart] = resource;
-   decaf_check(mMemoryMap.find(keyEnd) == mMemoryMap.end());
-   mMemoryMap[keyEnd] = resource;
+   // Remember the range we inserted, the resource's bounds may have been
+   //  updated by the time it is removed.
+   auto start = static_cast<uint32_t>(resource->cpuMemStart);
+   auto end = static_cast<uint32_t>(resource->cpuMemEnd);
+   mKnownResources[resource] = { start, end };
+   mMemoryMap.insert(start, end, resource);
 }
 
 void
@@ -43,15 +29,11 @@ ResourceMemoryMap::removeResource(Resource *resource)
 
    auto knownIter = mKnownResources.find(resource);
    decaf_check(knownIter != mKnownResources.end());
-   auto counter = knownIter->second;
+   auto [start, end] = knownIter->second;
    mKnownResources.erase(knownIter);
-   auto keyStart = static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter;
-   auto keyEnd = static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter;
 
-   decaf_check(mMemoryMap.find(keyStart) != mMemoryMap.end());
-   mMemoryMap.erase(keyStart);
-   decaf_check(mMemoryMap.find(keyEnd) != mMemoryMap.end());
-   mMemoryMap.erase(keyEnd);
+   auto erased = mMemoryMap.erase(start, end, resource);
+   decaf_check(erased);
 }
 
 } // namespace opengl
@@ -1,7 +1,8 @@
 #pragma once
 #ifdef DECAF_GL
+#include "gpu_intervalmap.h"
+
 #include <libcpu/be2_struct.h>
-#include <map>
 #include <mutex>
 #include <unordered_map>
 
@@ -34,39 +35,11 @@ struct Resource
 
 // Manages data ranges associated with resources for efficient querying by
 //  address.  addResource() and removeResource() lock the object for the
-//  duration of the call.
+//  duration of the call, callers of forEachResource() which may race with
+//  a resource being destroyed must hold getMutex().
 class ResourceMemoryMap
 {
 public:
-   class Iterator
-   {
-   public:
-      Iterator(const ResourceMemoryMap &map, phys_addr start, size_t size)
-         : mMap(map),
-           mKeyStart(static_cast<uint64_t>(start) << 32),
-           mKeyEnd(static_cast<uint64_t>(start + size) << 32),
-           mMapIter(mMap.mMemoryMap.lower_bound(mKeyStart))
-      {
-      }
-
-      Resource *next()
-      {
-         if (mMapIter != mMap.mMemoryMap.end() && mMapIter->first < mKeyEnd) {
-            return (mMapIter++)->second;
-         } else {
-            return nullptr;
-         }
-      }
-
-   private:
-      const ResourceMemoryMap &mMap;
-      uint64_t mKeyStart;
-      uint64_t mKeyEnd;
-      std::map<uint64_t, Resource *>::const_iterator mMapIter;
-   };
-
-   ResourceMemoryMap();
-
    void
    addResource(Resource *resource);
 
@@ -79,17 +52,26 @@ public:
       return mMutex;
    }
 
-   Iterator
-   getIterator(phys_addr start, size_t size)
+   //! Call func for every resource which overlaps [start, start + size)
+   template<typename Func>
+   void
+   forEachResource(phys_addr start,
+                   size_t size,
+                   Func &&func)
    {
-      return Iterator(*this, start, size);
+      auto rangeStart = static_cast<uint32_t>(start);
+      auto rangeEnd = static_cast<uint32_t>(start + size);
+
+      mMemoryMap.forEachOverlapping(rangeStart, rangeEnd,
+         [&](Resource *resource, uint32_t, uint32_t) {
+            func(resource);
+         });
    }
 
 private:
    std::mutex mMutex;
-   std::unordered_map<Resource *, uint32_t> mKnownResources;
-   std::map<uint64_t, Resource *> mMemoryMap;
-   uint32_t mCounter;
+   std::unordered_map<Resource *, std::pair<uint32_t, uint32_t>> mKnownResources;
+   gpu::IntervalMap<Resource *> mMemoryMap;
 };
 
 } // namespace opengl
@@ -58,6 +58,10 @@ dumpRawShader(const std::string &type,
    auto binary = gsl::make_span(gpu::internal::translateAddress<uint8_t>(address), size);
    auto output = latte::disassemble(binary, isSubroutine);
    file << output << std::endl;
+
+   // Also keep the raw binary, so the dump can be used as a translation corpus
+   auto binaryFile = std::ofstream { fmt::format("dump/gpu_{}_{}.bin", type, address), std::ofstream::out | std::ofstream::binary };
+   binaryFile.write(reinterpret_cast<const char *>(binary.data()), binary.size());
 }
 
 static void
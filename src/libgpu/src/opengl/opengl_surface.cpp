@@ -1,5 +1,6 @@
 #ifdef DECAF_GL
 #include "gpu_config.h"
+#include "gpu_formats.h"
 #include "gpu_memory.h"
 #include "gpu_tiling.h"
 #include "latte/latte_formats.h"
@@ -247,8 +248,13 @@ getGlStorageFormat(latte::SQ_DATA_FORMAT format,
    switch (format) {
    case latte::SQ_DATA_FORMAT::FMT_8:
       return getFormat(gl::GL_R8, gl::GL_R8_SNORM, gl::GL_R8UI, gl::GL_R8I, gl::GL_SRGB8);
-   //case latte::SQ_DATA_FORMAT::FMT_4_4:
-   //case latte::SQ_DATA_FORMAT::FMT_3_3_2:
+   case latte::SQ_DATA_FORMAT::FMT_4_4:
+   case latte::SQ_DATA_FORMAT::FMT_3_3_2:
+   case latte::SQ_DATA_FORMAT::FMT_6_5_5:
+   case latte::SQ_DATA_FORMAT::FMT_1_5_5_5:
+   case latte::SQ_DATA_FORMAT::FMT_5_5_5_1:
+      // Expanded to RGBA8 on upload by convertSurfaceForUpload
+      return getFormat(gl::GL_RGBA8, BADFMT, BADFMT, BADFMT, gl::GL_SRGB8_ALPHA8);
    case latte::SQ_DATA_FORMAT::FMT_16:
       if (isDepthBuffer) {
          return gl::GL_DEPTH_COMPONENT16;
@@ -261,11 +267,8 @@ getGlStorageFormat(latte::SQ_DATA_FORMAT format,
       return getFormat(gl::GL_RG8, gl::GL_RG8_SNORM, gl::GL_RG8UI, gl::GL_RG8I, BADFMT);
    case latte::SQ_DATA_FORMAT::FMT_5_6_5:
       return getFormat(gl::GL_RGB565, BADFMT, BADFMT, BADFMT, BADFMT);
-   //case latte::SQ_DATA_FORMAT::FMT_6_5_5:
-   //case latte::SQ_DATA_FORMAT::FMT_1_5_5_5:
    case latte::SQ_DATA_FORMAT::FMT_4_4_4_4:
       return getFormat(gl::GL_RGBA4, BADFMT, BADFMT, BADFMT, BADFMT);
-   //case latte::SQ_DATA_FORMAT::FMT_5_5_5_1:
    case latte::SQ_DATA_FORMAT::FMT_32:
       return getFormat(BADFMT, BADFMT, gl::GL_R32UI, gl::GL_R32I, BADFMT);
    case latte::SQ_DATA_FORMAT::FMT_32_FLOAT:
@@ -511,6 +514,80 @@ getSurfaceBytes(uint32_t pitch,
    return numPixels * bitsPerPixel / 8;
 }
 
+/**
+ * Convert untiled surface data which OpenGL cannot upload as it is, or could
+ * only upload by having the driver convert it, with the gpu::formats kernels.
+ *
+ * Returns false when the data can be uploaded with getGlFormat and
+ * getGlDataType, otherwise image holds the data to upload in textureFormat and
+ * textureDataType.
+ */
+static bool
+convertSurfaceForUpload(latte::SQ_DATA_FORMAT format,
+                        bool isDepthBuffer,
+                        std::vector<uint8_t> &image,
+                        gl::GLenum &textureFormat,
+                        gl::GLenum &textureDataType)
+{
+   auto layout = gpu::formats::FormatLayout { };
+
+   if (!gpu::formats::getFormatLayout(format, layout) || layout.isCompressed) {
+      return false;
+   }
+
+   auto numElements = image.size() * 8 / layout.elementBits;
+
+   switch (format) {
+   case latte::SQ_DATA_FORMAT::FMT_16:
+   case latte::SQ_DATA_FORMAT::FMT_32_FLOAT:
+      if (!isDepthBuffer) {
+         return false;
+      }
+
+      textureFormat = gl::GL_DEPTH_COMPONENT;
+      textureDataType = (format == latte::SQ_DATA_FORMAT::FMT_16) ? gl::GL_UNSIGNED_SHORT : gl::GL_FLOAT;
+      return true;
+   case latte::SQ_DATA_FORMAT::FMT_8_24:
+      // GL_UNSIGNED_INT_24_8 has depth in the high 24 bits, as FMT_24_8 does
+      decaf_check(gpu::formats::convert(latte::SQ_DATA_FORMAT::FMT_24_8, image.data(),
+                                        format, image.data(), numElements));
+      // fallthrough
+   case latte::SQ_DATA_FORMAT::FMT_24_8:
+      textureFormat = gl::GL_DEPTH_STENCIL;
+      textureDataType = gl::GL_UNSIGNED_INT_24_8;
+      return true;
+   case latte::SQ_DATA_FORMAT::FMT_X24_8_32_FLOAT:
+      // Float depth then stencil in the low bits of the next word, the unused
+      // bits are ignored by GL_FLOAT_32_UNSIGNED_INT_24_8_REV
+      textureFormat = gl::GL_DEPTH_STENCIL;
+      textureDataType = gl::GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+      return true;
+   case latte::SQ_DATA_FORMAT::FMT_10_10_10_2:
+      // Repack to the native layout of GL_RGB10_A2
+      decaf_check(gpu::formats::convert(latte::SQ_DATA_FORMAT::FMT_2_10_10_10, image.data(),
+                                        format, image.data(), numElements));
+      textureFormat = gl::GL_RGBA;
+      textureDataType = gl::GL_UNSIGNED_INT_2_10_10_10_REV;
+      return true;
+   case latte::SQ_DATA_FORMAT::FMT_4_4:
+   case latte::SQ_DATA_FORMAT::FMT_3_3_2:
+   case latte::SQ_DATA_FORMAT::FMT_6_5_5:
+   case latte::SQ_DATA_FORMAT::FMT_1_5_5_5:
+   case latte::SQ_DATA_FORMAT::FMT_5_5_5_1:
+   {
+      // No matching storage format, these are stored as RGBA8
+      auto expanded = std::vector<uint8_t>(numElements * 4);
+      decaf_check(gpu::formats::expandToRGBA8(format, expanded.data(), image.data(), numElements));
+      image = std::move(expanded);
+      textureFormat = gl::GL_RGBA;
+      textureDataType = gl::GL_UNSIGNED_BYTE;
+      return true;
+   }
+   default:
+      return false;
+   }
+}
+
 void
 GLDriver::uploadSurface(SurfaceBuffer *buffer,
                         phys_addr baseAddress,
@@ -589,15 +666,19 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
       auto compressed = latte::getDataFormatIsCompressed(format);
       auto target = getGlTarget(dim);
       auto textureDataType = gl::GL_INVALID_ENUM;
-      auto textureFormat = getGlFormat(format);
-      auto size = untiledImage.size();
+      auto textureFormat = gl::GL_INVALID_ENUM;
 
       if (compressed) {
+         textureFormat = getGlFormat(format);
          textureDataType = getGlCompressedDataType(format, formatComp, degamma);
-      } else {
+      } else if (!convertSurfaceForUpload(format, isDepthBuffer, untiledImage,
+                                          textureFormat, textureDataType)) {
+         textureFormat = getGlFormat(format);
          textureDataType = getGlDataType(format, formatComp, degamma);
       }
 
+      auto size = untiledImage.size();
+
       if (textureDataType == gl::GL_INVALID_ENUM || textureFormat == gl::GL_INVALID_ENUM) {
          decaf_abort(fmt::format("Texture with unsupported format {}", format));
       }
@@ -23,7 +23,7 @@ GLDriver::checkViewport()
          1.0f / pa_cl_vport_yscale.VPORT_YSCALE());
    }
 
-   if (mViewportDirty) {
+   if (isRegisterGroupDirty(RegisterGroup::Viewport)) {
       auto pa_cl_vport_xscale = getRegister<latte::PA_CL_VPORT_XSCALE_N>(latte::Register::PA_CL_VPORT_XSCALE_0);
       auto pa_cl_vport_xoffset = getRegister<latte::PA_CL_VPORT_XOFFSET_N>(latte::Register::PA_CL_VPORT_XOFFSET_0);
       auto pa_cl_vport_yscale = getRegister<latte::PA_CL_VPORT_YSCALE_N>(latte::Register::PA_CL_VPORT_YSCALE_0);
@@ -39,10 +39,10 @@ GLDriver::checkViewport()
                      gsl::narrow_cast<gl::GLint>(y),
                      gsl::narrow_cast<gl::GLint>(width),
                      gsl::narrow_cast<gl::GLint>(height));
-      mViewportDirty = false;
+      clearRegisterGroupDirty(RegisterGroup::Viewport);
    }
 
-   if (mDepthRangeDirty) {
+   if (isRegisterGroupDirty(RegisterGroup::DepthRange)) {
       auto pa_cl_vport_zscale = getRegister<latte::PA_CL_VPORT_ZSCALE_N>(latte::Register::PA_CL_VPORT_ZSCALE_0);
       auto pa_cl_vport_zoffset = getRegister<latte::PA_CL_VPORT_ZOFFSET_N>(latte::Register::PA_CL_VPORT_ZOFFSET_0);
       auto pa_sc_vport_zmin = getRegister<latte::PA_SC_VPORT_ZMIN_N>(latte::Register::PA_SC_VPORT_ZMIN_0);
@@ -59,10 +59,10 @@ GLDriver::checkViewport()
       }
 
       gl::glDepthRangef(nearZ, farZ);
-      mDepthRangeDirty = false;
+      clearRegisterGroupDirty(RegisterGroup::DepthRange);
    }
 
-   if (mScissorDirty) {
+   if (isRegisterGroupDirty(RegisterGroup::Scissor)) {
       auto pa_sc_generic_scissor_tl = getRegister<latte::PA_SC_GENERIC_SCISSOR_TL>(latte::Register::PA_SC_GENERIC_SCISSOR_TL);
       auto pa_sc_generic_scissor_br = getRegister<latte::PA_SC_GENERIC_SCISSOR_BR>(latte::Register::PA_SC_GENERIC_SCISSOR_BR);
 
@@ -72,7 +72,7 @@ GLDriver::checkViewport()
       auto height = pa_sc_generic_scissor_br.BR_Y() - y;
 
       gl::glScissor(x, y, width, height);
-      mScissorDirty = false;
+      clearRegisterGroupDirty(RegisterGroup::Scissor);
    }
 
    return true;
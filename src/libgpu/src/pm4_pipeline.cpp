@@ -0,0 +1,369 @@
+#include "latte/latte_pm4_reader.h"
+#include "pm4_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <common/decaf_assert.h>
+#include <common/platform_thread.h>
+
+using namespace latte::pm4;
+
+static uint64_t
+getElapsedNanoseconds(std::chrono::steady_clock::time_point start)
+{
+   auto elapsed = std::chrono::steady_clock::now() - start;
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+//! Packets which write guest memory when the backend executes them.
+static bool
+isGuestMemoryWritePacket(IT_OPCODE opcode)
+{
+   switch (opcode) {
+   case IT_OPCODE::MEM_WRITE:
+   case IT_OPCODE::EVENT_WRITE:
+   case IT_OPCODE::EVENT_WRITE_EOP:
+   case IT_OPCODE::PFP_SYNC_ME:
+   case IT_OPCODE::SURFACE_SYNC:
+   case IT_OPCODE::STRMOUT_BUFFER_UPDATE:
+      return true;
+   default:
+      return false;
+   }
+}
+
+Pm4Parser::Pm4Parser(gpu::IndexBufferCache &indexBufferCache,
+                     SyncFunction sync) :
+   mIndexBufferCache(indexBufferCache),
+   mSync(std::move(sync))
+{
+   // Must match the backend's initial registers, only changes are recorded
+   mRegisters.fill(0);
+}
+
+Pm4CommandStream *
+Pm4Parser::parse(const gpu::ringbuffer::Item &item,
+                 Pm4CommandStream *stream)
+{
+   mParseStart = std::chrono::steady_clock::now();
+   stream->clear();
+   stream->item = item;
+
+   mStream = stream;
+   runCommandBuffer(item.buffer.getRawPointer(), item.numWords);
+   stream = mStream;
+   mStream = nullptr;
+
+   if (stream) {
+      stream->parseTime = getElapsedNanoseconds(mParseStart);
+   }
+
+   return stream;
+}
+
+void
+Pm4Parser::beforeGuestMemoryRead()
+{
+   if (!mSyncPending || !mSync || !mStream) {
+      return;
+   }
+
+   // The memory may be written by a packet which has only been recorded,
+   //  so let everything recorded so far execute before reading it.
+   auto item = mStream->item;
+   mStream->parseTime = getElapsedNanoseconds(mParseStart);
+   mStream->retireItem = false;
+   mStream = mSync(mStream);
+   mSyncPending = false;
+
+   if (mStream) {
+      mStream->clear();
+      mStream->item = item;
+   }
+
+   mParseStart = std::chrono::steady_clock::now();
+}
+
+void
+Pm4Parser::applyRegister(latte::Register reg)
+{
+   if (mStream) {
+      mStream->registers.emplace_back(reg / 4, getRegister<uint32_t>(reg));
+   }
+}
+
+void
+Pm4Parser::executePacket(HeaderType3 header,
+                         const gsl::span<uint32_t> &data)
+{
+   if (!mStream) {
+      // The pipeline is stopping
+      return;
+   }
+
+   auto command = Pm4CommandStream::Command { };
+   command.header = header.value;
+   command.firstRegister = 0;
+   command.indexBuffer = -1;
+
+   if (!mStream->commands.empty()) {
+      auto &previous = mStream->commands.back();
+      command.firstRegister = previous.firstRegister + previous.numRegisters;
+   }
+
+   command.numRegisters = static_cast<uint32_t>(mStream->registers.size()) - command.firstRegister;
+   command.firstWord = static_cast<uint32_t>(mStream->words.size());
+   command.numWords = static_cast<uint32_t>(data.size());
+   mStream->words.insert(mStream->words.end(), data.begin(), data.end());
+
+   if (auto indices = convertIndices(header, data)) {
+      command.indexBuffer = static_cast<int32_t>(mStream->indexBuffers.size());
+      mStream->indexBuffers.push_back(*indices);
+
+      // The copy belongs to this stream, it has never been uploaded
+      mStream->indexBuffers.back().uploadGeneration = ~0ull;
+   }
+
+   mStream->commands.push_back(command);
+
+   if (isGuestMemoryWritePacket(header.opcode())) {
+      mSyncPending = true;
+   }
+}
+
+gpu::IndexBuffer *
+Pm4Parser::convertIndices(HeaderType3 header,
+                          const gsl::span<uint32_t> &data)
+{
+   auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+   auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
+   PacketReader reader { data };
+
+   switch (header.opcode()) {
+   case IT_OPCODE::DRAW_INDEX_AUTO:
+   {
+      auto draw = read<DrawIndexAuto>(reader);
+      return mIndexBufferCache.getAutoIndices(draw.count,
+                                              vgt_primitive_type.PRIM_TYPE());
+   }
+   case IT_OPCODE::DRAW_INDEX_2:
+   {
+      auto draw = read<DrawIndex2>(reader);
+      return mIndexBufferCache.getIndices(draw.addr,
+                                          draw.count,
+                                          vgt_dma_index_type.INDEX_TYPE(),
+                                          vgt_dma_index_type.SWAP_MODE(),
+                                          vgt_primitive_type.PRIM_TYPE());
+   }
+   case IT_OPCODE::DRAW_INDEX_IMMD:
+   {
+      auto draw = read<DrawIndexImmd>(reader);
+      return mIndexBufferCache.getImmediateIndices(draw.indices.data(),
+                                                   draw.count,
+                                                   vgt_dma_index_type.INDEX_TYPE(),
+                                                   vgt_dma_index_type.SWAP_MODE(),
+                                                   vgt_primitive_type.PRIM_TYPE());
+   }
+   default:
+      return nullptr;
+   }
+}
+
+Pm4Pipeline::Pm4Pipeline(gpu::IndexBufferCache &indexBufferCache) :
+   mParser(indexBufferCache,
+           [this](Pm4CommandStream *stream) { return syncStream(stream); })
+{
+}
+
+Pm4Pipeline::~Pm4Pipeline()
+{
+   stop();
+}
+
+void
+Pm4Pipeline::start()
+{
+   decaf_check(!mRunning);
+   mRunning = true;
+   mThread = std::thread { [this]() { parseThread(); } };
+   platform::setThreadName(&mThread, "GPU Parse");
+}
+
+void
+Pm4Pipeline::stop()
+{
+   if (!mRunning) {
+      return;
+   }
+
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mRunning = false;
+      mFreeCV.notify_all();
+   }
+
+   gpu::ringbuffer::awaken();
+   mThread.join();
+}
+
+Pm4CommandStream *
+Pm4Pipeline::acquireStream()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+
+   if (mFree.empty() && mStreams.size() < MaxStreams) {
+      mStreams.emplace_back(std::make_unique<Pm4CommandStream>());
+      mFree.push_back(mStreams.back().get());
+   }
+
+   if (mFree.empty()) {
+      auto start = std::chrono::steady_clock::now();
+
+      while (mFree.empty() && mRunning) {
+         mFreeCV.wait(lock);
+      }
+
+      mStats.parseStallTime += getElapsedNanoseconds(start);
+
+      if (mFree.empty()) {
+         return nullptr;
+      }
+   }
+
+   auto stream = mFree.back();
+   mFree.pop_back();
+   mParsing = true;
+   return stream;
+}
+
+void
+Pm4Pipeline::parseThread()
+{
+   while (mRunning) {
+      auto item = gpu::ringbuffer::waitForItem();
+
+      if (!item.numWords) {
+         // Pass the wake up on to the submit stage
+         std::unique_lock<std::mutex> lock { mMutex };
+         mParsed.push_back(nullptr);
+         mParsedCV.notify_all();
+         continue;
+      }
+
+      auto stream = acquireStream();
+
+      if (!stream) {
+         break;
+      }
+
+      stream = mParser.parse(item, stream);
+
+      if (!stream) {
+         break;
+      }
+
+      std::unique_lock<std::mutex> lock { mMutex };
+      mParsing = false;
+      mParsed.push_back(stream);
+      mStats.parseTime += stream->parseTime;
+      mStats.queueDepth++;
+      mStats.maxQueueDepth = std::max(mStats.maxQueueDepth, mStats.queueDepth);
+      mParsedCV.notify_all();
+   }
+}
+
+Pm4CommandStream *
+Pm4Pipeline::syncStream(Pm4CommandStream *stream)
+{
+   auto start = std::chrono::steady_clock::now();
+   std::unique_lock<std::mutex> lock { mMutex };
+   auto reuse = stream->commands.empty() && stream->registers.empty();
+   mParsing = false;
+
+   if (!reuse) {
+      mParsed.push_back(stream);
+      mStats.parseTime += stream->parseTime;
+      mStats.queueDepth++;
+      mStats.maxQueueDepth = std::max(mStats.maxQueueDepth, mStats.queueDepth);
+      mParsedCV.notify_all();
+   }
+
+   // Wait for the submit stage to execute every stream parsed so far
+   while (mStats.queueDepth && mRunning) {
+      mFreeCV.wait(lock);
+   }
+
+   mStats.parseStallTime += getElapsedNanoseconds(start);
+
+   if (!mRunning) {
+      return nullptr;
+   }
+
+   if (reuse) {
+      mParsing = true;
+      return stream;
+   }
+
+   lock.unlock();
+   return acquireStream();
+}
+
+Pm4CommandStream *
+Pm4Pipeline::waitForStream()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+
+   if (mParsed.empty()) {
+      auto start = std::chrono::steady_clock::now();
+      auto stalled = mParsing;
+
+      while (mParsed.empty()) {
+         mParsedCV.wait(lock);
+      }
+
+      if (stalled) {
+         mStats.submitStallTime += getElapsedNanoseconds(start);
+      }
+   }
+
+   auto stream = mParsed.front();
+   mParsed.pop_front();
+   return stream;
+}
+
+Pm4CommandStream *
+Pm4Pipeline::dequeueStream()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+
+   if (mParsed.empty()) {
+      return nullptr;
+   }
+
+   auto stream = mParsed.front();
+   mParsed.pop_front();
+   return stream;
+}
+
+void
+Pm4Pipeline::releaseStream(Pm4CommandStream *stream,
+                           uint64_t submitTime)
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+
+   if (stream->retireItem) {
+      mStats.numBuffers++;
+   }
+
+   mStats.submitTime += submitTime;
+   mStats.queueDepth--;
+   mFree.push_back(stream);
+   mFreeCV.notify_all();
+}
+
+Pm4PipelineStats
+Pm4Pipeline::getStats()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+   return mStats;
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include "gpu_indexbuffer.h"
+#include "gpu_ringbuffer.h"
+#include "pm4_processor.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * A command buffer which has been parsed ahead of execution.
+ *
+ * Only the packets which need the backend are kept, each along with the
+ * registers which changed before it, so executing the stream leaves the
+ * backend in the same state as running the original command buffer would.
+ */
+struct Pm4CommandStream
+{
+   struct Command
+   {
+      //! Raw HeaderType3 of the packet.
+      uint32_t header;
+
+      //! Registers which changed before this packet, from registers.
+      uint32_t firstRegister;
+      uint32_t numRegisters;
+
+      //! Byte swapped packet body, from words.
+      uint32_t firstWord;
+      uint32_t numWords;
+
+      //! Converted indices for a draw packet in indexBuffers, or -1.
+      int32_t indexBuffer;
+   };
+
+   void
+   clear()
+   {
+      commands.clear();
+      registers.clear();
+      words.clear();
+      indexBuffers.clear();
+      parseTime = 0;
+      retireItem = true;
+   }
+
+   //! The ring buffer item this stream was parsed from.
+   gpu::ringbuffer::Item item;
+
+   //! False if the item continues in a later stream, the item must only be
+   //! retired once its last stream has executed.
+   bool retireItem = true;
+
+   std::vector<Command> commands;
+
+   //! Register index and value pairs.
+   std::vector<std::pair<uint32_t, uint32_t>> registers;
+   std::vector<uint32_t> words;
+   std::vector<gpu::IndexBuffer> indexBuffers;
+
+   //! Time taken to parse, in nanoseconds.
+   uint64_t parseTime = 0;
+};
+
+/**
+ * The backend independent half of Pm4Processor.
+ *
+ * Runs the register, shadow state and indirect buffer handling and converts
+ * draw indices, recording everything else in a Pm4CommandStream for the
+ * backend to execute with runCommandStream.
+ *
+ * Packets such as MEM_WRITE or EVENT_WRITE_EOP write guest memory when the
+ * backend executes them. Before the next packet which reads guest memory,
+ * the stream so far is handed to the sync function, which must return once
+ * it has executed, along with a stream to record the rest of the item into.
+ */
+class Pm4Parser : public Pm4Processor
+{
+public:
+   using SyncFunction = std::function<Pm4CommandStream *(Pm4CommandStream *)>;
+
+   Pm4Parser(gpu::IndexBufferCache &indexBufferCache,
+             SyncFunction sync = { });
+
+   //! Parse item into stream, returns the stream holding the end of the
+   //! item, which differs from stream if the parser had to sync, or nullptr
+   //! if the sync function returned nullptr.
+   Pm4CommandStream *
+   parse(const gpu::ringbuffer::Item &item,
+         Pm4CommandStream *stream);
+
+protected:
+   void executePacket(HeaderType3 header, const gsl::span<uint32_t> &data) override;
+   void applyRegister(latte::Register reg) override;
+   void beforeGuestMemoryRead() override;
+
+   // Every packet which reaches these is recorded by executePacket instead
+   void decafSetBuffer(const DecafSetBuffer &data) override { }
+   void decafCopyColorToScan(const DecafCopyColorToScan &data) override { }
+   void decafSwapBuffers(const DecafSwapBuffers &data) override { }
+   void decafCapSyncRegisters(const DecafCapSyncRegisters &data) override { }
+   void decafClearColor(const DecafClearColor &data) override { }
+   void decafClearDepthStencil(const DecafClearDepthStencil &data) override { }
+   void decafDebugMarker(const DecafDebugMarker &data) override { }
+   void decafOSScreenFlip(const DecafOSScreenFlip &data) override { }
+   void decafCopySurface(const DecafCopySurface &data) override { }
+   void decafSetSwapInterval(const DecafSetSwapInterval &data) override { }
+   void drawIndexAuto(const DrawIndexAuto &data) override { }
+   void drawIndex2(const DrawIndex2 &data) override { }
+   void drawIndexImmd(const DrawIndexImmd &data) override { }
+   void memWrite(const MemWrite &data) override { }
+   void eventWrite(const EventWrite &data) override { }
+   void eventWriteEOP(const EventWriteEOP &data) override { }
+   void pfpSyncMe(const PfpSyncMe &data) override { }
+   void streamOutBaseUpdate(const StreamOutBaseUpdate &data) override { }
+   void streamOutBufferUpdate(const StreamOutBufferUpdate &data) override { }
+   void surfaceSync(const SurfaceSync &data) override { }
+
+private:
+   gpu::IndexBuffer *
+   convertIndices(HeaderType3 header,
+                  const gsl::span<uint32_t> &data);
+
+   gpu::IndexBufferCache &mIndexBufferCache;
+   SyncFunction mSync;
+   Pm4CommandStream *mStream = nullptr;
+   std::chrono::steady_clock::time_point mParseStart;
+
+   //! A packet recorded since the last sync may write guest memory.
+   bool mSyncPending = false;
+};
+
+struct Pm4PipelineStats
+{
+   //! Command buffers which have been executed.
+   uint64_t numBuffers = 0;
+
+   //! Time spent parsing and executing command buffers, in nanoseconds.
+   uint64_t parseTime = 0;
+   uint64_t submitTime = 0;
+
+   //! Time the parse stage waited for the submit stage to free a stream or
+   //! to execute packets which write guest memory, a large value means the
+   //! submit stage is the bottleneck.
+   uint64_t parseStallTime = 0;
+
+   //! Time the submit stage waited for a parsed stream while there were
+   //! buffers left to parse, a large value means the parse stage is the
+   //! bottleneck.
+   uint64_t submitStallTime = 0;
+
+   //! Streams parsed but not yet executed.
+   uint32_t queueDepth = 0;
+   uint32_t maxQueueDepth = 0;
+};
+
+/**
+ * Splits command buffer processing over two threads.
+ *
+ * A parse thread takes command buffers from gpu::ringbuffer and turns them
+ * into Pm4CommandStreams, which the backend thread then executes, so
+ * register decoding and index conversion run in parallel with the backend
+ * API calls for the previous command buffers.
+ */
+class Pm4Pipeline
+{
+   //! Command buffers which may be parsed ahead of the submit stage.
+   static constexpr size_t MaxStreams = 8;
+
+public:
+   Pm4Pipeline(gpu::IndexBufferCache &indexBufferCache);
+   ~Pm4Pipeline();
+
+   void
+   start();
+
+   void
+   stop();
+
+   //! The next parsed stream, or nullptr if the pipeline was woken by
+   //! gpu::ringbuffer::awaken without one.
+   Pm4CommandStream *
+   waitForStream();
+
+   //! The next parsed stream, or nullptr if there is none ready.
+   Pm4CommandStream *
+   dequeueStream();
+
+   //! Return a stream once the backend has executed it.
+   void
+   releaseStream(Pm4CommandStream *stream,
+                 uint64_t submitTime);
+
+   Pm4PipelineStats
+   getStats();
+
+private:
+   void
+   parseThread();
+
+   Pm4CommandStream *
+   acquireStream();
+
+   Pm4CommandStream *
+   syncStream(Pm4CommandStream *stream);
+
+   Pm4Parser mParser;
+   std::thread mThread;
+   std::atomic<bool> mRunning { false };
+
+   std::mutex mMutex;
+   std::condition_variable mParsedCV;
+   std::condition_variable mFreeCV;
+
+   //! Parsed streams in order, nullptr wakes the submit stage.
+   std::deque<Pm4CommandStream *> mParsed;
+   std::vector<Pm4CommandStream *> mFree;
+   std::vector<std::unique_ptr<Pm4CommandStream>> mStreams;
+
+   //! The parse stage is working on a command buffer.
+   bool mParsing = false;
+   Pm4PipelineStats mStats;
+};
@@ -1,10 +1,125 @@
 #include "latte/latte_pm4_reader.h"
 #include "gpu_memory.h"
+#include "pm4_pipeline.h"
 #include "pm4_processor.h"
 
+#include <algorithm>
+#include <array>
 #include <common/log.h>
+#include <cstring>
 #include <libcpu/mmu.h>
 
+static std::array<RegisterGroup, 0x10000>
+buildRegisterGroups()
+{
+   auto groups = std::array<RegisterGroup, 0x10000> { };
+   groups.fill(RegisterGroup::Other);
+
+   auto setGroup = [&](uint32_t first, uint32_t last, RegisterGroup group) {
+      for (auto reg = first; reg <= last; reg += 4) {
+         groups[reg / 4] = group;
+      }
+   };
+
+   setGroup(latte::Register::CB_BLEND_RED, latte::Register::CB_BLEND_ALPHA, RegisterGroup::Blend);
+   setGroup(latte::Register::CB_BLEND0_CONTROL, latte::Register::CB_BLEND7_CONTROL, RegisterGroup::Blend);
+   setGroup(latte::Register::CB_BLEND_CONTROL, latte::Register::CB_COLOR_CONTROL, RegisterGroup::Blend);
+   setGroup(latte::Register::CB_TARGET_MASK, latte::Register::CB_SHADER_MASK, RegisterGroup::Blend);
+
+   setGroup(latte::Register::DB_STENCIL_CLEAR, latte::Register::DB_DEPTH_CLEAR, RegisterGroup::DepthStencil);
+   setGroup(latte::Register::DB_STENCILREFMASK, latte::Register::DB_STENCILREFMASK_BF, RegisterGroup::DepthStencil);
+   setGroup(latte::Register::DB_DEPTH_CONTROL, latte::Register::DB_DEPTH_CONTROL, RegisterGroup::DepthStencil);
+
+   setGroup(latte::Register::PA_CL_CLIP_CNTL, latte::Register::PA_SU_SC_MODE_CNTL, RegisterGroup::Raster);
+   setGroup(latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX, latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX, RegisterGroup::Raster);
+   setGroup(latte::Register::VGT_MULTI_PRIM_IB_RESET_EN, latte::Register::VGT_MULTI_PRIM_IB_RESET_EN, RegisterGroup::Raster);
+
+   setGroup(latte::Register::PA_CL_VPORT_XSCALE_0, latte::Register::PA_CL_VPORT_YOFFSET_0, RegisterGroup::Viewport);
+   setGroup(latte::Register::PA_CL_VPORT_ZSCALE_0, latte::Register::PA_CL_VPORT_ZOFFSET_0, RegisterGroup::DepthRange);
+   setGroup(latte::Register::PA_SC_VPORT_ZMIN_0, latte::Register::PA_SC_VPORT_ZMAX_0, RegisterGroup::DepthRange);
+
+   setGroup(latte::Register::PA_SC_SCREEN_SCISSOR_TL, latte::Register::PA_SC_SCREEN_SCISSOR_BR, RegisterGroup::Scissor);
+   setGroup(latte::Register::PA_SC_WINDOW_OFFSET, latte::Register::PA_SC_WINDOW_SCISSOR_BR, RegisterGroup::Scissor);
+   setGroup(latte::Register::PA_SC_GENERIC_SCISSOR_TL, latte::Register::PA_SC_GENERIC_SCISSOR_BR, RegisterGroup::Scissor);
+   setGroup(latte::Register::PA_SC_VPORT_SCISSOR_0_TL, latte::Register::PA_SC_VPORT_SCISSOR_0_BR, RegisterGroup::Scissor);
+
+   setGroup(latte::Register::CB_COLOR0_BASE, latte::Register::CB_COLOR7_MASK, RegisterGroup::ColorBuffer);
+   setGroup(latte::Register::DB_DEPTH_SIZE, latte::Register::DB_DEPTH_HTILE_DATA_BASE, RegisterGroup::DepthBuffer);
+
+   setGroup(latte::Register::SQ_VTX_SEMANTIC_0, latte::Register::SQ_VTX_SEMANTIC_31, RegisterGroup::Shader);
+   setGroup(latte::Register::SPI_VS_OUT_ID_0, latte::Register::SPI_FOG_FUNC_BIAS, RegisterGroup::Shader);
+   setGroup(latte::Register::SQ_PGM_START_PS, latte::Register::SQ_PGM_CF_OFFSET_FS, RegisterGroup::Shader);
+   setGroup(latte::Register::SQ_VTX_SEMANTIC_CLEAR, latte::Register::SQ_VTX_SEMANTIC_CLEAR, RegisterGroup::Shader);
+
+   setGroup(latte::Register::VGT_STRMOUT_EN, latte::Register::VGT_STRMOUT_DRAW_OPAQUE_OFFSET, RegisterGroup::StreamOut);
+
+   setGroup(latte::Register::AluConstRegisterBase, latte::Register::AluConstRegisterEnd - 4, RegisterGroup::AluConst);
+   setGroup(latte::Register::ResourceRegisterBase, latte::Register::ResourceRegisterEnd - 4, RegisterGroup::Resource);
+   setGroup(latte::Register::SamplerRegisterBase, latte::Register::SamplerRegisterEnd - 4, RegisterGroup::Sampler);
+   setGroup(latte::Register::TD_PS_SAMPLER_BORDER0_RED, latte::Register::TD_GS_SAMPLER_BORDER17_ALPHA, RegisterGroup::Sampler);
+   return groups;
+}
+
+static RegisterGroup
+getRegisterGroup(uint32_t index)
+{
+   static const auto sRegisterGroups = buildRegisterGroups();
+   return sRegisterGroups[index];
+}
+
+//! Packets which only write registers, these do not need the pending
+//! register changes to be applied first.
+static bool
+isRegisterPacket(IT_OPCODE opcode)
+{
+   switch (opcode) {
+   case IT_OPCODE::NOP:
+   case IT_OPCODE::INDEX_TYPE:
+   case IT_OPCODE::NUM_INSTANCES:
+   case IT_OPCODE::CONTEXT_CTL:
+   case IT_OPCODE::INDIRECT_BUFFER_PRIV:
+   case IT_OPCODE::SET_ALU_CONST:
+   case IT_OPCODE::SET_CONFIG_REG:
+   case IT_OPCODE::SET_CONTEXT_REG:
+   case IT_OPCODE::SET_CTL_CONST:
+   case IT_OPCODE::SET_LOOP_CONST:
+   case IT_OPCODE::SET_SAMPLER:
+   case IT_OPCODE::SET_RESOURCE:
+   case IT_OPCODE::LOAD_CONFIG_REG:
+   case IT_OPCODE::LOAD_CONTEXT_REG:
+   case IT_OPCODE::LOAD_ALU_CONST:
+   case IT_OPCODE::LOAD_BOOL_CONST:
+   case IT_OPCODE::LOAD_LOOP_CONST:
+   case IT_OPCODE::LOAD_RESOURCE:
+   case IT_OPCODE::LOAD_SAMPLER:
+   case IT_OPCODE::LOAD_CTL_CONST:
+      return true;
+   default:
+      return false;
+   }
+}
+
+//! Packets which read guest memory other than their own command buffer.
+static bool
+isGuestMemoryReadPacket(IT_OPCODE opcode)
+{
+   switch (opcode) {
+   case IT_OPCODE::INDIRECT_BUFFER_PRIV:
+   case IT_OPCODE::LOAD_CONFIG_REG:
+   case IT_OPCODE::LOAD_CONTEXT_REG:
+   case IT_OPCODE::LOAD_ALU_CONST:
+   case IT_OPCODE::LOAD_BOOL_CONST:
+   case IT_OPCODE::LOAD_LOOP_CONST:
+   case IT_OPCODE::LOAD_RESOURCE:
+   case IT_OPCODE::LOAD_SAMPLER:
+   case IT_OPCODE::LOAD_CTL_CONST:
+   case IT_OPCODE::DRAW_INDEX_2:
+      return true;
+   default:
+      return false;
+   }
+}
+
 void
 Pm4Processor::indirectBufferCall(const IndirectBufferCall &data)
 {
@@ -65,6 +180,25 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
    }
 }
 
+void
+Pm4Processor::runCommandStream(Pm4CommandStream &stream)
+{
+   for (auto &command : stream.commands) {
+      for (auto i = 0u; i < command.numRegisters; ++i) {
+         auto &[index, value] = stream.registers[command.firstRegister + i];
+         writeRegister(index, value);
+      }
+
+      if (command.indexBuffer >= 0) {
+         mPreparedIndices = &stream.indexBuffers[command.indexBuffer];
+      }
+
+      handlePacketType3(HeaderType3::get(command.header),
+                        gsl::make_span(stream.words.data() + command.firstWord, command.numWords));
+      mPreparedIndices = nullptr;
+   }
+}
+
 void
 Pm4Processor::handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data)
 {
@@ -82,46 +216,16 @@ Pm4Processor::handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &d
 {
    PacketReader reader{ data };
 
+   if (isGuestMemoryReadPacket(header.opcode())) {
+      beforeGuestMemoryRead();
+   }
+
+   // Register writes are batched until a packet which may depend on them
+   if (!mDirtyRegisters.empty() && !isRegisterPacket(header.opcode())) {
+      applyDirtyRegisters();
+   }
+
    switch (header.opcode()) {
-   case IT_OPCODE::DECAF_COPY_COLOR_TO_SCAN:
-      decafCopyColorToScan(read<DecafCopyColorToScan>(reader));
-      break;
-   case IT_OPCODE::DECAF_SWAP_BUFFERS:
-      decafSwapBuffers(read<DecafSwapBuffers>(reader));
-      break;
-   case IT_OPCODE::DECAF_CAP_SYNC_REGISTERS:
-      decafCapSyncRegisters(read<DecafCapSyncRegisters>(reader));
-      break;
-   case IT_OPCODE::DECAF_CLEAR_COLOR:
-      decafClearColor(read<DecafClearColor>(reader));
-      break;
-   case IT_OPCODE::DECAF_CLEAR_DEPTH_STENCIL:
-      decafClearDepthStencil(read<DecafClearDepthStencil>(reader));
-      break;
-   case IT_OPCODE::DECAF_SET_BUFFER:
-      decafSetBuffer(read<DecafSetBuffer>(reader));
-      break;
-   case IT_OPCODE::DECAF_DEBUGMARKER:
-      decafDebugMarker(read<DecafDebugMarker>(reader));
-      break;
-   case IT_OPCODE::DECAF_OSSCREEN_FLIP:
-      decafOSScreenFlip(read<DecafOSScreenFlip>(reader));
-      break;
-   case IT_OPCODE::DECAF_COPY_SURFACE:
-      decafCopySurface(read<DecafCopySurface>(reader));
-      break;
-   case IT_OPCODE::DECAF_SET_SWAP_INTERVAL:
-      decafSetSwapInterval(read<DecafSetSwapInterval>(reader));
-      break;
-   case IT_OPCODE::DRAW_INDEX_AUTO:
-      drawIndexAuto(read<DrawIndexAuto>(reader));
-      break;
-   case IT_OPCODE::DRAW_INDEX_2:
-      drawIndex2(read<DrawIndex2>(reader));
-      break;
-   case IT_OPCODE::DRAW_INDEX_IMMD:
-      drawIndexImmd(read<DrawIndexImmd>(reader));
-      break;
    case IT_OPCODE::INDEX_TYPE:
       indexType(read<IndexType>(reader));
       break;
@@ -176,6 +280,62 @@ Pm4Processor::handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &d
    case IT_OPCODE::INDIRECT_BUFFER_PRIV:
       indirectBufferCall(read<IndirectBufferCall>(reader));
       break;
+   case IT_OPCODE::NOP:
+      nopPacket(read<Nop>(reader));
+      break;
+   case IT_OPCODE::CONTEXT_CTL:
+      contextControl(read<ContextControl>(reader));
+      break;
+   default:
+      executePacket(header, data);
+   }
+}
+
+void
+Pm4Processor::executePacket(HeaderType3 header, const gsl::span<uint32_t> &data)
+{
+   PacketReader reader{ data };
+
+   switch (header.opcode()) {
+   case IT_OPCODE::DECAF_COPY_COLOR_TO_SCAN:
+      decafCopyColorToScan(read<DecafCopyColorToScan>(reader));
+      break;
+   case IT_OPCODE::DECAF_SWAP_BUFFERS:
+      decafSwapBuffers(read<DecafSwapBuffers>(reader));
+      break;
+   case IT_OPCODE::DECAF_CAP_SYNC_REGISTERS:
+      decafCapSyncRegisters(read<DecafCapSyncRegisters>(reader));
+      break;
+   case IT_OPCODE::DECAF_CLEAR_COLOR:
+      decafClearColor(read<DecafClearColor>(reader));
+      break;
+   case IT_OPCODE::DECAF_CLEAR_DEPTH_STENCIL:
+      decafClearDepthStencil(read<DecafClearDepthStencil>(reader));
+      break;
+   case IT_OPCODE::DECAF_SET_BUFFER:
+      decafSetBuffer(read<DecafSetBuffer>(reader));
+      break;
+   case IT_OPCODE::DECAF_DEBUGMARKER:
+      decafDebugMarker(read<DecafDebugMarker>(reader));
+      break;
+   case IT_OPCODE::DECAF_OSSCREEN_FLIP:
+      decafOSScreenFlip(read<DecafOSScreenFlip>(reader));
+      break;
+   case IT_OPCODE::DECAF_COPY_SURFACE:
+      decafCopySurface(read<DecafCopySurface>(reader));
+      break;
+   case IT_OPCODE::DECAF_SET_SWAP_INTERVAL:
+      decafSetSwapInterval(read<DecafSetSwapInterval>(reader));
+      break;
+   case IT_OPCODE::DRAW_INDEX_AUTO:
+      drawIndexAuto(read<DrawIndexAuto>(reader));
+      break;
+   case IT_OPCODE::DRAW_INDEX_2:
+      drawIndex2(read<DrawIndex2>(reader));
+      break;
+   case IT_OPCODE::DRAW_INDEX_IMMD:
+      drawIndexImmd(read<DrawIndexImmd>(reader));
+      break;
    case IT_OPCODE::MEM_WRITE:
       memWrite(read<MemWrite>(reader));
       break;
@@ -194,15 +354,9 @@ Pm4Processor::handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &d
    case IT_OPCODE::STRMOUT_BUFFER_UPDATE:
       streamOutBufferUpdate(read<StreamOutBufferUpdate>(reader));
       break;
-   case IT_OPCODE::NOP:
-      nopPacket(read<Nop>(reader));
-      break;
    case IT_OPCODE::SURFACE_SYNC:
       surfaceSync(read<SurfaceSync>(reader));
       break;
-   case IT_OPCODE::CONTEXT_CTL:
-      contextControl(read<ContextControl>(reader));
-      break;
    default:
       gLog->debug("Unhandled pm4 packet type 3 opcode {}", header.opcode());
    }
@@ -236,13 +390,13 @@ void Pm4Processor::nopPacket(const Nop &data)
 void
 Pm4Processor::indexType(const IndexType &data)
 {
-   mRegisters[latte::Register::VGT_DMA_INDEX_TYPE / 4] = data.type.value;
+   writeRegister(latte::Register::VGT_DMA_INDEX_TYPE / 4, data.type.value);
 }
 
 void
 Pm4Processor::numInstances(const NumInstances &data)
 {
-   mRegisters[latte::Register::VGT_DMA_NUM_INSTANCES / 4] = data.count;
+   writeRegister(latte::Register::VGT_DMA_NUM_INSTANCES / 4, data.count);
 }
 
 void Pm4Processor::contextControl(const ContextControl &data)
@@ -265,9 +419,7 @@ void Pm4Processor::setAluConsts(const SetAluConsts &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(data.id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(data.id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::setConfigRegs(const SetConfigRegs &data)
@@ -283,9 +435,7 @@ void Pm4Processor::setConfigRegs(const SetConfigRegs &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(data.id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(data.id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::setContextRegs(const SetContextRegs &data)
@@ -301,9 +451,7 @@ void Pm4Processor::setContextRegs(const SetContextRegs &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(data.id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(data.id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::setControlConstants(const SetControlConstants &data)
@@ -319,9 +467,7 @@ void Pm4Processor::setControlConstants(const SetControlConstants &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(data.id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(data.id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::setLoopConsts(const SetLoopConsts &data)
@@ -337,9 +483,7 @@ void Pm4Processor::setLoopConsts(const SetLoopConsts &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(data.id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(data.id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::setSamplers(const SetSamplers &data)
@@ -355,9 +499,7 @@ void Pm4Processor::setSamplers(const SetSamplers &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(data.id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(data.id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::setResources(const SetResources &data)
@@ -372,9 +514,7 @@ void Pm4Processor::setResources(const SetResources &data)
       }
    }
 
-   for (auto i = 0u; i < data.values.size(); ++i) {
-      setRegister(static_cast<latte::Register>(id + i * 4), data.values[i]);
-   }
+   setRegisters(static_cast<latte::Register>(id), data.values.data(), data.values.size());
 }
 
 void Pm4Processor::loadRegisters(latte::Register base,
@@ -386,9 +526,14 @@ void Pm4Processor::loadRegisters(latte::Register base,
       auto start = range.first;
       auto count = range.second;
 
-      for (auto j = start; j < start + count; ++j) {
-         setRegister(static_cast<latte::Register>(base + j * 4), src[j]);
+      // Shadow memory is big endian, swap each range into host order so
+      //  setRegisters can skip the ones which are unchanged.
+      mLoadBuffer.resize(count);
+      for (auto j = 0u; j < count; ++j) {
+         mLoadBuffer[j] = src[start + j];
       }
+
+      setRegisters(static_cast<latte::Register>(base + start * 4), mLoadBuffer.data(), count);
    }
 }
 
@@ -461,10 +606,9 @@ Pm4Processor::setRegister(latte::Register reg,
                           uint32_t value)
 {
    decaf_check((reg % 4) == 0);
-   auto isChanged = (value != mRegisters[reg / 4]);
 
    // Save to local registers
-   mRegisters[reg / 4] = value;
+   writeRegister(reg / 4, value);
 
    // Writing SQ_VTX_SEMANTIC_CLEAR has side effects, so process those
    if (reg == latte::Register::SQ_VTX_SEMANTIC_CLEAR) {
@@ -474,9 +618,58 @@ Pm4Processor::setRegister(latte::Register reg,
          }
       }
    }
+}
+
+void
+Pm4Processor::writeRegister(uint32_t index,
+                            uint32_t value)
+{
+   auto previous = mRegisters[index];
+   mRegisters[index] = value;
+
+   // Remember the value the backend last saw so the change can be applied
+   //  before the next packet which depends on it.
+   if (value != previous && !mRegisterIsDirty.test(index)) {
+      mRegisterIsDirty.set(index);
+      mDirtyRegisters.push_back({ index, previous });
+   }
+}
+
+void
+Pm4Processor::setRegisters(latte::Register base,
+                           const uint32_t *values,
+                           size_t count)
+{
+   decaf_check((base % 4) == 0);
+   auto index = base / 4;
+   decaf_check(index + count <= mRegisters.size());
+
+   // GX2 reloads large blocks of identical state for every draw, so check
+   //  the whole block before looking at individual registers.
+   auto semanticClear = latte::Register::SQ_VTX_SEMANTIC_CLEAR / 4;
+   auto hasSideEffects = (semanticClear >= index && semanticClear < index + count);
+
+   if (!hasSideEffects && std::memcmp(&mRegisters[index], values, count * sizeof(uint32_t)) == 0) {
+      return;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      setRegister(static_cast<latte::Register>(base + i * 4), values[i]);
+   }
+}
+
+void
+Pm4Processor::applyDirtyRegisters()
+{
+   for (auto &dirty : mDirtyRegisters) {
+      mRegisterIsDirty.reset(dirty.index);
 
-   // Apply changes directly to OpenGL state if appropriate
-   if (isChanged) {
-      applyRegister(reg);
+      // A register may have been changed and then restored between draws
+      if (mRegisters[dirty.index] != dirty.appliedValue) {
+         mDirtyGroups.set(static_cast<size_t>(getRegisterGroup(dirty.index)));
+         applyRegister(static_cast<latte::Register>(dirty.index * 4));
+      }
    }
+
+   mDirtyRegisters.clear();
 }
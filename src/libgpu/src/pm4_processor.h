@@ -1,9 +1,41 @@
 #pragma once
 #include "latte/latte_pm4_commands.h"
+#include <array>
+#include <bitset>
 #include <libcpu/pointer.h>
+#include <vector>
 
 using namespace latte::pm4;
 
+namespace gpu
+{
+struct IndexBuffer;
+}
+
+struct Pm4CommandStream;
+
+//! Pipeline state categories used to batch register changes between draws.
+enum class RegisterGroup : uint32_t
+{
+   Blend,
+   DepthStencil,
+   Raster,
+   Viewport,
+   DepthRange,
+   Scissor,
+   ColorBuffer,
+   DepthBuffer,
+   Shader,
+   StreamOut,
+   AluConst,
+   Resource,
+   Sampler,
+   Other,
+   Max,
+};
+
+using RegisterGroupSet = std::bitset<static_cast<size_t>(RegisterGroup::Max)>;
+
 class Pm4Processor
 {
 protected:
@@ -30,6 +62,16 @@ protected:
 
    void handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data);
    void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data);
+
+   //! Decode a packet which is not handled by the processor itself and call
+   //! the matching handler.
+   virtual void executePacket(HeaderType3 header, const gsl::span<uint32_t> &data);
+
+   //! Called before handling a packet which reads guest memory other than
+   //! its own command buffer, e.g. LOAD_* shadow state or DRAW_INDEX_2
+   //! indices.
+   virtual void beforeGuestMemoryRead() { }
+
    void nopPacket(const Nop &data);
    void indirectBufferCall(const IndirectBufferCall &data);
    void indexType(const IndexType &data);
@@ -60,8 +102,37 @@ protected:
                       const gsl::span<std::pair<uint32_t, uint32_t>> &registers);
 
    void setRegister(latte::Register reg, uint32_t value);
+   void setRegisters(latte::Register base, const uint32_t *values, size_t count);
+   void applyDirtyRegisters();
    void runCommandBuffer(uint32_t *buffer, uint32_t size);
 
+   //! Execute a command buffer which has already been parsed by Pm4Parser.
+   void runCommandStream(Pm4CommandStream &stream);
+
+   //! Indices converted by the parse stage for the draw packet being
+   //! executed, nullptr if they have not been converted ahead of time.
+   gpu::IndexBuffer *getPreparedIndices()
+   {
+      return mPreparedIndices;
+   }
+
+   //! True if a register in group has changed since the group was last
+   //! cleared, backends use this to only revalidate state which changed.
+   bool isRegisterGroupDirty(RegisterGroup group) const
+   {
+      return mDirtyGroups.test(static_cast<size_t>(group));
+   }
+
+   void clearRegisterGroupDirty(RegisterGroup group)
+   {
+      mDirtyGroups.reset(static_cast<size_t>(group));
+   }
+
+   void markAllRegisterGroupsDirty()
+   {
+      mDirtyGroups.set();
+   }
+
    template<typename Type>
    Type getRegister(uint32_t id)
    {
@@ -71,4 +142,26 @@ protected:
 
    latte::ShadowState mShadowState;
    std::array<uint32_t, 0x10000> mRegisters;
+
+private:
+   void writeRegister(uint32_t index, uint32_t value);
+
+   struct DirtyRegister
+   {
+      uint32_t index;
+
+      //! The value of the register when it was last applied.
+      uint32_t appliedValue;
+   };
+
+   //! Registers written since the last applyDirtyRegisters, each register
+   //! appears at most once.
+   std::vector<DirtyRegister> mDirtyRegisters;
+   std::bitset<0x10000> mRegisterIsDirty;
+   RegisterGroupSet mDirtyGroups;
+
+   //! Host order copy of the range being loaded by loadRegisters.
+   std::vector<uint32_t> mLoadBuffer;
+
+   gpu::IndexBuffer *mPreparedIndices = nullptr;
 };
@@ -0,0 +1,152 @@
+#include <catch.hpp>
+
+#include <libcpu/cpu.h>
+#include <libcpu/cpu_config.h>
+#include <libcpu/state.h>
+#include <libcpu/trace.h>
+#include <libcpu/espresso/espresso_instructionset.h>
+
+#include <cstdio>
+#include <vector>
+
+using espresso::InstructionID;
+
+static void
+traceInstruction(cpu::Core &core, espresso::Instruction instr)
+{
+   auto data = espresso::decodeInstruction(instr);
+   REQUIRE(data);
+
+   auto tracer = traceInstructionStart(instr, data, &core);
+
+   if (data->id == InstructionID::addi) {
+      core.gpr[instr.rD] = core.gpr[instr.rA] + instr.simm;
+   } else if (data->id == InstructionID::fmr) {
+      core.fpr[instr.frD].idw = core.fpr[instr.frB].idw;
+   }
+
+   traceInstructionEnd(tracer, instr, data, &core);
+}
+
+static bool
+operator ==(const Trace &lhs, const Trace &rhs)
+{
+   auto fieldsEqual = [](const auto &a, const auto &b) {
+      if (a.size() != b.size()) {
+         return false;
+      }
+
+      for (auto i = 0u; i < a.size(); ++i) {
+         if (a[i].type != b[i].type ||
+             a[i].value.u64v0 != b[i].value.u64v0) {
+            return false;
+         }
+      }
+
+      return true;
+   };
+
+   return lhs.cia == rhs.cia
+       && lhs.instr.value == rhs.instr.value
+       && fieldsEqual(lhs.reads, rhs.reads)
+       && fieldsEqual(lhs.writes, rhs.writes);
+}
+
+TEST_CASE("streamed instruction trace round trips")
+{
+   static const auto sInitialised = (espresso::initialiseInstructionSet(), true);
+   REQUIRE(sInitialised);
+
+   cpu::config::trace::enabled = true;
+   cpu::config::trace::stream_directory = ".";
+
+   // A small ring so it wraps, and is streamed, many times
+   auto tracer = cpu::allocTracer(64);
+   cpu::config::trace::enabled = false;
+   cpu::config::trace::stream_directory.clear();
+   REQUIRE(tracer);
+
+   auto path = getTracerStreamPath(tracer);
+   REQUIRE(!path.empty());
+
+   cpu::Core core { };
+   core.tracer = tracer;
+   core.cia = 0x02000000;
+
+   auto addi = espresso::encodeInstruction(InstructionID::addi);
+   addi.rD = 3;
+   addi.rA = 3;
+   addi.simm = 1;
+
+   auto fmr = espresso::encodeInstruction(InstructionID::fmr);
+   fmr.frD = 1;
+   fmr.frB = 2;
+
+   const auto numInstructions = 4096u;
+
+   for (auto i = 0u; i < numInstructions; ++i) {
+      if (i % 100 == 99) {
+         // Branch somewhere, so not every cia is sequential
+         core.cia += 0x1000;
+         core.fpr[2].idw = 0x3FF0000000000000ull + i;
+         traceInstruction(core, fmr);
+      } else {
+         core.cia += 4;
+         traceInstruction(core, addi);
+      }
+   }
+
+   auto ring = std::vector<Trace> { };
+   for (auto i = static_cast<int>(getTracerNumTraces(tracer)) - 1; i >= 0; --i) {
+      ring.push_back(getTrace(tracer, i));
+   }
+
+   cpu::freeTracer(tracer);
+
+   auto streamed = std::vector<Trace> { };
+   auto read = readTraceStream(path, streamed);
+
+   auto file = std::fopen(path.c_str(), "rb");
+   REQUIRE(file);
+   std::fseek(file, 0, SEEK_END);
+   auto fileSize = std::ftell(file);
+   std::fclose(file);
+   std::remove(path.c_str());
+
+   REQUIRE(read);
+   REQUIRE(streamed.size() == numInstructions);
+   REQUIRE(!ring.empty());
+   REQUIRE(ring.size() < streamed.size());
+
+   // The ring holds the newest records, which must match the end of the stream
+   for (auto i = 0u; i < ring.size(); ++i) {
+      REQUIRE(streamed[streamed.size() - ring.size() + i] == ring[i]);
+   }
+
+   // Every streamed record decodes back to the state it was traced with
+   auto r3 = 0u;
+
+   for (auto i = 0u; i < numInstructions; ++i) {
+      auto &trace = streamed[i];
+
+      if (i % 100 == 99) {
+         REQUIRE(trace.instr.value == fmr.value);
+         REQUIRE(trace.reads.size() == 1);
+         REQUIRE(trace.reads[0].value.u64v0 == 0x3FF0000000000000ull + i);
+         REQUIRE(trace.writes.size() == 1);
+         REQUIRE(trace.writes[0].type == StateField::FPR + 1);
+         REQUIRE(trace.writes[0].value.u64v0 == 0x3FF0000000000000ull + i);
+      } else {
+         REQUIRE(trace.instr.value == addi.value);
+         REQUIRE(trace.reads.size() == 1);
+         REQUIRE(trace.reads[0].value.u32v0 == r3);
+         REQUIRE(trace.writes.size() == 1);
+         REQUIRE(trace.writes[0].value.u32v0 == r3 + 1);
+         r3++;
+      }
+   }
+
+   // A raw sequential addi record is 17 bytes, delta encoding the read of a
+   // register written by the previous instruction makes it a single byte.
+   REQUIRE(static_cast<size_t>(fileSize) < numInstructions * 13);
+}
@@ -0,0 +1,368 @@
+#include <catch.hpp>
+
+#include <libgpu/gpu_formats.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+using gpu::formats::FormatLayout;
+using gpu::formats::Implementation;
+using latte::SQ_DATA_FORMAT;
+
+static std::vector<SQ_DATA_FORMAT>
+getFormatsWithLayout()
+{
+   auto result = std::vector<SQ_DATA_FORMAT> { };
+
+   for (auto i = 1u; i <= static_cast<uint32_t>(SQ_DATA_FORMAT::FMT_CTX1); ++i) {
+      auto format = static_cast<SQ_DATA_FORMAT>(i);
+      auto layout = FormatLayout { };
+
+      if (gpu::formats::getFormatLayout(format, layout)) {
+         result.push_back(format);
+      }
+   }
+
+   return result;
+}
+
+static uint64_t
+getComponentMask(const gpu::formats::FormatComponent &component)
+{
+   return (uint64_t { 1 } << component.bits) - 1;
+}
+
+//! Set the bits of an element which do not belong to any component to zero.
+static void
+clearPaddingBits(const FormatLayout &layout,
+                 std::vector<uint8_t> &data)
+{
+   auto elementBytes = layout.elementBits / 8;
+   auto used = std::vector<uint8_t>(elementBytes, 0);
+
+   for (auto c = 0u; c < layout.numComponents; ++c) {
+      auto &component = layout.components[c];
+
+      for (auto bit = component.offset; bit < component.offset + component.bits; ++bit) {
+         used[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+      }
+   }
+
+   for (auto i = size_t { 0 }; i < data.size(); ++i) {
+      data[i] &= used[i % elementBytes];
+   }
+}
+
+static std::vector<uint8_t>
+getRandomBytes(size_t size,
+               std::mt19937 &random)
+{
+   auto result = std::vector<uint8_t>(size);
+
+   for (auto &byte : result) {
+      byte = static_cast<uint8_t>(random());
+   }
+
+   return result;
+}
+
+//! Run fn once with each implementation supported by the host.
+template<typename Function>
+static void
+forEachImplementation(Function fn)
+{
+   auto previous = gpu::formats::getImplementation();
+
+   for (auto implementation : { Implementation::Scalar, Implementation::AVX2 }) {
+      if (gpu::formats::setImplementation(implementation)) {
+         fn(implementation);
+      }
+   }
+
+   gpu::formats::setImplementation(previous);
+}
+
+TEST_CASE("gpu::formats layouts")
+{
+   auto formats = getFormatsWithLayout();
+   REQUIRE(formats.size() == 50);
+
+   for (auto format : formats) {
+      auto layout = FormatLayout { };
+      gpu::formats::getFormatLayout(format, layout);
+      INFO("format " << static_cast<uint32_t>(format));
+
+      auto usedBits = std::vector<bool>(layout.elementBits, false);
+
+      for (auto c = 0u; c < 4; ++c) {
+         auto &component = layout.components[c];
+         REQUIRE((component.bits != 0) == (c < layout.numComponents));
+         REQUIRE(component.bits <= 32);
+         REQUIRE(component.offset + component.bits <= layout.elementBits);
+
+         for (auto bit = component.offset; bit < component.offset + component.bits; ++bit) {
+            REQUIRE(!usedBits[bit]);
+            usedBits[bit] = true;
+         }
+      }
+   }
+}
+
+TEST_CASE("gpu::formats exhaustive round trip")
+{
+   for (auto format : getFormatsWithLayout()) {
+      auto layout = FormatLayout { };
+      gpu::formats::getFormatLayout(format, layout);
+
+      if (layout.elementBits > 16) {
+         continue;
+      }
+
+      INFO("format " << static_cast<uint32_t>(format));
+
+      // Every possible element value, all of these formats use every bit
+      auto numElements = size_t { 1 } << layout.elementBits;
+      auto src = std::vector<uint8_t>((numElements * layout.elementBits + 7) / 8);
+
+      for (auto i = size_t { 0 }; i < numElements; ++i) {
+         if (layout.elementBits == 16) {
+            src[i * 2 + 0] = static_cast<uint8_t>(i);
+            src[i * 2 + 1] = static_cast<uint8_t>(i >> 8);
+         } else if (layout.elementBits == 8) {
+            src[i] = static_cast<uint8_t>(i);
+         } else {
+            src[i * layout.elementBits / 8] |= static_cast<uint8_t>(i << (i * layout.elementBits % 8));
+         }
+      }
+
+      // Elements smaller than a byte only write their own bits
+      auto components = std::vector<uint32_t>(numElements * 4);
+      auto dst = std::vector<uint8_t>(src.size(), (layout.elementBits % 8) ? 0x00 : 0xCD);
+      REQUIRE(gpu::formats::unpack(format, components.data(), src.data(), numElements));
+      REQUIRE(gpu::formats::pack(format, dst.data(), components.data(), numElements));
+      REQUIRE(dst == src);
+   }
+}
+
+TEST_CASE("gpu::formats random round trip")
+{
+   auto random = std::mt19937 { 0x1234 };
+   auto numElements = size_t { 4099 };
+
+   for (auto format : getFormatsWithLayout()) {
+      auto layout = FormatLayout { };
+      gpu::formats::getFormatLayout(format, layout);
+
+      if (layout.elementBits <= 16) {
+         continue;
+      }
+
+      INFO("format " << static_cast<uint32_t>(format));
+
+      // Elements to components and back
+      auto src = getRandomBytes(numElements * layout.elementBits / 8, random);
+      clearPaddingBits(layout, src);
+
+      auto components = std::vector<uint32_t>(numElements * 4);
+      auto dst = std::vector<uint8_t>(src.size(), 0xCD);
+      REQUIRE(gpu::formats::unpack(format, components.data(), src.data(), numElements));
+      REQUIRE(gpu::formats::pack(format, dst.data(), components.data(), numElements));
+      REQUIRE(dst == src);
+
+      // Components to elements and back
+      for (auto i = size_t { 0 }; i < components.size(); ++i) {
+         components[i] = static_cast<uint32_t>(random() & getComponentMask(layout.components[i % 4]));
+      }
+
+      auto unpacked = std::vector<uint32_t>(components.size());
+      REQUIRE(gpu::formats::pack(format, dst.data(), components.data(), numElements));
+      REQUIRE(gpu::formats::unpack(format, unpacked.data(), dst.data(), numElements));
+      REQUIRE(unpacked == components);
+   }
+}
+
+TEST_CASE("gpu::formats known values")
+{
+   forEachImplementation([](Implementation) {
+      uint16_t rgb565[] = { 0xF800, 0x07E0, 0x001F, 0x8410 };
+      uint8_t rgba8[16];
+      REQUIRE(gpu::formats::expandToRGBA8(SQ_DATA_FORMAT::FMT_5_6_5, rgba8, rgb565, 4));
+      REQUIRE(std::vector<uint8_t>(rgba8, rgba8 + 16) == std::vector<uint8_t> {
+         0xFF, 0x00, 0x00, 0xFF,
+         0x00, 0xFF, 0x00, 0xFF,
+         0x00, 0x00, 0xFF, 0xFF,
+         0x84, 0x82, 0x84, 0xFF,
+      });
+
+      // R = 0x3FF, G = 1, B = 2, A = 3
+      uint32_t rgb10a2 = (0x3FFu << 22) | (1u << 12) | (2u << 2) | 3u;
+      uint32_t a2bgr10 = 0;
+      REQUIRE(gpu::formats::convert(SQ_DATA_FORMAT::FMT_2_10_10_10, &a2bgr10,
+                                    SQ_DATA_FORMAT::FMT_10_10_10_2, &rgb10a2, 1));
+      REQUIRE(a2bgr10 == (0x3FFu | (1u << 10) | (2u << 20) | (3u << 30)));
+
+      uint32_t depthStencil = 0x12345678;
+      uint32_t depth = 0;
+      uint8_t stencil = 0;
+      REQUIRE(gpu::formats::splitDepthStencil(SQ_DATA_FORMAT::FMT_8_24, &depth, &stencil, &depthStencil, 1));
+      REQUIRE(depth == 0x345678);
+      REQUIRE(stencil == 0x12);
+
+      // In place, as the OpenGL upload of FMT_8_24 does
+      auto depthStencils = std::vector<uint32_t>(11, 0x12345678);
+      REQUIRE(gpu::formats::convert(SQ_DATA_FORMAT::FMT_24_8, depthStencils.data(),
+                                    SQ_DATA_FORMAT::FMT_8_24, depthStencils.data(),
+                                    depthStencils.size()));
+      REQUIRE(depthStencils == std::vector<uint32_t>(11, 0x34567812));
+
+      uint16_t words[] = { 0x1122, 0x3344 };
+      REQUIRE(gpu::formats::endianSwap(words, words, sizeof(words), latte::SQ_ENDIAN::SWAP_8IN16));
+      REQUIRE(words[0] == 0x2211);
+      REQUIRE(words[1] == 0x4433);
+   });
+}
+
+TEST_CASE("gpu::formats implementations match")
+{
+   if (!gpu::formats::isImplementationSupported(Implementation::AVX2)) {
+      WARN("AVX2 is not supported by this host");
+      return;
+   }
+
+   auto random = std::mt19937 { 0x5678 };
+
+   // Odd sizes so the scalar tail after the vector loop is covered
+   auto numElements = size_t { 65536 + 7 };
+   auto input = getRandomBytes(numElements * 8, random);
+
+   for (size_t i = 0; i < 65536; ++i) {
+      input[i * 2 + 0] = static_cast<uint8_t>(i);
+      input[i * 2 + 1] = static_cast<uint8_t>(i >> 8);
+   }
+
+   auto run = [&](auto kernel) {
+      auto results = std::vector<std::vector<uint8_t>> { };
+
+      forEachImplementation([&](Implementation) {
+         results.push_back(kernel());
+      });
+
+      REQUIRE(results.size() == 2);
+      REQUIRE(results[0] == results[1]);
+   };
+
+   for (auto endian : { latte::SQ_ENDIAN::SWAP_8IN16, latte::SQ_ENDIAN::SWAP_8IN32 }) {
+      run([&]() {
+         auto dst = std::vector<uint8_t>(numElements * 4);
+         REQUIRE(gpu::formats::endianSwap(dst.data(), input.data(), dst.size(), endian));
+         return dst;
+      });
+   }
+
+   for (auto format : getFormatsWithLayout()) {
+      INFO("format " << static_cast<uint32_t>(format));
+
+      run([&]() {
+         auto dst = std::vector<uint8_t>(numElements * 4);
+
+         if (!gpu::formats::expandToRGBA8(format, dst.data(), input.data(), numElements)) {
+            dst.clear();
+         }
+
+         return dst;
+      });
+   }
+
+   auto conversions = std::vector<std::pair<SQ_DATA_FORMAT, SQ_DATA_FORMAT>> {
+      { SQ_DATA_FORMAT::FMT_10_10_10_2, SQ_DATA_FORMAT::FMT_2_10_10_10 },
+      { SQ_DATA_FORMAT::FMT_2_10_10_10, SQ_DATA_FORMAT::FMT_10_10_10_2 },
+      { SQ_DATA_FORMAT::FMT_8_24, SQ_DATA_FORMAT::FMT_24_8 },
+      { SQ_DATA_FORMAT::FMT_24_8, SQ_DATA_FORMAT::FMT_8_24 },
+   };
+
+   for (auto &[dstFormat, srcFormat] : conversions) {
+      run([&]() {
+         auto dst = std::vector<uint8_t>(numElements * 4);
+         REQUIRE(gpu::formats::convert(dstFormat, dst.data(), srcFormat, input.data(), numElements));
+         return dst;
+      });
+   }
+
+   for (auto format : { SQ_DATA_FORMAT::FMT_8_24, SQ_DATA_FORMAT::FMT_24_8, SQ_DATA_FORMAT::FMT_X24_8_32_FLOAT }) {
+      run([&]() {
+         auto depth = std::vector<uint32_t>(numElements);
+         auto stencil = std::vector<uint8_t>(numElements);
+         auto merged = std::vector<uint8_t>(numElements * 8);
+         REQUIRE(gpu::formats::splitDepthStencil(format, depth.data(), stencil.data(), input.data(), numElements));
+         REQUIRE(gpu::formats::mergeDepthStencil(format, merged.data(), depth.data(), stencil.data(), numElements));
+
+         auto result = std::vector<uint8_t>(reinterpret_cast<uint8_t *>(depth.data()),
+                                            reinterpret_cast<uint8_t *>(depth.data() + numElements));
+         result.insert(result.end(), stencil.begin(), stencil.end());
+         result.insert(result.end(), merged.begin(), merged.end());
+         return result;
+      });
+   }
+}
+
+TEST_CASE("gpu::formats throughput", "[.][benchmark]")
+{
+   auto random = std::mt19937 { 0x9ABC };
+   auto numElements = size_t { 4 * 1024 * 1024 };
+   auto input = getRandomBytes(numElements * 4, random);
+   auto output = std::vector<uint8_t>(numElements * 4);
+   auto depth = std::vector<uint32_t>(numElements);
+   auto stencil = std::vector<uint8_t>(numElements);
+
+   auto measure = [&](const char *name, size_t bytes, auto kernel) {
+      forEachImplementation([&](Implementation implementation) {
+         auto iterations = 10;
+         auto begin = std::chrono::steady_clock::now();
+
+         for (auto i = 0; i < iterations; ++i) {
+            REQUIRE(kernel());
+         }
+
+         auto elapsed = std::chrono::steady_clock::now() - begin;
+         auto seconds = std::chrono::duration<double>(elapsed).count();
+         std::printf("%-24s %-6s %8.1f MB/s\n", name,
+                     implementation == Implementation::AVX2 ? "AVX2" : "Scalar",
+                     bytes * iterations / seconds / (1024.0 * 1024.0));
+      });
+   };
+
+   measure("endianSwap 8in16", numElements * 4, [&]() {
+      return gpu::formats::endianSwap(output.data(), input.data(), numElements * 4, latte::SQ_ENDIAN::SWAP_8IN16);
+   });
+
+   measure("endianSwap 8in32", numElements * 4, [&]() {
+      return gpu::formats::endianSwap(output.data(), input.data(), numElements * 4, latte::SQ_ENDIAN::SWAP_8IN32);
+   });
+
+   measure("expandToRGBA8 5_6_5", numElements * 2, [&]() {
+      return gpu::formats::expandToRGBA8(SQ_DATA_FORMAT::FMT_5_6_5, output.data(), input.data(), numElements);
+   });
+
+   measure("expandToRGBA8 4_4_4_4", numElements * 2, [&]() {
+      return gpu::formats::expandToRGBA8(SQ_DATA_FORMAT::FMT_4_4_4_4, output.data(), input.data(), numElements);
+   });
+
+   measure("convert 10_10_10_2", numElements * 4, [&]() {
+      return gpu::formats::convert(SQ_DATA_FORMAT::FMT_2_10_10_10, output.data(),
+                                   SQ_DATA_FORMAT::FMT_10_10_10_2, input.data(), numElements);
+   });
+
+   measure("splitDepthStencil 8_24", numElements * 4, [&]() {
+      return gpu::formats::splitDepthStencil(SQ_DATA_FORMAT::FMT_8_24, depth.data(), stencil.data(),
+                                             input.data(), numElements);
+   });
+
+   measure("mergeDepthStencil 8_24", numElements * 4, [&]() {
+      return gpu::formats::mergeDepthStencil(SQ_DATA_FORMAT::FMT_8_24, output.data(), depth.data(),
+                                             stencil.data(), numElements);
+   });
+}
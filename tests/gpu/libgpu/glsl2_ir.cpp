@@ -0,0 +1,355 @@
+#include <catch.hpp>
+
+#include <libgpu/src/glsl2/glsl2_ir.h>
+#include <libgpu/src/glsl2/glsl2_translate.h>
+
+#include <array>
+#include <common/bit_cast.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace latte;
+
+struct AluSrc
+{
+   SQ_ALU_SRC sel;
+   SQ_CHAN chan;
+};
+
+static AluSrc
+gpr(unsigned index, SQ_CHAN chan)
+{
+   return { static_cast<SQ_ALU_SRC>(index), chan };
+}
+
+static AluSrc
+pv(SQ_CHAN chan)
+{
+   return { SQ_ALU_SRC::PV, chan };
+}
+
+static AluSrc
+ps()
+{
+   return { SQ_ALU_SRC::PS, SQ_CHAN::X };
+}
+
+static AluSrc
+literal(SQ_CHAN chan)
+{
+   return { SQ_ALU_SRC::LITERAL, chan };
+}
+
+/**
+ * Encode an OP2 instruction writing dstGpr.chan, or only PV / PS if dstGpr
+ * is negative.
+ */
+static AluInst
+op2(SQ_OP2_INST id,
+    SQ_CHAN chan,
+    int dstGpr,
+    AluSrc src0,
+    AluSrc src1 = { SQ_ALU_SRC::IMM_0, SQ_CHAN::X },
+    bool last = false)
+{
+   auto inst = AluInst { };
+   std::memset(&inst, 0, sizeof(AluInst));
+
+   inst.word0 = inst.word0
+      .SRC0_SEL(src0.sel)
+      .SRC0_CHAN(src0.chan)
+      .SRC1_SEL(src1.sel)
+      .SRC1_CHAN(src1.chan)
+      .LAST(last);
+
+   inst.word1 = inst.word1
+      .ENCODING(SQ_ALU_ENCODING::OP2)
+      .DST_GPR(dstGpr < 0 ? 0 : dstGpr)
+      .DST_CHAN(chan);
+
+   inst.op2 = inst.op2
+      .WRITE_MASK(dstGpr >= 0)
+      .ALU_INST(id);
+
+   return inst;
+}
+
+static AluInst
+last(AluInst inst)
+{
+   inst.word0 = inst.word0
+      .LAST(true);
+   return inst;
+}
+
+static void
+addLiterals(std::vector<AluInst> &clause,
+            float x,
+            float y)
+{
+   auto values = std::array<uint32_t, 2> { bit_cast<uint32_t>(x), bit_cast<uint32_t>(y) };
+   auto slot = AluInst { };
+   std::memcpy(&slot, values.data(), sizeof(AluInst));
+   clause.push_back(slot);
+}
+
+/**
+ * A clause exercising each of the optimiser passes:
+ *
+ *   00 x: ADD   R1.x, 2.0, 1.0       folds to 3.0, read by 01 through PV.x
+ *      y: MUL   ____, R0.y, R0.y     read by 01 through PV.y
+ *      z: MOV   ____, R0.z           never read
+ *      t: MOV   ____, 4.0            folds to 4.0, read by 01 through PS
+ *   01 x: MUL   R2.x, PV.x, PS       folds to 12.0 through PV / PS
+ *      y: ADD   R2.y, PV.y, R0.x
+ *      w: MOV   R3.w, R0.w
+ *   02 x: MOV   R4.x, R4.y           swaps, so must go through PVo
+ *      y: MOV   R4.y, R4.x
+ *   03 x: MOV   R5.x, R0.x
+ */
+static std::vector<AluInst>
+makeTestClause()
+{
+   auto clause = std::vector<AluInst> { };
+   clause.push_back(op2(SQ_OP2_INST_ADD, SQ_CHAN::X, 1, literal(SQ_CHAN::X), { SQ_ALU_SRC::IMM_1, SQ_CHAN::X }));
+   clause.push_back(op2(SQ_OP2_INST_MUL, SQ_CHAN::Y, -1, gpr(0, SQ_CHAN::Y), gpr(0, SQ_CHAN::Y)));
+   clause.push_back(op2(SQ_OP2_INST_MOV, SQ_CHAN::Z, -1, gpr(0, SQ_CHAN::Z)));
+   clause.push_back(last(op2(SQ_OP2_INST_MOV, SQ_CHAN::X, -1, literal(SQ_CHAN::Y))));
+   addLiterals(clause, 2.0f, 4.0f);
+
+   clause.push_back(op2(SQ_OP2_INST_MUL, SQ_CHAN::X, 2, pv(SQ_CHAN::X), ps()));
+   clause.push_back(op2(SQ_OP2_INST_ADD, SQ_CHAN::Y, 2, pv(SQ_CHAN::Y), gpr(0, SQ_CHAN::X)));
+   clause.push_back(last(op2(SQ_OP2_INST_MOV, SQ_CHAN::W, 3, gpr(0, SQ_CHAN::W))));
+
+   clause.push_back(op2(SQ_OP2_INST_MOV, SQ_CHAN::X, 4, gpr(4, SQ_CHAN::Y)));
+   clause.push_back(last(op2(SQ_OP2_INST_MOV, SQ_CHAN::Y, 4, gpr(4, SQ_CHAN::X))));
+
+   clause.push_back(last(op2(SQ_OP2_INST_MOV, SQ_CHAN::X, 5, gpr(0, SQ_CHAN::X))));
+   return clause;
+}
+
+/**
+ * Wrap an ALU clause in a shader: an ALU CF instruction followed by a NOP
+ * which ends the program.
+ */
+static std::vector<uint8_t>
+makeShader(const std::vector<AluInst> &clause)
+{
+   auto cf = std::array<ControlFlowInst, 2> { };
+   std::memset(cf.data(), 0, sizeof(ControlFlowInst) * cf.size());
+
+   cf[0].alu.word0 = cf[0].alu.word0
+      .ADDR(static_cast<uint32_t>(cf.size()));
+   cf[0].alu.word1 = cf[0].alu.word1
+      .COUNT(static_cast<uint32_t>(clause.size() - 1))
+      .CF_INST(SQ_CF_INST_ALU);
+   cf[0].word1 = cf[0].word1
+      .CF_INST_TYPE(SQ_CF_INST_TYPE_ALU);
+
+   cf[1].word1 = cf[1].word1
+      .CF_INST(SQ_CF_INST_NOP)
+      .CF_INST_TYPE(SQ_CF_INST_TYPE_NORMAL)
+      .END_OF_PROGRAM(true);
+
+   auto binary = std::vector<uint8_t>(sizeof(ControlFlowInst) * cf.size() + sizeof(AluInst) * clause.size());
+   std::memcpy(binary.data(), cf.data(), sizeof(ControlFlowInst) * cf.size());
+   std::memcpy(binary.data() + sizeof(ControlFlowInst) * cf.size(), clause.data(), sizeof(AluInst) * clause.size());
+   return binary;
+}
+
+static std::string
+translateClause(const std::vector<AluInst> &clause,
+                bool optimise,
+                glsl2::TranslateStats *stats = nullptr)
+{
+   const auto binary = makeShader(clause);
+   auto shader = glsl2::Shader { };
+   auto error = std::string { };
+   shader.type = glsl2::Shader::PixelShader;
+   shader.optimiseAlu = optimise;
+
+   REQUIRE(glsl2::tryTranslate(shader, gsl::make_span(binary.data(), binary.size()), error));
+   REQUIRE(error.empty());
+
+   if (stats) {
+      *stats = shader.stats;
+   }
+
+   return shader.codeBody;
+}
+
+//! The GLSL statements of the body, without disassembly comments or indent.
+static std::vector<std::string>
+getStatements(const std::string &body)
+{
+   auto statements = std::vector<std::string> { };
+   auto pos = size_t { 0 };
+
+   while (pos < body.size()) {
+      auto end = body.find('\n', pos);
+      if (end == std::string::npos) {
+         end = body.size();
+      }
+
+      auto line = body.substr(pos, end - pos);
+      auto start = line.find_first_not_of(' ');
+      pos = end + 1;
+
+      if (start == std::string::npos || line.compare(start, 2, "//") == 0) {
+         continue;
+      }
+
+      statements.push_back(line.substr(start));
+   }
+
+   return statements;
+}
+
+TEST_CASE("ALU clause IR is unchanged with the optimiser off")
+{
+   auto clause = makeTestClause();
+   auto ir = glsl2::AluClauseIr { };
+   glsl2::buildAluClauseIr(ir, clause.data(), clause.size());
+
+   REQUIRE(ir.groups.size() == 4);
+   REQUIRE(ir.groups[0].nodes.size() == 4);
+   REQUIRE(ir.groups[0].literals.size() == 2);
+   REQUIRE(ir.groups[0].getUnitNode(SQ_CHAN::T) == &ir.groups[0].nodes[3]);
+
+   for (auto &group : ir.groups) {
+      REQUIRE(group.pvCopyMask == 0xF);
+
+      for (auto &node : group.nodes) {
+         REQUIRE(!node.isConstant);
+         REQUIRE(!node.isDead());
+         REQUIRE(!node.writeGprDirectly);
+      }
+   }
+
+   REQUIRE(ir.groups[0].psCopy);
+   REQUIRE(!ir.groups[1].psCopy);
+}
+
+TEST_CASE("ALU clause IR folds constants through PV and PS")
+{
+   auto clause = makeTestClause();
+   auto ir = glsl2::AluClauseIr { };
+   auto stats = glsl2::TranslateStats { };
+   glsl2::buildAluClauseIr(ir, clause.data(), clause.size());
+   glsl2::optimiseAluClauseIr(ir, stats);
+
+   auto &group0 = ir.groups[0];
+   auto &group1 = ir.groups[1];
+   auto &group2 = ir.groups[2];
+   auto &group3 = ir.groups[3];
+
+   // 2.0 + 1.0 and the PS move of 4.0 fold, 3.0 * 4.0 folds through PV / PS
+   REQUIRE(group0.nodes[0].isConstant);
+   REQUIRE(group0.nodes[0].constantValue == bit_cast<uint32_t>(3.0f));
+   REQUIRE(!group0.nodes[1].isConstant);
+   REQUIRE(group0.nodes[3].isConstant);
+   REQUIRE(group0.nodes[3].constantValue == bit_cast<uint32_t>(4.0f));
+   REQUIRE(group1.nodes[0].isConstant);
+   REQUIRE(group1.nodes[0].constantValue == bit_cast<uint32_t>(12.0f));
+   REQUIRE(!group1.nodes[1].isConstant);
+
+   uint32_t value = 0;
+   REQUIRE(glsl2::getPreviousConstant(&group0, SQ_ALU_SRC::PV, SQ_CHAN::X, value));
+   REQUIRE(value == bit_cast<uint32_t>(3.0f));
+   REQUIRE(glsl2::getPreviousConstant(&group0, SQ_ALU_SRC::PS, SQ_CHAN::X, value));
+   REQUIRE(value == bit_cast<uint32_t>(4.0f));
+   REQUIRE(!glsl2::getPreviousConstant(&group0, SQ_ALU_SRC::PV, SQ_CHAN::Y, value));
+   REQUIRE(!glsl2::getPreviousConstant(nullptr, SQ_ALU_SRC::PV, SQ_CHAN::X, value));
+
+   // Only the non-constant PV.y is still read through PV, the folded PS move
+   // and the unread z are dead.
+   REQUIRE(group0.pvCopyMask == 0x2);
+   REQUIRE(!group0.psCopy);
+   REQUIRE(group0.nodes[1].resultUsed);
+   REQUIRE(!group0.nodes[1].isDead());
+   REQUIRE(group0.nodes[2].isDead());
+   REQUIRE(group0.nodes[3].isDead());
+   REQUIRE(group1.pvCopyMask == 0);
+
+   // Results nobody reads through PV go straight to their GPR, unless
+   // another instruction in the group reads that GPR.
+   REQUIRE(group0.nodes[0].writeGprDirectly);
+   REQUIRE(!group0.nodes[1].writeGprDirectly);
+   REQUIRE(group1.nodes[0].writeGprDirectly);
+   REQUIRE(group1.nodes[1].writeGprDirectly);
+   REQUIRE(group1.nodes[2].writeGprDirectly);
+   REQUIRE(!group2.nodes[0].writeGprDirectly);
+   REQUIRE(!group2.nodes[1].writeGprDirectly);
+
+   // PV / PS are not carried out of the clause, the last group is kept as is
+   REQUIRE(group3.pvCopyMask == 0xF);
+   REQUIRE(!group3.nodes[0].writeGprDirectly);
+
+   REQUIRE(stats.aluInstructions == 10);
+   REQUIRE(stats.foldedInstructions == 3);
+   REQUIRE(stats.deadInstructions == 2);
+   REQUIRE(stats.forwardedWrites == 4);
+}
+
+TEST_CASE("ALU clause GLSL with the optimiser off")
+{
+   auto statements = getStatements(translateClause(makeTestClause(), false));
+
+   REQUIRE(statements == std::vector<std::string> {
+      "if (activeMask == Active) {",
+      "PVo.x = 2.0f + 1.0f;",
+      "PVo.y = R[0].y * R[0].y;",
+      "PVo.z = R[0].z;",
+      "PSo   = 4.0f;",
+      "R[1].x = PVo.x;",
+      "PV = PVo;",
+      "PS = PSo;",
+      "PVo.x = PV.x * PS;",
+      "PVo.y = PV.y + R[0].x;",
+      "PVo.w = R[0].w;",
+      "R[2].x = PVo.x;",
+      "R[2].y = PVo.y;",
+      "R[3].w = PVo.w;",
+      "PV = PVo;",
+      "PVo.x = R[4].y;",
+      "PVo.y = R[4].x;",
+      "R[4].x = PVo.x;",
+      "R[4].y = PVo.y;",
+      "PV = PVo;",
+      "PVo.x = R[0].x;",
+      "R[5].x = PVo.x;",
+      "PV = PVo;",
+      "}",
+   });
+}
+
+TEST_CASE("ALU clause GLSL with the optimiser on")
+{
+   auto stats = glsl2::TranslateStats { };
+   auto statements = getStatements(translateClause(makeTestClause(), true, &stats));
+
+   // Folded PV / PS reads are substituted, only PV.y is still copied and
+   // nothing reads the PV written by the swap.
+   REQUIRE(statements == std::vector<std::string> {
+      "if (activeMask == Active) {",
+      "R[1].x = 3.0f;",
+      "PVo.y = R[0].y * R[0].y;",
+      "PV.y = PVo.y;",
+      "R[2].x = 12.0f;",
+      "R[2].y = PV.y + R[0].x;",
+      "R[3].w = R[0].w;",
+      "PVo.x = R[4].y;",
+      "PVo.y = R[4].x;",
+      "R[4].x = PVo.x;",
+      "R[4].y = PVo.y;",
+      "PVo.x = R[0].x;",
+      "R[5].x = PVo.x;",
+      "PV = PVo;",
+      "}",
+   });
+
+   REQUIRE(stats.foldedInstructions == 3);
+   REQUIRE(stats.deadInstructions == 2);
+   REQUIRE(stats.forwardedWrites == 4);
+}
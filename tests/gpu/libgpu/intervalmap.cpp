@@ -0,0 +1,181 @@
+#include <catch.hpp>
+
+#include <libgpu/src/gpu_intervalmap.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+
+using Range = std::tuple<uint32_t, uint32_t, int>;
+
+static std::vector<int>
+queryIntervalMap(gpu::IntervalMap<int> &map,
+                 uint32_t start,
+                 uint32_t end)
+{
+   auto result = std::vector<int> { };
+   map.forEachOverlapping(start, end, [&](int value, uint32_t, uint32_t) {
+      result.push_back(value);
+   });
+   std::sort(result.begin(), result.end());
+   return result;
+}
+
+static std::vector<int>
+queryLinear(const std::vector<Range> &ranges,
+            uint32_t start,
+            uint32_t end)
+{
+   auto result = std::vector<int> { };
+   for (auto &[rangeStart, rangeEnd, value] : ranges) {
+      if (rangeStart < end && start < rangeEnd) {
+         result.push_back(value);
+      }
+   }
+   std::sort(result.begin(), result.end());
+   return result;
+}
+
+TEST_CASE("IntervalMap finds overlapping ranges", "[intervalmap]")
+{
+   auto map = gpu::IntervalMap<int> { };
+   map.insert(0x1000, 0x2000, 1);
+   map.insert(0x1800, 0x1900, 2);
+   map.insert(0x0000, 0x10000, 3);
+   map.insert(0x2000, 0x3000, 4);
+
+   // A range contained entirely within a query
+   REQUIRE(queryIntervalMap(map, 0x1700, 0x1A00) == std::vector<int> { 1, 2, 3 });
+
+   // A query contained entirely within a range
+   REQUIRE(queryIntervalMap(map, 0x8000, 0x8004) == std::vector<int> { 3 });
+
+   // End addresses are exclusive
+   REQUIRE(queryIntervalMap(map, 0x2000, 0x2001) == std::vector<int> { 3, 4 });
+   REQUIRE(queryIntervalMap(map, 0x10000, 0x20000).empty());
+
+   REQUIRE(map.erase(0x0000, 0x10000, 3));
+   REQUIRE(!map.erase(0x0000, 0x10000, 3));
+   REQUIRE(queryIntervalMap(map, 0x8000, 0x8004).empty());
+   REQUIRE(map.size() == 3);
+}
+
+TEST_CASE("IntervalMap matches a linear scan", "[intervalmap]")
+{
+   std::mt19937 rng { 0x1234 };
+
+   for (auto trial = 0; trial < 20000; ++trial) {
+      auto map = gpu::IntervalMap<int> { };
+      auto ranges = std::vector<Range> { };
+      auto numRanges = std::uniform_int_distribution<int> { 0, 70 }(rng);
+      auto address = std::uniform_int_distribution<uint32_t> { 0, 1000 };
+      auto length = std::uniform_int_distribution<uint32_t> { 1, 100 };
+
+      for (auto i = 0; i < numRanges; ++i) {
+         auto start = address(rng);
+         auto end = start + length(rng);
+         map.insert(start, end, i);
+         ranges.emplace_back(start, end, i);
+      }
+
+      // Erase some to exercise rebuilding a previously built index
+      if (!ranges.empty() && (trial & 1)) {
+         map.size();
+         auto erase = std::uniform_int_distribution<size_t> { 0, ranges.size() - 1 }(rng);
+         auto [start, end, value] = ranges[erase];
+         REQUIRE(map.erase(start, end, value));
+         ranges.erase(ranges.begin() + erase);
+      }
+
+      for (auto query = 0; query < 8; ++query) {
+         auto start = address(rng);
+         auto end = start + length(rng);
+         auto expected = std::vector<Range> { };
+         auto found = std::vector<Range> { };
+
+         for (auto &range : ranges) {
+            if (std::get<0>(range) < end && start < std::get<1>(range)) {
+               expected.push_back(range);
+            }
+         }
+
+         map.forEachOverlapping(start, end, [&](int value, uint32_t rangeStart, uint32_t rangeEnd) {
+            found.emplace_back(rangeStart, rangeEnd, value);
+         });
+
+         std::sort(expected.begin(), expected.end());
+         std::sort(found.begin(), found.end());
+         REQUIRE(found == expected);
+      }
+   }
+}
+
+/*
+ * Replays the flush pattern of a typical frame: a few hundred large render
+ * targets and textures (many of which alias the same memory), thousands of
+ * small uniform and attribute buffers and shaders, then many small DCFlush
+ * ranges from the CPU updating buffers with the occasional large texture
+ * upload flush.
+ *
+ * Run with: test-libgpu "[benchmark]"
+ */
+TEST_CASE("IntervalMap flush replay", "[.][benchmark][intervalmap]")
+{
+   auto rng = std::mt19937 { 0x5678 };
+   auto map = gpu::IntervalMap<int> { };
+   auto ranges = std::vector<Range> { };
+   const auto heapStart = 0x30000000u;
+   const auto heapSize = 0x20000000u;
+
+   for (auto i = 0; i < 400; ++i) {
+      auto start = heapStart + (rng() % (heapSize / 0x1000)) * 0x1000;
+      auto size = 0x100000u + (rng() % 0x700000u);
+      ranges.emplace_back(start, start + size, i);
+   }
+
+   for (auto i = 400; i < 8000; ++i) {
+      auto start = heapStart + (rng() % (heapSize / 0x100)) * 0x100;
+      auto size = 0x40u + (rng() % 0x4000u);
+      ranges.emplace_back(start, start + size, i);
+   }
+
+   for (auto &[start, end, value] : ranges) {
+      map.insert(start, end, value);
+   }
+
+   auto flushes = std::vector<std::pair<uint32_t, uint32_t>> { };
+
+   for (auto i = 0; i < 100000; ++i) {
+      auto start = heapStart + (rng() % (heapSize / 0x40)) * 0x40;
+      auto size = (i % 64) ? 0x40u + (rng() % 0x1000u) : 0x100000u;
+      flushes.emplace_back(start, start + size);
+   }
+
+   auto hits = size_t { 0 };
+   auto begin = std::chrono::steady_clock::now();
+
+   for (auto &[start, end] : flushes) {
+      map.forEachOverlapping(start, end, [&](int, uint32_t, uint32_t) { ++hits; });
+   }
+
+   auto elapsed = std::chrono::steady_clock::now() - begin;
+   auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+   auto linearHits = size_t { 0 };
+   auto linearBegin = std::chrono::steady_clock::now();
+
+   for (auto &[start, end] : flushes) {
+      linearHits += queryLinear(ranges, start, end).size();
+   }
+
+   auto linearElapsed = std::chrono::steady_clock::now() - linearBegin;
+   auto linearNs = std::chrono::duration_cast<std::chrono::nanoseconds>(linearElapsed).count();
+
+   std::printf("%zu ranges, %zu flushes, %zu hits\n", ranges.size(), flushes.size(), hits);
+   std::printf("IntervalMap: %.1f ns per flush\n", static_cast<double>(ns) / flushes.size());
+   std::printf("Linear scan: %.1f ns per flush\n", static_cast<double>(linearNs) / flushes.size());
+   REQUIRE(hits == linearHits);
+}
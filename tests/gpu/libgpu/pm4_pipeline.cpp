@@ -0,0 +1,126 @@
+#include <catch.hpp>
+
+#include "test_pm4_processor.h"
+
+#include <libgpu/latte/latte_pm4_sizer.h>
+#include <libgpu/latte/latte_pm4_writer.h>
+#include <libgpu/src/pm4_pipeline.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace latte::pm4;
+
+template<typename Type>
+static void
+writePM4(std::vector<uint32_t> &buffer,
+         const Type &value)
+{
+   auto &ncValue = const_cast<Type &>(value);
+
+   PacketSizer sizer;
+   ncValue.serialise(sizer);
+   auto totalSize = sizer.getSize() + 1;
+
+   auto size = static_cast<uint32_t>(buffer.size());
+   buffer.resize(size + totalSize);
+
+   auto writer = PacketWriter { buffer.data(), size, Type::Opcode, totalSize };
+   ncValue.serialise(writer);
+}
+
+/**
+ * A command buffer which draws with each kind of index source, with a
+ * MEM_WRITE before a draw which reads its indices from guest memory.
+ */
+static std::vector<uint32_t>
+buildCommandBuffer(phys_addr indices)
+{
+   auto buffer = std::vector<uint32_t> { };
+   auto primType = std::vector<uint32_t> { latte::VGT_DI_PRIMITIVE_TYPE::TRILIST };
+   auto viewport = std::vector<uint32_t> { 0x3F800000, 0x40000000 };
+   auto immediate = std::vector<uint32_t> { 0x00010000, 0x00030002 };
+
+   writePM4(buffer, SetConfigRegs {
+      latte::Register::VGT_PRIMITIVE_TYPE,
+      gsl::make_span(primType)
+   });
+
+   writePM4(buffer, SetContextRegs {
+      latte::Register::PA_CL_VPORT_XSCALE_0,
+      gsl::make_span(viewport)
+   });
+
+   writePM4(buffer, IndexType { latte::VGT_DMA_INDEX_TYPE::get(0).INDEX_TYPE(latte::VGT_INDEX_TYPE::INDEX_16) });
+   writePM4(buffer, NumInstances { 3 });
+   writePM4(buffer, DrawIndexAuto { 6, latte::VGT_DRAW_INITIATOR::get(0) });
+
+   writePM4(buffer, MemWrite {
+      MW_ADDR_LO::get(0).ADDR_LO((indices.getAddress() + 0x100) >> 2),
+      MW_ADDR_HI::get(0).DATA32(true),
+      0x12345678,
+      0
+   });
+
+   viewport[1] = 0x40400000;
+   writePM4(buffer, SetContextRegs {
+      latte::Register::PA_CL_VPORT_XSCALE_0,
+      gsl::make_span(viewport)
+   });
+
+   writePM4(buffer, NumInstances { 2 });
+   writePM4(buffer, DrawIndex2 { 3, indices, 3, latte::VGT_DRAW_INITIATOR::get(0) });
+
+   writePM4(buffer, NumInstances { 1 });
+   writePM4(buffer, DrawIndexImmd { 4, latte::VGT_DRAW_INITIATOR::get(0), gsl::make_span(immediate) });
+   return buffer;
+}
+
+TEST_CASE("parsed command streams replay like a direct run")
+{
+   REQUIRE(initialiseTestMemory());
+
+   // Big endian 16 bit indices for DRAW_INDEX_2
+   const uint8_t indexData[] = { 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00 };
+   auto indices = phys_addr { 0x01200000 };
+   std::memcpy(phys_cast<uint8_t *>(indices).getRawPointer(), indexData, sizeof(indexData));
+
+   auto buffer = buildCommandBuffer(indices);
+   auto guestBuffer = phys_cast<uint32_t *>(phys_addr { 0x01300000 });
+   std::memcpy(guestBuffer.getRawPointer(), buffer.data(), buffer.size() * sizeof(uint32_t));
+
+   // Run the command buffer directly
+   auto direct = TestPm4Processor { };
+   direct.runCommandBuffer(buffer.data(), static_cast<uint32_t>(buffer.size()));
+   REQUIRE(direct.draws.size() == 3);
+
+   // Parse it, splitting where the parser has to sync, then replay it
+   auto indexBufferCache = gpu::IndexBufferCache { };
+   auto streams = std::vector<std::unique_ptr<Pm4CommandStream>> { };
+   streams.emplace_back(std::make_unique<Pm4CommandStream>());
+
+   auto parser = Pm4Parser {
+      indexBufferCache,
+      [&](Pm4CommandStream *) {
+         streams.emplace_back(std::make_unique<Pm4CommandStream>());
+         return streams.back().get();
+      }
+   };
+
+   auto item = gpu::ringbuffer::Item { nullptr, guestBuffer, static_cast<uint32_t>(buffer.size()) };
+   REQUIRE(parser.parse(item, streams.front().get()) == streams.back().get());
+
+   // The MEM_WRITE must execute before DRAW_INDEX_2 reads guest memory
+   REQUIRE(streams.size() == 2);
+   REQUIRE(!streams[0]->retireItem);
+   REQUIRE(streams[1]->retireItem);
+
+   auto replay = TestPm4Processor { };
+   for (auto &stream : streams) {
+      replay.runCommandStream(*stream);
+   }
+
+   REQUIRE(replay.draws == direct.draws);
+   REQUIRE(replay.mRegisters == direct.mRegisters);
+}
@@ -0,0 +1,96 @@
+#include <catch.hpp>
+
+#include "test_pm4_processor.h"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+TEST_CASE("LOAD_* packets read big endian shadow memory")
+{
+   REQUIRE(initialiseTestMemory());
+
+   // Shadow memory as GX2 writes it, two ranges of context registers
+   const uint8_t blob[] = {
+      0x12, 0x34, 0x56, 0x78,
+      0x9A, 0xBC, 0xDE, 0xF0,
+      0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x01,
+   };
+
+   auto address = phys_addr { 0x01000000 };
+   std::memcpy(phys_cast<uint8_t *>(address).getRawPointer(), blob, sizeof(blob));
+
+   auto ranges = std::vector<std::pair<uint32_t, uint32_t>> {
+      { 0, 2 },
+      { 4, 1 },
+   };
+
+   auto pm4 = TestPm4Processor { };
+   pm4.loadRegisters(latte::Register::ContextRegisterBase, address, gsl::make_span(ranges));
+   REQUIRE(pm4.getRegister<uint32_t>(latte::Register::ContextRegisterBase + 0) == 0x12345678u);
+   REQUIRE(pm4.getRegister<uint32_t>(latte::Register::ContextRegisterBase + 4) == 0x9ABCDEF0u);
+   REQUIRE(pm4.getRegister<uint32_t>(latte::Register::ContextRegisterBase + 16) == 0x00000001u);
+
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.applied.size() == 3);
+
+   // Loading the same state again changes nothing
+   pm4.applied.clear();
+   pm4.loadRegisters(latte::Register::ContextRegisterBase, address, gsl::make_span(ranges));
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.applied.empty());
+
+   // A direct guest write to shadow memory is seen by the next load
+   phys_cast<uint32_t *>(address)[1] = 0x11223344u;
+   pm4.loadRegisters(latte::Register::ContextRegisterBase, address, gsl::make_span(ranges));
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.getRegister<uint32_t>(latte::Register::ContextRegisterBase + 4) == 0x11223344u);
+   REQUIRE(pm4.applied == std::vector<latte::Register> {
+      static_cast<latte::Register>(latte::Register::ContextRegisterBase + 4)
+   });
+}
+
+TEST_CASE("register changes are batched until they are needed")
+{
+   auto pm4 = TestPm4Processor { };
+   auto viewport = std::vector<uint32_t> { 1, 2, 3, 4 };
+   pm4.setRegisters(latte::Register::PA_CL_VPORT_XSCALE_0, viewport.data(), viewport.size());
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.applied.size() == 4);
+   REQUIRE(pm4.isRegisterGroupDirty(RegisterGroup::Viewport));
+   REQUIRE(!pm4.isRegisterGroupDirty(RegisterGroup::Blend));
+
+   // Rewriting the same block applies nothing
+   pm4.applied.clear();
+   pm4.setRegisters(latte::Register::PA_CL_VPORT_XSCALE_0, viewport.data(), viewport.size());
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.applied.empty());
+
+   // Only the register which changed is applied
+   viewport[2] = 5;
+   pm4.setRegisters(latte::Register::PA_CL_VPORT_XSCALE_0, viewport.data(), viewport.size());
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.applied == std::vector<latte::Register> {
+      static_cast<latte::Register>(latte::Register::PA_CL_VPORT_XSCALE_0 + 8)
+   });
+
+   // A register changed and then restored before it is needed is not
+   // applied, one changed twice is applied once
+   pm4.applied.clear();
+   auto blend = uint32_t { 0x3F800000 };
+   auto restored = viewport[0];
+   viewport[0] = 7;
+   pm4.setRegisters(latte::Register::PA_CL_VPORT_XSCALE_0, viewport.data(), viewport.size());
+   pm4.setRegisters(latte::Register::CB_BLEND_RED, &blend, 1);
+   blend = 0x3F000000;
+   pm4.setRegisters(latte::Register::CB_BLEND_RED, &blend, 1);
+   viewport[0] = restored;
+   pm4.setRegisters(latte::Register::PA_CL_VPORT_XSCALE_0, viewport.data(), viewport.size());
+   REQUIRE(pm4.applied.empty());
+
+   pm4.applyDirtyRegisters();
+   REQUIRE(pm4.applied == std::vector<latte::Register> { latte::Register::CB_BLEND_RED });
+   REQUIRE(pm4.getRegister<uint32_t>(latte::Register::CB_BLEND_RED) == 0x3F000000u);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <libgpu/src/pm4_processor.h>
+#include <libcpu/mmu.h>
+
+#include <vector>
+
+/**
+ * A Pm4Processor with no backend, it records the registers which would have
+ * been applied to the backend and the draw packets it was asked to execute.
+ */
+class TestPm4Processor : public Pm4Processor
+{
+public:
+   using Pm4Processor::applyDirtyRegisters;
+   using Pm4Processor::getRegister;
+   using Pm4Processor::isRegisterGroupDirty;
+   using Pm4Processor::loadRegisters;
+   using Pm4Processor::mRegisters;
+   using Pm4Processor::runCommandBuffer;
+   using Pm4Processor::runCommandStream;
+   using Pm4Processor::setRegisters;
+
+   TestPm4Processor()
+   {
+      mRegisters.fill(0);
+   }
+
+   struct Draw
+   {
+      IT_OPCODE opcode;
+      uint32_t count;
+      uint32_t indexType;
+      uint32_t numInstances;
+
+      bool operator ==(const Draw &other) const
+      {
+         return opcode == other.opcode
+             && count == other.count
+             && indexType == other.indexType
+             && numInstances == other.numInstances;
+      }
+   };
+
+   std::vector<latte::Register> applied;
+   std::vector<Draw> draws;
+
+protected:
+   void decafSetBuffer(const DecafSetBuffer &) override { }
+   void decafCopyColorToScan(const DecafCopyColorToScan &) override { }
+   void decafSwapBuffers(const DecafSwapBuffers &) override { }
+   void decafCapSyncRegisters(const DecafCapSyncRegisters &) override { }
+   void decafClearColor(const DecafClearColor &) override { }
+   void decafClearDepthStencil(const DecafClearDepthStencil &) override { }
+   void decafDebugMarker(const DecafDebugMarker &) override { }
+   void decafOSScreenFlip(const DecafOSScreenFlip &) override { }
+   void decafCopySurface(const DecafCopySurface &) override { }
+   void decafSetSwapInterval(const DecafSetSwapInterval &) override { }
+   void memWrite(const MemWrite &) override { }
+   void eventWrite(const EventWrite &) override { }
+   void eventWriteEOP(const EventWriteEOP &) override { }
+   void pfpSyncMe(const PfpSyncMe &) override { }
+   void streamOutBaseUpdate(const StreamOutBaseUpdate &) override { }
+   void streamOutBufferUpdate(const StreamOutBufferUpdate &) override { }
+   void surfaceSync(const SurfaceSync &) override { }
+
+   void drawIndexAuto(const DrawIndexAuto &data) override
+   {
+      recordDraw(IT_OPCODE::DRAW_INDEX_AUTO, data.count);
+   }
+
+   void drawIndex2(const DrawIndex2 &data) override
+   {
+      recordDraw(IT_OPCODE::DRAW_INDEX_2, data.count);
+   }
+
+   void drawIndexImmd(const DrawIndexImmd &data) override
+   {
+      recordDraw(IT_OPCODE::DRAW_INDEX_IMMD, data.count);
+   }
+
+   void applyRegister(latte::Register reg) override
+   {
+      applied.push_back(reg);
+   }
+
+private:
+   void recordDraw(IT_OPCODE opcode, uint32_t count)
+   {
+      draws.push_back({
+         opcode,
+         count,
+         getRegister<uint32_t>(latte::Register::VGT_DMA_INDEX_TYPE),
+         getRegister<uint32_t>(latte::Register::VGT_DMA_NUM_INSTANCES),
+      });
+   }
+};
+
+//! Guest physical memory for tests which need the GPU to read from it.
+inline bool
+initialiseTestMemory()
+{
+   static const auto sInitialised = cpu::initialiseMemory();
+   return sInitialised;
+}
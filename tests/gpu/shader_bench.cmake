@@ -0,0 +1,18 @@
+# Assembles the test shaders into a gsh and runs them through shader-bench,
+# which fails if any of them can not be translated to GLSL.
+execute_process(COMMAND ${LATTE_ASSEMBLER} compile
+                   --vsh ${SHADER_DIR}/pos_colour.vsh
+                   --psh ${SHADER_DIR}/pos_colour.psh
+                   pos_colour.gsh
+                RESULT_VARIABLE RESULT)
+
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "latte-assembler failed: ${RESULT}")
+endif()
+
+execute_process(COMMAND ${SHADER_BENCH} --threads 2 --iterations 4 run pos_colour.gsh
+                RESULT_VARIABLE RESULT)
+
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "shader-bench failed: ${RESULT}")
+endif()
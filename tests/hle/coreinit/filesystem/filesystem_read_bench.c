@@ -0,0 +1,131 @@
+#include <hle_test.h>
+#include <coreinit/filesystem.h>
+#include <coreinit/time.h>
+#include <stdio.h>
+
+/*
+ * Reads every file under /vol/content and reports the read throughput, once
+ * with sequential FSReadFile and once with FSReadFileWithPos.
+ *
+ * Point decaf-cli at a real title's content with --content-path to measure
+ * something more interesting than the test content.
+ */
+
+#define ChunkSize (1024 * 1024)
+#define MaxPath 512
+
+static uint8_t sBuffer[ChunkSize] __attribute__((aligned(0x40)));
+
+FSClient sClient;
+FSCmdBlock sCmdBlock;
+
+typedef struct
+{
+   uint64_t bytes;
+   uint32_t files;
+   OSTime ticks;
+} ReadStats;
+
+static void
+readFile(const char *path,
+         BOOL withPos,
+         ReadStats *stats)
+{
+   FSFileHandle fh;
+   FSStatus status;
+   OSTime start;
+   uint32_t pos = 0;
+
+   status = FSOpenFile(&sClient, &sCmdBlock, path, "r", &fh, -1);
+   test_eq(status, FS_STATUS_OK);
+
+   start = OSGetTime();
+
+   while (1) {
+      if (withPos) {
+         status = FSReadFileWithPos(&sClient, &sCmdBlock, sBuffer, 1, ChunkSize, pos, fh, 0, -1);
+      } else {
+         status = FSReadFile(&sClient, &sCmdBlock, sBuffer, 1, ChunkSize, fh, 0, -1);
+      }
+
+      test_assert(status >= 0);
+
+      if (status == 0) {
+         break;
+      }
+
+      pos += status;
+   }
+
+   stats->ticks += OSGetTime() - start;
+   stats->bytes += pos;
+   stats->files++;
+
+   test_eq(FSCloseFile(&sClient, &sCmdBlock, fh, -1), FS_STATUS_OK);
+}
+
+static void
+readDirectory(const char *path,
+              BOOL withPos,
+              ReadStats *stats)
+{
+   FSDirectoryHandle dh;
+   FSDirectoryEntry entry;
+   char childPath[MaxPath];
+
+   test_eq(FSOpenDir(&sClient, &sCmdBlock, path, &dh, -1), FS_STATUS_OK);
+
+   while (FSReadDir(&sClient, &sCmdBlock, dh, &entry, -1) == FS_STATUS_OK) {
+      snprintf(childPath, sizeof(childPath), "%s/%s", path, entry.name);
+
+      if (entry.info.flags & FS_STAT_DIRECTORY) {
+         readDirectory(childPath, withPos, stats);
+      } else {
+         readFile(childPath, withPos, stats);
+      }
+   }
+
+   test_eq(FSCloseDir(&sClient, &sCmdBlock, dh, -1), FS_STATUS_OK);
+}
+
+static void
+reportStats(const char *name,
+            ReadStats *stats)
+{
+   uint64_t us = OSTicksToMicroseconds(stats->ticks);
+
+   test_report("%s: %u files, %llu bytes in %llu us, %llu MB/s",
+               name,
+               stats->files,
+               stats->bytes,
+               us,
+               us ? stats->bytes / us : 0);
+}
+
+int main(int argc, char **argv)
+{
+   ReadStats sequential = { 0 };
+   ReadStats withPos = { 0 };
+
+   FSInit();
+   FSAddClient(&sClient, 0);
+   FSInitCmdBlock(&sCmdBlock);
+
+   // Once to warm the host page cache, then once each way to measure
+   readDirectory("/vol/content", FALSE, &sequential);
+
+   sequential.bytes = 0;
+   sequential.files = 0;
+   sequential.ticks = 0;
+   readDirectory("/vol/content", FALSE, &sequential);
+   readDirectory("/vol/content", TRUE, &withPos);
+
+   test_gt(sequential.files, 0);
+   test_eq(sequential.bytes, withPos.bytes);
+   reportStats("FSReadFile", &sequential);
+   reportStats("FSReadFileWithPos", &withPos);
+
+   FSDelClient(&sClient, 0);
+   FSShutdown();
+   return 0;
+}
@@ -0,0 +1,67 @@
+#include <hle_test.h>
+#include <coreinit/filesystem.h>
+#include <string.h>
+
+/*
+ * Reads short_text.txt in small chunks and checks the file position follows
+ * the data which was read.
+ *
+ * This is recorded with --replay-record and then played back with
+ * --replay-playback against a different short_text.txt, the guest must still
+ * see the recorded contents and a file position which matches them.
+ */
+
+#define ChunkSize 2
+
+static const char sExpected[] = "decaf";
+
+int main(int argc, char **argv)
+{
+   FSClient client;
+   FSCmdBlock cmdBlock;
+   FSFileHandle fh;
+   FSStatus status;
+   char buffer[64];
+   uint32_t total = 0;
+   uint32_t pos = 0;
+
+   FSInit();
+   FSAddClient(&client, 0);
+   FSInitCmdBlock(&cmdBlock);
+
+   status = FSOpenFile(&client, &cmdBlock, "/vol/content/short_text.txt", "r", &fh, -1);
+   test_eq(status, FS_STATUS_OK);
+
+   while (1) {
+      status = FSReadFile(&client, &cmdBlock, buffer + total, 1, ChunkSize, fh, 0, -1);
+      test_assert(status >= 0);
+
+      total += status;
+      test_eq(FSGetPosFile(&client, &cmdBlock, fh, &pos, -1), FS_STATUS_OK);
+      test_report("FSReadFile read %d bytes, position %u", status, pos);
+      test_eq(pos, total);
+
+      if (status == 0) {
+         break;
+      }
+
+      test_assert(total + ChunkSize < sizeof(buffer));
+   }
+
+   buffer[total] = 0;
+   test_report("Read \"%s\"", buffer);
+   test_eq(total, strlen(sExpected));
+   test_eq(strcmp(buffer, sExpected), 0);
+
+   // A positional read leaves the position at the end of what it read
+   status = FSReadFileWithPos(&client, &cmdBlock, buffer, 1, ChunkSize, 1, fh, 0, -1);
+   test_eq(status, ChunkSize);
+   test_eq(FSGetPosFile(&client, &cmdBlock, fh, &pos, -1), FS_STATUS_OK);
+   test_eq(pos, 1 + ChunkSize);
+   test_eq(memcmp(buffer, sExpected + 1, ChunkSize), 0);
+
+   test_eq(FSCloseFile(&client, &cmdBlock, fh, -1), FS_STATUS_OK);
+   FSDelClient(&client, 0);
+   FSShutdown();
+   return 0;
+}
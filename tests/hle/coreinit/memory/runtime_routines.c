@@ -0,0 +1,143 @@
+#include <hle_test.h>
+#include <string.h>
+
+/*
+ * Checks the statically linked runtime routines which decaf can replace with
+ * host versions (system.hle_replace_routines), the results must be the same
+ * whether or not they are replaced.
+ */
+
+#define BufferSize 256
+
+static uint8_t sBuffer[BufferSize];
+static char sString[BufferSize];
+static char sOther[BufferSize];
+
+// Sizes are read through volatile so the compiler calls the routines rather
+// than inlining them.
+static volatile uint32_t sZero = 0;
+
+static uint32_t
+size(uint32_t value)
+{
+   return value + sZero;
+}
+
+static void
+fillPattern()
+{
+   int i;
+
+   for (i = 0; i < BufferSize; ++i) {
+      sBuffer[i] = (uint8_t)i;
+   }
+}
+
+static void
+testMemcpy()
+{
+   int i;
+
+   fillPattern();
+   test_eq(memcpy(sBuffer + 128, sBuffer, size(100)), sBuffer + 128);
+
+   for (i = 0; i < 100; ++i) {
+      test_eq(sBuffer[128 + i], (uint8_t)i);
+   }
+
+   test_eq(sBuffer[228], 228);
+
+   // Copying to a lower overlapping address, which guest code relies on
+   fillPattern();
+   memcpy(sBuffer, sBuffer + 3, size(200));
+
+   for (i = 0; i < 200; ++i) {
+      test_eq(sBuffer[i], (uint8_t)(i + 3));
+   }
+
+   test_eq(sBuffer[200], 200);
+
+   // Zero sized copies touch nothing
+   fillPattern();
+   memcpy(sBuffer, sBuffer + 1, size(0));
+   test_eq(sBuffer[0], 0);
+}
+
+static void
+testMemmove()
+{
+   int i;
+
+   fillPattern();
+   test_eq(memmove(sBuffer + 5, sBuffer, size(200)), sBuffer + 5);
+
+   for (i = 0; i < 200; ++i) {
+      test_eq(sBuffer[5 + i], (uint8_t)i);
+   }
+
+   for (i = 0; i < 5; ++i) {
+      test_eq(sBuffer[i], (uint8_t)i);
+   }
+
+   fillPattern();
+   memmove(sBuffer, sBuffer + 7, size(200));
+
+   for (i = 0; i < 200; ++i) {
+      test_eq(sBuffer[i], (uint8_t)(i + 7));
+   }
+}
+
+static void
+testMemset()
+{
+   int i;
+
+   fillPattern();
+   test_eq(memset(sBuffer + 1, 0x1AB, size(100)), sBuffer + 1);
+   test_eq(sBuffer[0], 0);
+
+   for (i = 1; i <= 100; ++i) {
+      test_eq(sBuffer[i], 0xAB);
+   }
+
+   test_eq(sBuffer[101], 101);
+}
+
+static void
+testStrings()
+{
+   memset(sString, 0, sizeof(sString));
+   memset(sOther, 0, sizeof(sOther));
+   memset(sString, 'a', size(37));
+   memset(sOther, 'a', size(37));
+
+   test_eq(strlen(sString), 37);
+   test_eq(strlen(sString + 37), 0);
+   test_eq(strcmp(sString, sOther), 0);
+
+   sOther[20] = 'b';
+   test_gt(0, strcmp(sString, sOther));
+   test_gt(strcmp(sOther, sString), 0);
+   test_eq(strncmp(sString, sOther, size(20)), 0);
+   test_gt(0, strncmp(sString, sOther, size(21)));
+
+   // Characters compare as unsigned
+   sOther[20] = (char)0xE0;
+   test_gt(0, strcmp(sString, sOther));
+
+   // A shorter string compares lower
+   sOther[20] = 'a';
+   sOther[37] = 'a';
+   test_gt(0, strcmp(sString, sOther));
+   test_eq(strncmp(sString, sOther, size(37)), 0);
+   test_eq(strncmp(sString, sOther, size(0)), 0);
+}
+
+int main(int argc, char **argv)
+{
+   testMemcpy();
+   testMemmove();
+   testMemset();
+   testStrings();
+   return 0;
+}
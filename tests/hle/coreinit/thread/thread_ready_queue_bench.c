@@ -0,0 +1,120 @@
+#include <hle_test.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+/*
+ * Benchmarks the scheduler run queues with many ready threads of mixed
+ * priority and affinity.
+ *
+ * Core 0 and core 2 are kept busy by a priority 0 thread each, and the main
+ * thread runs at priority 0 on core 1, so every worker stays ready in the run
+ * queues. The main thread then requeues them by changing their priority.
+ * Once the busy threads are released the workers yield to each other.
+ */
+
+#define NumWorkers 96
+#define NumRequeues 100000
+#define NumYields 1000
+#define StackSize 4096
+
+static const uint32_t sAffinities[] = {
+   OS_THREAD_ATTRIB_AFFINITY_CPU0,
+   OS_THREAD_ATTRIB_AFFINITY_CPU1,
+   OS_THREAD_ATTRIB_AFFINITY_CPU2,
+   OS_THREAD_ATTRIB_AFFINITY_ANY,
+};
+
+OSThread sWorkers[NumWorkers];
+uint8_t sWorkerStacks[NumWorkers][StackSize];
+
+OSThread sBusyThreads[2];
+uint8_t sBusyStacks[2][StackSize];
+
+volatile BOOL sBusyRunning[2];
+volatile BOOL sReleaseBusy;
+
+int busyThreadEntry(int argc, const char **argv)
+{
+   sBusyRunning[argc] = TRUE;
+
+   while (!sReleaseBusy) {
+   }
+
+   return 0;
+}
+
+int workerThreadEntry(int argc, const char **argv)
+{
+   int i;
+
+   for (i = 0; i < NumYields; ++i) {
+      OSYieldThread();
+   }
+
+   return 0;
+}
+
+static int
+workerPriority(int index)
+{
+   return 1 + (index * 7) % 31;
+}
+
+int main(int argc, char **argv)
+{
+   OSTime start, end;
+   int i;
+
+   test_eq(OSSetThreadPriority(OSGetCurrentThread(), 0), TRUE);
+
+   OSCreateThread(&sBusyThreads[0], busyThreadEntry, 0, NULL, sBusyStacks[0] + StackSize,
+                  StackSize, 0, OS_THREAD_ATTRIB_AFFINITY_CPU0);
+   OSCreateThread(&sBusyThreads[1], busyThreadEntry, 1, NULL, sBusyStacks[1] + StackSize,
+                  StackSize, 0, OS_THREAD_ATTRIB_AFFINITY_CPU2);
+   OSResumeThread(&sBusyThreads[0]);
+   OSResumeThread(&sBusyThreads[1]);
+
+   while (!sBusyRunning[0] || !sBusyRunning[1]) {
+      OSYieldThread();
+   }
+
+   for (i = 0; i < NumWorkers; ++i) {
+      OSCreateThread(&sWorkers[i], workerThreadEntry, 0, NULL, sWorkerStacks[i] + StackSize,
+                     StackSize, workerPriority(i), sAffinities[i % 4]);
+      OSResumeThread(&sWorkers[i]);
+   }
+
+   // Every worker is now ready but none can run, requeue them
+   start = OSGetTime();
+
+   for (i = 0; i < NumRequeues; ++i) {
+      OSSetThreadPriority(&sWorkers[i % NumWorkers], workerPriority(i * 13));
+   }
+
+   end = OSGetTime();
+
+   test_report("%d requeues with %d ready threads in %lld us, %lld ns per requeue",
+               NumRequeues,
+               NumWorkers,
+               OSTicksToMicroseconds(end - start),
+               OSTicksToNanoseconds(end - start) / NumRequeues);
+
+   // Let the workers run, they yield between threads of the same priority
+   start = OSGetTime();
+   sReleaseBusy = TRUE;
+
+   for (i = 0; i < NumWorkers; ++i) {
+      test_eq(OSJoinThread(&sWorkers[i], NULL), TRUE);
+   }
+
+   end = OSGetTime();
+   test_eq(OSJoinThread(&sBusyThreads[0], NULL), TRUE);
+   test_eq(OSJoinThread(&sBusyThreads[1], NULL), TRUE);
+
+   test_report("%d yields across %d threads in %lld us, %lld ns per yield",
+               NumWorkers * NumYields,
+               NumWorkers,
+               OSTicksToMicroseconds(end - start),
+               OSTicksToNanoseconds(end - start) / (NumWorkers * NumYields));
+   return 0;
+}
@@ -0,0 +1,62 @@
+#include <hle_test.h>
+#include <coreinit/messagequeue.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+#define NumIterations 100000
+#define StackSize 4096
+
+OSMessageQueue sPingQueue;
+OSMessage sPingMessages[1];
+
+OSMessageQueue sPongQueue;
+OSMessage sPongMessages[1];
+
+OSThread sThread;
+uint8_t sThreadStack[StackSize];
+
+int pongThreadEntry(int argc, const char **argv)
+{
+   OSMessage msg;
+   int i;
+
+   for (i = 0; i < NumIterations; ++i) {
+      test_eq(OSReceiveMessage(&sPingQueue, &msg, OS_MESSAGE_FLAGS_BLOCKING), TRUE);
+      test_eq(OSSendMessage(&sPongQueue, &msg, OS_MESSAGE_FLAGS_BLOCKING), TRUE);
+   }
+
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   OSMessage msg;
+   OSTime start, end;
+   int i;
+
+   OSInitMessageQueue(&sPingQueue, sPingMessages, 1);
+   OSInitMessageQueue(&sPongQueue, sPongMessages, 1);
+
+   // Run both threads on the same core so every message is a context switch
+   OSCreateThread(&sThread, pongThreadEntry, 0, NULL, sThreadStack + StackSize,
+                  StackSize, 16, OS_THREAD_ATTRIB_AFFINITY_CPU1);
+   OSResumeThread(&sThread);
+
+   start = OSGetTime();
+
+   for (i = 0; i < NumIterations; ++i) {
+      msg.message = (void *)i;
+      test_eq(OSSendMessage(&sPingQueue, &msg, OS_MESSAGE_FLAGS_BLOCKING), TRUE);
+      test_eq(OSReceiveMessage(&sPongQueue, &msg, OS_MESSAGE_FLAGS_BLOCKING), TRUE);
+      test_eq(msg.message, (void *)i);
+   }
+
+   end = OSGetTime();
+   test_eq(OSJoinThread(&sThread, NULL), TRUE);
+
+   test_report("%d context switches in %lld us, %lld ns per switch",
+               NumIterations * 2,
+               OSTicksToMicroseconds(end - start),
+               OSTicksToNanoseconds(end - start) / (NumIterations * 2));
+   return 0;
+}
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <common/platform.h>
+#include <common/platform_dir.h>
+#include <cstdlib>
+#include <excmd.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <gsl.h>
+#include <iostream>
+#include <libgfd/gfd.h>
+#include <libgpu/latte/latte_constants.h>
+#include <libgpu/latte/latte_disassembler.h>
+#include <libgpu/src/glsl2/glsl2_translate.h>
+#include <libgpu/src/opengl/opengl_constants.h>
+#include <map>
+#include <spdlog/sinks/stdout_sinks.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_WINDOWS
+#include <common/platform_winapi_string.h>
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+using Clock = std::chrono::steady_clock;
+
+struct CorpusShader
+{
+   //! File the shader came from, with an index for shaders inside a gsh.
+   std::string name;
+   glsl2::Shader::Type type;
+   std::vector<uint8_t> binary;
+   std::array<latte::SQ_TEX_DIM, 16> samplerDim;
+   bool uniformBlocks = false;
+};
+
+struct ShaderResult
+{
+   bool translated = false;
+   std::string error;
+   size_t disassemblyBytes = 0;
+   size_t outputBytes = 0;
+   glsl2::TranslateStats stats;
+   std::string glsl;
+};
+
+struct BenchOptions
+{
+   unsigned threads = 1;
+   unsigned iterations = 1;
+   bool optimise = true;
+   bool keepGlsl = false;
+};
+
+static bool
+readFile(const std::string &path,
+         std::vector<uint8_t> &buff)
+{
+   std::ifstream ifs { path, std::ios::in | std::ios::binary };
+   if (ifs.fail()) {
+      return false;
+   }
+
+   buff.resize(static_cast<size_t>(ifs.seekg(0, std::ios::end).tellg()));
+   if (!buff.empty()) {
+      ifs.seekg(0, std::ios::beg).read(reinterpret_cast<char *>(buff.data()), static_cast<std::streamsize>(buff.size()));
+   }
+
+   return true;
+}
+
+static bool
+endsWith(const std::string &str,
+         const std::string &suffix)
+{
+   return str.size() >= suffix.size()
+       && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::vector<std::string>
+listDirectory(const std::string &path)
+{
+   std::vector<std::string> files;
+
+#ifdef PLATFORM_WINDOWS
+   WIN32_FIND_DATAW data;
+   auto handle = FindFirstFileW(platform::toWinApiString(path + "\\*").c_str(), &data);
+
+   if (handle == INVALID_HANDLE_VALUE) {
+      return files;
+   }
+
+   do {
+      if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+         files.push_back(path + "/" + platform::fromWinApiString(data.cFileName));
+      }
+   } while (FindNextFileW(handle, &data));
+
+   FindClose(handle);
+#else
+   auto dir = opendir(path.c_str());
+
+   if (!dir) {
+      return files;
+   }
+
+   while (auto entry = readdir(dir)) {
+      auto filePath = path + "/" + entry->d_name;
+
+      if (platform::isFile(filePath)) {
+         files.push_back(filePath);
+      }
+   }
+
+   closedir(dir);
+#endif
+
+   std::sort(files.begin(), files.end());
+   return files;
+}
+
+static latte::SQ_TEX_DIM
+getSamplerDim(cafe::gx2::GX2SamplerVarType type)
+{
+   switch (type) {
+   case cafe::gx2::GX2SamplerVarType::Sampler1D:
+      return latte::SQ_TEX_DIM::DIM_1D;
+   case cafe::gx2::GX2SamplerVarType::Sampler3D:
+      return latte::SQ_TEX_DIM::DIM_3D;
+   case cafe::gx2::GX2SamplerVarType::SamplerCube:
+      return latte::SQ_TEX_DIM::DIM_CUBEMAP;
+   case cafe::gx2::GX2SamplerVarType::Sampler2D:
+   default:
+      return latte::SQ_TEX_DIM::DIM_2D;
+   }
+}
+
+template<typename GfdShader>
+static void
+addGfdShader(std::vector<CorpusShader> &corpus,
+             const std::string &name,
+             glsl2::Shader::Type type,
+             const GfdShader &gfdShader)
+{
+   auto shader = CorpusShader { };
+   shader.name = name;
+   shader.type = type;
+   shader.binary = gfdShader.data;
+   shader.samplerDim.fill(latte::SQ_TEX_DIM::DIM_2D);
+   shader.uniformBlocks = gfdShader.mode == cafe::gx2::GX2ShaderMode::UniformBlock;
+
+   for (auto &sampler : gfdShader.samplerVars) {
+      if (sampler.location < shader.samplerDim.size()) {
+         shader.samplerDim[sampler.location] = getSamplerDim(sampler.type);
+      }
+   }
+
+   corpus.push_back(std::move(shader));
+}
+
+static bool
+loadGsh(std::vector<CorpusShader> &corpus,
+        const std::string &path)
+{
+   gfd::GFDFile file;
+
+   try {
+      if (!gfd::readFile(file, path)) {
+         return false;
+      }
+   } catch (gfd::GFDReadException ex) {
+      gLog->error("Error reading gfd {}: {}", path, ex.what());
+      return false;
+   }
+
+   for (auto i = 0u; i < file.vertexShaders.size(); ++i) {
+      addGfdShader(corpus, fmt::format("{}:vertex{}", path, i), glsl2::Shader::VertexShader, file.vertexShaders[i]);
+   }
+
+   for (auto i = 0u; i < file.pixelShaders.size(); ++i) {
+      addGfdShader(corpus, fmt::format("{}:pixel{}", path, i), glsl2::Shader::PixelShader, file.pixelShaders[i]);
+   }
+
+   for (auto i = 0u; i < file.geometryShaders.size(); ++i) {
+      addGfdShader(corpus, fmt::format("{}:geometry{}", path, i), glsl2::Shader::GeometryShader, file.geometryShaders[i]);
+   }
+
+   return true;
+}
+
+/**
+ * Raw binaries are expected to be named like the gpu.dump_shaders output,
+ * e.g. gpu_pixel_0x12345678.bin, which is how we know their type.
+ */
+static bool
+loadBinary(std::vector<CorpusShader> &corpus,
+           const std::string &path)
+{
+   auto shader = CorpusShader { };
+   auto filename = path.substr(path.find_last_of("/\\") + 1);
+
+   if (filename.find("fetch") != std::string::npos) {
+      // Fetch shaders are subroutines of a vertex shader
+      return true;
+   } else if (filename.find("pixel") != std::string::npos) {
+      shader.type = glsl2::Shader::PixelShader;
+   } else if (filename.find("geometry") != std::string::npos) {
+      shader.type = glsl2::Shader::GeometryShader;
+   } else if (filename.find("vertex") != std::string::npos) {
+      shader.type = glsl2::Shader::VertexShader;
+   } else {
+      gLog->warn("Skipping {}, unable to determine shader type from name", path);
+      return true;
+   }
+
+   if (!readFile(path, shader.binary)) {
+      gLog->error("Could not read {}", path);
+      return false;
+   }
+
+   shader.name = path;
+   shader.samplerDim.fill(latte::SQ_TEX_DIM::DIM_2D);
+   shader.uniformBlocks = true;
+   corpus.push_back(std::move(shader));
+   return true;
+}
+
+static bool
+loadPath(std::vector<CorpusShader> &corpus,
+         const std::string &path)
+{
+   if (platform::isDirectory(path)) {
+      for (auto &file : listDirectory(path)) {
+         if (endsWith(file, ".gsh") || endsWith(file, ".bin")) {
+            if (!loadPath(corpus, file)) {
+               return false;
+            }
+         }
+      }
+
+      return true;
+   }
+
+   if (endsWith(path, ".gsh")) {
+      return loadGsh(corpus, path);
+   } else {
+      return loadBinary(corpus, path);
+   }
+}
+
+static void
+benchShader(const CorpusShader &shader,
+            const BenchOptions &options,
+            ShaderResult &result)
+{
+   auto binary = gsl::make_span(shader.binary.data(), shader.binary.size());
+   result.disassemblyBytes = latte::disassemble(binary).size();
+
+   auto glslShader = glsl2::Shader { };
+   glslShader.type = shader.type;
+   glslShader.samplerDim = shader.samplerDim;
+   glslShader.uniformBlocksEnabled = shader.uniformBlocks;
+   glslShader.uniformRegistersEnabled = !shader.uniformBlocks;
+   glslShader.optimiseAlu = options.optimise;
+
+   result.error.clear();
+   result.translated = glsl2::tryTranslate(glslShader, binary, result.error);
+
+   if (result.translated) {
+      result.outputBytes = glslShader.fileHeader.size()
+                         + glslShader.codeHeader.size()
+                         + glslShader.codeBody.size();
+      result.stats = glslShader.stats;
+
+      if (options.keepGlsl) {
+         result.glsl = glslShader.fileHeader
+                     + "void main()\n{\n"
+                     + glslShader.codeHeader
+                     + glslShader.codeBody
+                     + "}\n";
+      }
+   }
+}
+
+static double
+runBench(const std::vector<CorpusShader> &corpus,
+         const BenchOptions &options,
+         std::vector<ShaderResult> &results)
+{
+   auto start = Clock::now();
+   results.clear();
+   results.resize(corpus.size());
+
+   for (auto iteration = 0u; iteration < options.iterations; ++iteration) {
+      auto next = std::atomic<size_t> { 0 };
+      auto workers = std::vector<std::thread> { };
+
+      for (auto i = 0u; i < options.threads; ++i) {
+         workers.emplace_back([&]() {
+            for (auto index = next++; index < corpus.size(); index = next++) {
+               benchShader(corpus[index], options, results[index]);
+            }
+         });
+      }
+
+      for (auto &worker : workers) {
+         worker.join();
+      }
+   }
+
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Compile the translated shaders with an external reference compiler such
+ * as glslangValidator, which is run as "<validator> <file>".
+ */
+static unsigned
+validateShaders(const std::vector<CorpusShader> &corpus,
+                const std::vector<ShaderResult> &results,
+                const std::string &validator)
+{
+   auto failures = 0u;
+   platform::createDirectory("shader-bench");
+
+   for (auto i = 0u; i < corpus.size(); ++i) {
+      auto extension = "vert";
+
+      if (!results[i].translated) {
+         continue;
+      }
+
+      if (corpus[i].type == glsl2::Shader::PixelShader) {
+         extension = "frag";
+      } else if (corpus[i].type == glsl2::Shader::GeometryShader) {
+         // These need an input / output layout from the driver
+         continue;
+      }
+
+      auto path = fmt::format("shader-bench/{}.{}", i, extension);
+
+      {
+         std::ofstream file { path, std::ofstream::out };
+         file << results[i].glsl;
+      }
+
+      auto command = fmt::format("\"{}\" \"{}\"", validator, path);
+
+      if (std::system(command.c_str()) != 0) {
+         std::cout << "Validation failed: " << corpus[i].name << " (" << path << ")" << std::endl;
+         ++failures;
+      }
+   }
+
+   return failures;
+}
+
+static void
+printReport(const std::vector<CorpusShader> &corpus,
+            const std::vector<ShaderResult> &results,
+            const BenchOptions &options,
+            double seconds)
+{
+   auto translated = size_t { 0 };
+   auto inputBytes = size_t { 0 };
+   auto disassemblyBytes = size_t { 0 };
+   auto outputBytes = size_t { 0 };
+   auto stats = glsl2::TranslateStats { };
+   auto failures = std::map<std::string, std::vector<std::string>> { };
+
+   for (auto i = 0u; i < corpus.size(); ++i) {
+      auto &result = results[i];
+      inputBytes += corpus[i].binary.size();
+      disassemblyBytes += result.disassemblyBytes;
+
+      if (!result.translated) {
+         failures[result.error].push_back(corpus[i].name);
+         continue;
+      }
+
+      translated++;
+      outputBytes += result.outputBytes;
+      stats.aluInstructions += result.stats.aluInstructions;
+      stats.deadInstructions += result.stats.deadInstructions;
+      stats.foldedInstructions += result.stats.foldedInstructions;
+      stats.forwardedWrites += result.stats.forwardedWrites;
+   }
+
+   auto shadersRun = static_cast<double>(corpus.size()) * options.iterations;
+
+   fmt::print("Shaders:           {} ({} translated, {} failed)\n", corpus.size(), translated, corpus.size() - translated);
+   fmt::print("Threads:           {}\n", options.threads);
+   fmt::print("Iterations:        {}\n", options.iterations);
+   fmt::print("ALU optimisation:  {}\n", options.optimise ? "on" : "off");
+   fmt::print("Time:              {:.3f} s\n", seconds);
+   fmt::print("Throughput:        {:.1f} shaders/s\n", shadersRun / seconds);
+   fmt::print("Input bytes:       {}\n", inputBytes);
+   fmt::print("Disassembly bytes: {}\n", disassemblyBytes);
+   fmt::print("GLSL bytes:        {} ({:.0f} per shader)\n", outputBytes, translated ? static_cast<double>(outputBytes) / translated : 0.0);
+
+   if (options.optimise) {
+      fmt::print("ALU instructions:  {}\n", stats.aluInstructions);
+      fmt::print("  dead:            {}\n", stats.deadInstructions);
+      fmt::print("  folded:          {}\n", stats.foldedInstructions);
+      fmt::print("  forwarded:       {}\n", stats.forwardedWrites);
+   }
+
+   if (failures.empty()) {
+      return;
+   }
+
+   // Most common failure first
+   auto sorted = std::vector<std::pair<std::string, std::vector<std::string>>> { failures.begin(), failures.end() };
+   std::sort(sorted.begin(), sorted.end(), [](auto &lhs, auto &rhs) {
+      return lhs.second.size() > rhs.second.size();
+   });
+
+   fmt::print("\nFailures:\n");
+
+   for (auto &[error, names] : sorted) {
+      fmt::print("  {:>5}  {}\n", names.size(), error);
+      fmt::print("         e.g. {}\n", names.front());
+   }
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+
+   // Setup command line options
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." })
+      .add_option("threads",
+                  excmd::description { "Number of threads to translate on, defaults to the number of cores." },
+                  excmd::value<unsigned> {})
+      .add_option("iterations",
+                  excmd::description { "Number of times to translate the whole corpus." },
+                  excmd::value<unsigned> {})
+      .add_option("no-optimise",
+                  excmd::description { "Disable the ALU clause optimiser." })
+      .add_option("validate",
+                  excmd::description { "Compile the generated GLSL with this reference compiler, e.g. glslangValidator." },
+                  excmd::value<std::string> {});
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("run")
+      .add_argument("path", excmd::value<std::string> { });
+
+   // Parse command line
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      return -1;
+   }
+
+   // Print help
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("shader-bench", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("shader-bench") << std::endl;
+      }
+
+      return 0;
+   }
+
+   if (!options.has("run")) {
+      return -1;
+   }
+
+   gLog = std::make_shared<spdlog::logger>("shader-bench",
+                                           std::make_shared<spdlog::sinks::stdout_sink_mt>());
+
+   // There is no OpenGL context to query the real limit from
+   opengl::MaxUniformBlockSize = latte::MaxUniformBlockSize;
+
+   auto benchOptions = BenchOptions { };
+   benchOptions.threads = std::max(1u, std::thread::hardware_concurrency());
+   benchOptions.optimise = !options.has("no-optimise");
+   benchOptions.keepGlsl = options.has("validate");
+
+   if (options.has("threads")) {
+      benchOptions.threads = std::max(1u, options.get<unsigned>("threads"));
+   }
+
+   if (options.has("iterations")) {
+      benchOptions.iterations = std::max(1u, options.get<unsigned>("iterations"));
+   }
+
+   auto corpus = std::vector<CorpusShader> { };
+
+   if (!loadPath(corpus, options.get<std::string>("path"))) {
+      return -1;
+   }
+
+   if (corpus.empty()) {
+      std::cout << "No shaders found" << std::endl;
+      return -1;
+   }
+
+   auto results = std::vector<ShaderResult> { };
+   auto seconds = runBench(corpus, benchOptions, results);
+   printReport(corpus, results, benchOptions, seconds);
+
+   auto failed = std::any_of(results.begin(), results.end(),
+                             [](const ShaderResult &result) { return !result.translated; });
+
+   if (options.has("validate")) {
+      auto validator = options.get<std::string>("validate");
+
+      if (validateShaders(corpus, results, validator)) {
+         failed = true;
+      }
+   }
+
+   return failed ? 1 : 0;
+}
@@ -0,0 +1,344 @@
+#include <filesystem/filesystem_archive.h>
+#include <filesystem/filesystem_archive_format.h>
+#include <filesystem/filesystem_host_folderhandle.h>
+#include <filesystem/filesystem_host_path.h>
+
+#include <algorithm>
+#include <common/align.h>
+#include <common/platform_dir.h>
+#include <deque>
+#include <excmd.h>
+#include <fstream>
+#include <iostream>
+#include <spdlog/sinks/stdout_sinks.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+struct PackNode
+{
+   std::string name;
+   fs::HostPath hostPath;
+   bool folder = false;
+   uint64_t size = 0;
+   std::vector<PackNode> children;
+};
+
+struct PackOptions
+{
+   bool compress = false;
+   uint32_t blockSize = 64 * 1024;
+};
+
+static bool
+scanFolder(PackNode &node)
+{
+   auto handle = fs::HostFolderHandle { node.hostPath };
+   auto entry = fs::FolderEntry { };
+
+   if (!handle.open()) {
+      std::cout << "Could not open folder " << node.hostPath.path() << std::endl;
+      return false;
+   }
+
+   while (handle.read(entry)) {
+      auto child = PackNode { };
+      child.name = entry.name;
+      child.hostPath = node.hostPath.join(entry.name);
+      child.folder = (entry.type == fs::FolderEntry::Folder);
+      child.size = entry.size;
+
+      if (child.folder && !scanFolder(child)) {
+         return false;
+      }
+
+      node.children.emplace_back(std::move(child));
+   }
+
+   // Children must be sorted by name so the emulator can binary search them
+   std::sort(node.children.begin(), node.children.end(),
+             [](const PackNode &lhs, const PackNode &rhs) {
+                return lhs.name < rhs.name;
+             });
+   return true;
+}
+
+static void
+alignOutput(std::ofstream &out,
+            uint64_t alignment)
+{
+   auto pos = static_cast<uint64_t>(out.tellp());
+   auto padding = align_up(pos, alignment) - pos;
+   static const char zeroes[fs::ArchiveDataAlignment] = { 0 };
+
+   while (padding) {
+      auto count = std::min<uint64_t>(padding, sizeof(zeroes));
+      out.write(zeroes, static_cast<std::streamsize>(count));
+      padding -= count;
+   }
+}
+
+static bool
+writeFileData(std::ofstream &out,
+              const PackNode &node,
+              const PackOptions &options,
+              fs::ArchiveEntry &entry)
+{
+   std::ifstream in { node.hostPath.path(), std::ios::in | std::ios::binary };
+
+   if (!in.is_open()) {
+      std::cout << "Could not open file " << node.hostPath.path() << std::endl;
+      return false;
+   }
+
+   alignOutput(out, fs::ArchiveDataAlignment);
+   entry.offset = static_cast<uint64_t>(out.tellp());
+   entry.size = node.size;
+
+   if (!options.compress) {
+      std::vector<char> buffer(options.blockSize);
+
+      for (auto remaining = node.size; remaining > 0; ) {
+         auto count = std::min<uint64_t>(remaining, buffer.size());
+         in.read(buffer.data(), static_cast<std::streamsize>(count));
+         out.write(buffer.data(), static_cast<std::streamsize>(count));
+         remaining -= count;
+      }
+
+      return !in.fail();
+   }
+
+   auto blockOffsets = std::vector<uint64_t> { };
+   auto buffer = std::vector<Bytef>(options.blockSize);
+   auto compressed = std::vector<Bytef>(compressBound(options.blockSize));
+
+   for (auto remaining = node.size; remaining > 0; ) {
+      auto count = std::min<uint64_t>(remaining, options.blockSize);
+      in.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(count));
+
+      auto compressedSize = static_cast<uLongf>(compressed.size());
+      auto result = compress2(compressed.data(), &compressedSize,
+                              buffer.data(), static_cast<uLong>(count),
+                              Z_BEST_COMPRESSION);
+
+      blockOffsets.push_back(static_cast<uint64_t>(out.tellp()));
+
+      if (result == Z_OK && compressedSize < count) {
+         out.write(reinterpret_cast<char *>(compressed.data()), compressedSize);
+      } else {
+         // Stored sizes equal to the block size mean uncompressed data
+         out.write(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(count));
+      }
+
+      remaining -= count;
+   }
+
+   blockOffsets.push_back(static_cast<uint64_t>(out.tellp()));
+   alignOutput(out, sizeof(uint64_t));
+
+   entry.flags |= fs::ArchiveEntryCompressed;
+   entry.numBlocks = static_cast<uint32_t>(blockOffsets.size() - 1);
+   entry.offset = static_cast<uint64_t>(out.tellp());
+   out.write(reinterpret_cast<char *>(blockOffsets.data()),
+             static_cast<std::streamsize>(blockOffsets.size() * sizeof(uint64_t)));
+   return !in.fail();
+}
+
+static bool
+packTitle(const std::string &src,
+          const std::string &dst,
+          const PackOptions &options)
+{
+   auto root = PackNode { };
+   root.folder = true;
+   root.hostPath = src;
+
+   // Accept both the title folder and its data subfolder
+   if (!platform::isFile(root.hostPath.join("code").join("cos.xml").path()) &&
+       platform::isFile(root.hostPath.join("data").join("code").join("cos.xml").path())) {
+      root.hostPath = root.hostPath.join("data");
+   }
+
+   if (!scanFolder(root)) {
+      return false;
+   }
+
+   // Flatten the tree breadth first so every folder's children are contiguous
+   auto nodes = std::vector<const PackNode *> { &root };
+   auto entries = std::vector<fs::ArchiveEntry> { };
+   auto names = std::string { };
+
+   for (auto i = size_t { 0 }; i < nodes.size(); ++i) {
+      auto node = nodes[i];
+      auto entry = fs::ArchiveEntry { };
+      entry.nameOffset = static_cast<uint32_t>(names.size());
+      entry.nameLength = static_cast<uint32_t>(node->name.size());
+      names += node->name;
+
+      if (node->folder) {
+         entry.flags = fs::ArchiveEntryFolder;
+         entry.firstChild = static_cast<uint32_t>(nodes.size());
+         entry.numChildren = static_cast<uint32_t>(node->children.size());
+
+         for (auto &child : node->children) {
+            nodes.push_back(&child);
+         }
+      }
+
+      entries.push_back(entry);
+   }
+
+   auto header = fs::ArchiveHeader { };
+   header.magic = fs::ArchiveMagic;
+   header.version = fs::ArchiveVersion;
+   header.numEntries = static_cast<uint32_t>(entries.size());
+   header.blockSize = options.blockSize;
+   header.entriesOffset = sizeof(fs::ArchiveHeader);
+   header.namesOffset = header.entriesOffset + entries.size() * sizeof(fs::ArchiveEntry);
+   header.namesSize = names.size();
+
+   std::ofstream out { dst, std::ios::out | std::ios::binary | std::ios::trunc };
+
+   if (!out.is_open()) {
+      std::cout << "Could not open " << dst << " for writing" << std::endl;
+      return false;
+   }
+
+   // Reserve space for the index, it is rewritten once data offsets are known
+   out.write(reinterpret_cast<char *>(&header), sizeof(header));
+   out.write(reinterpret_cast<char *>(entries.data()),
+             static_cast<std::streamsize>(entries.size() * sizeof(fs::ArchiveEntry)));
+   out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+   for (auto i = size_t { 0 }; i < nodes.size(); ++i) {
+      if (!nodes[i]->folder && !writeFileData(out, *nodes[i], options, entries[i])) {
+         return false;
+      }
+   }
+
+   out.seekp(static_cast<std::streamoff>(header.entriesOffset));
+   out.write(reinterpret_cast<char *>(entries.data()),
+             static_cast<std::streamsize>(entries.size() * sizeof(fs::ArchiveEntry)));
+
+   if (out.fail()) {
+      std::cout << "Error writing " << dst << std::endl;
+      return false;
+   }
+
+   std::cout << "Packed " << entries.size() << " entries into " << dst << std::endl;
+   return true;
+}
+
+static void
+printFolder(const fs::Archive &archive,
+            uint32_t index,
+            const std::string &path)
+{
+   auto &folder = archive.entry(index);
+
+   for (auto i = 0u; i < folder.numChildren; ++i) {
+      auto child = folder.firstChild + i;
+      auto &entry = archive.entry(child);
+      auto childPath = path + "/" + std::string { archive.name(child) };
+
+      if (archive.isFolder(child)) {
+         std::cout << childPath << "/" << std::endl;
+         printFolder(archive, child, childPath);
+      } else {
+         std::cout << childPath << " " << entry.size;
+
+         if (entry.flags & fs::ArchiveEntryCompressed) {
+            std::cout << " (" << entry.numBlocks << " compressed blocks)";
+         }
+
+         std::cout << std::endl;
+      }
+   }
+}
+
+static bool
+listArchive(const std::string &path)
+{
+   auto archive = fs::Archive::open(path);
+
+   if (!archive) {
+      return false;
+   }
+
+   printFolder(*archive, 0, "");
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   int result = -1;
+   excmd::parser parser;
+   excmd::option_state options;
+
+   // Setup command line options
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." });
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("pack")
+      .add_option("compress",
+                  excmd::description { "Compress file data with zlib." })
+      .add_option("block-size",
+                  excmd::description { "Size of compressed blocks in bytes." },
+                  excmd::value<unsigned> { })
+      .add_argument("src", excmd::value<std::string> { })
+      .add_argument("dst", excmd::value<std::string> { });
+
+   parser.add_command("list")
+      .add_argument("archive", excmd::value<std::string> { });
+
+   // Parse command line
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   // Print help
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("title-archive", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("title-archive") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   gLog = std::make_shared<spdlog::logger>("title-archive",
+                                           std::make_shared<spdlog::sinks::stdout_sink_mt>());
+
+   if (options.has("pack")) {
+      auto packOptions = PackOptions { };
+      packOptions.compress = options.has("compress");
+
+      if (options.has("block-size")) {
+         packOptions.blockSize = options.get<unsigned>("block-size");
+      }
+
+      if (packOptions.blockSize == 0) {
+         std::cout << "Block size must be non-zero" << std::endl;
+         return -1;
+      }
+
+      result = packTitle(options.get<std::string>("src"),
+                         options.get<std::string>("dst"),
+                         packOptions) ? 0 : -1;
+   } else if (options.has("list")) {
+      result = listArchive(options.get<std::string>("archive")) ? 0 : -1;
+   }
+
+   return result;
+}